@@ -0,0 +1,95 @@
+//===- CombPathsAnalysis.h - HW combinational path analysis -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This header file defines an analysis of the combinational paths between the
+// ports of the modules of a design in the HW, Comb, Seq, and SV dialects.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_ANALYSIS_COMB_PATHS_ANALYSIS_H
+#define CIRCT_ANALYSIS_COMB_PATHS_ANALYSIS_H
+
+#include "circt/Dialect/HW/HWOpInterfaces.h"
+#include "circt/Support/LLVM.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace mlir {
+class AnalysisManager;
+} // namespace mlir
+
+namespace circt {
+namespace analysis {
+
+/// A summary of the combinational paths through a module. The depth of a path
+/// is the number of Comb operations along it, including the operations of the
+/// modules it goes through.
+struct ModuleCombPaths {
+  /// For every input port of the module, the set of output ports it has a
+  /// combinational path to.
+  SmallVector<llvm::BitVector> paths;
+
+  /// For every input port and output port, the depth of the longest path
+  /// between them, or zero if there is no path.
+  SmallVector<SmallVector<unsigned>> pathDepths;
+
+  /// For every input port, the depth of the longest path from it to a
+  /// register or an output port.
+  SmallVector<unsigned> inputDepths;
+
+  /// For every output port, the depth of the longest path to it from a
+  /// register or an input port.
+  SmallVector<unsigned> outputDepths;
+
+  /// The depth of the longest path in the module.
+  unsigned longestPath = 0;
+
+  /// Whether the body of the module contains a combinational cycle, taking the
+  /// paths through the modules it instantiates into account. The depths of a
+  /// module with a cycle are zero.
+  bool hasCycle = false;
+};
+
+/// CombPathsAnalysis summarizes the combinational paths between the ports of
+/// every `hw.module` of a design. The modules are summarized in parallel, one
+/// level of the instance graph at a time, such that the paths through the
+/// instances of a module are known when the module is summarized.
+///
+/// Registers (`seq.compreg`) and the assignments of an `sv.alwaysff`, an
+/// `sv.initial` or an edge-triggered `sv.always` break combinational paths,
+/// continuous assignments (`sv.assign`) and the assignments of an
+/// `sv.alwayscomb` do not. Paths start at the registers, including the
+/// `sv.reg`s which are only assigned in these sequential regions. External and
+/// generated modules are assumed to have no combinational paths.
+///
+/// To use this class, retrieve a cached copy from the analysis manager:
+///   auto &combPaths = getAnalysis<CombPathsAnalysis>();
+class CombPathsAnalysis {
+public:
+  /// Summarize the modules of a design. This must be called on the operation
+  /// holding the modules, i.e. an `mlir::ModuleOp`.
+  CombPathsAnalysis(Operation *operation, mlir::AnalysisManager &am);
+
+  /// Return the summary of a module.
+  const ModuleCombPaths &getCombPaths(hw::HWModuleLike module) const;
+
+  /// Return true if there is a combinational path from an input port to an
+  /// output port of a module.
+  bool hasCombPath(hw::HWModuleLike module, unsigned inputPort,
+                   unsigned outputPort) const {
+    return getCombPaths(module).paths[inputPort].test(outputPort);
+  }
+
+private:
+  DenseMap<Operation *, ModuleCombPaths> summaries;
+};
+
+} // namespace analysis
+} // namespace circt
+
+#endif // CIRCT_ANALYSIS_COMB_PATHS_ANALYSIS_H
@@ -18,22 +18,57 @@
 
 namespace circt {
 
-std::unique_ptr<mlir::Pass> createExportVerilogPass(llvm::raw_ostream &os);
+/// A cache of the Verilog emitted for individual modules. The text of a module
+/// is looked up by a key covering the module after its preparation for
+/// emission, the interface of the modules it instantiates, the operations it
+/// references by symbol, and the lowering options. It is only emitted if the
+/// lookup fails, and then stored under the same key. The cache is called from
+/// the threads emitting the modules in parallel.
+class ExportVerilogModuleCache {
+public:
+  virtual ~ExportVerilogModuleCache() = default;
+
+  /// Return the text cached for the given key, if any.
+  virtual llvm::Optional<std::string> lookup(llvm::StringRef key) = 0;
+
+  /// Store the text emitted for the given key.
+  virtual void store(llvm::StringRef key, llvm::StringRef text) = 0;
+};
+
+std::unique_ptr<mlir::Pass>
+createExportVerilogPass(llvm::raw_ostream &os,
+                        ExportVerilogModuleCache *moduleCache = nullptr);
 std::unique_ptr<mlir::Pass> createExportVerilogPass();
 
 std::unique_ptr<mlir::Pass>
-createExportSplitVerilogPass(llvm::StringRef directory = "./");
+createExportSplitVerilogPass(llvm::StringRef directory = "./",
+                             bool skipUnchangedFiles = false);
 
 /// Export a module containing HW, and SV dialect code. Requires that the SV
-/// dialect is loaded in to the context.
-mlir::LogicalResult exportVerilog(mlir::ModuleOp module, llvm::raw_ostream &os);
+/// dialect is loaded in to the context. If a module cache is given, the text of
+/// the modules is reused from it when possible.
+mlir::LogicalResult
+exportVerilog(mlir::ModuleOp module, llvm::raw_ostream &os,
+              ExportVerilogModuleCache *moduleCache = nullptr);
+
+/// The number of files produced by `exportSplitVerilog`, split between the
+/// ones which were written and the unchanged ones which were left untouched.
+struct SplitExportStatistics {
+  unsigned numFilesWritten = 0;
+  unsigned numFilesReused = 0;
+};
 
 /// Export a module containing HW, and SV dialect code, as one file per SV
 /// module. Requires that the SV dialect is loaded in to the context.
 ///
-/// Files are created in the directory indicated by \p dirname.
-mlir::LogicalResult exportSplitVerilog(mlir::ModuleOp module,
-                                       llvm::StringRef dirname);
+/// Files are created in the directory indicated by \p dirname. If
+/// \p skipUnchangedFiles is set, the files whose contents did not change are
+/// not rewritten, which preserves their modification time for incremental
+/// builds.
+mlir::LogicalResult
+exportSplitVerilog(mlir::ModuleOp module, llvm::StringRef dirname,
+                   bool skipUnchangedFiles = false,
+                   SplitExportStatistics *statistics = nullptr);
 
 } // namespace circt
 
@@ -36,6 +36,11 @@ struct FIRParserOptions {
   /// This, along with numOMIRFiles provides structure to the buffers in the
   /// source manager.
   unsigned numAnnotationFiles;
+  /// If this is set to true, annotation files are parsed one annotation at a
+  /// time rather than as a single JSON document, and the annotations are
+  /// converted to attributes in parallel.  This bounds the memory used to
+  /// import very large annotation files.
+  bool streamAnnotationFiles = false;
 };
 
 mlir::OwningOpRef<mlir::ModuleOp> importFIRFile(llvm::SourceMgr &sourceMgr,
@@ -43,6 +48,12 @@ mlir::OwningOpRef<mlir::ModuleOp> importFIRFile(llvm::SourceMgr &sourceMgr,
                                                 mlir::TimingScope &ts,
                                                 FIRParserOptions options = {});
 
+/// Lex the main buffer of the given source manager without parsing it, and
+/// return the number of tokens it holds, or None if it holds an invalid token,
+/// which is reported as a diagnostic.  This is used to benchmark the lexer.
+llvm::Optional<size_t> lexFIRFile(const llvm::SourceMgr &sourceMgr,
+                                  mlir::MLIRContext *context);
+
 // Decode a source locator string `spelling`, returning a pair indicating that
 // the the `spelling` was correct and an optional location attribute.  The
 // `skipParsing` option can be used to short-circuit parsing and just do
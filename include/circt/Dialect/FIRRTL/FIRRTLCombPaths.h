@@ -0,0 +1,75 @@
+//===- FIRRTLCombPaths.h - Combinational paths between ports ----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines an analysis of the combinational paths between the ports
+// of the modules of a FIRRTL circuit.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_FIRRTL_FIRRTLCOMBPATHS_H
+#define CIRCT_DIALECT_FIRRTL_FIRRTLCOMBPATHS_H
+
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/Pass/AnalysisManager.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace circt {
+namespace firrtl {
+
+/// A summary of the combinational paths through a module.
+struct ModuleCombPaths {
+  /// For every port of the module, the set of output ports it has a
+  /// combinational path to. The set is empty for output ports.
+  SmallVector<llvm::BitVector> paths;
+
+  /// Whether the body of the module contains a combinational cycle, taking the
+  /// paths through the modules it instantiates into account.
+  bool hasCycle = false;
+};
+
+/// This analysis summarizes the combinational paths between the ports of
+/// every module of a circuit. The modules are summarized in parallel, one
+/// level of the instance graph at a time, such that the paths through the
+/// instances of a module are known when the module is summarized. Registers
+/// and memories with a non-zero read latency break combinational paths, and
+/// external modules are assumed to have no combinational paths.
+///
+/// To use this class, retrieve a cached copy from the analysis manager:
+///   auto &combPaths = getAnalysis<CombPathsAnalysis>();
+class CombPathsAnalysis {
+public:
+  /// Summarize the modules of a circuit. This must be called on a FIRRTL
+  /// CircuitOp.
+  CombPathsAnalysis(Operation *operation, mlir::AnalysisManager &am);
+
+  /// Return the summary of a module.
+  const ModuleCombPaths &getCombPaths(FModuleLike module) const;
+
+  /// Return true if there is a combinational path from an input port to an
+  /// output port of a module.
+  bool hasCombPath(FModuleLike module, unsigned inputPort,
+                   unsigned outputPort) const {
+    auto &ports = getCombPaths(module).paths[inputPort];
+    return outputPort < ports.size() && ports.test(outputPort);
+  }
+
+  /// Return the modules containing a combinational cycle, instantiated modules
+  /// before the modules instantiating them.
+  ArrayRef<FModuleOp> getModulesWithCycles() const { return cyclicModules; }
+
+private:
+  DenseMap<Operation *, ModuleCombPaths> summaries;
+  SmallVector<FModuleOp> cyclicModules;
+};
+
+} // namespace firrtl
+} // namespace circt
+
+#endif // CIRCT_DIALECT_FIRRTL_FIRRTLCOMBPATHS_H
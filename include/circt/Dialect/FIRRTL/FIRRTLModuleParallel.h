@@ -0,0 +1,112 @@
+//===- FIRRTLModuleParallel.h - Module-parallel pass driver -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a driver for passes on a whole circuit, whose work is
+// mostly local to the modules. Such passes summarize every module in parallel,
+// solve a problem over the whole circuit from the summaries, and then apply the
+// solution to every module in parallel.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_FIRRTL_FIRRTLMODULEPARALLEL_H
+#define CIRCT_DIALECT_FIRRTL_FIRRTLMODULEPARALLEL_H
+
+#include "circt/Dialect/FIRRTL/FIRRTLInstanceGraph.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/Threading.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+
+#include <vector>
+
+namespace circt {
+namespace firrtl {
+
+/// The order in which the modules of a circuit are visited.
+enum class ModuleOrder {
+  /// The order of the modules in the body of the circuit.
+  Circuit,
+  /// Instantiated modules before the modules instantiating them.
+  BottomUp,
+  /// Instantiating modules before the modules they instantiate.
+  TopDown,
+};
+
+/// Return the modules of a circuit in the given order. Modules which are not
+/// instantiated below the top-level module are included as well.
+SmallVector<FModuleLike> getModulesInOrder(CircuitOp circuit,
+                                           InstanceGraph &instanceGraph,
+                                           ModuleOrder order);
+
+/// A driver running the phases of a pass over the modules of a circuit, where
+/// every module with a body is associated with a summary of type `SummaryT`.
+///
+/// The functions run by `summarize` and `apply` run in parallel, and may only
+/// modify the module they are given and its summary. They may read the other
+/// modules, e.g. the ports of instantiated modules, but not their bodies. The
+/// diagnostics they emit are reported in the order of the modules, such that
+/// the output does not depend on the number of threads. The `solve` phase
+/// visits the modules one after the other, in order, and is where the
+/// summaries are combined into state shared across the circuit.
+///
+///   ModuleParallelDriver<Summary> driver(circuit, instanceGraph);
+///   if (failed(driver.summarize(summarizeModule)) ||
+///       failed(driver.solve(mergeSummary)) ||
+///       failed(driver.apply(updateModule)))
+///     return signalPassFailure();
+template <typename SummaryT>
+class ModuleParallelDriver {
+public:
+  using ModuleFn = llvm::function_ref<LogicalResult(FModuleOp, SummaryT &)>;
+
+  ModuleParallelDriver(CircuitOp circuit, InstanceGraph &instanceGraph,
+                       ModuleOrder order = ModuleOrder::Circuit)
+      : context(circuit.getContext()) {
+    for (auto module : getModulesInOrder(circuit, instanceGraph, order))
+      if (auto fmodule = dyn_cast<FModuleOp>(module.getOperation()))
+        modules.push_back(fmodule);
+    summaries.resize(modules.size());
+  }
+
+  /// Summarize every module, in parallel.
+  LogicalResult summarize(ModuleFn fn) { return runParallel(fn); }
+
+  /// Visit the summaries of the modules sequentially, in order. Stops at the
+  /// first failure.
+  LogicalResult solve(ModuleFn fn) {
+    for (size_t i = 0, e = modules.size(); i != e; ++i)
+      if (failed(fn(modules[i], summaries[i])))
+        return failure();
+    return success();
+  }
+
+  /// Apply the solution to every module, in parallel.
+  LogicalResult apply(ModuleFn fn) { return runParallel(fn); }
+
+  /// Return the modules, in the order they are solved.
+  ArrayRef<FModuleOp> getModules() const { return modules; }
+
+  /// Return the summary of the module at an index of `getModules()`.
+  SummaryT &getSummary(size_t index) { return summaries[index]; }
+
+private:
+  LogicalResult runParallel(ModuleFn fn) {
+    return mlir::failableParallelForEachN(
+        context, 0, modules.size(),
+        [&](size_t index) { return fn(modules[index], summaries[index]); });
+  }
+
+  MLIRContext *context;
+  SmallVector<FModuleOp> modules;
+  std::vector<SummaryT> summaries;
+};
+
+} // namespace firrtl
+} // namespace circt
+
+#endif // CIRCT_DIALECT_FIRRTL_FIRRTLMODULEPARALLEL_H
@@ -0,0 +1,97 @@
+//===- FIRRTLStructuralHash.h - FIRRTL module hashing -----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the structural hash of FIRRTL modules, used to find
+// identical modules and to fingerprint modules across compilations.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_FIRRTL_FIRRTLSTRUCTURALHASH_H
+#define CIRCT_DIALECT_FIRRTL_FIRRTLSTRUCTURALHASH_H
+
+#include "circt/Dialect/FIRRTL/FIRRTLOpInterfaces.h"
+#include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
+#include "circt/Support/LLVM.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/SHA256.h"
+
+#include <array>
+#include <string>
+
+namespace circt {
+namespace firrtl {
+
+/// Computes a SHA256 hash of the structure of an operation. Values are hashed
+/// by their index of appearance, such that two operations hash the same if
+/// they only differ in the SSA names of their values.
+///
+/// In the default `Structural` mode, attributes and types are hashed by their
+/// interned pointer, and the names and annotations of modules and declarations
+/// are ignored. Such hashes are cheap to compute, but only meaningful within a
+/// single MLIRContext. In `Persistent` mode, attributes, types and locations
+/// are hashed by their textual form and nothing is ignored, such that hashes
+/// can be compared across compilations.
+class StructuralHasher {
+public:
+  enum class Mode { Structural, Persistent };
+
+  explicit StructuralHasher(MLIRContext *context,
+                            Mode mode = Mode::Structural);
+
+  std::array<uint8_t, 32> hash(FModuleLike module) {
+    return hash(module.getOperation());
+  }
+  std::array<uint8_t, 32> hash(Operation *op);
+
+private:
+  void reset();
+  void update(const void *pointer);
+  void update(size_t value);
+  void update(StringRef string);
+  void update(TypeID typeID);
+  void update(BundleType type);
+  void update(Type type);
+  void update(Attribute attr);
+  void update(Location loc);
+  void update(BlockArgument arg);
+  void update(OpResult result);
+  void update(OpOperand &operand);
+  void update(DictionaryAttr dict);
+  void update(Block &block);
+  void update(mlir::OperationName name);
+  void update(Operation *op);
+
+  /// Hash the textual form of an attribute or a type, printed once.
+  template <typename T>
+  void updateText(T value);
+
+  Mode mode;
+
+  // Every value is assigned a unique id based on their order of appearance.
+  unsigned currentIndex = 0;
+  DenseMap<Value, unsigned> indexes;
+
+  // This is a set of every attribute we should ignore.
+  DenseSet<Attribute> nonessentialAttributes;
+  // This is a cached "portTypes" string attr.
+  StringAttr portTypesAttr;
+
+  // The textual form of the attributes, types and locations hashed in
+  // persistent mode, by interned pointer.
+  DenseMap<const void *, std::string> printed;
+
+  // This is the actual running hash calculation. This is a stateful element
+  // that should be reinitialized after each hash is produced.
+  llvm::SHA256 sha;
+};
+
+} // namespace firrtl
+} // namespace circt
+
+#endif // CIRCT_DIALECT_FIRRTL_FIRRTLSTRUCTURALHASH_H
@@ -22,6 +22,7 @@ namespace circt {
 namespace hw {
 
 std::unique_ptr<mlir::Pass> createPrintInstanceGraphPass();
+std::unique_ptr<mlir::Pass> createPrintCombPathsPass();
 std::unique_ptr<mlir::Pass> createHWSpecializePass();
 
 /// Generate the code for registering passes.
@@ -16,14 +16,37 @@
 
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/MLIRContext.h"
+#include "llvm/ADT/StringMap.h"
 #include <string>
 
 namespace circt {
 namespace handshake {
+
+/// The ways a handshake function can be executed.
+enum class SimulationMode {
+  /// Interpret the operations of the function one by one.
+  Interpreted,
+  /// Compile the function to micro-ops operating on typed storage, falling
+  /// back to the interpreter if the function cannot be compiled.
+  Compiled,
+  /// Compile the function to micro-ops and simulate it cycle by cycle,
+  /// modeling the capacity of the buffers and the latency of the operations,
+  /// and report the throughput of its channels.
+  CycleAccurate
+};
+
+struct SimulationOptions {
+  SimulationMode mode = SimulationMode::Interpreted;
+  /// The latency in cycles of the operations in cycle-accurate mode, by
+  /// operation name. Operations which are not listed are combinational.
+  llvm::StringMap<unsigned> latencies;
+};
+
 bool simulate(llvm::StringRef toplevelFunction,
               llvm::ArrayRef<std::string> inputArgs,
               mlir::OwningOpRef<mlir::ModuleOp> &module,
-              mlir::MLIRContext &context);
+              mlir::MLIRContext &context,
+              const SimulationOptions &options = SimulationOptions());
 } // namespace handshake
 } // namespace circt
 
@@ -13,6 +13,7 @@
 #ifndef CIRCT_DIALECT_LLHD_SIMULATOR_ENGINE_H
 #define CIRCT_DIALECT_LLHD_SIMULATOR_ENGINE_H
 
+#include "ObjectCache.h"
 #include "State.h"
 #include "Trace.h"
 
@@ -32,22 +33,54 @@ namespace circt {
 namespace llhd {
 namespace sim {
 
+/// Counters of the work done by the engine. They are always collected, and
+/// printed by llhd-sim when the statistics are enabled with -stats.
+struct EngineStatistics {
+  /// Instance wakeups triggered by signal changes.
+  uint64_t signalWakeups = 0;
+  /// Signal changes ignored by processes not sensitive to them.
+  uint64_t ignoredTriggers = 0;
+  /// Scheduled process wakeups.
+  uint64_t scheduledWakeups = 0;
+  /// Instance evaluations.
+  uint64_t instanceRuns = 0;
+  /// Designs loaded from the object cache.
+  uint64_t objectCacheHits = 0;
+  /// Designs compiled and stored in the object cache.
+  uint64_t objectCacheMisses = 0;
+
+  /// Print the counters in the format of the LLVM statistics.
+  void print(llvm::raw_ostream &os) const;
+};
+
 class Engine {
 public:
   /// Initialize an LLHD simulation engine. This initializes the state, as well
-  /// as the mlir::ExecutionEngine with the given module.
+  /// as the mlir::ExecutionEngine with the given module. The instances woken up
+  /// in a delta step are evaluated on the given number of threads.
+  ///
+  /// If an object cache directory is given, the compiled design is stored in
+  /// it, and later engines for the same design skip the lowering and the
+  /// compilation entirely. The cache is keyed by the module and the given
+  /// description of the options used by the transformers.
   Engine(
       llvm::raw_ostream &out, ModuleOp module,
       llvm::function_ref<mlir::LogicalResult(mlir::ModuleOp)> mlirTransformer,
       llvm::function_ref<llvm::Error(llvm::Module *)> llvmTransformer,
-      std::string root, TraceMode tm, ArrayRef<StringRef> sharedLibPaths);
+      std::string root, TraceMode tm, ArrayRef<StringRef> sharedLibPaths,
+      unsigned threads = 1, StringRef objectCacheDir = {},
+      StringRef transformerOptions = {});
 
   /// Default destructor
   ~Engine();
 
   /// Run simulation up to n steps or maxTime picoseconds of simulation time.
-  /// n=0 and T=0 make the simulation run indefinitely.
-  int simulate(int n, uint64_t maxTime);
+  /// n=0 and T=0 make the simulation run indefinitely. If a snapshot file is
+  /// given, the simulation continues from the state stored in it instead of
+  /// starting from the initial state. If a checkpoint file is given, a
+  /// snapshot of the state is written to it when the simulation stops.
+  int simulate(int n, uint64_t maxTime, StringRef restorePath = {},
+               StringRef checkpointPath = {});
 
   /// Build the instance layout of the design.
   void buildLayout(ModuleOp module);
@@ -58,6 +91,9 @@ public:
   /// Get the simulation state.
   const State *getState() const { return state.get(); }
 
+  /// Get the counters of the work done by the engine.
+  const EngineStatistics &getStatistics() const { return stats; }
+
   /// Dump the instance layout stored in the State.
   void dumpStateLayout();
 
@@ -67,12 +103,19 @@ public:
 private:
   void walkEntity(EntityOp entity, Instance &child);
 
+  /// Look up the packed wrapper of a jitted function, either in the execution
+  /// engine or in the cached object.
+  llvm::Expected<void (*)(void **)> lookupPacked(StringRef name);
+
   llvm::raw_ostream &out;
   std::string root;
   std::unique_ptr<State> state;
   std::unique_ptr<mlir::ExecutionEngine> engine;
+  std::unique_ptr<ObjectJIT> cachedObject;
   ModuleOp module;
   TraceMode traceMode;
+  unsigned threads;
+  EngineStatistics stats;
 };
 
 } // namespace sim
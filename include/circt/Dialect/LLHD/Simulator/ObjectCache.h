@@ -0,0 +1,93 @@
+//===- ObjectCache.h - On-disk cache of simulation object code --*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the on-disk cache of the object code compiled by the LLHD
+// simulator, and the JIT used to run a cached object.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_OBJECTCACHE_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_OBJECTCACHE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include <memory>
+#include <string>
+
+namespace llvm {
+class MemoryBuffer;
+namespace orc {
+class LLJIT;
+} // namespace orc
+} // namespace llvm
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+/// An on-disk cache of the object code compiled for the simulated designs. The
+/// objects are stored in a directory, one file per design, named after a hash
+/// of the design and of all the options affecting the generated code.
+class ObjectFileCache {
+public:
+  /// Create a cache storing its objects in the given directory. The directory
+  /// is created when the first object is stored.
+  ObjectFileCache(llvm::StringRef directory) : directory(directory) {}
+
+  /// Compute the key of a design, given its textual IR and a description of
+  /// the lowering and code generation options. The key also covers the LLVM
+  /// version and the host target, such that stale objects are never reused.
+  static std::string computeKey(llvm::StringRef design,
+                                llvm::StringRef options);
+
+  /// Return the object cached for the given key, or null if there is none.
+  std::unique_ptr<llvm::MemoryBuffer> lookup(llvm::StringRef key) const;
+
+  /// Store an object in the cache under the given key. The object is written
+  /// to a temporary file by the given callback, and then moved in place, such
+  /// that concurrent simulations never see a partially written object.
+  llvm::Error store(
+      llvm::StringRef key,
+      llvm::function_ref<llvm::Error(llvm::StringRef path)> writeObject) const;
+
+private:
+  /// Return the path of the object stored for the given key.
+  std::string getPath(llvm::StringRef key) const;
+
+  std::string directory;
+};
+
+/// A JIT running an object compiled by the mlir::ExecutionEngine, exposing the
+/// same interface to the packed wrappers of the functions it defines.
+class ObjectJIT {
+public:
+  ~ObjectJIT();
+
+  /// Create a JIT running the given object. The symbols it references are
+  /// resolved in the given shared libraries and in the current process.
+  static llvm::Expected<std::unique_ptr<ObjectJIT>>
+  create(std::unique_ptr<llvm::MemoryBuffer> object,
+         llvm::ArrayRef<llvm::StringRef> sharedLibPaths);
+
+  /// Look up the packed wrapper of the function with the given name.
+  llvm::Expected<void (*)(void **)> lookupPacked(llvm::StringRef name) const;
+
+private:
+  ObjectJIT() = default;
+
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+};
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_OBJECTCACHE_H
@@ -0,0 +1,50 @@
+//===- Snapshot.h - Simulation state snapshots ------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the functions used to save the state of a running LLHD
+// simulation to a file, and to continue the simulation from such a file.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_SNAPSHOT_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_SNAPSHOT_H
+
+#include "State.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+/// Write a snapshot of the simulation state to the given file. The snapshot
+/// holds the current time, the pending events of the queue, the value of every
+/// signal and the entity and process states allocated by the jitted code.
+///
+/// All the fields are stored as native 64 bit words, and all the byte arrays
+/// are padded to a multiple of 8 bytes, such that the file can be mapped in
+/// memory and read in place.
+llvm::Error writeSnapshot(const State &state, llvm::StringRef path);
+
+/// Restore the simulation state from the snapshot stored in the given file.
+/// The state must have been initialized by the `llhd_init` function of the
+/// same design the snapshot was taken from, and its queue must be empty.
+///
+/// Process states may persist pointers to the signal values, to the signal
+/// tables of the instances and to the process states themselves. As those are
+/// allocated again by the restored simulation, the pointers stored at the
+/// offsets recorded in `Instance::procStatePointers` are relocated to the new
+/// memory.
+llvm::Error restoreSnapshot(State &state, llvm::StringRef path);
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_SNAPSHOT_H
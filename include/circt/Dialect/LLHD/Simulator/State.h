@@ -15,9 +15,12 @@
 #define CIRCT_DIALECT_LLHD_SIMULATOR_STATE_H
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
 
+#include <array>
 #include <map>
 #include <queue>
 #include <regex>
@@ -57,6 +60,10 @@ public:
 
   uint64_t getTime() const { return time; }
 
+  uint64_t getDelta() const { return delta; }
+
+  uint64_t getEps() const { return eps; }
+
 private:
   /// Simulation real time.
   uint64_t time;
@@ -121,12 +128,28 @@ public:
     return instanceIndices;
   }
 
-  void pushInstanceIndex(unsigned i) { instanceIndices.push_back(i); }
+  /// Return the position of the signal in the sensitivity list of each of the
+  /// instances it triggers, in the same order as the instance indices.
+  const std::vector<unsigned> &getTriggeredSenseIndices() const {
+    return senseIndices;
+  }
+
+  /// Add an instance triggered by the signal, where the signal is found at the
+  /// given position of its sensitivity list.
+  void pushInstanceIndex(unsigned i, unsigned senseIndex) {
+    instanceIndices.push_back(i);
+    senseIndices.push_back(senseIndex);
+  }
 
   bool hasElement() const { return elements.size() > 0; }
 
   size_t getElementSize() const { return elements.size(); }
 
+  /// Return the offset and size in bytes of the i-th element of the signal.
+  std::pair<unsigned, unsigned> getElement(unsigned i) const {
+    return elements[i];
+  }
+
   void pushElement(std::pair<unsigned, unsigned> val) {
     elements.push_back(val);
   }
@@ -195,6 +218,8 @@ private:
   std::string owner;
   // The list of instances this signal triggers.
   std::vector<unsigned> instanceIndices;
+  // The position of the signal in the sensitivity list of each instance.
+  std::vector<unsigned> senseIndices;
   uint64_t size;
   uint8_t *value;
   std::vector<std::pair<unsigned, unsigned>> elements;
@@ -202,6 +227,15 @@ private:
 
 /// The simulator's internal representation of one queue slot.
 struct Slot {
+  /// A buffered drive of a signal.
+  struct Change {
+    unsigned bitOffset;
+    unsigned width;
+    // The driven value if it fits in 64 bits, otherwise the index of its first
+    // word in the slot's wide values arena.
+    uint64_t value;
+  };
+
   /// Create a new empty slot.
   Slot(Time time) : time(time) {}
 
@@ -217,11 +251,22 @@ struct Slot {
   /// Insert a scheduled process wakeup.
   void insertChange(unsigned inst);
 
+  /// Apply a change buffer to a signal value of the given width in bits, stored
+  /// as 64 bit words. Changes covering the whole signal replace its value,
+  /// while partial changes only replace the driven bits.
+  void applyChange(unsigned buffer, uint64_t *value, unsigned width) const;
+
+  /// Remove all the changes and scheduled wakeups, keeping the allocated
+  /// storage around for reuse.
+  void clear();
+
   // A map from signal indexes to change buffers. Makes it easy to sort the
   // changes such that we can process one signal at a time.
   llvm::SmallVector<std::pair<unsigned, unsigned>, 32> changes;
   // Buffers for the signal changes.
-  llvm::SmallVector<std::pair<unsigned, llvm::APInt>, 32> buffers;
+  llvm::SmallVector<Change, 32> buffers;
+  // Storage for the values of the changes wider than 64 bits.
+  llvm::SmallVector<uint64_t, 0> wideValues;
   // The number of used change buffers in the slot.
   size_t changesSize = 0;
 
@@ -231,12 +276,17 @@ struct Slot {
   bool unused = false;
 };
 
-/// This is equivalent to and std::priorityQueue<Slot> ordered using the greater
-/// operator, which adds an insertion method to add changes to a slot.
-class UpdateQueue : public llvm::SmallVector<Slot, 8> {
-  unsigned topSlot = 0;
-  llvm::SmallVector<unsigned, 4> unused;
-
+/// The simulator's event queue. It behaves like an std::priority_queue<Slot>
+/// ordered using the greater operator, which adds an insertion method to add
+/// changes to a slot.
+///
+/// Slots sharing the same real-time value are kept in a group, sorted by their
+/// delta and epsilon values. The groups are ordered by a hierarchical timing
+/// wheel, where each level covers `wheelBits` bits of the real-time value and
+/// keeps a bitmap of its non-empty buckets. This makes both inserting a new
+/// event and popping the top of the queue O(1) amortized, independently of the
+/// number of pending events.
+class UpdateQueue {
 public:
   /// Check wheter a slot for the given time already exists. If that's the case,
   /// add the new change to it, else create a new slot and push it to the queue.
@@ -261,7 +311,98 @@ public:
   /// unused and resets its internal structures such that they can be reused.
   void pop();
 
+  /// Return true if there are no pending events in the queue.
+  bool empty() const { return events == 0; }
+
+  /// Call the given function on each pending slot, in no particular order.
+  void forEachSlot(llvm::function_ref<void(const Slot &)> fn) const;
+
   unsigned events = 0;
+
+private:
+  /// The number of real-time bits covered by each level of the timing wheel.
+  static constexpr unsigned wheelBits = 6;
+  static constexpr unsigned wheelSize = 1 << wheelBits;
+  static constexpr unsigned wheelLevels = (64 + wheelBits - 1) / wheelBits;
+
+  /// A group of slots sharing the same real-time value.
+  struct Group {
+    uint64_t time = 0;
+    // Indices of the slots in the group, sorted by (delta, eps).
+    llvm::SmallVector<unsigned, 2> slots;
+  };
+
+  /// Return the index of a group for the given real-time value, creating it and
+  /// placing it in the timing wheel if needed.
+  unsigned getOrCreateGroup(uint64_t time);
+
+  /// Place a group in the timing wheel, relative to the current wheel time.
+  void placeInWheel(unsigned group);
+
+  /// Make a group available for reuse.
+  void releaseGroup(unsigned group);
+
+  /// Move the timing wheel back to an earlier real-time value, placing all the
+  /// pending groups again.
+  void rewind(uint64_t time);
+
+  /// Advance the timing wheel to the earliest pending group, and make it the
+  /// current group.
+  void advance();
+
+  // The pool of slots, and the indices of the slots available for reuse.
+  llvm::SmallVector<Slot, 8> slots;
+  llvm::SmallVector<unsigned, 4> unusedSlots;
+  // The pool of groups, and the indices of the groups available for reuse.
+  llvm::SmallVector<Group, 8> groups;
+  llvm::SmallVector<unsigned, 4> unusedGroups;
+  // A map from real-time values to the group holding their slots.
+  llvm::DenseMap<uint64_t, unsigned> groupIndex;
+
+  // The timing wheel buckets and the bitmaps of the non-empty buckets.
+  std::array<std::array<llvm::SmallVector<unsigned, 0>, wheelSize>,
+             wheelLevels>
+      wheel;
+  std::array<uint64_t, wheelLevels> occupied = {};
+  // The real-time value the wheel is currently positioned at.
+  uint64_t wheelTime = 0;
+  // The group at the current wheel time, holding the top of the queue. This is
+  // not stored in the wheel itself, and only valid if the queue is not empty.
+  // It is left empty after popping its last slot until the next call to top().
+  unsigned currentGroup = 0;
+};
+
+struct State;
+
+/// Events scheduled by one instance while the instances of a delta step are
+/// evaluated in parallel. They are buffered here instead of being inserted in
+/// the shared queue, and applied to it once all the instances are done.
+struct DeferredEvents {
+  /// A buffered signal drive.
+  struct Drive {
+    Time time;
+    unsigned index;
+    int bitOffset;
+    unsigned width;
+    llvm::SmallVector<uint64_t, 1> value;
+  };
+
+  /// Buffer a signal drive, copying the driven value.
+  void insertDrive(Time time, unsigned index, int bitOffset, uint8_t *bytes,
+                   unsigned width);
+
+  /// Buffer a scheduled wakeup of the given process instance, after the given
+  /// amount of time from the current one.
+  void insertWakeup(Time delay, unsigned inst) {
+    wakeups.push_back(std::make_pair(delay, inst));
+  }
+
+  /// Apply the buffered events to the state, in the order they were
+  /// scheduled, and clear the buffers.
+  void apply(State &state);
+
+  llvm::SmallVector<Drive, 4> drives;
+  llvm::SmallVector<std::pair<Time, unsigned>, 1> wakeups;
 };
 
 /// State structure for process persistence across suspension.
@@ -291,6 +432,10 @@ struct Instance {
   llvm::SmallVector<SignalDetail, 0> sensitivityList;
   std::unique_ptr<ProcState> procState;
   std::unique_ptr<uint8_t> entityState;
+  // The size in bytes of the entity or process state.
+  uint64_t stateSize = 0;
+  // The offsets in bytes of the pointers stored in the process state.
+  llvm::SmallVector<uint64_t, 2> procStatePointers;
   Time expectedWakeup;
   // A pointer to the base unit jitted function.
   void (*unitFPtr)(void **);
@@ -325,8 +470,9 @@ struct State {
 
   void addSignalElement(unsigned, unsigned, unsigned);
 
-  /// Add a pointer to the process persistence state to a process instance.
-  void addProcPtr(std::string name, ProcState *procStatePtr);
+  /// Add a pointer to the process persistence state of the given size in bytes
+  /// to a process instance.
+  void addProcPtr(std::string name, ProcState *procStatePtr, uint64_t size);
 
   /// Dump a signal to the out stream. One entry is added for every instance
   /// the signal appears in.
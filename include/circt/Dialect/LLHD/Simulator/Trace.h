@@ -27,7 +27,18 @@ namespace circt {
 namespace llhd {
 namespace sim {
 
-enum class TraceMode { Full, Reduced, Merged, MergedReduce, NamedOnly, None };
+enum class TraceMode {
+  Full,
+  Reduced,
+  Merged,
+  MergedReduce,
+  NamedOnly,
+  VCD,
+  Binary,
+  None
+};
+
+class WaveformWriter;
 
 class Trace {
   llvm::raw_ostream &out;
@@ -42,6 +53,8 @@ class Trace {
   std::map<std::pair<unsigned, int>, std::string> mergedChanges;
   // Buffer of last dumped change for each signal.
   std::map<std::pair<std::string, int>, std::string> lastValue;
+  // The writer handling the waveform formats.
+  std::unique_ptr<WaveformWriter> writer;
 
   /// Push one change to the changes vector.
   void pushChange(unsigned inst, unsigned sigIndex, int elem);
@@ -63,6 +76,7 @@ class Trace {
 public:
   Trace(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
         TraceMode mode);
+  ~Trace();
 
   /// Add a value change to the trace changes buffer.
   void addChange(unsigned);
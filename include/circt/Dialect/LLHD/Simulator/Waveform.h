@@ -0,0 +1,123 @@
+//===- Waveform.h - Simulation waveform writers -----------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the streaming waveform writers used by the llhd-sim tool
+// to dump signal traces in the VCD and in a compact binary format.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_WAVEFORM_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_WAVEFORM_H
+
+#include "State.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <memory>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+/// Base class of the streaming waveform writers. The signals changed during a
+/// real-time step are collected by index, and once the simulation moves past
+/// that step, the raw value of each of them is compared to the last written
+/// one and written out only if it differs.
+class WaveformWriter {
+public:
+  WaveformWriter(const State &state, llvm::raw_ostream &out)
+      : state(state), out(out) {}
+  virtual ~WaveformWriter() = default;
+
+  /// Mark a signal as changed in the current real-time step.
+  void addChange(unsigned sigIndex);
+
+  /// Write the changes of the current real-time step if the simulation moved
+  /// past it. The flush can be forced to write the changes regardless, along
+  /// with any data buffered by the writer.
+  void flush(bool force = false);
+
+protected:
+  /// One traced value: either a whole signal, or one element of a signal of
+  /// structured type.
+  struct Entry {
+    unsigned sigIndex;
+    // Offset and size of the value in the signal, in bytes.
+    unsigned offset;
+    unsigned size;
+    // Offset of the last written value in the `lastValues` buffer.
+    size_t lastValue;
+  };
+
+  /// Return the hierarchical name of an entry as seen from the given instance.
+  std::string getEntryName(unsigned entry, unsigned inst) const;
+
+  /// Return the instances a signal is declared in, in increasing order. A
+  /// signal listed several times in the sensitivity list of an instance is
+  /// only returned once.
+  llvm::SmallVector<unsigned, 4> getSignalInstances(unsigned sigIndex) const;
+
+  /// Write the file header, declaring all the entries.
+  virtual void writeHeader() = 0;
+  /// Start a new real-time step.
+  virtual void beginTimeStep(uint64_t time) = 0;
+  /// Write the new value of an entry. The previous one is still available in
+  /// the `lastValues` buffer.
+  virtual void writeChange(unsigned entry, const uint8_t *value) = 0;
+  /// Close the current real-time step.
+  virtual void endTimeStep() {}
+  /// Write out any buffered data.
+  virtual void flushBuffers() {}
+
+  const State &state;
+  llvm::raw_ostream &out;
+  std::vector<Entry> entries;
+  // The index of the first entry of each signal, plus one past the last entry.
+  std::vector<unsigned> firstEntry;
+  // The last written value of all the entries, stored back to back.
+  std::vector<uint8_t> lastValues;
+
+private:
+  /// Build the entries table. This is deferred to the first change, as the
+  /// signal values and elements are only known after the design is
+  /// initialized.
+  void initialize();
+
+  llvm::BitVector isDirty;
+  std::vector<unsigned> dirty;
+  uint64_t currentTime = 0;
+  bool initialized = false;
+  bool firstStep = true;
+};
+
+/// Create a writer for the Value Change Dump format, as defined by IEEE 1364.
+/// Each traced value gets a short printable identifier code, shared by all the
+/// instances its signal appears in.
+std::unique_ptr<WaveformWriter> createVCDWriter(const State &state,
+                                                llvm::raw_ostream &out);
+
+/// Create a writer for the binary waveform format. The output starts with a
+/// table declaring all the traced values, followed by blocks of real-time
+/// steps. Each block records its start time, number of steps and size, such
+/// that a reader can skip it entirely. Within a block, times and value indices
+/// are delta encoded as ULEB128 numbers, and each new value is stored as the
+/// XOR with its previous value, with the zero high bytes trimmed.
+std::unique_ptr<WaveformWriter> createBinaryWaveWriter(const State &state,
+                                                       llvm::raw_ostream &out);
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_WAVEFORM_H
@@ -16,6 +16,8 @@
 #include "circt/Dialect/FIRRTL/FIREmitter.h"
 #include "circt/Dialect/FIRRTL/FIRParser.h"
 #include "circt/Dialect/MSFT/ExportTcl.h"
+#include "circt/InitAllDialects.h"
+#include "circt/Support/BinaryIR.h"
 
 #ifndef CIRCT_INITALLTRANSLATIONS_H
 #define CIRCT_INITALLTRANSLATIONS_H
@@ -31,6 +33,7 @@ inline void registerAllTranslations() {
     calyx::registerToCalyxTranslation();
     firrtl::registerFromFIRFileTranslation();
     firrtl::registerToFIRFileTranslation();
+    registerBinaryIRTranslations(registerAllDialects);
     return true;
   }();
   (void)initOnce;
@@ -0,0 +1,62 @@
+//===- BinaryIR.h - Binary IR serialization ---------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares a compact binary serialization of MLIR operations, which
+// is much faster to load than the textual form.
+//
+// The format is dialect agnostic.  Strings, operation names, types, attributes
+// and locations are uniqued into tables at the start of the file, which are
+// loaded once.  Types and most attributes are stored in their textual form and
+// parsed once per distinct value.  The regions of every operation which is
+// isolated from above, e.g. a module, are stored in a separate length-prefixed
+// section with its own value numbering, such that the sections can be decoded
+// independently, and are decoded in parallel.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_SUPPORT_BINARYIR_H
+#define CIRCT_SUPPORT_BINARYIR_H
+
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/OwningOpRef.h"
+
+#include <functional>
+
+namespace llvm {
+class SourceMgr;
+} // namespace llvm
+
+namespace mlir {
+class DialectRegistry;
+} // namespace mlir
+
+namespace circt {
+
+/// Return true if the given buffer holds binary IR rather than text.
+bool isBinaryIR(StringRef buffer);
+
+/// Write the given operation and its regions as binary IR.
+void writeBinaryIR(Operation *op, raw_ostream &os);
+
+/// Read the binary IR in the main buffer of the given source manager, which
+/// must hold a builtin module.  The dialects used by the IR must be registered
+/// in the context.  Returns null and emits an error if the IR is malformed or
+/// does not verify.
+mlir::OwningOpRef<mlir::ModuleOp> readBinaryIR(llvm::SourceMgr &sourceMgr,
+                                               MLIRContext *context);
+
+/// Register the `export-binary-ir` and `import-binary-ir` translations between
+/// textual MLIR and binary IR.  The given function registers the dialects the
+/// IR may use.
+void registerBinaryIRTranslations(
+    const std::function<void(mlir::DialectRegistry &)> &registerDialects);
+
+} // namespace circt
+
+#endif // CIRCT_SUPPORT_BINARYIR_H
@@ -0,0 +1,349 @@
+//===- CombPathsAnalysis.cpp - HW combinational path analysis -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the analysis of the combinational paths between the
+// ports of HW modules.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Analysis/CombPathsAnalysis.h"
+#include "circt/Dialect/Comb/CombDialect.h"
+#include "circt/Dialect/HW/HWInstanceGraph.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/SV/SVOps.h"
+#include "circt/Dialect/Seq/SeqOps.h"
+#include "mlir/IR/Threading.h"
+#include "mlir/Pass/AnalysisManager.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+using namespace circt;
+using namespace circt::analysis;
+
+using Summaries = DenseMap<Operation *, ModuleCombPaths>;
+
+/// Size the tables of a summary for the ports of a module, with no paths
+/// between them.
+static void initSummary(ModuleCombPaths &summary, Operation *module) {
+  auto moduleType = hw::getModuleType(module);
+  unsigned numInputs = moduleType.getNumInputs();
+  unsigned numOutputs = moduleType.getNumResults();
+  summary.paths.assign(numInputs, llvm::BitVector(numOutputs));
+  summary.pathDepths.assign(numInputs, SmallVector<unsigned>(numOutputs));
+  summary.inputDepths.assign(numInputs, 0);
+  summary.outputDepths.assign(numOutputs, 0);
+}
+
+/// Return true if an operation only runs on clock edges or once at the start of
+/// the simulation, i.e. if it is nested in an `sv.alwaysff`, an `sv.initial`,
+/// or an `sv.always` with a sensitivity list.
+static bool isInSequentialRegion(Operation *op) {
+  for (auto *parent = op->getParentOp(); !isa<hw::HWModuleOp>(parent);
+       parent = parent->getParentOp()) {
+    if (isa<sv::AlwaysFFOp, sv::InitialOp>(parent))
+      return true;
+    if (auto always = dyn_cast<sv::AlwaysOp>(parent))
+      if (!always.events().empty())
+        return true;
+  }
+  return false;
+}
+
+/// Return true if a register is only assigned in sequential regions, such that
+/// its value starts combinational paths like a `seq.compreg`.
+static bool isSequentialReg(sv::RegOp reg) {
+  return llvm::all_of(reg->getUses(), [](OpOperand &use) {
+    auto *owner = use.getOwner();
+    if (!isa<sv::AssignOp, sv::BPAssignOp, sv::PAssignOp>(owner) ||
+        use.getOperandNumber() != 0)
+      return true;
+    return isInSequentialRegion(owner);
+  });
+}
+
+namespace {
+/// The combinational graph of a module. The first nodes are the input ports,
+/// then the output ports, and then the values reachable from them and from
+/// the registers and instances of the module, in the order they are
+/// discovered. The edges of every node are stored next to each other in a
+/// single array, and weighted by the depth they add to a path.
+class CombGraph {
+public:
+  CombGraph(hw::HWModuleOp module, const Summaries &summaries,
+            hw::InstanceGraph &instanceGraph);
+
+  /// Compute the combinational paths between the ports of the module, and
+  /// their depths.
+  ModuleCombPaths summarize();
+
+private:
+  unsigned getNode(Value value);
+  void addEdge(unsigned node, unsigned weight);
+  void addUses(unsigned node);
+  const ModuleCombPaths &getSummary(hw::InstanceOp instance);
+  bool sortNodes();
+
+  hw::HWModuleOp module;
+  const Summaries &summaries;
+  hw::InstanceGraph &instanceGraph;
+  unsigned numInputs;
+  unsigned numOutputs;
+
+  SmallVector<Value> values;
+  DenseMap<Value, unsigned> nodes;
+  /// The depth of the paths starting and ending at every node, i.e. the depth
+  /// of the paths inside the instance the node is an output or input of.
+  SmallVector<unsigned> startDepths;
+  SmallVector<unsigned> endDepths;
+  SmallVector<unsigned> edgeBegins;
+  SmallVector<unsigned> edges;
+  SmallVector<unsigned> weights;
+  /// The nodes in topological order, once sorted.
+  SmallVector<unsigned> order;
+};
+} // namespace
+
+CombGraph::CombGraph(hw::HWModuleOp module, const Summaries &summaries,
+                     hw::InstanceGraph &instanceGraph)
+    : module(module), summaries(summaries), instanceGraph(instanceGraph) {
+  auto moduleType = hw::getModuleType(module);
+  numInputs = moduleType.getNumInputs();
+  numOutputs = moduleType.getNumResults();
+  for (auto arg : module.getBodyBlock()->getArguments())
+    getNode(arg);
+  values.append(numOutputs, Value());
+  startDepths.append(numOutputs, 0);
+  endDepths.append(numOutputs, 0);
+
+  // Paths also start at registers, and inside of instances.
+  module.walk([&](Operation *op) {
+    if (isa<seq::CompRegOp>(op))
+      getNode(op->getResult(0));
+    if (auto reg = dyn_cast<sv::RegOp>(op))
+      if (isSequentialReg(reg))
+        getNode(reg->getResult(0));
+    if (auto instance = dyn_cast<hw::InstanceOp>(op)) {
+      auto &summary = getSummary(instance);
+      for (auto result : instance.getResults()) {
+        auto node = getNode(result);
+        startDepths[node] = summary.outputDepths[result.getResultNumber()];
+      }
+    }
+  });
+
+  // Nodes discovered while adding edges are appended to the list, and visited
+  // in turn.
+  for (unsigned node = 0; node < values.size(); ++node) {
+    edgeBegins.push_back(edges.size());
+    if (values[node])
+      addUses(node);
+  }
+  edgeBegins.push_back(edges.size());
+}
+
+unsigned CombGraph::getNode(Value value) {
+  auto [it, inserted] = nodes.insert({value, values.size()});
+  if (inserted) {
+    values.push_back(value);
+    startDepths.push_back(0);
+    endDepths.push_back(0);
+  }
+  return it->second;
+}
+
+void CombGraph::addEdge(unsigned node, unsigned weight) {
+  edges.push_back(node);
+  weights.push_back(weight);
+}
+
+const ModuleCombPaths &CombGraph::getSummary(hw::InstanceOp instance) {
+  auto *module = instanceGraph.getReferencedModule(instance).getOperation();
+  return summaries.find(module)->second;
+}
+
+void CombGraph::addUses(unsigned node) {
+  for (auto &use : values[node].getUses()) {
+    auto *owner = use.getOwner();
+    // The values read on clock edges are only visible through registers. The
+    // values read in an `sv.alwayscomb` are visible right away.
+    if (isInSequentialRegion(owner))
+      continue;
+
+    if (isa<seq::CompRegOp>(owner))
+      continue;
+
+    if (isa<hw::OutputOp>(owner)) {
+      addEdge(numInputs + use.getOperandNumber(), 0);
+      continue;
+    }
+
+    // A continuous assignment, or an assignment of a combinational procedural
+    // region, drives its destination from its source.
+    // Their operands are the destination, and then the source.
+    if (isa<sv::AssignOp, sv::BPAssignOp, sv::PAssignOp>(owner)) {
+      if (use.getOperandNumber() == 1)
+        addEdge(getNode(owner->getOperand(0)), 0);
+      continue;
+    }
+
+    // An input of an instance drives the outputs it has a combinational path
+    // to, through the operations of the instantiated module.
+    if (auto instance = dyn_cast<hw::InstanceOp>(owner)) {
+      auto &summary = getSummary(instance);
+      auto port = use.getOperandNumber();
+      endDepths[node] = std::max(endDepths[node], summary.inputDepths[port]);
+      for (auto outputPort : summary.paths[port].set_bits())
+        addEdge(getNode(instance.getResult(outputPort)),
+                summary.pathDepths[port][outputPort]);
+      continue;
+    }
+
+    unsigned weight = isa<comb::CombDialect>(owner->getDialect()) ? 1 : 0;
+    for (auto result : owner->getResults())
+      addEdge(getNode(result), weight);
+  }
+}
+
+/// Sort the nodes topologically, with Kahn's algorithm. Return false if the
+/// graph has a cycle.
+bool CombGraph::sortNodes() {
+  unsigned numNodes = values.size();
+  SmallVector<unsigned> numParents(numNodes);
+  for (auto node : edges)
+    ++numParents[node];
+  for (unsigned node = 0; node < numNodes; ++node)
+    if (!numParents[node])
+      order.push_back(node);
+  for (unsigned i = 0; i < order.size(); ++i) {
+    auto node = order[i];
+    for (auto e = edgeBegins[node], end = edgeBegins[node + 1]; e != end; ++e)
+      if (!--numParents[edges[e]])
+        order.push_back(edges[e]);
+  }
+  return order.size() == numNodes;
+}
+
+ModuleCombPaths CombGraph::summarize() {
+  ModuleCombPaths summary;
+  initSummary(summary, module);
+  unsigned numNodes = values.size();
+  const unsigned unreached = ~0u;
+  SmallVector<unsigned> depths(numNodes);
+
+  // Without a topological order, only the reachability of the ports is
+  // computed, by walking the graph from every input port.
+  if (!sortNodes()) {
+    summary.hasCycle = true;
+    SmallVector<unsigned> worklist;
+    for (unsigned port = 0; port < numInputs; ++port) {
+      std::fill(depths.begin(), depths.end(), unreached);
+      depths[port] = 0;
+      worklist.push_back(port);
+      while (!worklist.empty()) {
+        auto node = worklist.pop_back_val();
+        if (node >= numInputs && node < numInputs + numOutputs)
+          summary.paths[port].set(node - numInputs);
+        for (auto e = edgeBegins[node], end = edgeBegins[node + 1]; e != end;
+             ++e) {
+          if (depths[edges[e]] == unreached) {
+            depths[edges[e]] = 0;
+            worklist.push_back(edges[e]);
+          }
+        }
+      }
+    }
+    return summary;
+  }
+
+  // Compute the longest paths from every input port, in topological order.
+  for (unsigned port = 0; port < numInputs; ++port) {
+    std::fill(depths.begin(), depths.end(), unreached);
+    depths[port] = 0;
+    auto &inputDepth = summary.inputDepths[port];
+    for (auto node : order) {
+      auto depth = depths[node];
+      if (depth == unreached)
+        continue;
+      inputDepth = std::max(inputDepth, depth + endDepths[node]);
+      for (auto e = edgeBegins[node], end = edgeBegins[node + 1]; e != end;
+           ++e) {
+        auto &childDepth = depths[edges[e]];
+        if (childDepth == unreached || childDepth < depth + weights[e])
+          childDepth = depth + weights[e];
+      }
+    }
+    for (unsigned outputPort = 0; outputPort < numOutputs; ++outputPort) {
+      auto depth = depths[numInputs + outputPort];
+      if (depth == unreached)
+        continue;
+      summary.paths[port].set(outputPort);
+      summary.pathDepths[port][outputPort] = depth;
+    }
+  }
+
+  // Compute the longest paths from any node, starting with the depth of the
+  // paths inside of instances.
+  depths.assign(startDepths.begin(), startDepths.end());
+  for (auto node : order) {
+    auto depth = depths[node];
+    summary.longestPath =
+        std::max(summary.longestPath, depth + endDepths[node]);
+    for (auto e = edgeBegins[node], end = edgeBegins[node + 1]; e != end; ++e)
+      depths[edges[e]] = std::max(depths[edges[e]], depth + weights[e]);
+  }
+  for (unsigned outputPort = 0; outputPort < numOutputs; ++outputPort)
+    summary.outputDepths[outputPort] = depths[numInputs + outputPort];
+  return summary;
+}
+
+CombPathsAnalysis::CombPathsAnalysis(Operation *operation,
+                                     mlir::AnalysisManager &am) {
+  auto &instanceGraph = am.getAnalysis<hw::InstanceGraph>();
+
+  // Group the modules by their height in the instance graph, i.e. the length
+  // of the longest chain of instances below them. A module only instantiates
+  // modules of a lower height, so the modules of a level can be summarized in
+  // parallel once the levels below are.
+  DenseMap<hw::InstanceGraphNode *, unsigned> heights;
+  SmallVector<SmallVector<hw::HWModuleOp>> levels;
+  SmallPtrSet<hw::InstanceGraphNode *, 16> visited;
+  for (auto *root : instanceGraph) {
+    for (auto *node : llvm::post_order_ext(root, visited)) {
+      unsigned height = 0;
+      for (auto *record : *node)
+        height = std::max(height, heights.lookup(record->getTarget()) + 1);
+      heights[node] = height;
+
+      // Every module has an entry before the summaries are computed, such that
+      // the map is not modified while it is read.
+      auto *module = node->getModule().getOperation();
+      initSummary(summaries[module], module);
+      if (auto hwModule = dyn_cast<hw::HWModuleOp>(module)) {
+        if (levels.size() <= height)
+          levels.resize(height + 1);
+        levels[height].push_back(hwModule);
+      }
+    }
+  }
+
+  for (auto &level : levels) {
+    mlir::parallelForEach(
+        operation->getContext(), level, [&](hw::HWModuleOp module) {
+          auto summary =
+              CombGraph(module, summaries, instanceGraph).summarize();
+          summaries.find(module)->second = std::move(summary);
+        });
+  }
+}
+
+const ModuleCombPaths &
+CombPathsAnalysis::getCombPaths(hw::HWModuleLike module) const {
+  auto it = summaries.find(module.getOperation());
+  assert(it != summaries.end() && "module not in the design");
+  return it->second;
+}
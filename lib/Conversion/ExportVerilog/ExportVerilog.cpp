@@ -31,19 +31,28 @@
 #include "circt/Support/Path.h"
 #include "circt/Support/Version.h"
 #include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "mlir/IR/Threading.h"
 #include "mlir/Support/FileUtilities.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
 #include "llvm/Support/SaveAndRestore.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <atomic>
+#include <deque>
+#include <future>
+
 using namespace circt;
 
 using namespace comb;
@@ -4394,6 +4403,80 @@ static void emitOperation(VerilogEmitterState &state, Operation *op) {
       });
 }
 
+std::string SharedEmitterState::getModuleCacheKey(Operation *op) const {
+  // Modules containing binds are emitted along with the bound instances of
+  // other modules, and are never cached.
+  auto module = dyn_cast<HWModuleOp>(op);
+  if (!moduleCache || !module || modulesContainingBinds.count(op))
+    return {};
+
+  // The names in the module are legalized and its locations are emitted, such
+  // that its printed form covers everything its text depends on, beyond the
+  // operations it refers to.
+  auto flags = OpPrintingFlags().useLocalScope().enableDebugInfo();
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  os << options.toString() << '\n';
+  module->print(os, flags);
+
+  // The instances only depend on the interface of the modules they
+  // instantiate, and the inner references on the name of the declaration they
+  // refer to. Any other operation referred to by symbol is printed entirely.
+  SmallPtrSet<Operation *, 8> printed;
+  auto printReference = [&](Operation *refOp, bool interfaceOnly) {
+    if (!refOp || !printed.insert(refOp).second)
+      return;
+    os << '\n';
+    if (interfaceOnly)
+      os << refOp->getName() << ' ' << refOp->getAttrDictionary();
+    else
+      refOp->print(os, flags);
+  };
+  module.walk([&](Operation *nested) {
+    nested->getAttrDictionary().walkSubAttrs([&](Attribute attr) {
+      if (auto ref = attr.dyn_cast<FlatSymbolRefAttr>()) {
+        auto *refOp = symbolCache.getDefinition(ref);
+        printReference(refOp, refOp && isAnyModule(refOp));
+      } else if (auto innerRef = attr.dyn_cast<InnerRefAttr>()) {
+        auto *refModule = symbolCache.getDefinition(innerRef.getModuleRef());
+        printReference(refModule, /*interfaceOnly=*/true);
+        auto item = symbolCache.getInnerDefinition(innerRef);
+        if (!item.hasPort())
+          printReference(item.getOp(), /*interfaceOnly=*/true);
+      }
+    });
+  });
+
+  llvm::SHA256 hasher;
+  hasher.update(os.str());
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+void SharedEmitterState::emitOperationCached(Operation *op, raw_ostream &os) {
+  auto key = getModuleCacheKey(op);
+  if (!key.empty()) {
+    if (auto text = moduleCache->lookup(key)) {
+      os << *text;
+      return;
+    }
+  }
+
+  // The text is collected in a buffer to be stored in the cache, unless the
+  // emission fails.
+  SmallString<256> buffer;
+  llvm::raw_svector_ostream bufferStream(buffer);
+  VerilogEmitterState state(designOp, *this, options, symbolCache, globalNames,
+                            key.empty() ? os : bufferStream);
+  emitOperation(state, op);
+  if (state.encounteredError)
+    encounteredError = true;
+  if (key.empty())
+    return;
+  if (!state.encounteredError)
+    moduleCache->store(key, buffer);
+  os << buffer;
+}
+
 /// Actually emit the collected list of operations and strings to the
 /// specified file.
 void SharedEmitterState::emitOps(EmissionList &thingsToEmit, raw_ostream &os,
@@ -4410,10 +4493,14 @@ void SharedEmitterState::emitOps(EmissionList &thingsToEmit, raw_ostream &os,
     VerilogEmitterState state(designOp, *this, options, symbolCache,
                               globalNames, os);
     for (auto &entry : thingsToEmit) {
-      if (auto *op = entry.getOperation())
-        emitOperation(state, op);
-      else
+      if (auto *op = entry.getOperation()) {
+        if (moduleCache)
+          emitOperationCached(op, os);
+        else
+          emitOperation(state, op);
+      } else {
         os << entry.getStringData();
+      }
     }
 
     if (state.encounteredError)
@@ -4422,41 +4509,67 @@ void SharedEmitterState::emitOps(EmissionList &thingsToEmit, raw_ostream &os,
   }
 
   // If we are parallelizing emission, we emit each independent operation to a
-  // string buffer in parallel, then concat at the end.
-  parallelForEach(context, thingsToEmit, [&](StringOrOpToEmit &stringOrOp) {
-    auto *op = stringOrOp.getOperation();
-    if (!op)
-      return; // Ignore things that are already strings.
-
-    // BindOp emission reaches into the hw.module of the instance, and that
-    // body may be being transformed by its own emission.  Defer their
-    // emission to the serial phase.  They are speedy to emit anyway.
-    if (isa<BindOp>(op) || modulesContainingBinds.count(op))
-      return;
-
-    SmallString<256> buffer;
-    llvm::raw_svector_ostream tmpStream(buffer);
-    VerilogEmitterState state(designOp, *this, options, symbolCache,
-                              globalNames, tmpStream);
-    emitOperation(state, op);
-    stringOrOp.setString(buffer);
-  });
+  // string buffer in parallel, and stream the buffers to the output in order
+  // as soon as they are complete. At most a few buffers per thread are in
+  // flight at any time, such that the memory held by the buffers is
+  // proportional to the number of threads rather than to the size of the
+  // design.
+  llvm::ThreadPool &threadPool = context->getThreadPool();
+  size_t windowSize = emissionWindowSize ? emissionWindowSize
+                                         : 4 * threadPool.getThreadCount();
+  ParallelDiagnosticHandler diagHandler(context);
+  std::deque<std::pair<StringOrOpToEmit *, std::shared_future<void>>> window;
+
+  // Wait for the oldest entry in flight and emit it.
+  auto emitOldest = [&]() {
+    auto &[entry, rendered] = window.front();
+    if (rendered.valid())
+      rendered.wait();
 
-  // Finally emit each entry now that we know it is a string.
-  for (auto &entry : thingsToEmit) {
     // Almost everything is lowered to a string, just concat the strings onto
     // the output stream.
-    auto *op = entry.getOperation();
-    if (!op) {
-      os << entry.getStringData();
-      continue;
+    if (auto *op = entry->getOperation()) {
+      // If this wasn't emitted to a string (e.g. it is a bind) do so now. Its
+      // emission reaches into the bodies of other modules, so the entries
+      // still rendered by the workers are drained first.
+      for (auto &inFlight : window)
+        if (inFlight.second.valid())
+          inFlight.second.wait();
+      VerilogEmitterState state(designOp, *this, options, symbolCache,
+                                globalNames, os);
+      emitOperation(state, op);
+    } else {
+      os << entry->getStringData();
+      entry->releaseString();
     }
+    window.pop_front();
+  };
 
-    // If this wasn't emitted to a string (e.g. it is a bind) do so now.
-    VerilogEmitterState state(designOp, *this, options, symbolCache,
-                              globalNames, os);
-    emitOperation(state, op);
+  size_t index = 0;
+  for (auto &stringOrOp : thingsToEmit) {
+    std::shared_future<void> rendered;
+    auto *op = stringOrOp.getOperation();
+    // BindOp emission reaches into the hw.module of the instance, and that
+    // body may be being transformed by its own emission.  Emit them serially
+    // once they reach the front of the window, and no other entry is being
+    // rendered.  They are speedy to emit anyway.
+    if (op && !isa<BindOp>(op) && !modulesContainingBinds.count(op)) {
+      rendered = threadPool.async([&, op, index, entry = &stringOrOp] {
+        diagHandler.setOrderIDForThread(index);
+        SmallString<256> buffer;
+        llvm::raw_svector_ostream tmpStream(buffer);
+        emitOperationCached(op, tmpStream);
+        entry->setString(buffer);
+        diagHandler.eraseOrderIDForThread();
+      });
+    }
+    window.emplace_back(&stringOrOp, std::move(rendered));
+    ++index;
+    if (window.size() >= windowSize)
+      emitOldest();
   }
+  while (!window.empty())
+    emitOldest();
 }
 
 /// Prepare the given MLIR module for emission.
@@ -4473,7 +4586,9 @@ static void prepareForEmission(ModuleOp module,
 // Unified Emitter
 //===----------------------------------------------------------------------===//
 
-LogicalResult circt::exportVerilog(ModuleOp module, llvm::raw_ostream &os) {
+static LogicalResult exportVerilogImpl(ModuleOp module, llvm::raw_ostream &os,
+                                       ExportVerilogModuleCache *moduleCache,
+                                       size_t emissionWindowSize) {
   // Prepare the ops in the module for emission and legalize the names that will
   // end up in the output.
   LoweringOptions options(module);
@@ -4481,6 +4596,8 @@ LogicalResult circt::exportVerilog(ModuleOp module, llvm::raw_ostream &os) {
   GlobalNameTable globalNames = legalizeGlobalNames(module);
 
   SharedEmitterState emitter(module, options, std::move(globalNames));
+  emitter.moduleCache = moduleCache;
+  emitter.emissionWindowSize = emissionWindowSize;
   emitter.gatherFiles(false);
 
   if (emitter.options.emitReplicatedOpsToHeader)
@@ -4515,28 +4632,38 @@ LogicalResult circt::exportVerilog(ModuleOp module, llvm::raw_ostream &os) {
   return failure(emitter.encounteredError);
 }
 
+LogicalResult circt::exportVerilog(ModuleOp module, llvm::raw_ostream &os,
+                                   ExportVerilogModuleCache *moduleCache) {
+  return exportVerilogImpl(module, os, moduleCache,
+                           /*emissionWindowSize=*/0);
+}
+
 namespace {
 
 struct ExportVerilogPass : public ExportVerilogBase<ExportVerilogPass> {
-  ExportVerilogPass(raw_ostream &os) : os(os) {}
+  ExportVerilogPass(raw_ostream &os, ExportVerilogModuleCache *moduleCache)
+      : os(os), moduleCache(moduleCache) {}
   void runOnOperation() override {
     // Make sure LoweringOptions are applied to the module if it was overridden
     // on the command line.
     // TODO: This should be moved up to circt-opt and circt-translate.
     applyLoweringCLOptions(getOperation());
 
-    if (failed(exportVerilog(getOperation(), os)))
+    if (failed(exportVerilogImpl(getOperation(), os, moduleCache,
+                                 emissionWindowSize)))
       signalPassFailure();
   }
 
 private:
   raw_ostream &os;
+  ExportVerilogModuleCache *moduleCache;
 };
 } // end anonymous namespace
 
 std::unique_ptr<mlir::Pass>
-circt::createExportVerilogPass(llvm::raw_ostream &os) {
-  return std::make_unique<ExportVerilogPass>(os);
+circt::createExportVerilogPass(llvm::raw_ostream &os,
+                               ExportVerilogModuleCache *moduleCache) {
+  return std::make_unique<ExportVerilogPass>(os, moduleCache);
 }
 
 std::unique_ptr<mlir::Pass> circt::createExportVerilogPass() {
@@ -4574,13 +4701,51 @@ createOutputFile(StringRef fileName, StringRef dirname,
   return output;
 }
 
-static void createSplitOutputFile(StringAttr fileName, FileInfo &file,
-                                  StringRef dirname,
-                                  SharedEmitterState &emitter) {
+namespace {
+/// Writes the files of the split emitter. Files are emitted to memory first,
+/// such that the ones whose contents did not change can be left untouched, and
+/// the incremental builds downstream do not see them as modified.
+struct SplitFileWriter {
+  SplitFileWriter(StringRef dirname, bool skipUnchangedFiles,
+                  SharedEmitterState &emitter)
+      : dirname(dirname), skipUnchangedFiles(skipUnchangedFiles),
+        emitter(emitter) {}
+
+  void write(StringRef fileName, StringRef contents);
+
+  StringRef dirname;
+  bool skipUnchangedFiles;
+  SharedEmitterState &emitter;
+
+  // The files are written in parallel.
+  std::atomic<unsigned> numFilesWritten{0};
+  std::atomic<unsigned> numFilesReused{0};
+};
+} // namespace
+
+void SplitFileWriter::write(StringRef fileName, StringRef contents) {
+  if (skipUnchangedFiles) {
+    SmallString<128> outputFilename(dirname);
+    appendPossiblyAbsolutePath(outputFilename, fileName);
+    auto existing = llvm::MemoryBuffer::getFile(
+        outputFilename, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (existing && (*existing)->getBuffer() == contents) {
+      ++numFilesReused;
+      return;
+    }
+  }
+
   auto output = createOutputFile(fileName, dirname, emitter);
   if (!output)
     return;
+  output->os() << contents;
+  output->keep();
+  ++numFilesWritten;
+}
 
+static void createSplitOutputFile(StringAttr fileName, FileInfo &file,
+                                  SplitFileWriter &writer,
+                                  SharedEmitterState &emitter) {
   SharedEmitterState::EmissionList list;
   emitter.collectOpsForFile(file, list,
                             emitter.options.emitReplicatedOpsToHeader);
@@ -4589,11 +4754,15 @@ static void createSplitOutputFile(StringAttr fileName, FileInfo &file,
   // state.  Don't parallelize emission of the ops within this file - we
   // already parallelize per-file emission and we pay a string copy overhead
   // for parallelization.
-  emitter.emitOps(list, output->os(), /*parallelize=*/false);
-  output->keep();
+  std::string contents;
+  llvm::raw_string_ostream os(contents);
+  emitter.emitOps(list, os, /*parallelize=*/false);
+  writer.write(fileName, os.str());
 }
 
-LogicalResult circt::exportSplitVerilog(ModuleOp module, StringRef dirname) {
+LogicalResult circt::exportSplitVerilog(ModuleOp module, StringRef dirname,
+                                        bool skipUnchangedFiles,
+                                        SplitExportStatistics *statistics) {
   // Prepare the ops in the module for emission and legalize the names that will
   // end up in the output.
   LoweringOptions options(module);
@@ -4620,40 +4789,35 @@ LogicalResult circt::exportSplitVerilog(ModuleOp module, StringRef dirname) {
     }
   }
 
+  SplitFileWriter writer(dirname, skipUnchangedFiles, emitter);
+
   // Emit each file in parallel if context enables it.
   parallelForEach(module->getContext(), emitter.files.begin(),
                   emitter.files.end(), [&](auto &it) {
-                    createSplitOutputFile(it.first, it.second, dirname,
+                    createSplitOutputFile(it.first, it.second, writer,
                                           emitter);
                   });
 
   // Write the file list.
-  SmallString<128> filelistPath(dirname);
-  llvm::sys::path::append(filelistPath, "filelist.f");
-
-  std::string errorMessage;
-  auto output = mlir::openOutputFile(filelistPath, &errorMessage);
-  if (!output) {
-    module->emitError(errorMessage);
-    return failure();
-  }
-
+  std::string filelist;
   for (const auto &it : emitter.files) {
     if (it.second.addToFilelist)
-      output->os() << it.first.str() << "\n";
+      filelist += it.first.str() + "\n";
   }
-  output->keep();
+  writer.write("filelist.f", filelist);
 
   // Emit the filelists.
   for (auto &it : emitter.fileLists) {
-    auto output = createOutputFile(it.first(), dirname, emitter);
-    if (!output)
-      continue;
+    std::string contents;
     for (auto &name : it.second)
-      output->os() << name.str() << "\n";
-    output->keep();
+      contents += name.str() + "\n";
+    writer.write(it.first(), contents);
   }
 
+  if (statistics) {
+    statistics->numFilesWritten = writer.numFilesWritten;
+    statistics->numFilesReused = writer.numFilesReused;
+  }
   return failure(emitter.encounteredError);
 }
 
@@ -4661,21 +4825,29 @@ namespace {
 
 struct ExportSplitVerilogPass
     : public ExportSplitVerilogBase<ExportSplitVerilogPass> {
-  ExportSplitVerilogPass(StringRef directory) {
+  ExportSplitVerilogPass(StringRef directory, bool skipUnchanged) {
     directoryName = directory.str();
+    skipUnchangedFiles = skipUnchanged;
   }
   void runOnOperation() override {
     // Make sure LoweringOptions are applied to the module if it was overridden
     // on the command line.
     // TODO: This should be moved up to circt-opt and circt-translate.
     applyLoweringCLOptions(getOperation());
-    if (failed(exportSplitVerilog(getOperation(), directoryName)))
+    SplitExportStatistics statistics;
+    auto result = exportSplitVerilog(getOperation(), directoryName,
+                                     skipUnchangedFiles, &statistics);
+    numFilesWritten += statistics.numFilesWritten;
+    numFilesReused += statistics.numFilesReused;
+    if (failed(result))
       signalPassFailure();
   }
 };
 } // end anonymous namespace
 
 std::unique_ptr<mlir::Pass>
-circt::createExportSplitVerilogPass(StringRef directory) {
-  return std::make_unique<ExportSplitVerilogPass>(directory);
+circt::createExportSplitVerilogPass(StringRef directory,
+                                   bool skipUnchangedFiles) {
+  return std::make_unique<ExportSplitVerilogPass>(directory,
+                                                  skipUnchangedFiles);
 }
@@ -18,6 +18,7 @@
 
 namespace circt {
 struct LoweringOptions;
+class ExportVerilogModuleCache;
 
 namespace ExportVerilog {
 class GlobalNameResolver;
@@ -186,6 +187,15 @@ public:
     pointerData = (const void *)data;
   }
 
+  /// Release the string held by the entry once it has been emitted, leaving
+  /// the entry empty.
+  void releaseString() {
+    if (const void *ptr = pointerData.dyn_cast<const void *>())
+      free(const_cast<void *>(ptr));
+    pointerData = (Operation *)nullptr;
+    length = 0;
+  }
+
   // These move just fine.
   StringOrOpToEmit(StringOrOpToEmit &&rhs)
       : pointerData(rhs.pointerData), length(rhs.length) {
@@ -237,6 +247,13 @@ struct SharedEmitterState {
   /// Information about renamed global symbols, parameters, etc.
   const GlobalNameTable globalNames;
 
+  /// The cache the text of the modules is reused from, if any.
+  ExportVerilogModuleCache *moduleCache = nullptr;
+
+  /// The number of operations rendered ahead of the output by parallel
+  /// emission, or 0 for a few per thread.
+  size_t emissionWindowSize = 0;
+
   explicit SharedEmitterState(ModuleOp designOp, const LoweringOptions &options,
                               GlobalNameTable globalNames)
       : designOp(designOp), options(options),
@@ -248,6 +265,14 @@ struct SharedEmitterState {
   void collectOpsForFile(const FileInfo &fileInfo, EmissionList &thingsToEmit,
                          bool emitHeader = false);
   void emitOps(EmissionList &thingsToEmit, raw_ostream &os, bool parallelize);
+
+  /// Return the key of an operation in the module cache, or an empty string if
+  /// its text cannot be cached.
+  std::string getModuleCacheKey(Operation *op) const;
+
+  /// Emit an operation to the given stream, reusing its text from the module
+  /// cache if possible.
+  void emitOperationCached(Operation *op, raw_ostream &os);
 };
 
 //===----------------------------------------------------------------------===//
@@ -256,6 +256,33 @@ static Type getProcPersistenceTy(LLVM::LLVMDialect *dialect,
   return LLVM::LLVMStructType::getLiteral(dialect->getContext(), types);
 }
 
+/// Collect the GEP indices and the type of all the pointers nested in the
+/// given type.
+static void collectPointerIndices(
+    Type type, SmallVectorImpl<int32_t> &indices,
+    SmallVectorImpl<std::pair<SmallVector<int32_t>, Type>> &out) {
+  if (type.isa<LLVM::LLVMPointerType>()) {
+    out.emplace_back(SmallVector<int32_t>(indices.begin(), indices.end()),
+                     type);
+    return;
+  }
+  if (auto structTy = type.dyn_cast<LLVM::LLVMStructType>()) {
+    for (auto &elem : llvm::enumerate(structTy.getBody())) {
+      indices.push_back(elem.index());
+      collectPointerIndices(elem.value(), indices, out);
+      indices.pop_back();
+    }
+    return;
+  }
+  if (auto arrayTy = type.dyn_cast<LLVM::LLVMArrayType>()) {
+    for (unsigned i = 0, e = arrayTy.getNumElements(); i < e; ++i) {
+      indices.push_back(i);
+      collectPointerIndices(arrayTy.getElementType(), indices, out);
+      indices.pop_back();
+    }
+  }
+}
+
 /// Insert a comparison block that either jumps to the trueDest block, if the
 /// resume index mathces the current index, or to falseDest otherwise. If no
 /// falseDest is provided, the next block is taken insead.
@@ -1074,14 +1101,21 @@ struct InstOpConversion : public ConvertToLLVMPattern {
                             "addSigStructElement", addSigStructElemFuncTy);
 
     // Get or insert allocProc library call definition.
-    auto allocProcFuncTy =
-        LLVM::LLVMFunctionType::get(voidTy, {i8PtrTy, i8PtrTy, i8PtrTy});
+    auto allocProcFuncTy = LLVM::LLVMFunctionType::get(
+        voidTy, {i8PtrTy, i8PtrTy, i8PtrTy, i64Ty});
     auto allocProcFunc = getOrInsertFunction(module, rewriter, op->getLoc(),
                                              "allocProc", allocProcFuncTy);
 
+    // Get or insert addProcPointer library call definition.
+    auto addProcPointerFuncTy =
+        LLVM::LLVMFunctionType::get(voidTy, {i8PtrTy, i8PtrTy, i64Ty});
+    auto addProcPointerFunc =
+        getOrInsertFunction(module, rewriter, op->getLoc(), "addProcPointer",
+                            addProcPointerFuncTy);
+
     // Get or insert allocEntity library call definition.
-    auto allocEntityFuncTy =
-        LLVM::LLVMFunctionType::get(voidTy, {i8PtrTy, i8PtrTy, i8PtrTy});
+    auto allocEntityFuncTy = LLVM::LLVMFunctionType::get(
+        voidTy, {i8PtrTy, i8PtrTy, i8PtrTy, i64Ty});
     auto allocEntityFunc = getOrInsertFunction(
         module, rewriter, op->getLoc(), "allocEntity", allocEntityFuncTy);
 
@@ -1157,7 +1191,7 @@ struct InstOpConversion : public ConvertToLLVMPattern {
       // Add reg state pointer to global state.
       initBuilder.create<LLVM::CallOp>(
           op->getLoc(), llvm::None, SymbolRefAttr::get(allocEntityFunc),
-          ArrayRef<Value>({initStatePtr, owner, regMall}));
+          ArrayRef<Value>({initStatePtr, owner, regMall, regSize}));
 
       // Index of the signal in the entity's signal table.
       int initCounter = 0;
@@ -1289,11 +1323,12 @@ struct InstOpConversion : public ConvertToLLVMPattern {
       // Handle process instantiation.
       auto sensesPtrTy = LLVM::LLVMPointerType::get(
           LLVM::LLVMArrayType::get(i1Ty, proc.getNumArguments()));
+      auto persistenceTy =
+          getProcPersistenceTy(&getDialect(), typeConverter, proc);
       auto procStatePtrTy =
           LLVM::LLVMPointerType::get(LLVM::LLVMStructType::getLiteral(
               rewriter.getContext(),
-              {i32Ty, i32Ty, sensesPtrTy,
-               getProcPersistenceTy(&getDialect(), typeConverter, proc)}));
+              {i32Ty, i32Ty, sensesPtrTy, persistenceTy}));
 
       auto zeroC = initBuilder.create<LLVM::ConstantOp>(
           op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(0));
@@ -1366,10 +1401,31 @@ struct InstOpConversion : public ConvertToLLVMPattern {
       initBuilder.create<LLVM::StoreOp>(op->getLoc(), sensesBC,
                                         procStateSensesPtr);
 
-      std::array<Value, 3> allocProcArgs({initStatePtr, owner, procStateMall});
+      std::array<Value, 4> allocProcArgs(
+          {initStatePtr, owner, procStateMall, procStateSize});
       initBuilder.create<LLVM::CallOp>(op->getLoc(), llvm::None,
                                        SymbolRefAttr::get(allocProcFunc),
                                        allocProcArgs);
+
+      // Record the offsets of the pointers persisted across suspensions, such
+      // that the simulator can relocate them when restoring a snapshot.
+      SmallVector<int32_t> indices = {0, 3};
+      SmallVector<std::pair<SmallVector<int32_t>, Type>> pointers;
+      collectPointerIndices(persistenceTy, indices, pointers);
+      for (auto &pointer : pointers) {
+        SmallVector<Value> gepArgs;
+        for (auto index : pointer.first)
+          gepArgs.push_back(initBuilder.create<LLVM::ConstantOp>(
+              op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(index)));
+        auto pointerGep = initBuilder.create<LLVM::GEPOp>(
+            op->getLoc(), LLVM::LLVMPointerType::get(pointer.second),
+            procStateNullPtr, gepArgs);
+        auto pointerOffset = initBuilder.create<LLVM::PtrToIntOp>(
+            op->getLoc(), i64Ty, pointerGep);
+        initBuilder.create<LLVM::CallOp>(
+            op->getLoc(), llvm::None, SymbolRefAttr::get(addProcPointerFunc),
+            ArrayRef<Value>({initStatePtr, owner, pointerOffset}));
+      }
     }
 
     rewriter.eraseOp(op);
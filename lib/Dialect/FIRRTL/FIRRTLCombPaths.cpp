@@ -0,0 +1,293 @@
+//===- FIRRTLCombPaths.cpp - Combinational paths between ports ------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the analysis of the combinational paths between the
+// ports of FIRRTL modules.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/FIRRTLCombPaths.h"
+#include "circt/Dialect/FIRRTL/FIRRTLInstanceGraph.h"
+#include "circt/Dialect/FIRRTL/FIRRTLModuleParallel.h"
+#include "mlir/IR/Threading.h"
+
+using namespace circt;
+using namespace firrtl;
+
+namespace {
+/// The combinational graph of a module. The nodes are the values reachable
+/// from the ports and from the destinations of the connects, numbered in the
+/// order they are discovered, and the edges of every node are stored next to
+/// each other in a single array.
+class CombGraph {
+public:
+  CombGraph(FModuleOp module,
+            const DenseMap<Operation *, ModuleCombPaths> &summaries,
+            InstanceGraph &instanceGraph);
+
+  /// Compute the combinational paths between the ports of the module, and
+  /// whether the module contains a combinational cycle.
+  ModuleCombPaths summarize();
+
+private:
+  unsigned getNode(Value value);
+  void addChildren(Value value);
+  void addUses(Value value);
+  void addMemoryChildren(MemOp memory, SubfieldOp subfield);
+  bool hasCycle();
+
+  FModuleOp module;
+  const DenseMap<Operation *, ModuleCombPaths> &summaries;
+  InstanceGraph &instanceGraph;
+
+  SmallVector<Value> values;
+  DenseMap<Value, unsigned> nodes;
+  SmallVector<unsigned> edgeBegins;
+  SmallVector<unsigned> edges;
+};
+} // namespace
+
+CombGraph::CombGraph(FModuleOp module,
+                     const DenseMap<Operation *, ModuleCombPaths> &summaries,
+                     InstanceGraph &instanceGraph)
+    : module(module), summaries(summaries), instanceGraph(instanceGraph) {
+  // As a FIRRTL module is an SSA region, every cycle contains a connect, and
+  // so the destination of a connect.
+  for (auto arg : module.getBody()->getArguments())
+    getNode(arg);
+  for (auto connect : module.getOps<FConnectLike>())
+    getNode(connect.dest());
+
+  // Nodes discovered while adding edges are appended to the list, and visited
+  // in turn.
+  for (unsigned node = 0; node < values.size(); ++node) {
+    edgeBegins.push_back(edges.size());
+    addChildren(values[node]);
+  }
+  edgeBegins.push_back(edges.size());
+}
+
+unsigned CombGraph::getNode(Value value) {
+  auto [it, inserted] = nodes.insert({value, values.size()});
+  if (inserted)
+    values.push_back(value);
+  return it->second;
+}
+
+void CombGraph::addChildren(Value value) {
+  auto *op = value.getDefiningOp();
+  if (!op)
+    return addUses(value);
+
+  // Registers break combinational paths.
+  if (isa<RegOp, RegResetOp>(op))
+    return;
+
+  // An input of an instance drives the users of the outputs it has a
+  // combinational path to.
+  if (auto instance = dyn_cast<InstanceOp>(op)) {
+    auto *module = instanceGraph.getReferencedModule(instance).getOperation();
+    auto it = summaries.find(module);
+    if (it == summaries.end())
+      return;
+    auto &ports = it->second.paths[value.cast<OpResult>().getResultNumber()];
+    for (auto outputPort : ports.set_bits())
+      addUses(instance.getResult(outputPort));
+    return;
+  }
+
+  if (auto subfield = dyn_cast<SubfieldOp>(op))
+    if (auto memory = subfield.input().getDefiningOp<MemOp>())
+      return addMemoryChildren(memory, subfield);
+
+  addUses(value);
+}
+
+void CombGraph::addUses(Value value) {
+  for (auto &use : value.getUses()) {
+    auto *owner = use.getOwner();
+    // A connect drives its destination from its source.
+    if (auto connect = dyn_cast<FConnectLike>(owner)) {
+      if (use.get() == connect.src())
+        edges.push_back(getNode(connect.dest()));
+      continue;
+    }
+    if (owner->getNumResults() > 0)
+      edges.push_back(getNode(owner->getResult(0)));
+  }
+}
+
+void CombGraph::addMemoryChildren(MemOp memory, SubfieldOp subfield) {
+  // Only the address of a read port of a memory with a read latency of zero
+  // has a combinational path, to the data of the same port.
+  if (memory.readLatency() != 0)
+    return;
+  auto portKind =
+      memory.getPortKind(subfield.input().cast<OpResult>().getResultNumber());
+  auto subfieldIndex = subfield.fieldIndex();
+  if (!(portKind == MemOp::PortKind::Read &&
+        subfieldIndex == (unsigned)ReadPortSubfield::addr) &&
+      !(portKind == MemOp::PortKind::ReadWrite &&
+        subfieldIndex == (unsigned)ReadWritePortSubfield::addr))
+    return;
+
+  for (auto *user : subfield.input().getUsers()) {
+    auto dataSubfield = dyn_cast<SubfieldOp>(user);
+    if (!dataSubfield)
+      return;
+    auto index = dataSubfield.fieldIndex();
+    if ((portKind == MemOp::PortKind::Read &&
+         index == (unsigned)ReadPortSubfield::data) ||
+        (portKind == MemOp::PortKind::ReadWrite &&
+         index == (unsigned)ReadWritePortSubfield::rdata))
+      return addUses(dataSubfield.result());
+  }
+}
+
+/// Look for a strongly connected component with more than one node, or a node
+/// with an edge to itself, with an iterative version of Tarjan's algorithm.
+bool CombGraph::hasCycle() {
+  const unsigned unvisited = ~0u;
+  unsigned numNodes = values.size();
+  SmallVector<unsigned> indices(numNodes, unvisited);
+  SmallVector<unsigned> lowLinks(numNodes);
+  llvm::BitVector onStack(numNodes);
+  SmallVector<unsigned> stack;
+  // The nodes being visited, along with the next edge to follow.
+  SmallVector<std::pair<unsigned, unsigned>> visiting;
+  unsigned nextIndex = 0;
+
+  auto visit = [&](unsigned node) {
+    indices[node] = lowLinks[node] = nextIndex++;
+    stack.push_back(node);
+    onStack.set(node);
+    visiting.push_back({node, edgeBegins[node]});
+  };
+
+  for (unsigned root = 0; root < numNodes; ++root) {
+    if (indices[root] != unvisited)
+      continue;
+    visit(root);
+    while (!visiting.empty()) {
+      auto node = visiting.back().first;
+      auto &edge = visiting.back().second;
+      if (edge != edgeBegins[node + 1]) {
+        auto child = edges[edge++];
+        if (child == node)
+          return true;
+        if (indices[child] == unvisited)
+          visit(child);
+        else if (onStack.test(child))
+          lowLinks[node] = std::min(lowLinks[node], indices[child]);
+        continue;
+      }
+
+      // The node is the root of a component. The nodes above it on the stack
+      // belong to the same component.
+      if (lowLinks[node] == indices[node]) {
+        if (stack.back() != node)
+          return true;
+        stack.pop_back();
+        onStack.reset(node);
+      }
+      visiting.pop_back();
+      if (!visiting.empty()) {
+        auto parent = visiting.back().first;
+        lowLinks[parent] = std::min(lowLinks[parent], lowLinks[node]);
+      }
+    }
+  }
+  return false;
+}
+
+ModuleCombPaths CombGraph::summarize() {
+  ModuleCombPaths summary;
+  summary.hasCycle = hasCycle();
+
+  // The ports are the first nodes of the graph. Walk the graph from every
+  // input port, and record the output ports it reaches.
+  unsigned numPorts = module.getNumPorts();
+  summary.paths.resize(numPorts);
+  llvm::BitVector visited(values.size());
+  SmallVector<unsigned> worklist;
+  for (unsigned port = 0; port < numPorts; ++port) {
+    if (module.getPortDirection(port) != Direction::In)
+      continue;
+    auto &outputs = summary.paths[port];
+    outputs.resize(numPorts);
+    visited.reset();
+    visited.set(port);
+    worklist.push_back(port);
+    while (!worklist.empty()) {
+      auto node = worklist.pop_back_val();
+      if (node < numPorts && module.getPortDirection(node) == Direction::Out)
+        outputs.set(node);
+      for (auto i = edgeBegins[node], e = edgeBegins[node + 1]; i != e; ++i) {
+        auto child = edges[i];
+        if (!visited.test(child)) {
+          visited.set(child);
+          worklist.push_back(child);
+        }
+      }
+    }
+  }
+  return summary;
+}
+
+CombPathsAnalysis::CombPathsAnalysis(Operation *operation,
+                                     mlir::AnalysisManager &am) {
+  auto circuit = cast<CircuitOp>(operation);
+  auto &instanceGraph = am.getAnalysis<InstanceGraph>();
+
+  // Group the modules by their height in the instance graph, i.e. the length
+  // of the longest chain of instances below them. A module only instantiates
+  // modules of a lower height, so the modules of a level can be summarized in
+  // parallel once the levels below are.
+  auto modules =
+      getModulesInOrder(circuit, instanceGraph, ModuleOrder::BottomUp);
+  DenseMap<InstanceGraphNode *, unsigned> heights;
+  SmallVector<SmallVector<FModuleOp>> levels;
+  for (auto module : modules) {
+    auto *node = instanceGraph.lookup(module.getOperation());
+    unsigned height = 0;
+    for (auto *record : *node)
+      height = std::max(height, heights.lookup(record->getTarget()) + 1);
+    heights[node] = height;
+
+    // Every module has an entry before the summaries are computed, such that
+    // the map is not modified while it is read.
+    auto &summary = summaries[module];
+    // TODO: Handle FExtModuleOp with `ExtModulePathAnnotation`s.
+    if (auto fmodule = dyn_cast<FModuleOp>(module.getOperation())) {
+      if (levels.size() <= height)
+        levels.resize(height + 1);
+      levels[height].push_back(fmodule);
+    } else {
+      summary.paths.resize(module.getNumPorts());
+    }
+  }
+
+  for (auto &level : levels) {
+    mlir::parallelForEach(circuit.getContext(), level, [&](FModuleOp module) {
+      auto summary = CombGraph(module, summaries, instanceGraph).summarize();
+      summaries.find(module)->second = std::move(summary);
+    });
+  }
+
+  for (auto module : modules)
+    if (auto fmodule = dyn_cast<FModuleOp>(module.getOperation()))
+      if (getCombPaths(module).hasCycle)
+        cyclicModules.push_back(fmodule);
+}
+
+const ModuleCombPaths &
+CombPathsAnalysis::getCombPaths(FModuleLike module) const {
+  auto it = summaries.find(module);
+  assert(it != summaries.end() && "module not in the circuit");
+  return it->second;
+}
@@ -0,0 +1,36 @@
+//===- FIRRTLModuleParallel.cpp - Module-parallel pass driver -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/FIRRTLModuleParallel.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+using namespace circt;
+using namespace firrtl;
+
+SmallVector<FModuleLike>
+circt::firrtl::getModulesInOrder(CircuitOp circuit,
+                                 InstanceGraph &instanceGraph,
+                                 ModuleOrder order) {
+  SmallVector<FModuleLike> modules;
+  if (order == ModuleOrder::Circuit) {
+    for (auto module : circuit.getBody()->getOps<FModuleLike>())
+      modules.push_back(module);
+    return modules;
+  }
+
+  // Visit the instance graph from every node, such that modules which are not
+  // instantiated below the top-level module are covered as well.
+  SmallPtrSet<InstanceGraphNode *, 16> visited;
+  for (auto *root : instanceGraph)
+    for (auto *node : llvm::post_order_ext(root, visited))
+      modules.push_back(cast<FModuleLike>(node->getModule().getOperation()));
+  if (order == ModuleOrder::TopDown)
+    std::reverse(modules.begin(), modules.end());
+  return modules;
+}
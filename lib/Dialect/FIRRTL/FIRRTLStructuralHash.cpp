@@ -0,0 +1,188 @@
+//===- FIRRTLStructuralHash.cpp - FIRRTL module hashing -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the structural hash of FIRRTL modules.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/FIRRTLStructuralHash.h"
+#include "mlir/IR/Operation.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace circt;
+using namespace firrtl;
+
+StructuralHasher::StructuralHasher(MLIRContext *context, Mode mode)
+    : mode(mode) {
+  portTypesAttr = StringAttr::get(context, "portTypes");
+  // Names and annotations make a difference to the output, so they are only
+  // ignored when looking for structurally identical modules.
+  if (mode == Mode::Persistent)
+    return;
+  nonessentialAttributes.insert(StringAttr::get(context, "annotations"));
+  nonessentialAttributes.insert(StringAttr::get(context, "name"));
+  nonessentialAttributes.insert(StringAttr::get(context, "portAnnotations"));
+  nonessentialAttributes.insert(StringAttr::get(context, "portNames"));
+  nonessentialAttributes.insert(StringAttr::get(context, "portSyms"));
+  nonessentialAttributes.insert(StringAttr::get(context, "sym_name"));
+  nonessentialAttributes.insert(StringAttr::get(context, "inner_sym"));
+}
+
+std::array<uint8_t, 32> StructuralHasher::hash(Operation *op) {
+  update(op);
+  auto hash = sha.final();
+  reset();
+  return hash;
+}
+
+void StructuralHasher::reset() {
+  currentIndex = 0;
+  indexes.clear();
+  sha.init();
+}
+
+void StructuralHasher::update(const void *pointer) {
+  auto *addr = reinterpret_cast<const uint8_t *>(&pointer);
+  sha.update(ArrayRef(addr, sizeof pointer));
+}
+
+void StructuralHasher::update(size_t value) {
+  auto *addr = reinterpret_cast<const uint8_t *>(&value);
+  sha.update(ArrayRef(addr, sizeof value));
+}
+
+void StructuralHasher::update(StringRef string) {
+  // Hash the length first, such that consecutive strings cannot run into each
+  // other.
+  update(string.size());
+  sha.update(string);
+}
+
+void StructuralHasher::update(TypeID typeID) {
+  update(typeID.getAsOpaquePointer());
+}
+
+template <typename T>
+void StructuralHasher::updateText(T value) {
+  auto &text = printed[value.getAsOpaquePointer()];
+  if (text.empty()) {
+    llvm::raw_string_ostream os(text);
+    value.print(os);
+  }
+  update(StringRef(text));
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void StructuralHasher::update(BundleType type) {
+  update(type.getTypeID());
+  for (auto &element : type.getElements()) {
+    update(element.isFlip);
+    update(element.type);
+  }
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void StructuralHasher::update(Type type) {
+  if (mode == Mode::Persistent)
+    return updateText(type);
+  if (auto bundle = type.dyn_cast<BundleType>())
+    return update(bundle);
+  update(type.getAsOpaquePointer());
+}
+
+void StructuralHasher::update(Attribute attr) {
+  if (mode == Mode::Persistent)
+    return updateText(attr);
+  update(attr.getAsOpaquePointer());
+}
+
+void StructuralHasher::update(Location loc) {
+  // Locations end up in the output, but do not affect the structure.
+  if (mode == Mode::Persistent)
+    updateText(loc);
+}
+
+void StructuralHasher::update(BlockArgument arg) {
+  indexes[arg] = currentIndex++;
+  if (mode == Mode::Persistent)
+    update(arg.getType());
+}
+
+void StructuralHasher::update(OpResult result) {
+  indexes[result] = currentIndex++;
+  update(result.getType());
+}
+
+void StructuralHasher::update(OpOperand &operand) {
+  // We hash the value's index as it apears in the block.
+  auto it = indexes.find(operand.get());
+  assert(it != indexes.end() && "op should have been previously hashed");
+  update(it->second);
+}
+
+void StructuralHasher::update(DictionaryAttr dict) {
+  for (auto namedAttr : dict) {
+    auto name = namedAttr.getName();
+    auto value = namedAttr.getValue();
+    // Skip names and annotations.
+    if (nonessentialAttributes.contains(name))
+      continue;
+    // Hash the port types, preceded by their number such that modules with a
+    // different number of ports never hash the same.
+    if (name == portTypesAttr && mode == Mode::Structural) {
+      auto portTypes = value.cast<ArrayAttr>();
+      update(portTypes.size());
+      for (auto type : portTypes.getAsValueRange<TypeAttr>())
+        update(type);
+      continue;
+    }
+    // Hash the interned pointer, or the text in persistent mode.
+    if (mode == Mode::Persistent)
+      update(name.getValue());
+    else
+      update(name.getAsOpaquePointer());
+    update(value);
+  }
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void StructuralHasher::update(Block &block) {
+  // Hash the block arguments.
+  for (auto arg : block.getArguments())
+    update(arg);
+  // Hash the operations in the block.
+  for (auto &op : block)
+    update(&op);
+}
+
+void StructuralHasher::update(mlir::OperationName name) {
+  // Operation names are interned.
+  if (mode == Mode::Persistent)
+    update(name.getStringRef());
+  else
+    update(name.getAsOpaquePointer());
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void StructuralHasher::update(Operation *op) {
+  update(op->getName());
+  update(op->getAttrDictionary());
+  update(op->getLoc());
+  // Hash the operands.
+  for (auto &operand : op->getOpOperands())
+    update(operand);
+  // Hash the regions. We need to make sure an empty region doesn't hash the
+  // same as no region, so we include the number of regions.
+  update(op->getNumRegions());
+  for (auto &region : op->getRegions())
+    for (auto &block : region.getBlocks())
+      update(block);
+  // Record any op results.
+  for (auto result : op->getResults())
+    update(result);
+}
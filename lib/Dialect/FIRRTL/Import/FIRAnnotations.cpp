@@ -304,6 +304,118 @@ static std::string addNLATargets(
   return leafTarget.str();
 }
 
+/// Examine an Annotation JSON object and return an optional string indicating
+/// the target associated with this annotation.  Erase the target from the JSON
+/// object if a target was found.  Automatically convert any legacy Named
+/// targets to actual Targets.  Note: it is expected that a target may not
+/// exist, e.g., any subclass of firrtl.annotations.NoTargetAnnotation will not
+/// have a target.
+static llvm::Optional<std::string> findAndEraseTarget(json::Object *object,
+                                                      json::Path p) {
+  // If no "target" field exists, then promote the annotation to a
+  // CircuitTarget annotation by returning a target of "~".
+  auto maybeTarget = object->get("target");
+  if (!maybeTarget)
+    return llvm::Optional<std::string>("~");
+
+  // Find the target.
+  auto maybeTargetStr = maybeTarget->getAsString();
+  if (!maybeTargetStr) {
+    p.field("target").report("target must be a string type");
+    return {};
+  }
+  auto canonTargetStr = oldCanonicalizeTarget(maybeTargetStr.getValue());
+  if (!canonTargetStr) {
+    p.field("target").report("invalid target string");
+    return {};
+  }
+
+  auto target = canonTargetStr.getValue();
+
+  // Remove the target field from the annotation and return the target.
+  object->erase("target");
+  return llvm::Optional<std::string>(target);
+}
+
+bool circt::firrtl::convertAnnotation(json::Object &object,
+                                      StringRef circuitTarget, json::Path p,
+                                      MLIRContext *context,
+                                      ConvertedAnnotation &result) {
+  auto convertFields = [&]() {
+    for (auto field : object) {
+      if (auto value = convertJSONToAttribute(context, field.second, p)) {
+        result.metadata.append(field.first, value);
+        continue;
+      }
+      return false;
+    }
+    return true;
+  };
+
+  // If the annotation has a class name which matches an annotation which the
+  // LowerAnnotations pass knows about, then defer its processing.
+  if (auto *clazz = object.get("class")) {
+    auto classString = clazz->getAsString();
+    if (classString && isAnnoClassLowered(classString.getValue())) {
+      result.isDeferred = true;
+      return convertFields();
+    }
+  }
+
+  // Find and remove the "target" field from the Annotation object if it
+  // exists.  In the FIRRTL Dialect, the target will be implicitly specified
+  // based on where the attribute is applied.
+  auto optTarget = findAndEraseTarget(&object, p);
+  if (!optTarget)
+    return false;
+  StringRef targetStrRef = optTarget.getValue();
+
+  if (targetStrRef != "~") {
+    auto circuitFieldEnd = targetStrRef.find_first_of('|');
+    if (circuitTarget != targetStrRef.take_front(circuitFieldEnd)) {
+      p.report("annotation has invalid circuit name");
+      return false;
+    }
+  }
+
+  // Build up the Attribute to represent the Annotation.
+  result.isDeferred = false;
+  result.target = std::move(*optTarget);
+  return convertFields();
+}
+
+void circt::firrtl::addConvertedAnnotation(
+    ConvertedAnnotation &annotation, CircuitOp circuit, size_t &nlaNumber,
+    llvm::StringMap<llvm::SmallVector<Attribute>> &mutableAnnotationMap) {
+  auto *context = circuit.getContext();
+  if (annotation.isDeferred) {
+    mutableAnnotationMap[rawAnnotations].push_back(
+        DictionaryAttr::get(context, annotation.metadata));
+    return;
+  }
+
+  // Store the annotation in the global Target -> Attribute mapping.
+  auto leafTarget =
+      addNLATargets(context, annotation.target, circuit, nlaNumber,
+                    annotation.metadata, mutableAnnotationMap);
+  mutableAnnotationMap[leafTarget].push_back(
+      DictionaryAttr::get(context, annotation.metadata));
+}
+
+void circt::firrtl::mergeAnnotationMap(
+    llvm::StringMap<llvm::SmallVector<Attribute>> &mutableAnnotationMap,
+    llvm::StringMap<ArrayAttr> &annotationMap, MLIRContext *context) {
+  // Convert the mutable Annotation map to a SmallVector<ArrayAttr>.
+  for (auto a : mutableAnnotationMap.keys()) {
+    // If multiple annotations on a single object, then append it.
+    if (annotationMap.count(a))
+      for (auto attr : annotationMap[a])
+        mutableAnnotationMap[a].push_back(attr);
+
+    annotationMap[a] = ArrayAttr::get(context, mutableAnnotationMap[a]);
+  }
+}
+
 /// Deserialize a JSON value into FIRRTL Annotations.  Annotations are
 /// represented as a Target-keyed arrays of attributes.  The input JSON value is
 /// checked, at runtime, to be an array of objects.  Returns true if successful,
@@ -314,39 +426,6 @@ bool circt::firrtl::fromJSON(json::Value &value, StringRef circuitTarget,
                              size_t &nlaNumber) {
   auto context = circuit.getContext();
 
-  /// Examine an Annotation JSON object and return an optional string indicating
-  /// the target associated with this annotation.  Erase the target from the
-  /// JSON object if a target was found.  Automatically convert any legacy Named
-  /// targets to actual Targets.  Note: it is expected that a target may not
-  /// exist, e.g., any subclass of firrtl.annotations.NoTargetAnnotation will
-  /// not have a target.
-  auto findAndEraseTarget = [](json::Object *object,
-                               json::Path p) -> llvm::Optional<std::string> {
-    // If no "target" field exists, then promote the annotation to a
-    // CircuitTarget annotation by returning a target of "~".
-    auto maybeTarget = object->get("target");
-    if (!maybeTarget)
-      return llvm::Optional<std::string>("~");
-
-    // Find the target.
-    auto maybeTargetStr = maybeTarget->getAsString();
-    if (!maybeTargetStr) {
-      p.field("target").report("target must be a string type");
-      return {};
-    }
-    auto canonTargetStr = oldCanonicalizeTarget(maybeTargetStr.getValue());
-    if (!canonTargetStr) {
-      p.field("target").report("invalid target string");
-      return {};
-    }
-
-    auto target = canonTargetStr.getValue();
-
-    // Remove the target field from the annotation and return the target.
-    object->erase("target");
-    return llvm::Optional<std::string>(target);
-  };
-
   // The JSON value must be an array of objects.  Anything else is reported as
   // invalid.
   auto array = value.getAsArray();
@@ -367,70 +446,139 @@ bool circt::firrtl::fromJSON(json::Value &value, StringRef circuitTarget,
       return false;
     }
 
-    // If the annotation has a class name which matches an annotation which the
-    // LowerAnnotations pass knows about, then defer its processing.
-    if (auto *clazz = object->get("class")) {
-      auto classString = clazz->getAsString();
-      if (classString && isAnnoClassLowered(classString.getValue())) {
-        NamedAttrList metadata;
-        for (auto field : *object) {
-          if (auto value = convertJSONToAttribute(context, field.second, p)) {
-            metadata.append(field.first, value);
-            continue;
-          }
-          return false;
-        }
-        mutableAnnotationMap[rawAnnotations].push_back(
-            DictionaryAttr::get(context, metadata));
-        continue;
-      }
-    }
-
-    // Find and remove the "target" field from the Annotation object if it
-    // exists.  In the FIRRTL Dialect, the target will be implicitly specified
-    // based on where the attribute is applied.
-    auto optTarget = findAndEraseTarget(object, p);
-    if (!optTarget)
+    ConvertedAnnotation annotation;
+    if (!convertAnnotation(*object, circuitTarget, p, context, annotation))
       return false;
-    StringRef targetStrRef = optTarget.getValue();
+    addConvertedAnnotation(annotation, circuit, nlaNumber,
+                           mutableAnnotationMap);
+  }
 
-    if (targetStrRef != "~") {
-      auto circuitFieldEnd = targetStrRef.find_first_of('|');
-      if (circuitTarget != targetStrRef.take_front(circuitFieldEnd)) {
-        p.report("annotation has invalid circuit name");
-        return false;
-      }
-    }
+  mergeAnnotationMap(mutableAnnotationMap, annotationMap, context);
+  return true;
+}
 
-    // Build up the Attribute to represent the Annotation and store it in the
-    // global Target -> Attribute mapping.
-    NamedAttrList metadata;
-    for (auto field : *object) {
-      if (auto value = convertJSONToAttribute(context, field.second, p)) {
-        metadata.append(field.first, value);
-        continue;
-      }
-      return false;
-    }
+//===----------------------------------------------------------------------===//
+// JSONArrayScanner
+//===----------------------------------------------------------------------===//
+
+static bool isJSONWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool JSONArrayScanner::isArray() const {
+  StringRef rest = text.ltrim();
+  return !rest.empty() && rest.front() == '[';
+}
+
+void JSONArrayScanner::skipWhitespace() {
+  while (pos != text.size() && isJSONWhitespace(text[pos]))
+    ++pos;
+}
 
-    auto leafTarget = addNLATargets(context, targetStrRef, circuit, nlaNumber,
-                                    metadata, mutableAnnotationMap);
+void JSONArrayScanner::fail(const Twine &message) {
+  auto [line, column] = getLineAndColumn(text.data() + pos);
+  error = ("[" + Twine(line) + ":" + Twine(column) + ", byte=" + Twine(pos) +
+           "]: " + message)
+              .str();
+}
+
+std::pair<unsigned, unsigned>
+JSONArrayScanner::getLineAndColumn(const char *ptr) const {
+  StringRef prefix = text.take_front(ptr - text.data());
+  unsigned line = prefix.count('\n') + 1;
+  size_t lineStart = prefix.rfind('\n');
+  unsigned column = lineStart == StringRef::npos ? prefix.size() + 1
+                                                 : prefix.size() - lineStart;
+  return {line, column};
+}
 
-    mutableAnnotationMap[leafTarget].push_back(
-        DictionaryAttr::get(context, metadata));
+llvm::Optional<StringRef> JSONArrayScanner::next() {
+  if (done || failed())
+    return None;
+
+  skipWhitespace();
+  if (!started) {
+    started = true;
+    if (pos == text.size() || text[pos] != '[') {
+      fail("Expected '['");
+      return None;
+    }
+    ++pos;
+    skipWhitespace();
+    if (pos != text.size() && text[pos] == ']') {
+      ++pos;
+      finish();
+      return None;
+    }
   }
 
-  // Convert the mutable Annotation map to a SmallVector<ArrayAttr>.
-  for (auto a : mutableAnnotationMap.keys()) {
-    // If multiple annotations on a single object, then append it.
-    if (annotationMap.count(a))
-      for (auto attr : annotationMap[a])
-        mutableAnnotationMap[a].push_back(attr);
+  // Find the end of the element, which is the first comma or closing bracket
+  // outside of any string or nested value.  The element itself is only
+  // checked once it is parsed.
+  size_t start = pos;
+  unsigned depth = 0;
+  while (pos != text.size()) {
+    char c = text[pos];
+    if (c == '"') {
+      if (!skipString())
+        return None;
+      continue;
+    }
+    if (c == '[' || c == '{') {
+      ++depth;
+    } else if (c == ']' || c == '}') {
+      if (depth == 0)
+        break;
+      --depth;
+    } else if (c == ',' && depth == 0) {
+      break;
+    }
+    ++pos;
+  }
+  if (pos == text.size()) {
+    fail("Unexpected EOF");
+    return None;
+  }
 
-    annotationMap[a] = ArrayAttr::get(context, mutableAnnotationMap[a]);
+  StringRef element = text.slice(start, pos).rtrim();
+  if (element.empty()) {
+    fail("Expected an element");
+    return None;
+  }
+  if (text[pos] == ',') {
+    ++pos;
+  } else if (text[pos] == ']') {
+    ++pos;
+    finish();
+    if (failed())
+      return None;
+  } else {
+    fail("Expected ',' or ']' after array element");
+    return None;
   }
+  return element;
+}
 
-  return true;
+bool JSONArrayScanner::skipString() {
+  // Skip the opening quote.
+  ++pos;
+  while (pos != text.size()) {
+    char c = text[pos++];
+    if (c == '"')
+      return true;
+    // Skip the escaped character, which may be a quote.
+    if (c == '\\' && pos != text.size())
+      ++pos;
+  }
+  fail("Unterminated string");
+  return false;
+}
+
+void JSONArrayScanner::finish() {
+  done = true;
+  skipWhitespace();
+  if (pos != text.size())
+    fail("Text after end of document");
 }
 
 /// Convert a JSON value containing OMIR JSON (an array of OMNodes), convert
@@ -14,10 +14,16 @@
 #define FIRANNOTATIONS_H
 
 #include "circt/Support/LLVM.h"
+#include "mlir/IR/OperationSupport.h"
+#include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringMap.h"
 
+#include <string>
+#include <utility>
+
 namespace llvm {
 namespace json {
+class Object;
 class Path;
 class Value;
 } // namespace json
@@ -37,6 +43,74 @@ bool fromJSON(llvm::json::Value &value, StringRef circuitTarget,
               llvm::StringMap<ArrayAttr> &annotationMap, llvm::json::Path path,
               CircuitOp circuit, size_t &nlaNumber);
 
+/// An annotation converted from its JSON object, which is yet to be added to
+/// the annotations of its target.
+struct ConvertedAnnotation {
+  /// True if the annotation is handled by the LowerAnnotations pass.
+  bool isDeferred = false;
+  /// The canonicalized target of the annotation, if it is not deferred.
+  std::string target;
+  /// The fields of the annotation, without its target.
+  NamedAttrList metadata;
+};
+
+/// Convert a JSON annotation object to attributes.  This does not touch the
+/// circuit, such that distinct annotations may be converted concurrently.
+/// Returns false and reports the problem on the path if the annotation is
+/// malformed.
+bool convertAnnotation(llvm::json::Object &object, StringRef circuitTarget,
+                       llvm::json::Path path, MLIRContext *context,
+                       ConvertedAnnotation &result);
+
+/// Add a converted annotation to the mutable Target-keyed map of annotations,
+/// creating the non-local anchors of its target in the circuit.  Annotations
+/// must be added in their order of appearance.
+void addConvertedAnnotation(
+    ConvertedAnnotation &annotation, CircuitOp circuit, size_t &nlaNumber,
+    llvm::StringMap<llvm::SmallVector<Attribute>> &mutableAnnotationMap);
+
+/// Convert the mutable Target-keyed map of annotations to arrays of
+/// attributes, appending the annotations already in `annotationMap`.
+void mergeAnnotationMap(
+    llvm::StringMap<llvm::SmallVector<Attribute>> &mutableAnnotationMap,
+    llvm::StringMap<ArrayAttr> &annotationMap, MLIRContext *context);
+
+/// Scans the JSON text of an array, yielding the text of one element at a time
+/// without building the JSON value of the whole array.  Only the nesting of
+/// brackets and strings is checked, each element has to be parsed on its own.
+class JSONArrayScanner {
+public:
+  explicit JSONArrayScanner(StringRef text) : text(text) {}
+
+  /// Return true if the text starts with an array.
+  bool isArray() const;
+
+  /// Return the text of the next element of the array, or None at the end of
+  /// the array or if the text is malformed.
+  llvm::Optional<StringRef> next();
+
+  /// Return true if the text was found to be malformed.
+  bool failed() const { return !error.empty(); }
+
+  /// Return the description of the problem with the text, if any.
+  const std::string &getError() const { return error; }
+
+  /// Return the 1-based line and column of a pointer into the text.
+  std::pair<unsigned, unsigned> getLineAndColumn(const char *ptr) const;
+
+private:
+  void skipWhitespace();
+  bool skipString();
+  void finish();
+  void fail(const Twine &message);
+
+  StringRef text;
+  size_t pos = 0;
+  bool started = false;
+  bool done = false;
+  std::string error;
+};
+
 /// Convert a JSON value containing OMIR JSON (an array of OMNodes), convert
 /// this to an OMIRAnnotation, and add it to a mutable `annotationMap` argument.
 bool fromOMIRJSON(llvm::json::Value &value, StringRef circuitTarget,
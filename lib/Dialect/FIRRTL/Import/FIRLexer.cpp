@@ -11,12 +11,18 @@
 //===----------------------------------------------------------------------===//
 
 #include "FIRLexer.h"
+#include "circt/Dialect/FIRRTL/FIRParser.h"
 #include "mlir/IR/Diagnostics.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace circt;
 using namespace firrtl;
 using llvm::SMLoc;
@@ -143,6 +149,90 @@ std::string FIRToken::getRawStringValue(StringRef spelling) {
   return result;
 }
 
+//===----------------------------------------------------------------------===//
+// Vectorized Scanning
+//===----------------------------------------------------------------------===//
+
+// Most of the time of the lexer is spent skipping over whitespace, comments,
+// identifiers, strings and file info.  These are scanned 16 bytes at a time
+// where SSE2 is available, and one byte at a time otherwise and at the end of
+// the buffer.
+
+#ifdef __SSE2__
+/// Load the 16 bytes starting at the given pointer.
+static __m128i loadChunk(const char *ptr) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+}
+
+/// Return a mask with bit N set if byte N of the chunk is one of the given
+/// characters.
+template <char... Cs>
+static unsigned matchChunk(__m128i chunk) {
+  __m128i match = _mm_setzero_si128();
+  ((match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(Cs)))),
+   ...);
+  return _mm_movemask_epi8(match);
+}
+
+/// Return a mask with bit N set if byte N of the chunk is in [lo, hi].  Bytes
+/// with the high bit set compare as negative, and never match.
+static __m128i matchChunkRange(__m128i chunk, char lo, char hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(lo - 1)),
+                       _mm_cmplt_epi8(chunk, _mm_set1_epi8(hi + 1)));
+}
+#endif
+
+/// Return the first character in [ptr, end) which is one of the given
+/// characters, or end if there is none.
+template <char... Cs>
+static const char *findFirstOf(const char *ptr, const char *end) {
+#ifdef __SSE2__
+  for (; end - ptr >= 16; ptr += 16)
+    if (unsigned mask = matchChunk<Cs...>(loadChunk(ptr)))
+      return ptr + llvm::countTrailingZeros(mask);
+#endif
+  while (ptr < end && ((*ptr != Cs) && ...))
+    ++ptr;
+  return ptr;
+}
+
+/// Return the first character in [ptr, end) which is not one of the given
+/// characters, or end if there is none.
+template <char... Cs>
+static const char *findFirstNotOf(const char *ptr, const char *end) {
+#ifdef __SSE2__
+  for (; end - ptr >= 16; ptr += 16)
+    if (unsigned mask = ~matchChunk<Cs...>(loadChunk(ptr)) & 0xFFFF)
+      return ptr + llvm::countTrailingZeros(mask);
+#endif
+  while (ptr < end && ((*ptr == Cs) || ...))
+    ++ptr;
+  return ptr;
+}
+
+/// Return the first character in [ptr, end) which cannot be part of an
+/// identifier, i.e. is not in [0-9a-zA-Z_$-], or end if there is none.
+static const char *findIdentifierEnd(const char *ptr, const char *end) {
+#ifdef __SSE2__
+  for (; end - ptr >= 16; ptr += 16) {
+    __m128i chunk = loadChunk(ptr);
+    // Setting bit 5 maps upper case letters to lower case ones, and no other
+    // character to a letter.
+    __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    __m128i alnum = _mm_or_si128(matchChunkRange(lower, 'a', 'z'),
+                                 matchChunkRange(chunk, '0', '9'));
+    unsigned mask =
+        _mm_movemask_epi8(alnum) | matchChunk<'_', '$', '-'>(chunk);
+    if (unsigned rest = ~mask & 0xFFFF)
+      return ptr + llvm::countTrailingZeros(rest);
+  }
+#endif
+  while (ptr < end && (llvm::isAlpha(*ptr) || llvm::isDigit(*ptr) ||
+                        *ptr == '_' || *ptr == '$' || *ptr == '-'))
+    ++ptr;
+  return ptr;
+}
+
 //===----------------------------------------------------------------------===//
 // FIRLexer
 //===----------------------------------------------------------------------===//
@@ -233,7 +323,9 @@ FIRToken FIRLexer::lexTokenImpl() {
     case '\n':
     case '\r':
     case ',':
-      // Handle whitespace.
+      // Handle whitespace, skipping the rest of it at once.
+      curPtr = findFirstNotOf<' ', '\t', '\n', '\r', ','>(curPtr,
+                                                         curBuffer.end());
       continue;
 
     case '_':
@@ -312,6 +404,9 @@ FIRToken FIRLexer::lexTokenImpl() {
 ///
 FIRToken FIRLexer::lexFileInfo(const char *tokStart) {
   while (1) {
+    // Skip over the characters which need no special handling.
+    curPtr = findFirstOf<']', '\\', '\n', '\v', '\f', 0>(curPtr,
+                                                         curBuffer.end());
     switch (*curPtr++) {
     case ']': // This is the end of the fileinfo literal.
       return formToken(FIRToken::fileinfo, tokStart);
@@ -345,6 +440,8 @@ FIRToken FIRLexer::lexInlineAnnotation(const char *tokStart) {
   size_t depth = 0;
   bool stringMode = false;
   while (1) {
+    // Skip over the characters which need no special handling.
+    curPtr = findFirstOf<'\\', '"', '[', ']', 0>(curPtr, curBuffer.end());
     switch (*curPtr++) {
     case '\\':
       ++curPtr;
@@ -383,9 +480,7 @@ FIRToken FIRLexer::lexInlineAnnotation(const char *tokStart) {
 ///
 FIRToken FIRLexer::lexIdentifierOrKeyword(const char *tokStart) {
   // Match the rest of the identifier regex: [0-9a-zA-Z_$-]*
-  while (llvm::isAlpha(*curPtr) || llvm::isDigit(*curPtr) || *curPtr == '_' ||
-         *curPtr == '$' || *curPtr == '-')
-    ++curPtr;
+  curPtr = findIdentifierEnd(curPtr, curBuffer.end());
 
   StringRef spelling(tokStart, curPtr - tokStart);
 
@@ -413,24 +508,10 @@ FIRToken FIRLexer::lexIdentifierOrKeyword(const char *tokStart) {
 
 /// Skip a comment line, starting with a ';' and going to end of line.
 void FIRLexer::skipComment() {
-  while (true) {
-    switch (*curPtr++) {
-    case '\n':
-    case '\r':
-      // Newline is end of comment.
-      return;
-    case 0:
-      // If this is the end of the buffer, end the comment.
-      if (curPtr - 1 == curBuffer.end()) {
-        --curPtr;
-        return;
-      }
-      LLVM_FALLTHROUGH;
-    default:
-      // Skip over other characters.
-      break;
-    }
-  }
+  curPtr = findFirstOf<'\n', '\r'>(curPtr, curBuffer.end());
+  // Newline is end of comment.  Otherwise this is the end of the buffer.
+  if (curPtr != curBuffer.end())
+    ++curPtr;
 }
 
 /// StringLit      ::= '"' UnquotedString? '"'
@@ -439,6 +520,9 @@ void FIRLexer::skipComment() {
 ///
 FIRToken FIRLexer::lexString(const char *tokStart, bool isRaw) {
   while (1) {
+    // Skip over the characters which need no special handling.
+    curPtr = findFirstOf<'"', '\'', '\\', '\n', '\r', '\v', '\f', 0>(
+        curPtr, curBuffer.end());
     switch (*curPtr++) {
     case '"': // This is the end of the string literal.
       if (isRaw)
@@ -510,3 +594,19 @@ FIRToken FIRLexer::lexNumber(const char *tokStart) {
   }
   return formToken(FIRToken::floatingpoint, tokStart);
 }
+
+//===----------------------------------------------------------------------===//
+// Driver
+//===----------------------------------------------------------------------===//
+
+Optional<size_t> circt::firrtl::lexFIRFile(const llvm::SourceMgr &sourceMgr,
+                                           MLIRContext *context) {
+  FIRLexer lexer(sourceMgr, context);
+  size_t numTokens = 0;
+  for (; !lexer.getToken().is(FIRToken::eof); lexer.lexToken()) {
+    if (lexer.getToken().is(FIRToken::error))
+      return None;
+    ++numTokens;
+  }
+  return numTokens;
+}
@@ -3265,6 +3265,19 @@ private:
   ParseResult importAnnotationsRaw(SMLoc loc, StringRef circuitTarget,
                                    StringRef annotationsStr,
                                    SmallVector<Attribute> &attrs);
+  /// Add annotations from a string to the internal annotation map like
+  /// importAnnotations, but parse and convert them one at a time rather than
+  /// parsing the whole string into a JSON value first.  The conversion of
+  /// batches of annotations to attributes is spread across threads.
+  ParseResult importAnnotationsStreaming(CircuitOp circuit, SMLoc loc,
+                                         StringRef circuitTarget,
+                                         StringRef annotationsStr,
+                                         size_t &nlaNumber);
+  /// Scatter the annotations of a Target-keyed map and merge them into the
+  /// global set we're accumulating.
+  ParseResult addAnnotations(CircuitOp circuit, SMLoc loc,
+                             llvm::StringMap<ArrayAttr> &thisAnnotationMap,
+                             size_t &nlaNumber);
   /// Generate OMIR-derived annotations.  Report errors if the OMIR is malformed
   /// in any way.  This also performs scattering of the OMIR to introduce
   /// tracking annotations in the circuit.
@@ -3356,6 +3369,105 @@ ParseResult FIRCircuitParser::importAnnotations(CircuitOp circuit, SMLoc loc,
     return failure();
   }
 
+  return addAnnotations(circuit, loc, thisAnnotationMap, nlaNumber);
+}
+
+ParseResult FIRCircuitParser::importAnnotationsStreaming(
+    CircuitOp circuit, SMLoc loc, StringRef circuitTarget,
+    StringRef annotationsStr, size_t &nlaNumber) {
+  // Anything but an array is invalid, let the regular import report it.
+  JSONArrayScanner scanner(annotationsStr);
+  if (!scanner.isArray())
+    return importAnnotations(circuit, loc, circuitTarget, annotationsStr,
+                             nlaNumber);
+
+  /// The conversion of one annotation of a batch.
+  struct Conversion {
+    StringRef text;
+    ConvertedAnnotation annotation;
+    /// The JSON syntax error of the annotation, if any.
+    std::string parseError;
+    /// The problem with the format of the annotation, if any.
+    std::string formatError;
+  };
+
+  // Annotations are converted in batches, such that only the JSON values of
+  // the annotations of one batch are alive at any time.
+  const size_t batchSize = 1024;
+  auto *context = getContext();
+  llvm::StringMap<llvm::SmallVector<Attribute>> mutableAnnotationMap;
+  SmallVector<Conversion, 0> batch;
+  size_t annotationIndex = 0;
+  do {
+    batch.clear();
+    while (batch.size() < batchSize) {
+      auto text = scanner.next();
+      if (!text)
+        break;
+      batch.emplace_back();
+      batch.back().text = *text;
+    }
+    if (scanner.failed()) {
+      auto diag = emitError(loc, "Failed to parse JSON Annotations");
+      diag.attachNote() << scanner.getError();
+      return failure();
+    }
+
+    // Parse and convert the annotations of the batch.  This does not touch
+    // the circuit, and any problem is reported in order below.
+    mlir::parallelForEach(context, batch, [&](Conversion &conversion) {
+      auto value = json::parse(conversion.text);
+      if (auto err = value.takeError()) {
+        handleAllErrors(std::move(err), [&](const json::ParseError &a) {
+          conversion.parseError = a.message();
+        });
+        return;
+      }
+
+      json::Path::Root root;
+      json::Path path(root);
+      auto *object = value->getAsObject();
+      if (!object)
+        path.report("Expected annotations to be an array of objects, but "
+                    "found an array of something else.");
+      else if (convertAnnotation(*object, circuitTarget, path, context,
+                                 conversion.annotation))
+        return;
+      conversion.formatError =
+          "See inline comments for problem area in JSON:\n";
+      llvm::raw_string_ostream s(conversion.formatError);
+      root.printErrorContext(*value, s);
+    });
+
+    // Add the annotations to their targets in order.
+    for (auto &conversion : batch) {
+      if (!conversion.parseError.empty() || !conversion.formatError.empty()) {
+        auto diag = emitError(loc, conversion.parseError.empty()
+                                       ? "Invalid/unsupported annotation format"
+                                       : "Failed to parse JSON Annotations");
+        diag.attachNote() << (conversion.parseError.empty()
+                                  ? conversion.formatError
+                                  : conversion.parseError);
+        auto [line, column] = scanner.getLineAndColumn(conversion.text.data());
+        diag.attachNote() << "in annotation " << annotationIndex << " at line "
+                          << line << ", column " << column;
+        return failure();
+      }
+      addConvertedAnnotation(conversion.annotation, circuit, nlaNumber,
+                             mutableAnnotationMap);
+      ++annotationIndex;
+    }
+  } while (batch.size() == batchSize);
+
+  llvm::StringMap<ArrayAttr> thisAnnotationMap;
+  mergeAnnotationMap(mutableAnnotationMap, thisAnnotationMap, context);
+  return addAnnotations(circuit, loc, thisAnnotationMap, nlaNumber);
+}
+
+ParseResult
+FIRCircuitParser::addAnnotations(CircuitOp circuit, SMLoc loc,
+                                 llvm::StringMap<ArrayAttr> &thisAnnotationMap,
+                                 size_t &nlaNumber) {
   if (!scatterCustomAnnotations(thisAnnotationMap, circuit, annotationID,
                                 translateLocation(loc), nlaNumber))
     return failure();
@@ -3767,10 +3879,16 @@ ParseResult FIRCircuitParser::parseCircuit(
       return failure();
 
   // Deal with the annotation file if one was specified
-  for (auto *annotationsBuf : annotationsBufs)
-    if (importAnnotations(circuit, info.getFIRLoc(), circuitTarget,
-                          annotationsBuf->getBuffer(), nlaNumber))
+  for (auto *annotationsBuf : annotationsBufs) {
+    auto annotationsStr = annotationsBuf->getBuffer();
+    if (getConstants().options.streamAnnotationFiles
+            ? importAnnotationsStreaming(circuit, info.getFIRLoc(),
+                                         circuitTarget, annotationsStr,
+                                         nlaNumber)
+            : importAnnotations(circuit, info.getFIRLoc(), circuitTarget,
+                                annotationsStr, nlaNumber))
       return failure();
+  }
 
   // Process OMIR files as annotations with a class of
   // "freechips.rocketchip.objectmodel.OMNode"
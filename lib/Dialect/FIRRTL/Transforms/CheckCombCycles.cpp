@@ -11,14 +11,15 @@
 //===----------------------------------------------------------------------===//
 
 #include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/FIRRTLCombPaths.h"
 #include "circt/Dialect/FIRRTL/FIRRTLInstanceGraph.h"
 #include "circt/Dialect/FIRRTL/FIRRTLUtils.h"
 #include "circt/Dialect/FIRRTL/FIRRTLVisitors.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
-#include "llvm/ADT/DepthFirstIterator.h"
-#include "llvm/ADT/PostOrderIterator.h"
+#include "mlir/IR/Threading.h"
 #include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/SmallSet.h"
+#include <atomic>
 #include <variant>
 
 using namespace circt;
@@ -28,24 +29,21 @@ using namespace firrtl;
 // Node class
 //===----------------------------------------------------------------------===//
 
-using CombPathsType = SmallVector<SmallVector<size_t, 2>>;
-using CombPathsMap = DenseMap<Operation *, CombPathsType>;
-
 using ConnectIterator =
     mlir::detail::op_iterator<FConnectLike, Region::OpIterator>;
 using ConnectRange = llvm::iterator_range<ConnectIterator>;
 
 namespace {
-/// The graph context containing pointers of the combinational paths map and the
-/// instance graph.
+/// The graph context containing pointers of the combinational paths analysis
+/// and the instance graph.
 struct NodeContext {
-  CombPathsMap *map;
+  const CombPathsAnalysis *combPaths;
   InstanceGraph *graph;
   ConnectRange connects;
 
-  explicit NodeContext(CombPathsMap *map, InstanceGraph *graph,
+  explicit NodeContext(const CombPathsAnalysis *combPaths, InstanceGraph *graph,
                        ConnectRange connects)
-      : map(map), graph(graph), connects(connects) {}
+      : combPaths(combPaths), graph(graph), connects(connects) {}
 };
 } // namespace
 
@@ -143,9 +141,9 @@ public:
   bool operator!=(const NodeIterator &rhs) const { return !(*this == rhs); }
 
   Value getValue() { return node.value; }
-  CombPathsMap *getCombPathsMap() {
+  const CombPathsAnalysis *getCombPaths() {
     assert(node.context && "invalid node context");
-    return node.context->map;
+    return node.context->combPaths;
   }
   InstanceGraph *getInstanceGraph() {
     assert(node.context && "invalid node context");
@@ -190,11 +188,12 @@ public:
 
     // Query the combinational paths between IOs of the current instance.
     auto module = getInstanceGraph()->getReferencedModule(instance);
-    auto &combPaths = getCombPathsMap()->FindAndConstruct(module).second;
-    auto &ports = combPaths[getValue().cast<OpResult>().getResultNumber()];
+    auto &combPaths = getCombPaths()->getCombPaths(module.getOperation());
+    auto resultNo = getValue().cast<OpResult>().getResultNumber();
+    auto &ports = combPaths.paths[resultNo];
 
-    portEnd = ports.end();
-    portIt = ports.begin();
+    portEnd = ports.set_bits_end();
+    portIt = ports.set_bits_begin();
     skipToNextValidPort();
   }
 
@@ -212,8 +211,8 @@ public:
 
 private:
   InstanceOp instance;
-  SmallVectorImpl<size_t>::iterator portEnd;
-  SmallVectorImpl<size_t>::iterator portIt;
+  llvm::BitVector::const_set_bits_iterator portEnd;
+  llvm::BitVector::const_set_bits_iterator portIt;
 };
 } // namespace
 
@@ -232,12 +231,10 @@ public:
     if (end)
       return;
 
+    // Subfields of anything but memories are diagnosed by the pass.
     auto memory = subfield.input().getDefiningOp<MemOp>();
-    if (!memory) {
-      subfield->emitOpError("input must be a port of a MemOp, please run "
-                            "-firrtl-lower-types first");
+    if (!memory)
       return;
-    }
 
     if (memory.readLatency() != 0)
       return;
@@ -256,11 +253,8 @@ public:
     // subfield. Find the corresponding subfield op.
     for (auto user : subfield.input().getUsers()) {
       auto currentSubfield = dyn_cast<SubfieldOp>(user);
-      if (!currentSubfield) {
-        user->emitOpError("MemOp must be used by SubfieldOp, please run "
-                          "-firrtl-lower-types first");
+      if (!currentSubfield)
         return;
-      }
 
       auto index = currentSubfield.fieldIndex();
       if ((portKind == MemOp::PortKind::Read &&
@@ -434,20 +428,6 @@ struct DenseMapInfo<Node> {
 };
 } // namespace llvm
 
-namespace {
-struct NodeDenseSet : public DenseSet<Node> {
-  using BaseSet = DenseSet<Node>;
-  using iterator = typename BaseSet::iterator;
-
-  std::pair<iterator, bool> insert(Node N) { return BaseSet::insert(N); }
-  template <typename IterT>
-  void insert(IterT Begin, IterT End) {
-    BaseSet::insert(Begin, End);
-  }
-
-  void completed(Node) {}
-};
-} // namespace
 
 //===----------------------------------------------------------------------===//
 // GraphTraits on Node
@@ -646,91 +626,91 @@ void dumpSimpleCycle(SCCIterator &scc, FModuleOp module,
   dumpPath(cycle, instancePath, module, /*isCycle=*/true, diag);
 }
 
-/// This pass constructs a local graph for each module to detect combinational
-/// cycles. To capture the cross-module combinational cycles, this pass inlines
-/// the combinational paths between IOs of its subinstances into a subgraph and
-/// encodes them in a `combPathsMap`.
+/// Check that the memories of a module have been lowered, such that their
+/// ports are only used by subfields, and that there are no other subfields.
+/// Every offending operation is reported once.
+static LogicalResult checkLowered(FModuleOp module) {
+  bool lowered = true;
+  module.walk([&](Operation *op) {
+    if (auto subfield = dyn_cast<SubfieldOp>(op)) {
+      if (!subfield.input().getDefiningOp<MemOp>()) {
+        subfield->emitOpError("input must be a port of a MemOp, please run "
+                              "-firrtl-lower-types first");
+        lowered = false;
+      }
+      return;
+    }
+    if (auto memory = dyn_cast<MemOp>(op)) {
+      for (auto *user : memory->getUsers()) {
+        if (!isa<SubfieldOp>(user)) {
+          user->emitOpError("MemOp must be used by SubfieldOp, please run "
+                            "-firrtl-lower-types first");
+          lowered = false;
+        }
+      }
+    }
+  });
+  return success(lowered);
+}
+
+/// This pass detects combinational cycles with the summaries of the
+/// `CombPathsAnalysis`, which are computed for every module in parallel, from
+/// the bottom of the instance graph up. Only the modules which contain a cycle
+/// are traversed again, with a local graph which inlines the combinational
+/// paths between IOs of its subinstances, to report the cycles.
 class CheckCombCyclesPass : public CheckCombCyclesBase<CheckCombCyclesPass> {
   void runOnOperation() override {
+    auto circuit = getOperation();
     auto &instanceGraph = getAnalysis<InstanceGraph>();
-    bool detectedCycle = false;
 
-    // Traverse modules in a post order to make sure the combinational paths
-    // between IOs of a module have been detected and recorded in `combPathsMap`
-    // before we handle its parent modules.
-    for (auto node : llvm::post_order<InstanceGraph *>(&instanceGraph)) {
-      if (auto module = dyn_cast<FModuleOp>(*node->getModule())) {
-        NodeContext context(&map, &instanceGraph,
-                            module.getOps<FConnectLike>());
-        auto dummyNode = Node(nullptr, &context);
-
-        // Traversing SCCs in the combinational graph to detect cycles. As
-        // FIRRTL module is an SSA region, all cycles must contain at least one
-        // connect op. Thus we introduce a dummy source node to iterate on the
-        // `dest`s of all connect ops in the module.
-        for (auto combSCC = SCCIterator::begin(dummyNode); !combSCC.isAtEnd();
-             ++combSCC) {
-          if (combSCC.hasCycle()) {
-            detectedCycle = true;
-            auto errorDiag = mlir::emitError(
-                module.getLoc(),
-                "detected combinational cycle in a FIRRTL module");
-            if (printSimpleCycle)
-              dumpSimpleCycle(combSCC, module, errorDiag);
-            else {
-              for (auto node : *combSCC) {
-                auto &noteDiag = errorDiag.attachNote(node.value.getLoc());
-                noteDiag << "this operation is part of the combinational cycle";
-              }
-            }
-          }
-        }
+    // The combinational paths of the modules cannot be computed before their
+    // memories are lowered.  Every module is checked, such that all the
+    // offending operations are reported.
+    SmallVector<FModuleOp> modules(circuit.getBody()->getOps<FModuleOp>());
+    std::atomic<bool> lowered(true);
+    mlir::parallelForEach(&getContext(), modules, [&](FModuleOp module) {
+      if (failed(checkLowered(module)))
+        lowered = false;
+    });
+    if (!lowered) {
+      signalPassFailure();
+      return;
+    }
 
-        SmallVector<bool, 8> directionVec;
-        for (auto &port : module.getPorts())
-          directionVec.push_back(port.isOutput());
-
-        auto &combPaths = map[module];
-        NodeDenseSet nodeSet;
-        SmallVector<size_t, 2> outputVec;
-        unsigned index = 0;
-
-        // Record all combinational paths.
-        for (auto &port : module.getPorts()) {
-          nodeSet.clear();
-          outputVec.clear();
-          auto arg = module.getArgument(index++);
-          if (port.isOutput()) {
-            combPaths.push_back(outputVec);
-            continue;
-          }
-          Node inputNode(arg, &context);
-          for (auto node : llvm::depth_first_ext<Node>(inputNode, nodeSet)) {
-            if (auto output = node.value.dyn_cast<BlockArgument>())
-              if (directionVec[output.getArgNumber()])
-                outputVec.push_back(output.getArgNumber());
+    auto &combPaths = getAnalysis<CombPathsAnalysis>();
+    bool detectedCycle = false;
+    for (auto module : combPaths.getModulesWithCycles()) {
+      NodeContext context(&combPaths, &instanceGraph,
+                          module.getOps<FConnectLike>());
+      auto dummyNode = Node(nullptr, &context);
+
+      // Traversing SCCs in the combinational graph to detect cycles. As
+      // FIRRTL module is an SSA region, all cycles must contain at least one
+      // connect op. Thus we introduce a dummy source node to iterate on the
+      // `dest`s of all connect ops in the module.
+      for (auto combSCC = SCCIterator::begin(dummyNode); !combSCC.isAtEnd();
+           ++combSCC) {
+        if (combSCC.hasCycle()) {
+          detectedCycle = true;
+          auto errorDiag = mlir::emitError(
+              module.getLoc(),
+              "detected combinational cycle in a FIRRTL module");
+          if (printSimpleCycle)
+            dumpSimpleCycle(combSCC, module, errorDiag);
+          else {
+            for (auto node : *combSCC) {
+              auto &noteDiag = errorDiag.attachNote(node.value.getLoc());
+              noteDiag << "this operation is part of the combinational cycle";
+            }
           }
-          combPaths.push_back(outputVec);
         }
-        continue;
       }
-      if (auto extModule = dyn_cast<FExtModuleOp>(*node->getModule())) {
-        // TODO: Handle FExtModuleOp with `ExtModulePathAnnotation`s.
-        auto &combPaths = map[extModule];
-        combPaths.resize(extModule.getNumPorts());
-        continue;
-      }
-      llvm_unreachable("invalid instance graph node");
     }
 
     if (detectedCycle)
       signalPassFailure();
     markAllAnalysesPreserved();
   }
-
-private:
-  /// A global map from FIRRTL modules to their combinational paths between IOs.
-  CombPathsMap map;
 };
 } // namespace
 
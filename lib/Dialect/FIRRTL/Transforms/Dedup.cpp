@@ -14,6 +14,7 @@
 #include "circt/Dialect/FIRRTL/FIRRTLAttributes.h"
 #include "circt/Dialect/FIRRTL/FIRRTLInstanceGraph.h"
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/FIRRTL/FIRRTLStructuralHash.h"
 #include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
 #include "circt/Dialect/FIRRTL/FIRRTLUtils.h"
 #include "circt/Dialect/FIRRTL/NLATable.h"
@@ -23,6 +24,7 @@
 #include "circt/Support/LLVM.h"
 #include "mlir/IR/BlockAndValueMapping.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Support/LogicalResult.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseMapInfo.h"
@@ -32,6 +34,9 @@
 #include "llvm/Support/Format.h"
 #include "llvm/Support/SHA256.h"
 
+#include <chrono>
+#include <mutex>
+
 using namespace circt;
 using namespace firrtl;
 using hw::InnerRefAttr;
@@ -56,140 +61,6 @@ llvm::raw_ostream &printHash(llvm::raw_ostream &stream, std::string data) {
   return printHex(stream, bytes);
 }
 
-struct StructuralHasher {
-  explicit StructuralHasher(MLIRContext *context) {
-    portTypesAttr = StringAttr::get(context, "portTypes");
-    nonessentialAttributes.insert(StringAttr::get(context, "annotations"));
-    nonessentialAttributes.insert(StringAttr::get(context, "name"));
-    nonessentialAttributes.insert(StringAttr::get(context, "portAnnotations"));
-    nonessentialAttributes.insert(StringAttr::get(context, "portNames"));
-    nonessentialAttributes.insert(StringAttr::get(context, "portSyms"));
-    nonessentialAttributes.insert(StringAttr::get(context, "sym_name"));
-    nonessentialAttributes.insert(StringAttr::get(context, "inner_sym"));
-  };
-
-  std::array<uint8_t, 32> hash(FModuleLike module) {
-    update(&(*module));
-    auto hash = sha.final();
-    reset();
-    return hash;
-  }
-
-private:
-  void reset() {
-    currentIndex = 0;
-    indexes.clear();
-    sha.init();
-  }
-
-  void update(const void *pointer) {
-    auto *addr = reinterpret_cast<const uint8_t *>(&pointer);
-    sha.update(ArrayRef(addr, sizeof pointer));
-  }
-
-  void update(size_t value) {
-    auto *addr = reinterpret_cast<const uint8_t *>(&value);
-    sha.update(ArrayRef(addr, sizeof value));
-  }
-
-  void update(TypeID typeID) { update(typeID.getAsOpaquePointer()); }
-
-  // NOLINTNEXTLINE(misc-no-recursion)
-  void update(BundleType type) {
-    update(type.getTypeID());
-    for (auto &element : type.getElements()) {
-      update(element.isFlip);
-      update(element.type);
-    }
-  }
-
-  // NOLINTNEXTLINE(misc-no-recursion)
-  void update(Type type) {
-    if (auto bundle = type.dyn_cast<BundleType>())
-      return update(bundle);
-    update(type.getAsOpaquePointer());
-  }
-
-  void update(BlockArgument arg) { indexes[arg] = currentIndex++; }
-
-  void update(OpResult result) {
-    indexes[result] = currentIndex++;
-    update(result.getType());
-  }
-
-  void update(OpOperand &operand) {
-    // We hash the value's index as it apears in the block.
-    auto it = indexes.find(operand.get());
-    assert(it != indexes.end() && "op should have been previously hashed");
-    update(it->second);
-  }
-
-  void update(DictionaryAttr dict) {
-    for (auto namedAttr : dict) {
-      auto name = namedAttr.getName();
-      auto value = namedAttr.getValue();
-      // Skip names and annotations.
-      if (nonessentialAttributes.contains(name))
-        continue;
-      // Hash the port types.
-      if (name == portTypesAttr) {
-        auto portTypes = value.cast<ArrayAttr>().getAsValueRange<TypeAttr>();
-        for (auto type : portTypes)
-          update(type);
-        continue;
-      }
-      // Hash the interned pointer.
-      update(name.getAsOpaquePointer());
-      update(value.getAsOpaquePointer());
-    }
-  }
-
-  void update(Block &block) {
-    // Hash the block arguments.
-    for (auto arg : block.getArguments())
-      update(arg);
-    // Hash the operations in the block.
-    for (auto &op : block)
-      update(&op);
-  }
-
-  void update(mlir::OperationName name) {
-    // Operation names are interned.
-    update(name.getAsOpaquePointer());
-  }
-
-  // NOLINTNEXTLINE(misc-no-recursion)
-  void update(Operation *op) {
-    update(op->getName());
-    update(op->getAttrDictionary());
-    // Hash the operands.
-    for (auto &operand : op->getOpOperands())
-      update(operand);
-    // Hash the regions. We need to make sure an empty region doesn't hash the
-    // same as no region, so we include the number of regions.
-    update(op->getNumRegions());
-    for (auto &region : op->getRegions())
-      for (auto &block : region.getBlocks())
-        update(block);
-    // Record any op results.
-    for (auto result : op->getResults())
-      update(result);
-  }
-
-  // Every value is assigned a unique id based on their order of appearance.
-  unsigned currentIndex = 0;
-  DenseMap<Value, unsigned> indexes;
-
-  // This is a set of every attribute we should ignore.
-  DenseSet<Attribute> nonessentialAttributes;
-  // This is a cached "portTypes" string attr.
-  StringAttr portTypesAttr;
-
-  // This is the actual running hash calculation. This is a stateful element
-  // that should be reinitialized after each hash is produced.
-  llvm::SHA256 sha;
-};
-
 //===----------------------------------------------------------------------===//
 // Equivalence
 //===----------------------------------------------------------------------===//
@@ -1142,7 +1013,6 @@ class DedupPass : public DedupBase<DedupPass> {
     auto *nlaTable = &getAnalysis<NLATable>();
     SymbolTable symbolTable(circuit);
     Deduper deduper(instanceGraph, symbolTable, nlaTable, circuit);
-    StructuralHasher hasher(&getContext());
     Equivalence equiv(context, instanceGraph);
     auto anythingChanged = false;
 
@@ -1150,51 +1020,125 @@ class DedupPass : public DedupBase<DedupPass> {
     auto noDedupClass =
         StringAttr::get(context, "firrtl.transforms.NoDedupAnnotation");
 
-    // A map of all the module hashes that we have calculated so far.
-    llvm::DenseMap<std::array<uint8_t, 32>, Operation *, SHA256HashDenseMapInfo>
-        moduleHashes;
-
     // We track the name of the module that each module is deduped into, so that
     // we can make sure all modules which are marked "must dedup" with each
     // other were all deduped to the same module.
     DenseMap<Attribute, StringAttr> dedupMap;
 
-    // We must iterate the modules from the bottom up so that we can properly
-    // deduplicate the modules. We have to store the visit order first so that
-    // we can safely delete nodes as we go from the instance graph.
+    // We must deduplicate the modules from the bottom up, such that the
+    // instances in a module refer to the deduplicated children by the time the
+    // module is hashed. The modules are grouped by their height in the instance
+    // graph, i.e. the length of the longest chain of instances below them.
+    // Equivalent modules have equivalent children, and so the same height,
+    // and a module only instantiates modules of a lower height. The modules of
+    // a level are hashed in parallel, and then deduplicated in the post order
+    // of the instance graph. We have to store the levels first so that we can
+    // safely delete nodes as we go from the instance graph.
+    DenseMap<InstanceGraphNode *, unsigned> heights;
+    SmallVector<SmallVector<FModuleLike>> levels;
     for (auto *node : llvm::post_order(&instanceGraph)) {
-      auto module = cast<FModuleLike>(*node->getModule());
-      auto moduleName = module.moduleNameAttr();
-      // If the module is marked with NoDedup, just skip it.
-      if (AnnotationSet(module).hasAnnotation(noDedupClass)) {
-        // We record it in the dedup map to help detect errors when the user
-        // marks the module as both NoDedup and MustDedup. We do not record this
-        // module in the hasher to make sure no other module dedups "into" this
-        // one.
-        dedupMap[moduleName] = moduleName;
-        continue;
+      unsigned height = 0;
+      for (auto *record : *node)
+        height = std::max(height, heights.lookup(record->getTarget()) + 1);
+      heights[node] = height;
+      if (levels.size() <= height)
+        levels.resize(height + 1);
+      levels[height].push_back(cast<FModuleLike>(*node->getModule()));
+    }
+
+    // The hashers are stateful, so every thread takes one from this pool.
+    std::mutex hashersMutex;
+    SmallVector<std::unique_ptr<StructuralHasher>> hashers;
+    auto hashModule = [&](FModuleLike module) {
+      std::unique_ptr<StructuralHasher> hasher;
+      {
+        std::lock_guard<std::mutex> lock(hashersMutex);
+        if (!hashers.empty())
+          hasher = hashers.pop_back_val();
       }
-      // Calculate the hash of the module.
-      auto h = hasher.hash(module);
-      // Check if there a module with the same hash.
-      auto it = moduleHashes.find(h);
-      if (it != moduleHashes.end()) {
-        auto original = cast<FModuleLike>(it->second);
-        // Record the group ID of the other module.
-        dedupMap[moduleName] = original.moduleNameAttr();
-        deduper.dedup(original, module);
-        erasedModules++;
-        anythingChanged = true;
-        continue;
+      if (!hasher)
+        hasher = std::make_unique<StructuralHasher>(context);
+      auto hash = hasher->hash(module);
+      std::lock_guard<std::mutex> lock(hashersMutex);
+      hashers.push_back(std::move(hasher));
+      return hash;
+    };
+
+    unsigned numHashed = 0;
+    std::chrono::steady_clock::duration hashDuration{};
+    for (auto &level : levels) {
+      // Modules can only be deduplicated if they are the same kind of module
+      // and have the same number of ports, both of which are part of the hash.
+      // Modules are bucketed by this signature first, such that a module which
+      // is alone in its bucket is not hashed at all.
+      using Signature = std::pair<const void *, size_t>;
+      auto getSignature = [](FModuleLike module) -> Signature {
+        return {module->getName().getAsOpaquePointer(), module.getNumPorts()};
+      };
+      DenseMap<Signature, unsigned> bucketSizes;
+      SmallVector<FModuleLike> candidates;
+      for (auto module : level) {
+        // If the module is marked with NoDedup, just skip it.
+        if (AnnotationSet(module).hasAnnotation(noDedupClass)) {
+          // We record it in the dedup map to help detect errors when the user
+          // marks the module as both NoDedup and MustDedup. We do not record
+          // this module in the hasher to make sure no other module dedups
+          // "into" this one.
+          dedupMap[module.moduleNameAttr()] = module.moduleNameAttr();
+          continue;
+        }
+        candidates.push_back(module);
+        ++bucketSizes[getSignature(module)];
+      }
+
+      // Calculate the hashes of the modules which share their bucket.
+      SmallVector<unsigned> toHash;
+      for (auto index : llvm::seq<unsigned>(0, candidates.size()))
+        if (bucketSizes[getSignature(candidates[index])] > 1)
+          toHash.push_back(index);
+      std::vector<std::array<uint8_t, 32>> hashes(candidates.size());
+      auto hashStart = std::chrono::steady_clock::now();
+      mlir::parallelForEach(context, toHash, [&](unsigned index) {
+        hashes[index] = hashModule(candidates[index]);
+      });
+      hashDuration += std::chrono::steady_clock::now() - hashStart;
+      numHashed += toHash.size();
+
+      // A map of all the module hashes of this level that we have seen so far.
+      llvm::DenseMap<std::array<uint8_t, 32>, Operation *,
+                     SHA256HashDenseMapInfo>
+          moduleHashes;
+      for (auto index : llvm::seq<unsigned>(0, candidates.size())) {
+        auto module = candidates[index];
+        auto moduleName = module.moduleNameAttr();
+        // Check if there a module with the same hash.
+        if (bucketSizes[getSignature(module)] > 1) {
+          auto &h = hashes[index];
+          auto it = moduleHashes.find(h);
+          if (it != moduleHashes.end()) {
+            auto original = cast<FModuleLike>(it->second);
+            // Record the group ID of the other module.
+            dedupMap[moduleName] = original.moduleNameAttr();
+            deduper.dedup(original, module);
+            erasedModules++;
+            anythingChanged = true;
+            continue;
+          }
+          // Record the module's hash.
+          moduleHashes[h] = module;
+        }
+        // Any module not deduplicated must be recorded.
+        deduper.record(module);
+        // Add the module to a new dedup group.
+        dedupMap[moduleName] = moduleName;
       }
-      // Any module not deduplicated must be recorded.
-      deduper.record(module);
-      // Add the module to a new dedup group.
-      dedupMap[moduleName] = moduleName;
-      // Record the module's hash.
-      moduleHashes[h] = module;
     }
 
+    numModulesHashed = numHashed;
+    hashTime =
+        std::chrono::duration_cast<std::chrono::microseconds>(hashDuration)
+            .count();
+
     // This part verifies that all modules marked by "MustDedup" have been
     // properly deduped with each other. For this check to succeed, all modules
     // have to been deduped to the same module. It is possible that a module was
@@ -30,55 +30,126 @@ static void mergeBlock(Block &destination, Block::iterator insertPoint,
   destination.getOperations().splice(insertPoint, source.getOperations());
 }
 
-/// This is a stack of hashtables, if lookup fails in the top-most hashtable,
-/// it will attempt to lookup in lower hashtables.  This class is used instead
-/// of a ScopedHashTable so we can manually pop off a scope and keep it around.
+/// This is a table of key-value pairs organized in nested scopes, where a
+/// lookup finds the value of the innermost scope defining the key.  It is
+/// implemented as a single flat hashtable holding the visible values, and an
+/// undo log recording the keys each scope inserted and the values they shadow.
+/// Lookups take constant time regardless of the nesting depth, and popping a
+/// scope only touches the keys it inserted.  A popped scope is returned so
+/// that it can be kept around, in the order its keys were inserted.
 ///
-/// This only allows inserting into the outermost scope.
+/// This only allows inserting into the innermost scope.
 template <typename KeyT, typename ValueT>
-struct HashTableStack {
+class ScopedTable {
+public:
   using ScopeT = typename llvm::MapVector<KeyT, ValueT>;
-  using StackT = typename llvm::SmallVector<ScopeT, 3>;
 
-  HashTableStack() {
+  ScopedTable() {
     // We require at least one scope.
-    pushScope();
+    scopeBegins.push_back(0);
   }
 
-  // TODO: This class will need its own iterator eventually.
-  using iterator = typename ScopeT::iterator;
+  /// Return the value of the key in the innermost scope defining it, or null if
+  /// there is none.  The pointer is invalidated by the next insertion.
+  ValueT *find(const KeyT &key) {
+    ++numLookups;
+    auto it = table.find(key);
+    return it == table.end() ? nullptr : &it->second.value;
+  }
 
-  iterator end() { return iterator(); }
+  /// Return the value of the key in the innermost scope defining it, or a
+  /// default constructed value if there is none.
+  ValueT lookup(const KeyT &key) {
+    ++numLookups;
+    auto it = table.find(key);
+    return it == table.end() ? ValueT() : it->second.value;
+  }
 
-  iterator find(const KeyT &key) {
-    // Try to find a hashtable with the missing value.
-    for (auto &map : llvm::reverse(mapStack)) {
-      auto it = map.find(key);
-      if (it != map.end())
-        return it;
+  /// Insert a key in the innermost scope, shadowing its value in the outer
+  /// scopes.  If the innermost scope already defines the key, its value is not
+  /// changed.  Returns the value in the innermost scope, and whether the key
+  /// was inserted.
+  std::pair<ValueT *, bool> insert(const KeyT &key, const ValueT &value) {
+    ++numLookups;
+    unsigned depth = getDepth();
+    auto [it, inserted] = table.insert({key, {value, depth}});
+    if (inserted) {
+      log.push_back({key, ValueT(), 0, false});
+      return {&it->second.value, true};
     }
-    return iterator();
+    if (it->second.depth == depth)
+      return {&it->second.value, false};
+    log.push_back({key, it->second.value, it->second.depth, true});
+    it->second = {value, depth};
+    return {&it->second.value, true};
   }
 
-  ScopeT &getLastScope() { return mapStack.back(); }
+  /// This lets you insert into the innermost scope.
+  ValueT &operator[](const KeyT &key) { return *insert(key, ValueT()).first; }
 
-  void pushScope() { mapStack.emplace_back(); }
+  /// Return the keys of the innermost scope, in the order they were inserted.
+  auto getScopeKeys() {
+    return llvm::map_range(
+        llvm::makeArrayRef(log).drop_front(scopeBegins.back()),
+        [](const LogEntry &entry) { return entry.key; });
+  }
+
+  void pushScope() {
+    scopeBegins.push_back(log.size());
+    ++numScopes;
+    totalScopeDepth += getDepth();
+  }
 
   ScopeT popScope() {
-    assert(mapStack.size() > 1 && "Cannot pop the last scope");
-    return mapStack.pop_back_val();
+    assert(scopeBegins.size() > 1 && "Cannot pop the last scope");
+    auto begin = scopeBegins.pop_back_val();
+    auto entries = llvm::makeArrayRef(log).drop_front(begin);
+    ScopeT scope;
+    for (auto &entry : entries)
+      scope.insert({entry.key, table.find(entry.key)->second.value});
+    // Restore the values shadowed by the scope.
+    for (auto &entry : llvm::reverse(entries)) {
+      if (entry.shadowed)
+        table[entry.key] = {entry.value, entry.depth};
+      else
+        table.erase(entry.key);
+    }
+    log.resize(begin);
+    return scope;
   }
 
-  // This class lets you insert into the top scope.
-  ValueT &operator[](const KeyT &key) { return mapStack.back()[key]; }
+  /// The number of lookups and insertions.
+  size_t numLookups = 0;
+  /// The number of scopes pushed, and the sum of their nesting depths.
+  size_t numScopes = 0;
+  size_t totalScopeDepth = 0;
 
 private:
-  StackT mapStack;
+  unsigned getDepth() const { return scopeBegins.size() - 1; }
+
+  /// A value visible in the table, and the depth of the scope defining it.
+  struct TableEntry {
+    ValueT value;
+    unsigned depth;
+  };
+
+  /// A key inserted by a scope, along with the value it shadows, if any.
+  struct LogEntry {
+    KeyT key;
+    ValueT value;
+    unsigned depth;
+    bool shadowed;
+  };
+
+  DenseMap<KeyT, TableEntry> table;
+  SmallVector<LogEntry> log;
+  /// The index of the first log entry of every scope.
+  SmallVector<size_t, 8> scopeBegins;
 };
 
 /// This is a determistic mapping of a FieldRef to the last operation which set
 /// a value to it.
-using ScopedDriverMap = HashTableStack<FieldRef, Operation *>;
+using ScopedDriverMap = ScopedTable<FieldRef, Operation *>;
 using DriverMap = ScopedDriverMap::ScopeT;
 
 //===----------------------------------------------------------------------===//
@@ -108,17 +179,16 @@ public:
   /// true if an old connect was erased.
   bool setLastConnect(FieldRef dest, Operation *connection) {
     // Try to insert, if it doesn't insert, replace the previous value.
-    auto itAndInserted = driverMap.getLastScope().insert({dest, connection});
-    if (!std::get<1>(itAndInserted)) {
-      auto iterator = std::get<0>(itAndInserted);
+    auto [value, inserted] = driverMap.insert(dest, connection);
+    if (!inserted) {
       auto changed = false;
       // Delete the old connection if it exists. Null connections are inserted
       // on declarations.
-      if (auto *oldConnect = iterator->second) {
+      if (auto *oldConnect = *value) {
         oldConnect->erase();
         changed = true;
       }
-      iterator->second = connection;
+      *value = connection;
       return changed;
     }
     return false;
@@ -301,13 +371,14 @@ public:
       auto dest = std::get<0>(destAndConnect);
       auto thenConnect = std::get<1>(destAndConnect);
 
-      auto outerIt = driverMap.find(dest);
-      if (outerIt == driverMap.end()) {
+      auto *outerEntry = driverMap.find(dest);
+      if (!outerEntry) {
         // `dest` is set in `then` only. This indicates it was created in the
         // `then` block, so just copy it into the outer scope.
         driverMap[dest] = thenConnect;
         continue;
       }
+      auto *outerConnect = *outerEntry;
 
       auto elseIt = elseScope.find(dest);
       if (elseIt != elseScope.end()) {
@@ -331,7 +402,6 @@ public:
         continue;
       }
 
-      auto &outerConnect = std::get<1>(*outerIt);
       if (!outerConnect) {
         // `dest` is null in the outer scope. This indicate an initialization
         // problem: `mux(p, then, nullptr)`. Just delete the broken connect.
@@ -356,15 +426,15 @@ public:
       auto dest = std::get<0>(destAndConnect);
       auto elseConnect = std::get<1>(destAndConnect);
 
-      auto outerIt = driverMap.find(dest);
-      if (outerIt == driverMap.end()) {
+      auto *outerEntry = driverMap.find(dest);
+      if (!outerEntry) {
         // `dest` is set in `else` only. This indicates it was created in the
         // `else` block, so just copy it into the outer scope.
         driverMap[dest] = elseConnect;
         continue;
       }
 
-      auto &outerConnect = std::get<1>(*outerIt);
+      auto *outerConnect = *outerEntry;
       if (!outerConnect) {
         // `dest` is null in the outer scope. This indicate an initialization
         // problem: `mux(p, null, else)`. Just delete the broken connect.
@@ -536,6 +606,9 @@ public:
   bool run(FModuleOp op);
   LogicalResult checkInitialization();
 
+  /// Return the table of drivers, which holds statistics about its use.
+  const ScopedDriverMap &getDriverMap() const { return driverMap; }
+
 private:
   /// The outermost scope of the module body.
   ScopedDriverMap driverMap;
@@ -581,14 +654,13 @@ void ModuleVisitor::visitStmt(WhenOp whenOp) {
 /// Perform initialization checking.  This uses the built up state from
 /// running on a module. Returns failure in the event of bad initialization.
 LogicalResult ModuleVisitor::checkInitialization() {
-  for (auto destAndConnect : driverMap.getLastScope()) {
+  for (auto dest : driverMap.getScopeKeys()) {
     // If there is valid connection to this destination, everything is good.
-    auto *connect = std::get<1>(destAndConnect);
+    auto *connect = driverMap.lookup(dest);
     if (connect)
       continue;
 
     // Get the op which defines the sink, and emit an error.
-    FieldRef dest = std::get<0>(destAndConnect);
     auto *definingOp = dest.getDefiningOp();
     if (auto mod = dyn_cast<FModuleLike>(definingOp))
       mlir::emitError(definingOp->getLoc())
@@ -617,7 +689,17 @@ void ExpandWhensPass::runOnOperation() {
   ModuleVisitor visitor;
   if (!visitor.run(getOperation()))
     markAllAnalysesPreserved();
-  if (failed(visitor.checkInitialization()))
+
+  // Check the initialization before recording the statistics, so that its
+  // lookups are counted even if it fails.
+  auto result = visitor.checkInitialization();
+
+  auto &driverMap = visitor.getDriverMap();
+  numScopes += driverMap.numScopes;
+  totalScopeDepth += driverMap.totalScopeDepth;
+  numLookups += driverMap.numLookups;
+
+  if (failed(result))
     signalPassFailure();
 }
 
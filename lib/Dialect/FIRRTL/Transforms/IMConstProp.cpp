@@ -14,7 +14,7 @@
 #include "circt/Support/APInt.h"
 #include "mlir/IR/Threading.h"
 #include "llvm/ADT/APSInt.h"
-#include "llvm/ADT/TinyPtrVector.h"
+#include "llvm/ADT/BitVector.h"
 
 using namespace circt;
 using namespace firrtl;
@@ -169,55 +169,71 @@ private:
 } // end anonymous namespace
 
 namespace {
-struct IMConstPropPass : public IMConstPropBase<IMConstPropPass> {
-  void runOnOperation() override;
-  void rewriteModuleBody(FModuleOp module);
+/// The analysis state of a single module. The operations in the body of the
+/// module are numbered in order, and the values defined in the body are
+/// indexed densely: ports by their argument number, and operation results
+/// after the results of the operations before them. The operands of every
+/// operation and the users of every value are recorded by index when the
+/// solver is created, such that solving the module does not look up any
+/// operation or value in a map. Every module is solved on its own, and only
+/// exchanges the lattice values of its ports with the modules instantiating
+/// it, in between rounds of solving.
+class ModuleSolver {
+public:
+  ModuleSolver(FModuleOp module, InstanceGraph &instanceGraph);
+
+  FModuleOp getModule() const { return module; }
 
-  /// Returns true if the given block is executable.
-  bool isBlockExecutable(Block *block) const {
-    return executableBlocks.count(block);
+  /// Returns true if the body of the module is executable.
+  bool isExecutable() const { return executable; }
+
+  /// Returns true if some operations must be revisited.
+  bool hasWork() const { return !opWorklist.empty(); }
+
+  /// Return the index of the first result of an operation in the body of the
+  /// module.  This looks the operation up in a map, and is not used while
+  /// solving.
+  unsigned lookupResultIndex(Operation *op) const {
+    auto it = opNumbers.find(op);
+    assert(it != opNumbers.end() && "operation not in the body of the module");
+    return resultIndices[it->second];
   }
 
+  /// Return the lattice value of a value of the module, which is unknown if it
+  /// has not been computed.  This looks the defining operation of the value up
+  /// in a map, and is only used to rewrite the module.
+  LatticeValue lookupLatticeValue(Value value) const;
+
   bool isOverdefined(Value value) const {
-    auto it = latticeValues.find(value);
-    return it != latticeValues.end() && it->second.isOverdefined();
+    return lookupLatticeValue(value).isOverdefined();
+  }
+
+  /// Return the lattice value of the value with the given index.
+  LatticeValue getLatticeValue(unsigned index) const {
+    return latticeValues[index];
   }
 
   /// Mark the given value as overdefined. This means that we cannot refine a
   /// specific constant for this value.
-  void markOverdefined(Value value) {
-    auto &entry = latticeValues[value];
+  void markOverdefined(unsigned index) {
+    auto &entry = latticeValues[index];
     if (!entry.isOverdefined()) {
       entry.markOverdefined();
-      changedLatticeValueWorklist.push_back(value);
+      markChanged(index);
     }
   }
 
   /// Merge information from the 'from' lattice value into value.  If it
   /// changes, then users of the value are added to the worklist for
   /// revisitation.
-  void mergeLatticeValue(Value value, LatticeValue &valueEntry,
-                         LatticeValue source) {
-    if (!source.isOverdefined() &&
-        (!isa_and_nonnull<InstanceOp>(value.getDefiningOp()) &&
-         hasDontTouch(value)))
-      source = LatticeValue::getOverdefined();
-    if (valueEntry.mergeIn(source))
-      changedLatticeValueWorklist.push_back(value);
-  }
-  void mergeLatticeValue(Value value, LatticeValue source) {
-    // Don't even do a map lookup if from has no info in it.
+  void mergeLatticeValue(unsigned index, LatticeValue source) {
+    // Don't even look up the entry if from has no info in it.
     if (source.isUnknown())
       return;
-    mergeLatticeValue(value, latticeValues[value], source);
-  }
-  void mergeLatticeValue(Value result, Value from) {
-    // If 'from' hasn't been computed yet, then it is unknown, don't do
-    // anything.
-    auto it = latticeValues.find(from);
-    if (it == latticeValues.end())
-      return;
-    mergeLatticeValue(result, it->second);
+    if (!source.isOverdefined() && isDontTouch(index))
+      source = LatticeValue::getOverdefined();
+    if (latticeValues[index].mergeIn(source))
+      markChanged(index);
   }
 
   /// setLatticeValue - This is used when a new LatticeValue is computed for
@@ -225,116 +241,362 @@ struct IMConstPropPass : public IMConstPropBase<IMConstPropPass> {
   /// e.g. because a fold() function on an op returned a new thing.  This should
   /// not be used on operations that have multiple contributors to it, e.g.
   /// wires or ports.
-  void setLatticeValue(Value value, LatticeValue source) {
-    // Don't even do a map lookup if from has no info in it.
+  void setLatticeValue(unsigned index, LatticeValue source) {
+    // Don't even look up the entry if from has no info in it.
     if (source.isUnknown())
       return;
 
-    if (!source.isOverdefined() &&
-        (!isa_and_nonnull<InstanceOp>(value.getDefiningOp()) &&
-         hasDontTouch(value)))
+    if (!source.isOverdefined() && isDontTouch(index))
       source = LatticeValue::getOverdefined();
     // If we've changed this value then revisit all the users.
-    auto &valueEntry = latticeValues[value];
+    auto &valueEntry = latticeValues[index];
     if (valueEntry != source) {
-      changedLatticeValueWorklist.push_back(value);
+      markChanged(index);
       valueEntry = source;
     }
   }
 
-  /// Return the lattice value for the specified SSA value, extended to the
+  /// Return the lattice value for the specified value, extended to the
   /// width of the specified destType.  If allowTruncation is true, then this
   /// allows truncating the lattice value to the specified type.
-  LatticeValue getExtendedLatticeValue(Value value, FIRRTLType destType,
+  LatticeValue getExtendedLatticeValue(unsigned index, FIRRTLType destType,
                                        bool allowTruncation = false);
 
-  /// Mark the given block as executable.
-  void markBlockExecutable(Block *block);
-  void markWireOrUnresetableRegOp(Operation *wireOrReg);
-  void markRegResetOp(RegResetOp regReset);
-  void markMemOp(MemOp mem);
+  /// Mark the body of the module as executable.
+  void markBlockExecutable();
+  void markWireOrUnresetableRegOp(unsigned number);
+  void markRegResetOp(unsigned number);
+  void markMemOp(unsigned number);
+
+  void markInvalidValueOp(unsigned number);
+  void markConstantOp(unsigned number);
+  void markSpecialConstantOp(unsigned number);
+  void markInstanceOp(unsigned number);
+
+  void visitConnect(unsigned number);
+  void visitOperation(unsigned number);
 
-  void markInvalidValueOp(InvalidValueOp invalid);
-  void markConstantOp(ConstantOp constant);
-  void markSpecialConstantOp(SpecialConstantOp specialConstant);
-  void markInstanceOp(InstanceOp instance);
+  /// Reprocess the users of the values whose lattice value changed, until the
+  /// module reaches a fixpoint.
+  void solve();
 
-  void visitConnect(ConnectOp connect);
-  void visitStrictConnect(StrictConnectOp connect);
-  void visitOperation(Operation *op);
+  /// The instances of defined modules in the body of this module, in the order
+  /// they were marked executable, along with the index of their first result.
+  SmallVector<std::pair<InstanceOp, unsigned>> instances;
+
+  /// The number of instances above whose results have received the lattice
+  /// values of the output ports of the instantiated module.
+  size_t numForwardedInstances = 0;
+
+  /// The instances of this module in the bodies of other modules, along with
+  /// the solvers of these modules and the index of the first result of the
+  /// instances in them.
+  SmallVector<std::tuple<ModuleSolver *, InstanceOp, unsigned>> instantiations;
+
+  /// Whether the lattice value of a port changed in the current round.
+  bool portsChanged = false;
+
+  /// Whether the module was solved in the current round.
+  bool solved = false;
+
+  /// Whether the body of the module was executable when it was last solved.
+  /// Modules only read this flag of other modules while exchanging ports, as
+  /// the modules may become executable in the meantime.
+  bool wasExecutable = false;
 
 private:
+  /// Return the index of an operand of the operation with the given number.
+  unsigned getOperandIndex(unsigned number, unsigned operandNo) const {
+    return operandIndices[operandBegins[number] + operandNo];
+  }
+
+  /// Return the index of a result of the operation with the given number.
+  unsigned getResultIndex(unsigned number, unsigned resultNo = 0) const {
+    return resultIndices[number] + resultNo;
+  }
+
+  /// Returns true if the value with the given index may not be replaced by a
+  /// constant.  The lattice values of instance results are not affected, as
+  /// they only reflect the ports of the instantiated module.
+  bool isDontTouch(unsigned index) const {
+    auto value = values[index];
+    return !isa_and_nonnull<InstanceOp>(value.getDefiningOp()) &&
+           hasDontTouch(value);
+  }
+
+  /// Record that the lattice value of a value changed, queueing its users in
+  /// the body of the module to be revisited once.
+  void markChanged(unsigned index);
+
+  FModuleOp module;
+
   /// This is the current instance graph for the Circuit.
-  InstanceGraph *instanceGraph = nullptr;
+  InstanceGraph &instanceGraph;
+
+  /// Whether the body of the module is known to execute.
+  bool executable = false;
+
+  /// The operations in the body, by number, and the number of every
+  /// operation.  The map is only used to relate the operations to their
+  /// number outside of solving.
+  std::vector<Operation *> ops;
+  DenseMap<Operation *, unsigned> opNumbers;
+
+  /// The values of the module, by index, and the index of the first result of
+  /// every operation, by number.
+  std::vector<Value> values;
+  std::vector<unsigned> resultIndices;
+
+  /// The indices of the operands of every operation, starting at the begin
+  /// offset of the operation.
+  std::vector<unsigned> operandIndices;
+  std::vector<unsigned> operandBegins;
+
+  /// The numbers of the operations in the body using every value, starting at
+  /// the begin offset of the value.  An operation using a value several times
+  /// is listed as many times.
+  std::vector<unsigned> users;
+  std::vector<unsigned> userBegins;
 
   /// This keeps track of the current state of each tracked value.
-  DenseMap<Value, LatticeValue> latticeValues;
+  std::vector<LatticeValue> latticeValues;
 
-  /// The set of blocks that are known to execute, or are intrinsically live.
-  SmallPtrSet<Block *, 16> executableBlocks;
+  /// A worklist of the numbers of the operations which use a value whose
+  /// lattice value recently changed, and the operations queued in it.
+  SmallVector<unsigned, 64> opWorklist;
+  llvm::BitVector queuedOps;
+};
+} // end anonymous namespace
 
-  /// A worklist containing blocks that need to be processed.
-  SmallVector<Block *, 64> blockWorklist;
+namespace {
+struct IMConstPropPass : public IMConstPropBase<IMConstPropPass> {
+  void runOnOperation() override;
+  void rewriteModuleBody(ModuleSolver &solver);
+
+  /// Merge the values driven into the instances of a module into its input
+  /// ports, marking the module executable if an instance is.
+  void pullInputPorts(ModuleSolver &solver);
 
-  /// A worklist of values whose LatticeValue recently changed, indicating the
-  /// users need to be reprocessed.
-  SmallVector<Value, 64> changedLatticeValueWorklist;
+  /// Merge the output ports of the modules instantiated in a module into the
+  /// results of the instances.
+  void pullInstanceResults(ModuleSolver &solver);
 
-  /// This keeps track of users the instance results that correspond to output
-  /// ports.
-  DenseMap<BlockArgument, llvm::TinyPtrVector<Value>>
-      resultPortToInstanceResultMapping;
+private:
+  /// This is the current instance graph for the Circuit.
+  InstanceGraph *instanceGraph = nullptr;
+
+  /// The solvers of the modules, by module.
+  DenseMap<Operation *, ModuleSolver *> solverMap;
 };
 } // end anonymous namespace
 
 // TODO: handle annotations: [[OptimizableExtModuleAnnotation]]
 void IMConstPropPass::runOnOperation() {
+  auto *context = &getContext();
   auto circuit = getOperation();
-
   instanceGraph = &getAnalysis<InstanceGraph>();
 
+  // Create the solvers, which number the values of their module.
+  SmallVector<FModuleOp> modules(circuit.getBody()->getOps<FModuleOp>());
+  std::vector<std::unique_ptr<ModuleSolver>> solvers(modules.size());
+  mlir::parallelForEachN(context, 0, modules.size(), [&](size_t index) {
+    solvers[index] =
+        std::make_unique<ModuleSolver>(modules[index], *instanceGraph);
+  });
+  for (auto &solver : solvers)
+    solverMap[solver->getModule()] = solver.get();
+
+  // Record the instances of every module. Instances nested in other
+  // operations, e.g. in `when`s, are never executable.
+  mlir::parallelForEach(context, solvers, [&](auto &solver) {
+    auto *node = instanceGraph->lookup(solver->getModule());
+    for (auto *record : node->uses()) {
+      auto instance = cast<InstanceOp>(*record->getInstance());
+      auto parent = instance->getParentOfType<FModuleOp>();
+      if (parent && instance->getBlock() == parent.getBody()) {
+        auto *parentSolver = solverMap.lookup(parent);
+        auto resultIndex = parentSolver->lookupResultIndex(instance);
+        solver->instantiations.push_back({parentSolver, instance, resultIndex});
+      }
+    }
+  });
+
   // Mark the input ports of public modules as being overdefined.
-  for (auto module : circuit.getBody()->getOps<FModuleOp>()) {
+  for (auto &solver : solvers) {
+    auto module = solver->getModule();
     if (module.isPublic()) {
-      markBlockExecutable(module.getBody());
-      for (auto port : module.getBody()->getArguments())
-        markOverdefined(port);
+      solver->markBlockExecutable();
+      for (unsigned portNo = 0, e = module.getNumPorts(); portNo != e; ++portNo)
+        solver->markOverdefined(portNo);
     }
   }
 
-  // If a value changed lattice state then reprocess any of its users.
-  while (!changedLatticeValueWorklist.empty()) {
-    Value changedVal = changedLatticeValueWorklist.pop_back_val();
-    for (Operation *user : changedVal.getUsers()) {
-      if (isBlockExecutable(user->getBlock()))
-        visitOperation(user);
+  // Solve the modules in rounds, until they reach a fixpoint. Every round
+  // solves the modules in parallel, and then exchanges the lattice values of
+  // the ports between the modules and their instances.
+  for (bool hasWork = true; hasWork;) {
+    mlir::parallelForEach(context, solvers,
+                          [&](auto &solver) { solver->solve(); });
+    mlir::parallelForEach(context, solvers,
+                          [&](auto &solver) { pullInputPorts(*solver); });
+    mlir::parallelForEach(context, solvers,
+                          [&](auto &solver) { pullInstanceResults(*solver); });
+    // Modules which just became executable have to make the modules they
+    // instantiate executable as well, even if they have nothing to solve.
+    hasWork = false;
+    for (auto &solver : solvers) {
+      solver->portsChanged = false;
+      solver->solved = false;
+      hasWork |= solver->hasWork() ||
+                 solver->isExecutable() != solver->wasExecutable;
     }
   }
 
   // Rewrite any constants in the modules.
-  mlir::parallelForEach(circuit.getContext(),
-                        circuit.getBody()->getOps<FModuleOp>(),
-                        [&](auto op) { rewriteModuleBody(op); });
+  mlir::parallelForEach(context, solvers,
+                        [&](auto &solver) { rewriteModuleBody(*solver); });
 
   // Clean up our state for next time.
   instanceGraph = nullptr;
-  latticeValues.clear();
-  executableBlocks.clear();
-  resultPortToInstanceResultMapping.clear();
+  solverMap.clear();
 }
 
-/// Return the lattice value for the specified SSA value, extended to the width
-/// of the specified destType.  If allowTruncation is true, then this allows
-/// truncating the lattice value to the specified type.
-LatticeValue IMConstPropPass::getExtendedLatticeValue(Value value,
-                                                      FIRRTLType destType,
-                                                      bool allowTruncation) {
-  // If 'value' hasn't been computed yet, then it is unknown.
-  auto it = latticeValues.find(value);
-  if (it == latticeValues.end())
+void IMConstPropPass::pullInputPorts(ModuleSolver &solver) {
+  // Until the module is executable, look for an executable instance. Once it
+  // is, the results of its instances can only change in modules which were
+  // solved in this round.
+  auto module = solver.getModule();
+  for (auto [parent, instance, resultIndex] : solver.instantiations) {
+    if (!parent->wasExecutable || (solver.wasExecutable && !parent->solved))
+      continue;
+    solver.markBlockExecutable();
+    for (size_t portNo = 0, e = instance.getNumResults(); portNo != e;
+         ++portNo) {
+      if (module.getPortDirection(portNo) != Direction::In)
+        continue;
+      solver.mergeLatticeValue(
+          portNo, parent->getLatticeValue(resultIndex + portNo));
+    }
+  }
+}
+
+void IMConstPropPass::pullInstanceResults(ModuleSolver &solver) {
+  // The output ports of a module only need to be forwarded again if they
+  // changed in this round, but new instances receive all of them.
+  for (size_t index = 0, e = solver.instances.size(); index != e; ++index) {
+    auto [instance, resultIndex] = solver.instances[index];
+    auto module =
+        cast<FModuleOp>(*instanceGraph->getReferencedModule(instance));
+    auto *child = solverMap.lookup(module);
+    if (index < solver.numForwardedInstances && !child->portsChanged)
+      continue;
+    for (size_t portNo = 0, e = instance.getNumResults(); portNo != e;
+         ++portNo) {
+      auto instancePortVal = instance.getResult(portNo);
+      // Inputs are driven by the instantiating module, and non-ground results
+      // are overdefined.
+      if (module.getPortDirection(portNo) == Direction::In ||
+          !instancePortVal.getType().cast<FIRRTLType>().isGround())
+        continue;
+      solver.mergeLatticeValue(resultIndex + portNo,
+                               child->getLatticeValue(portNo));
+    }
+  }
+  solver.numForwardedInstances = solver.instances.size();
+}
+
+ModuleSolver::ModuleSolver(FModuleOp module, InstanceGraph &instanceGraph)
+    : module(module), instanceGraph(instanceGraph) {
+  // Number the operations in the body of the module, and their results after
+  // the ports.
+  auto *body = module.getBody();
+  values.assign(body->args_begin(), body->args_end());
+  for (auto &op : *body) {
+    opNumbers[&op] = ops.size();
+    ops.push_back(&op);
+    resultIndices.push_back(values.size());
+    values.insert(values.end(), op.result_begin(), op.result_end());
+  }
+  latticeValues.resize(values.size());
+  queuedOps.resize(ops.size());
+
+  // Record the operands of every operation, which are all defined in the body,
+  // and count the users of every value.
+  userBegins.assign(values.size() + 1, 0);
+  for (auto *op : ops) {
+    operandBegins.push_back(operandIndices.size());
+    for (auto operand : op->getOperands()) {
+      unsigned index;
+      if (auto arg = operand.dyn_cast<BlockArgument>())
+        index = arg.getArgNumber();
+      else
+        index = lookupResultIndex(operand.getDefiningOp()) +
+                operand.cast<OpResult>().getResultNumber();
+      operandIndices.push_back(index);
+      ++userBegins[index + 1];
+    }
+  }
+  operandBegins.push_back(operandIndices.size());
+
+  // Place the users of every value after the users of the values before it.
+  for (size_t index = 1, e = userBegins.size(); index != e; ++index)
+    userBegins[index] += userBegins[index - 1];
+  users.resize(operandIndices.size());
+  auto userEnds = userBegins;
+  for (unsigned number = 0, e = ops.size(); number != e; ++number)
+    for (auto i = operandBegins[number]; i != operandBegins[number + 1]; ++i)
+      users[userEnds[operandIndices[i]]++] = number;
+}
+
+LatticeValue ModuleSolver::lookupLatticeValue(Value value) const {
+  // Values defined outside of the body, e.g. in `when`s, and the results of
+  // the operations created while rewriting the body are unknown.
+  if (value.getParentBlock() != module.getBody())
+    return LatticeValue();
+  auto result = value.dyn_cast<OpResult>();
+  if (!result)
+    return latticeValues[value.cast<BlockArgument>().getArgNumber()];
+  auto it = opNumbers.find(result.getOwner());
+  if (it == opNumbers.end())
     return LatticeValue();
+  return latticeValues[getResultIndex(it->second, result.getResultNumber())];
+}
+
+void ModuleSolver::markChanged(unsigned index) {
+  if (index < module.getNumPorts())
+    portsChanged = true;
+  for (auto i = userBegins[index], e = userBegins[index + 1]; i != e; ++i) {
+    auto number = users[i];
+    if (queuedOps.test(number))
+      continue;
+    queuedOps.set(number);
+    opWorklist.push_back(number);
+  }
+}
+
+void ModuleSolver::solve() {
+  wasExecutable = executable;
+  if (!executable || opWorklist.empty())
+    return;
+  solved = true;
+
+  // Reprocess the users of the values which changed lattice state. An
+  // operation is visited once for all of its operands which changed since it
+  // was queued.
+  while (!opWorklist.empty()) {
+    auto number = opWorklist.pop_back_val();
+    queuedOps.reset(number);
+    visitOperation(number);
+  }
+}
 
-  auto result = it->second;
+/// Return the lattice value of the value with the given index, extended to the
+/// width of the specified destType.  If allowTruncation is true, then this
+/// allows truncating the lattice value to the specified type.
+LatticeValue ModuleSolver::getExtendedLatticeValue(unsigned index,
+                                                   FIRRTLType destType,
+                                                   bool allowTruncation) {
+  auto result = latticeValues[index];
   // Unknown/overdefined stay whatever they are.
   if (result.isUnknown() || result.isOverdefined())
     return result;
@@ -363,87 +625,106 @@ LatticeValue IMConstPropPass::getExtendedLatticeValue(Value value,
   return LatticeValue(IntegerAttr::get(destType.getContext(), resultConstant));
 }
 
-/// Mark a block executable if it isn't already.  This does an initial scan of
+/// Mark the body executable if it isn't already.  This does an initial scan of
 /// the block, processing nullary operations like wires, instances, and
 /// constants that only get processed once.
-void IMConstPropPass::markBlockExecutable(Block *block) {
-  if (!executableBlocks.insert(block).second)
+void ModuleSolver::markBlockExecutable() {
+  if (executable)
     return; // Already executable.
+  executable = true;
+
+  // Mark don't touch output ports as overdefined.
+  auto *body = module.getBody();
+  for (auto port : body->getArguments())
+    if (module.getPortDirection(port.getArgNumber()) == Direction::Out &&
+        hasDontTouch(port))
+      markOverdefined(port.getArgNumber());
 
-  for (auto &op : *block) {
+  for (unsigned number = 0, e = ops.size(); number != e; ++number) {
+    auto *op = ops[number];
 
     // Handle each of the special operations in the firrtl dialect.
     if (isa<WireOp>(op) || isa<RegOp>(op))
-      markWireOrUnresetableRegOp(&op);
-    else if (auto constant = dyn_cast<ConstantOp>(op))
-      markConstantOp(constant);
-    else if (auto specialConstant = dyn_cast<SpecialConstantOp>(op))
-      markSpecialConstantOp(specialConstant);
-    else if (auto invalid = dyn_cast<InvalidValueOp>(op))
-      markInvalidValueOp(invalid);
-    else if (auto instance = dyn_cast<InstanceOp>(op))
-      markInstanceOp(instance);
-    else if (auto regReset = dyn_cast<RegResetOp>(op))
-      markRegResetOp(regReset);
-    else if (auto mem = dyn_cast<MemOp>(op))
-      markMemOp(mem);
+      markWireOrUnresetableRegOp(number);
+    else if (isa<ConstantOp>(op))
+      markConstantOp(number);
+    else if (isa<SpecialConstantOp>(op))
+      markSpecialConstantOp(number);
+    else if (isa<InvalidValueOp>(op))
+      markInvalidValueOp(number);
+    else if (isa<InstanceOp>(op))
+      markInstanceOp(number);
+    else if (isa<RegResetOp>(op))
+      markRegResetOp(number);
+    else if (isa<MemOp>(op))
+      markMemOp(number);
   }
 }
 
-void IMConstPropPass::markWireOrUnresetableRegOp(Operation *wireOrReg) {
+void ModuleSolver::markWireOrUnresetableRegOp(unsigned number) {
   // If the wire/reg has a non-ground type, then it is too complex for us to
   // handle, mark it as overdefined.
   // TODO: Eventually add a field-sensitive model.
-  auto resultValue = wireOrReg->getResult(0);
+  auto resultValue = ops[number]->getResult(0);
+  auto index = getResultIndex(number);
   if (!resultValue.getType().cast<FIRRTLType>().getPassiveType().isGround())
-    return markOverdefined(resultValue);
+    return markOverdefined(index);
 
   // Otherwise, this starts out as InvalidValue and is upgraded by connects.
-  mergeLatticeValue(resultValue, InvalidValueAttr::get(resultValue.getType()));
+  mergeLatticeValue(index, InvalidValueAttr::get(resultValue.getType()));
 }
 
-void IMConstPropPass::markRegResetOp(RegResetOp regReset) {
+void ModuleSolver::markRegResetOp(unsigned number) {
+  auto regReset = cast<RegResetOp>(ops[number]);
   // If the reg has a non-ground type, then it is too complex for us to handle,
   // mark it as overdefined.
   // TODO: Eventually add a field-sensitive model.
   if (!regReset.getType().getPassiveType().isGround())
-    return markOverdefined(regReset);
+    return markOverdefined(getResultIndex(number));
 
   // The reset value may be known - if so, merge it in if the enable is greater
-  // than invalid.
-  auto srcValue = getExtendedLatticeValue(regReset.resetValue(),
+  // than invalid.  The operands are the clock, the reset signal and the reset
+  // value.
+  auto srcValue = getExtendedLatticeValue(getOperandIndex(number, 2),
                                           regReset.getType().cast<FIRRTLType>(),
                                           /*allowTruncation=*/true);
-  auto enable = getExtendedLatticeValue(regReset.resetSignal(),
+  auto enable = getExtendedLatticeValue(getOperandIndex(number, 1),
                                         regReset.getType().cast<FIRRTLType>(),
                                         /*allowTruncation=*/true);
   if (enable.isOverdefined() ||
       (enable.isConstant() && !enable.getConstant().getValue().isZero()))
-    mergeLatticeValue(regReset, srcValue);
+    mergeLatticeValue(getResultIndex(number), srcValue);
 }
 
-void IMConstPropPass::markMemOp(MemOp mem) {
-  for (auto result : mem.getResults())
-    markOverdefined(result);
+void ModuleSolver::markMemOp(unsigned number) {
+  for (unsigned i = 0, e = ops[number]->getNumResults(); i != e; ++i)
+    markOverdefined(getResultIndex(number, i));
 }
 
-void IMConstPropPass::markConstantOp(ConstantOp constant) {
-  mergeLatticeValue(constant, LatticeValue(constant.valueAttr()));
+void ModuleSolver::markConstantOp(unsigned number) {
+  auto constant = cast<ConstantOp>(ops[number]);
+  mergeLatticeValue(getResultIndex(number), LatticeValue(constant.valueAttr()));
 }
 
-void IMConstPropPass::markSpecialConstantOp(SpecialConstantOp specialConstant) {
-  mergeLatticeValue(specialConstant, LatticeValue(specialConstant.valueAttr()));
+void ModuleSolver::markSpecialConstantOp(unsigned number) {
+  auto specialConstant = cast<SpecialConstantOp>(ops[number]);
+  mergeLatticeValue(getResultIndex(number),
+                    LatticeValue(specialConstant.valueAttr()));
 }
 
-void IMConstPropPass::markInvalidValueOp(InvalidValueOp invalid) {
-  mergeLatticeValue(invalid, InvalidValueAttr::get(invalid.getType()));
+void ModuleSolver::markInvalidValueOp(unsigned number) {
+  auto invalid = cast<InvalidValueOp>(ops[number]);
+  mergeLatticeValue(getResultIndex(number),
+                    InvalidValueAttr::get(invalid.getType()));
 }
 
 /// Instances have no operands, so they are visited exactly once when their
-/// enclosing block is marked live.  This sets up the def-use edges for ports.
-void IMConstPropPass::markInstanceOp(InstanceOp instance) {
+/// enclosing block is marked live.  The lattice values of the ports of defined
+/// modules are exchanged with the instance in between rounds of solving.
+void ModuleSolver::markInstanceOp(unsigned number) {
+  auto instance = cast<InstanceOp>(ops[number]);
   // Get the module being reference or a null pointer if this is an extmodule.
-  Operation *op = instanceGraph->getReferencedModule(instance);
+  Operation *op = instanceGraph.getReferencedModule(instance);
 
   // If this is an extmodule, just remember that any results and inouts are
   // overdefined.
@@ -451,23 +732,21 @@ void IMConstPropPass::markInstanceOp(InstanceOp instance) {
     auto module = dyn_cast<FModuleLike>(op);
     for (size_t resultNo = 0, e = instance.getNumResults(); resultNo != e;
          ++resultNo) {
-      auto portVal = instance.getResult(resultNo);
       // If this is an input to the extmodule, we can ignore it.
       if (module.getPortDirection(resultNo) == Direction::In)
         continue;
 
       // Otherwise this is a result from it or an inout, mark it as overdefined.
-      markOverdefined(portVal);
+      markOverdefined(getResultIndex(number, resultNo));
     }
     return;
   }
 
-  // Otherwise this is a defined module.
+  // Otherwise this is a defined module, whose body becomes executable and
+  // whose output ports are forwarded to the instance by the pass.
   auto fModule = cast<FModuleOp>(op);
-  markBlockExecutable(fModule.getBody());
+  instances.push_back({instance, getResultIndex(number)});
 
-  // Ok, it is a normal internal module reference.  Populate
-  // resultPortToInstanceResultMapping, and forward any already-computed values.
   for (size_t resultNo = 0, e = instance.getNumResults(); resultNo != e;
        ++resultNo) {
     auto instancePortVal = instance.getResult(resultNo);
@@ -478,65 +757,43 @@ void IMConstPropPass::markInstanceOp(InstanceOp instance) {
     // We only support simple values so far.
     if (!instancePortVal.getType().cast<FIRRTLType>().isGround()) {
       // TODO: Add field sensitivity.
-      markOverdefined(instancePortVal);
+      markOverdefined(getResultIndex(number, resultNo));
       continue;
     }
-
-    // Otherwise we have a result from the instance.  We need to forward results
-    // from the body to this instance result's SSA value, so remember it.
-    BlockArgument modulePortVal = fModule.getArgument(resultNo);
-
-    // Mark don't touch results as overdefined
-    if (hasDontTouch(modulePortVal))
-      markOverdefined(modulePortVal);
-
-    resultPortToInstanceResultMapping[modulePortVal].push_back(instancePortVal);
-
-    // If there is already a value known for modulePortVal make sure to forward
-    // it here.
-    mergeLatticeValue(instancePortVal, modulePortVal);
   }
 }
 
-// We merge the value from the RHS into the value of the LHS.
-void IMConstPropPass::visitConnect(ConnectOp connect) {
+// We merge the value from the RHS into the value of the LHS.  This handles
+// both connects and strict connects, whose operands are the destination and
+// then the source.
+void ModuleSolver::visitConnect(unsigned number) {
+  auto connect = cast<FConnectLike>(ops[number]);
   auto destType = connect.dest().getType().cast<FIRRTLType>().getPassiveType();
+  auto destIndex = getOperandIndex(number, 0);
+  auto srcIndex = getOperandIndex(number, 1);
 
   // Handle implicit extensions.
-  auto srcValue = getExtendedLatticeValue(connect.src(), destType);
+  auto srcValue = getExtendedLatticeValue(srcIndex, destType);
   if (srcValue.isUnknown())
     return;
 
   // Driving result ports propagates the value to each instance using the
-  // module.
-  if (auto blockArg = connect.dest().dyn_cast<BlockArgument>()) {
-    for (auto userOfResultPort : resultPortToInstanceResultMapping[blockArg])
-      mergeLatticeValue(userOfResultPort, srcValue);
-    // Output ports are wire-like and may have users.
-    mergeLatticeValue(connect.dest(), srcValue);
-    return;
-  }
+  // module, once the module is solved.  Output ports are wire-like and may
+  // have users.
+  if (connect.dest().isa<BlockArgument>())
+    return mergeLatticeValue(destIndex, srcValue);
 
   auto dest = connect.dest().cast<mlir::OpResult>();
 
   // For wires and registers, we drive the value of the wire itself, which
   // automatically propagates to users.
   if (isWireOrReg(dest.getOwner()))
-    return mergeLatticeValue(connect.dest(), srcValue);
+    return mergeLatticeValue(destIndex, srcValue);
 
   // Driving an instance argument port drives the corresponding argument of the
-  // referenced module.
-  if (auto instance = dest.getDefiningOp<InstanceOp>()) {
-    // Update the dest, when its an instance op.
-    mergeLatticeValue(connect.dest(), srcValue);
-    auto module =
-        dyn_cast<FModuleOp>(*instanceGraph->getReferencedModule(instance));
-    if (!module)
-      return;
-
-    BlockArgument modulePortVal = module.getArgument(dest.getResultNumber());
-    return mergeLatticeValue(modulePortVal, srcValue);
-  }
+  // referenced module, once the module is solved.
+  if (isa<InstanceOp>(dest.getOwner()))
+    return mergeLatticeValue(destIndex, srcValue);
 
   // Driving a memory result is ignored because these are always treated as
   // overdefined.
@@ -545,62 +802,17 @@ void IMConstPropPass::visitConnect(ConnectOp connect) {
       return;
   }
 
-  connect.emitError("connect unhandled by IMConstProp")
-          .attachNote(connect.dest().getLoc())
-      << "connect destination is here";
-}
-
-// We merge the value from the RHS into the value of the LHS.
-void IMConstPropPass::visitStrictConnect(StrictConnectOp connect) {
-  auto destType = connect.dest().getType().cast<FIRRTLType>().getPassiveType();
-
-  // Handle implicit extensions.
-  auto srcValue = getExtendedLatticeValue(connect.src(), destType);
-  if (srcValue.isUnknown())
+  if (isa<ConnectOp>(connect)) {
+    connect.emitError("connect unhandled by IMConstProp")
+            .attachNote(connect.dest().getLoc())
+        << "connect destination is here";
     return;
-
-  // Driving result ports propagates the value to each instance using the
-  // module.
-  if (auto blockArg = connect.dest().dyn_cast<BlockArgument>()) {
-    for (auto userOfResultPort : resultPortToInstanceResultMapping[blockArg])
-      mergeLatticeValue(userOfResultPort, srcValue);
-    // Output ports are wire-like and may have users.
-    mergeLatticeValue(connect.dest(), srcValue);
-    return;
-  }
-
-  auto dest = connect.dest().cast<mlir::OpResult>();
-
-  // For wires and registers, we drive the value of the wire itself, which
-  // automatically propagates to users.
-  if (isWireOrReg(dest.getOwner()))
-    return mergeLatticeValue(connect.dest(), srcValue);
-
-  // Driving an instance argument port drives the corresponding argument of the
-  // referenced module.
-  if (auto instance = dest.getDefiningOp<InstanceOp>()) {
-    // Update the dest, when its an instance op.
-    mergeLatticeValue(connect.dest(), srcValue);
-    auto module =
-        dyn_cast<FModuleOp>(*instanceGraph->getReferencedModule(instance));
-    if (!module)
-      return;
-
-    BlockArgument modulePortVal = module.getArgument(dest.getResultNumber());
-    return mergeLatticeValue(modulePortVal, srcValue);
-  }
-
-  // Driving a memory result is ignored because these are always treated as
-  // overdefined.
-  if (auto subfield = dest.getDefiningOp<SubfieldOp>()) {
-    if (subfield.getOperand().getDefiningOp<MemOp>())
-      return;
   }
 
   // Make aggregates overdefined for now.  Fix when context sensitive.
   if (isAggregate(dest.getOwner())) {
-    markOverdefined(connect.src());
-    return markOverdefined(connect.dest());
+    markOverdefined(srcIndex);
+    return markOverdefined(destIndex);
   }
 
   connect.emitError("strictconnect unhandled by IMConstProp")
@@ -614,14 +826,13 @@ void IMConstPropPass::visitStrictConnect(StrictConnectOp connect) {
 ///
 /// This should update the lattice value state for any result values.
 ///
-void IMConstPropPass::visitOperation(Operation *op) {
+void ModuleSolver::visitOperation(unsigned number) {
+  auto *op = ops[number];
   // If this is a operation with special handling, handle it specially.
-  if (auto connectOp = dyn_cast<ConnectOp>(op))
-    return visitConnect(connectOp);
-  if (auto strictConnectOp = dyn_cast<StrictConnectOp>(op))
-    return visitStrictConnect(strictConnectOp);
-  if (auto regResetOp = dyn_cast<RegResetOp>(op))
-    return markRegResetOp(regResetOp);
+  if (isa<ConnectOp, StrictConnectOp>(op))
+    return visitConnect(number);
+  if (isa<RegResetOp>(op))
+    return markRegResetOp(number);
 
   // The clock operand of regop changing doesn't change its result value.
   if (isa<RegOp>(op))
@@ -630,22 +841,27 @@ void IMConstPropPass::visitOperation(Operation *op) {
 
   // Nodes might not fold since they might have a name, but should prop
   if (isa<NodeOp>(op)) {
-    mergeLatticeValue(op->getResult(0), op->getOperand(0));
+    mergeLatticeValue(getResultIndex(number),
+                      latticeValues[getOperandIndex(number, 0)]);
     return;
   }
 
   // If all of the results of this operation are already overdefined (or if
   // there are no results) then bail out early: we've converged.
-  auto isOverdefinedFn = [&](Value value) { return isOverdefined(value); };
-  if (llvm::all_of(op->getResults(), isOverdefinedFn))
+  auto numResults = op->getNumResults();
+  auto isOverdefinedFn = [&](unsigned resultNo) {
+    return latticeValues[getResultIndex(number, resultNo)].isOverdefined();
+  };
+  if (llvm::all_of(llvm::seq(0u, numResults), isOverdefinedFn))
     return;
 
   // Collect all of the constant operands feeding into this operation. If any
   // are not ready to be resolved, bail out and wait for them to resolve.
   SmallVector<Attribute, 8> operandConstants;
   operandConstants.reserve(op->getNumOperands());
-  for (Value operand : op->getOperands()) {
-    auto &operandLattice = latticeValues[operand];
+  for (unsigned operandNo = 0, e = op->getNumOperands(); operandNo != e;
+       ++operandNo) {
+    auto operandLattice = latticeValues[getOperandIndex(number, operandNo)];
 
     // If the operand is an unknown value, then we generally don't want to
     // process it - we want to wait until the value is resolved to by the SCCP
@@ -664,10 +880,10 @@ void IMConstPropPass::visitOperation(Operation *op) {
   // Simulate the result of folding this operation to a constant. If folding
   // fails or was an in-place fold, mark the results as overdefined.
   SmallVector<OpFoldResult, 8> foldResults;
-  foldResults.reserve(op->getNumResults());
+  foldResults.reserve(numResults);
   if (failed(op->fold(operandConstants, foldResults))) {
-    for (auto value : op->getResults())
-      markOverdefined(value);
+    for (unsigned resultNo = 0; resultNo != numResults; ++resultNo)
+      markOverdefined(getResultIndex(number, resultNo));
     return;
   }
 
@@ -677,7 +893,7 @@ void IMConstPropPass::visitOperation(Operation *op) {
          "FIRRTL fold functions shouldn't do in-place updates!");
 
   // Merge the fold results into the lattice for this operation.
-  assert(foldResults.size() == op->getNumResults() && "invalid result size");
+  assert(foldResults.size() == numResults && "invalid result size");
   for (unsigned i = 0, e = foldResults.size(); i != e; ++i) {
     // Merge in the result of the fold, either a constant or a value.
     LatticeValue resultLattice;
@@ -689,21 +905,30 @@ void IMConstPropPass::visitOperation(Operation *op) {
         resultLattice = invalidValueAttr;
       else // Treat non integer constants as overdefined.
         resultLattice = LatticeValue::getOverdefined();
-    } else { // Folding to an operand results in its value.
-      resultLattice = latticeValues[foldResult.get<Value>()];
+    } else {
+      // Folding to an operand results in its value.  Folds which return
+      // another value are not expected, and looked up in the map.
+      auto foldValue = foldResult.get<Value>();
+      auto operands = op->getOperands();
+      auto it = llvm::find(operands, foldValue);
+      if (it != operands.end())
+        resultLattice = latticeValues[getOperandIndex(
+            number, std::distance(operands.begin(), it))];
+      else
+        resultLattice = lookupLatticeValue(foldValue);
     }
 
     // We do not "merge" the lattice value in, we set it.  This is because the
     // fold functions can produce different values over time, e.g. in the
     // presence of InvalidValue operands that get resolved to other constants.
-    setLatticeValue(op->getResult(i), resultLattice);
+    setLatticeValue(getResultIndex(number, i), resultLattice);
   }
 }
-
-void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
+void IMConstPropPass::rewriteModuleBody(ModuleSolver &solver) {
+  auto module = solver.getModule();
   auto *body = module.getBody();
   // If a module is unreachable, just ignore it.
-  if (!executableBlocks.count(body))
+  if (!solver.isExecutable())
     return;
 
   auto builder = OpBuilder::atBlockBegin(body);
@@ -731,13 +956,12 @@ void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
   // If the lattice value for the specified value is a constant or
   // InvalidValue, update it and return true.  Otherwise return false.
   auto replaceValueIfPossible = [&](Value value) -> bool {
-    auto it = latticeValues.find(value);
-    if (it == latticeValues.end() || it->second.isOverdefined() ||
-        it->second.isUnknown())
+    auto lattice = solver.lookupLatticeValue(value);
+    if (lattice.isOverdefined() || lattice.isUnknown())
       return false;
 
     auto cstValue =
-        getConst(it->second.getValue(), value.getType(), value.getLoc());
+        getConst(lattice.getValue(), value.getType(), value.getLoc());
 
     // Replace all uses of this value with the constant, unless this is the
     // destination of a connect.  We leave those alone to avoid upsetting flow.
@@ -766,7 +990,8 @@ void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
     // Connects to values that we found to be constant can be dropped.
     if (auto connect = dyn_cast<ConnectOp>(op)) {
       if (auto *destOp = connect.dest().getDefiningOp()) {
-        if (isDeletableWireOrReg(destOp) && !isOverdefined(connect.dest())) {
+        if (isDeletableWireOrReg(destOp) &&
+            !solver.isOverdefined(connect.dest())) {
           connect.erase();
           ++numErasedOp;
         }
@@ -775,7 +1000,8 @@ void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
     }
     if (auto connect = dyn_cast<StrictConnectOp>(op)) {
       if (auto *destOp = connect.dest().getDefiningOp()) {
-        if (isDeletableWireOrReg(destOp) && !isOverdefined(connect.dest())) {
+        if (isDeletableWireOrReg(destOp) &&
+            !solver.isOverdefined(connect.dest())) {
           connect.erase();
           ++numErasedOp;
         }
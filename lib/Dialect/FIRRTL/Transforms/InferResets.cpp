@@ -12,6 +12,7 @@
 
 #include "PassDetails.h"
 #include "circt/Dialect/FIRRTL/FIRRTLInstanceGraph.h"
+#include "circt/Dialect/FIRRTL/FIRRTLModuleParallel.h"
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
 #include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
@@ -416,11 +417,13 @@ struct InferResetsPass : public InferResetsBase<InferResetsPass> {
   // Reset type inference
 
   void traceResets(CircuitOp circuit);
-  void traceResets(InstanceOp inst);
-  void traceResets(Value dst, Value src, Location loc);
-  void traceResets(Value value);
+  void traceResets(FModuleOp module, ResetDrives &drives);
+  void traceResets(InstanceOp inst, ResetDrives &drives);
+  void traceResets(Value dst, Value src, Location loc, ResetDrives &drives);
   void traceResets(FIRRTLType dstType, Value dst, unsigned dstID,
-                   FIRRTLType srcType, Value src, unsigned srcID, Location loc);
+                   FIRRTLType srcType, Value src, unsigned srcID, Location loc,
+                   ResetDrives &drives);
+  void unionResets(const ResetDrive &drive);
 
   LogicalResult inferAndUpdateResets();
   FailureOr<ResetKind> inferReset(ResetNetwork net);
@@ -723,15 +726,36 @@ static bool typeContainsReset(FIRRTLType type) {
 /// them into reset nets. After this function returns, the `resetMap` is
 /// populated with the reset networks in the circuit, alongside information on
 /// drivers and their types that contribute to the reset.
+///
+/// The modules are traced in parallel, each collecting the drives involving
+/// resets in its body. The drives are then unified into the reset networks in
+/// the order of the modules in the circuit, such that the networks and the
+/// diagnostics do not depend on the number of threads.
 void InferResetsPass::traceResets(CircuitOp circuit) {
   LLVM_DEBUG(
       llvm::dbgs() << "\n===----- Tracing uninferred resets -----===\n\n");
-  circuit.walk([&](Operation *op) {
+  ModuleParallelDriver<ResetDrives> driver(circuit, *instanceGraph);
+  (void)driver.summarize([&](FModuleOp module, ResetDrives &drives) {
+    traceResets(module, drives);
+    return success();
+  });
+  (void)driver.solve([&](FModuleOp module, ResetDrives &drives) {
+    for (auto &drive : drives)
+      unionResets(drive);
+    return success();
+  });
+}
+
+/// Collect the drives involving resets in the body of a module. This only
+/// modifies the module itself, and may run in parallel for different modules.
+void InferResetsPass::traceResets(FModuleOp module, ResetDrives &drives) {
+  module.walk([&](Operation *op) {
     TypeSwitch<Operation *>(op)
-        .Case<ConnectOp, StrictConnectOp>(
-            [&](auto op) { traceResets(op.dest(), op.src(), op.getLoc()); })
+        .Case<ConnectOp, StrictConnectOp>([&](auto op) {
+          traceResets(op.dest(), op.src(), op.getLoc(), drives);
+        })
 
-        .Case<InstanceOp>([&](auto op) { traceResets(op); })
+        .Case<InstanceOp>([&](auto op) { traceResets(op, drives); })
 
         .Case<InvalidValueOp>([&](auto op) {
           // Uniquify `InvalidValueOp`s that are contributing to multiple reset
@@ -762,7 +786,7 @@ void InferResetsPass::traceResets(CircuitOp circuit) {
           auto index = op.fieldIndex();
           traceResets(op.getType(), op.getResult(), 0,
                       bundleType.getElements()[index].type, op.input(),
-                      getFieldID(bundleType, index), op.getLoc());
+                      getFieldID(bundleType, index), op.getLoc(), drives);
         })
 
         .Case<SubindexOp, SubaccessOp>([&](auto op) {
@@ -780,14 +804,14 @@ void InferResetsPass::traceResets(CircuitOp circuit) {
           auto vectorType = op.input().getType().template cast<FVectorType>();
           traceResets(op.getType(), op.getResult(), 0,
                       vectorType.getElementType(), op.input(),
-                      getFieldID(vectorType), op.getLoc());
+                      getFieldID(vectorType), op.getLoc(), drives);
         });
   });
 }
 
 /// Trace reset signals through an instance. This essentially associates the
 /// instance's port values with the target module's port values.
-void InferResetsPass::traceResets(InstanceOp inst) {
+void InferResetsPass::traceResets(InstanceOp inst, ResetDrives &drives) {
   // Lookup the referenced module. Nothing to do if its an extmodule.
   auto module = dyn_cast<FModuleOp>(*instanceGraph->getReferencedModule(inst));
   if (!module)
@@ -802,24 +826,25 @@ void InferResetsPass::traceResets(InstanceOp inst) {
     Value srcPort = it.value();
     if (dir == Direction::Out)
       std::swap(dstPort, srcPort);
-    traceResets(dstPort, srcPort, it.value().getLoc());
+    traceResets(dstPort, srcPort, it.value().getLoc(), drives);
   }
 }
 
 /// Analyze a connect of one (possibly aggregate) value to another.
 /// Each drive involving a `ResetType` is recorded.
-void InferResetsPass::traceResets(Value dst, Value src, Location loc) {
+void InferResetsPass::traceResets(Value dst, Value src, Location loc,
+                                  ResetDrives &drives) {
   // Analyze the actual connection.
   auto dstType = dst.getType().cast<FIRRTLType>();
   auto srcType = src.getType().cast<FIRRTLType>();
-  traceResets(dstType, dst, 0, srcType, src, 0, loc);
+  traceResets(dstType, dst, 0, srcType, src, 0, loc, drives);
 }
 
 /// Analyze a connect of one (possibly aggregate) value to another.
 /// Each drive involving a `ResetType` is recorded.
 void InferResetsPass::traceResets(FIRRTLType dstType, Value dst, unsigned dstID,
                                   FIRRTLType srcType, Value src, unsigned srcID,
-                                  Location loc) {
+                                  Location loc, ResetDrives &drives) {
   if (auto dstBundle = dstType.dyn_cast<BundleType>()) {
     auto srcBundle = srcType.cast<BundleType>();
     for (unsigned dstIdx = 0, e = dstBundle.getNumElements(); dstIdx < e;
@@ -833,11 +858,11 @@ void InferResetsPass::traceResets(FIRRTLType dstType, Value dst, unsigned dstID,
       if (dstElt.isFlip) {
         traceResets(srcElt.type, src, srcID + getFieldID(srcBundle, *srcIdx),
                     dstElt.type, dst, dstID + getFieldID(dstBundle, dstIdx),
-                    loc);
+                    loc, drives);
       } else {
         traceResets(dstElt.type, dst, dstID + getFieldID(dstBundle, dstIdx),
                     srcElt.type, src, srcID + getFieldID(srcBundle, *srcIdx),
-                    loc);
+                    loc, drives);
       }
     }
     return;
@@ -860,54 +885,57 @@ void InferResetsPass::traceResets(FIRRTLType dstType, Value dst, unsigned dstID,
     // the field ID and make sure in `updateType` that we handle vectors
     // accordingly.
     traceResets(dstElType, dst, dstID + getFieldID(dstVector), srcElType, src,
-                srcID + getFieldID(srcVector), loc);
+                srcID + getFieldID(srcVector), loc, drives);
     return;
   }
 
   if (dstType.isGround()) {
-    if (dstType.isa<ResetType>() || srcType.isa<ResetType>()) {
-      FieldRef dstField(dst, dstID);
-      FieldRef srcField(src, srcID);
-      LLVM_DEBUG(llvm::dbgs()
-                 << "Visiting driver '" << dstField << "' = '" << srcField
-                 << "' (" << dstType << " = " << srcType << ")\n");
-
-      // Determine the leaders for the dst and src reset networks before we make
-      // the connection. This will allow us to later detect if dst got merged
-      // into src, or src into dst.
-      ResetSignal dstLeader =
-          *resetClasses.findLeader(resetClasses.insert({dstField, dstType}));
-      ResetSignal srcLeader =
-          *resetClasses.findLeader(resetClasses.insert({srcField, srcType}));
-
-      // Unify the two reset networks.
-      ResetSignal unionLeader = *resetClasses.unionSets(dstLeader, srcLeader);
-      assert(unionLeader == dstLeader || unionLeader == srcLeader);
-
-      // If dst got merged into src, append dst's drives to src's, or vice
-      // versa. Also, remove dst's or src's entry in resetDrives, because they
-      // will never come up as a leader again.
-      if (dstLeader != srcLeader) {
-        auto &unionDrives = resetDrives[unionLeader]; // needed before finds
-        auto mergedDrivesIt =
-            resetDrives.find(unionLeader == dstLeader ? srcLeader : dstLeader);
-        if (mergedDrivesIt != resetDrives.end()) {
-          unionDrives.append(mergedDrivesIt->second);
-          resetDrives.erase(mergedDrivesIt);
-        }
-      }
-
-      // Keep note of this drive so we can point the user at the right location
-      // in case something goes wrong.
-      resetDrives[unionLeader].push_back(
-          {{dstField, dstType}, {srcField, srcType}, loc});
-    }
+    if (dstType.isa<ResetType>() || srcType.isa<ResetType>())
+      drives.push_back({{FieldRef(dst, dstID), dstType},
+                        {FieldRef(src, srcID), srcType},
+                        loc});
     return;
   }
 
   llvm_unreachable("unknown type");
 }
 
+/// Unify the reset networks of the two ends of a drive involving a reset.
+void InferResetsPass::unionResets(const ResetDrive &drive) {
+  LLVM_DEBUG(llvm::dbgs() << "Visiting driver '" << drive.dst.field << "' = '"
+                          << drive.src.field << "' (" << drive.dst.type
+                          << " = " << drive.src.type << ")\n");
+
+  // Determine the leaders for the dst and src reset networks before we make
+  // the connection. This will allow us to later detect if dst got merged
+  // into src, or src into dst.
+  ResetSignal dstLeader =
+      *resetClasses.findLeader(resetClasses.insert(drive.dst));
+  ResetSignal srcLeader =
+      *resetClasses.findLeader(resetClasses.insert(drive.src));
+
+  // Unify the two reset networks.
+  ResetSignal unionLeader = *resetClasses.unionSets(dstLeader, srcLeader);
+  assert(unionLeader == dstLeader || unionLeader == srcLeader);
+
+  // If dst got merged into src, append dst's drives to src's, or vice
+  // versa. Also, remove dst's or src's entry in resetDrives, because they
+  // will never come up as a leader again.
+  if (dstLeader != srcLeader) {
+    auto &unionDrives = resetDrives[unionLeader]; // needed before finds
+    auto mergedDrivesIt =
+        resetDrives.find(unionLeader == dstLeader ? srcLeader : dstLeader);
+    if (mergedDrivesIt != resetDrives.end()) {
+      unionDrives.append(mergedDrivesIt->second);
+      resetDrives.erase(mergedDrivesIt);
+    }
+  }
+
+  // Keep note of this drive so we can point the user at the right location
+  // in case something goes wrong.
+  resetDrives[unionLeader].push_back(drive);
+}
+
 //===----------------------------------------------------------------------===//
 // Reset Inference
 //===----------------------------------------------------------------------===//
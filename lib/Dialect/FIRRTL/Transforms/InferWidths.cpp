@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "PassDetails.h"
+#include "circt/Dialect/FIRRTL/FIRRTLModuleParallel.h"
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
 #include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
 #include "circt/Dialect/FIRRTL/FIRRTLUtils.h"
@@ -24,10 +25,14 @@
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 
+#include <chrono>
+#include <mutex>
+
 #define DEBUG_TYPE "infer-widths"
 
 using mlir::InferTypeOpInterface;
@@ -122,6 +127,11 @@ struct VarExpr : public ExprBase<VarExpr, Expr::Kind::Var> {
   /// The constraint expression this variable is supposed to be greater than or
   /// equal to. This is not part of the variable's hash and equality property.
   Expr *constraint = nullptr;
+
+  /// Whether the variable is shared across modules, i.e. is declared for a
+  /// module port. Constraints on it are deferred while the modules are mapped
+  /// in parallel.
+  bool shared = false;
 };
 
 /// An identity expression.
@@ -319,6 +329,9 @@ class InternedAllocator {
 public:
   InternedAllocator(llvm::BumpPtrAllocator &allocator) : allocator(allocator) {}
 
+  /// Drop the table of interned objects. The objects themselves remain valid.
+  void clear() { interned = llvm::DenseSet<Slot>(); }
+
   /// Allocate a new object if it does not yet exist, or return a pointer to the
   /// existing one. `R` is the type of the object to be allocated. `R` must be
   /// derived from or be the type `T`.
@@ -578,13 +591,19 @@ struct LinIneq {
   }
 };
 
-/// A simple solver for width constraints.
-class ConstraintSolver {
+/// A set of constraint expressions, along with the values and locations in the
+/// IR which lead to them. The solver holds the expressions shared across the
+/// circuit, i.e. the variables of the module ports, and every module is mapped
+/// into a set of its own, in parallel with the other modules.
+class ConstraintSet {
 public:
-  ConstraintSolver() = default;
+  ConstraintSet(llvm::BumpPtrAllocator &allocator, bool shared)
+      : allocator(allocator), vars(allocator), knowns(allocator),
+        ids(allocator), uns(allocator), bins(allocator), shared(shared) {}
 
   VarExpr *var() {
     auto v = vars.alloc();
+    v->shared = shared;
     exprs.push_back(v);
     if (currentInfo)
       info[v].insert(currentInfo);
@@ -600,8 +619,14 @@ public:
   MinExpr *min(Expr *lhs, Expr *rhs) { return alloc<MinExpr>(bins, lhs, rhs); }
 
   /// Add a constraint `lhs >= rhs`. Multiple constraints on the same variable
-  /// are coalesced into a `max(a, b)` expr.
+  /// are coalesced into a `max(a, b)` expr. The constraints a module imposes
+  /// on shared variables are deferred until the module is merged into the
+  /// solver, such that they are coalesced in the order of the modules.
   Expr *addGeqConstraint(VarExpr *lhs, Expr *rhs) {
+    if (lhs->shared && !shared) {
+      deferred.push_back({lhs, rhs, currentInfo, currentLoc});
+      return rhs;
+    }
     if (lhs->constraint)
       lhs->constraint = max(lhs->constraint, rhs);
     else
@@ -609,26 +634,36 @@ public:
     return lhs->constraint;
   }
 
-  void dumpConstraints(llvm::raw_ostream &os);
-  LogicalResult solve();
+  /// Drop the tables used to intern expressions once the set is complete. No
+  /// more expressions may be allocated afterwards.
+  void finalize() {
+    knowns.clear();
+    ids.clear();
+    uns.clear();
+    bins.clear();
+  }
 
   using ContextInfo = DenseMap<Expr *, llvm::SmallSetVector<FieldRef, 1>>;
-  const ContextInfo &getContextInfo() const { return info; }
+  using LocationInfo = DenseMap<Expr *, llvm::SmallSetVector<Location, 1>>;
   void setCurrentContextInfo(FieldRef fieldRef) { currentInfo = fieldRef; }
   void setCurrentLocation(Optional<Location> loc) { currentLoc = loc; }
 
 private:
-  // Allocator for constraint expressions.
-  llvm::BumpPtrAllocator allocator;
-  VarAllocator vars = {allocator};
-  InternedAllocator<KnownExpr> knowns = {allocator};
-  InternedAllocator<IdExpr> ids = {allocator};
-  InternedAllocator<UnaryExpr> uns = {allocator};
-  InternedAllocator<BinaryExpr> bins = {allocator};
+  friend class ConstraintSolver;
+
+  // Allocators for constraint expressions.
+  llvm::BumpPtrAllocator &allocator;
+  VarAllocator vars;
+  InternedAllocator<KnownExpr> knowns;
+  InternedAllocator<IdExpr> ids;
+  InternedAllocator<UnaryExpr> uns;
+  InternedAllocator<BinaryExpr> bins;
+
+  /// Whether this set holds the expressions shared across modules.
+  bool shared;
 
   /// A list of expressions in the order they were created.
   std::vector<Expr *> exprs;
-  RootExpr root = {exprs};
 
   /// Add an allocated expression to the list above.
   template <typename R, typename T, typename... Args>
@@ -647,9 +682,92 @@ private:
   /// IR lead to this expression.
   ContextInfo info;
   FieldRef currentInfo = {};
-  DenseMap<Expr *, llvm::SmallSetVector<Location, 1>> locs;
+  LocationInfo locs;
   Optional<Location> currentLoc = {};
 
+  /// A constraint on a shared variable, imposed while mapping a module.
+  struct DeferredConstraint {
+    VarExpr *var;
+    Expr *rhs;
+    FieldRef info;
+    Optional<Location> loc;
+  };
+  std::vector<DeferredConstraint> deferred;
+
+  // Forbid copying or moving the set, which would invalidate the refs to the
+  // allocator held by the allocators.
+  ConstraintSet(ConstraintSet &&) = delete;
+  ConstraintSet(const ConstraintSet &) = delete;
+  ConstraintSet &operator=(ConstraintSet &&) = delete;
+  ConstraintSet &operator=(const ConstraintSet &) = delete;
+};
+
+/// A solver for width constraints. The constraint graph is split into its
+/// strongly connected components, which are solved in topological order. Only
+/// the variables of the components which contain a cycle are solved one by one,
+/// with the recursion broken at the variable being solved.
+class ConstraintSolver {
+public:
+  ConstraintSolver() = default;
+
+  /// Return the set of expressions shared across modules.
+  ConstraintSet &getSharedSet() { return shared; }
+
+  /// Create a set for the expressions of a module. The set borrows an
+  /// allocator from a pool, such that modules mapped in parallel allocate from
+  /// separate arenas. The set must be finished once the module is mapped.
+  std::unique_ptr<ConstraintSet> createModuleSet();
+
+  /// Finalize the set of a module which has been mapped, and return its
+  /// allocator to the pool.
+  void finishModuleSet(ConstraintSet &set);
+
+  /// Add the expressions of a module to the constraint problem, and impose the
+  /// constraints it deferred on the shared variables.
+  void merge(std::unique_ptr<ConstraintSet> set);
+
+  void dumpConstraints(llvm::raw_ostream &os);
+  LogicalResult solve();
+
+  /// Statistics of the last call to `solve`.
+  unsigned getNumVariables() const { return numVariables; }
+  unsigned getNumCyclicSCCs() const { return numCyclicSCCs; }
+  unsigned getNumCycleVariables() const { return numCycleVariables; }
+
+private:
+  // Allocator for the shared constraint expressions.
+  llvm::BumpPtrAllocator allocator;
+  ConstraintSet shared = {allocator, /*shared=*/true};
+
+  /// The sets of the modules, in the order they were merged.
+  std::vector<std::unique_ptr<ConstraintSet>> moduleSets;
+
+  /// The allocators of the module sets. Every module set borrows one of the
+  /// allocators while it is being mapped, such that there are not more
+  /// allocators than modules mapped concurrently.
+  std::mutex allocatorMutex;
+  std::vector<std::unique_ptr<llvm::BumpPtrAllocator>> allocators;
+  SmallVector<llvm::BumpPtrAllocator *> freeAllocators;
+
+  /// A list of the expressions of all sets, shared ones first.
+  std::vector<Expr *> exprs;
+  RootExpr root = {exprs};
+
+  /// The index of every expression in the list above.
+  DenseMap<Expr *, unsigned> exprIndices;
+
+  /// The index of the strongly connected component of every expression.
+  DenseMap<Expr *, unsigned> sccIndices;
+
+  /// The inequalities of the expressions, as computed by `checkCycles` when
+  /// entered from a different component.
+  DenseMap<Expr *, LinIneq> sccIneqs;
+  unsigned currentSCC = 0;
+
+  unsigned numVariables = 0;
+  unsigned numCyclicSCCs = 0;
+  unsigned numCycleVariables = 0;
+
   // Forbid copyign or moving the solver, which would invalidate the refs to
   // allocator held by the allocators.
   ConstraintSolver(ConstraintSolver &&) = delete;
@@ -657,6 +775,13 @@ private:
   ConstraintSolver &operator=(ConstraintSolver &&) = delete;
   ConstraintSolver &operator=(const ConstraintSolver &) = delete;
 
+  /// Return the values and locations which lead to an expression, held by
+  /// the set which allocated it.
+  ArrayRef<FieldRef> getContextInfo(Expr *expr);
+  ArrayRef<Location> getLocations(Expr *expr);
+
+  void solveCycle(ArrayRef<Expr *> scc, SmallPtrSetImpl<Expr *> &seenVars);
+
   bool emitUninferredWidthError(VarExpr *var);
 
   LinIneq checkCycles(VarExpr *var, Expr *expr,
@@ -679,6 +804,59 @@ void ConstraintSolver::dumpConstraints(llvm::raw_ostream &os) {
   }
 }
 
+std::unique_ptr<ConstraintSet> ConstraintSolver::createModuleSet() {
+  llvm::BumpPtrAllocator *moduleAllocator;
+  {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    if (freeAllocators.empty()) {
+      allocators.push_back(std::make_unique<llvm::BumpPtrAllocator>());
+      freeAllocators.push_back(allocators.back().get());
+    }
+    moduleAllocator = freeAllocators.pop_back_val();
+  }
+  return std::make_unique<ConstraintSet>(*moduleAllocator, /*shared=*/false);
+}
+
+void ConstraintSolver::finishModuleSet(ConstraintSet &set) {
+  set.finalize();
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  freeAllocators.push_back(&set.allocator);
+}
+
+void ConstraintSolver::merge(std::unique_ptr<ConstraintSet> set) {
+  for (auto &constraint : set->deferred) {
+    shared.setCurrentContextInfo(constraint.info);
+    shared.setCurrentLocation(constraint.loc);
+    shared.addGeqConstraint(constraint.var, constraint.rhs);
+  }
+  set->deferred.clear();
+  moduleSets.push_back(std::move(set));
+}
+
+ArrayRef<FieldRef> ConstraintSolver::getContextInfo(Expr *expr) {
+  auto it = shared.info.find(expr);
+  if (it != shared.info.end())
+    return it->second.getArrayRef();
+  for (auto &set : moduleSets) {
+    auto it = set->info.find(expr);
+    if (it != set->info.end())
+      return it->second.getArrayRef();
+  }
+  return {};
+}
+
+ArrayRef<Location> ConstraintSolver::getLocations(Expr *expr) {
+  auto it = shared.locs.find(expr);
+  if (it != shared.locs.end())
+    return it->second.getArrayRef();
+  for (auto &set : moduleSets) {
+    auto it = set->locs.find(expr);
+    if (it != set->locs.end())
+      return it->second.getArrayRef();
+  }
+  return {};
+}
+
 #ifndef NDEBUG
 inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const LinIneq &l) {
   l.print(os);
@@ -700,6 +878,19 @@ LinIneq ConstraintSolver::checkCycles(VarExpr *var, Expr *expr,
                                       SmallPtrSetImpl<Expr *> &seenVars,
                                       InFlightDiagnostic *reportInto,
                                       unsigned indent) {
+  // An expression in a different component than the expression it is reached
+  // from cannot lead back to `var` or to any of the variables on the path to
+  // it. Its inequality is therefore the same for all variables, and cached.
+  unsigned scc = sccIndices.lookup(expr);
+  bool cacheable = !reportInto && scc != currentSCC;
+  if (cacheable) {
+    auto it = sccIneqs.find(expr);
+    if (it != sccIneqs.end())
+      return it->second;
+  }
+  auto parentSCC = currentSCC;
+  currentSCC = scc;
+
   auto ineq =
       TypeSwitch<Expr *, LinIneq>(expr)
           .Case<KnownExpr>([&](auto *expr) { return LinIneq(*expr->solution); })
@@ -752,6 +943,7 @@ LinIneq ConstraintSolver::checkCycles(VarExpr *var, Expr *expr,
                             indent + 1));
           })
           .Default([](auto) { return LinIneq::unsat(); });
+  currentSCC = parentSCC;
 
   // If we were passed an in-flight diagnostic and the current inequality is
   // unsatisfiable, attach notes to the diagnostic indicating the values or
@@ -771,15 +963,15 @@ LinIneq ConstraintSolver::checkCycles(VarExpr *var, Expr *expr,
         note << "+" << ineq.rec_bias;
       note << " here:";
     };
-    auto it = locs.find(expr);
-    if (it != locs.end())
-      for (auto loc : it->second)
-        report(loc);
+    for (auto loc : getLocations(expr))
+      report(loc);
   }
   if (!reportInto)
     LLVM_DEBUG(llvm::dbgs().indent(indent * 2)
                << "- Visited " << *expr << ": " << ineq << "\n");
 
+  if (cacheable)
+    sccIneqs.insert({expr, ineq});
   return ineq;
 }
 
@@ -900,15 +1092,119 @@ static ExprSolution solveExpr(Expr *expr, SmallPtrSetImpl<Expr *> &seenVars,
   return solution;
 }
 
-/// Solve the constraint problem. This is a very simple implementation that
-/// does not fully solve the problem if there are weird dependency cycles
-/// present.
+/// Compute the value of an expression from the solutions of its operands,
+/// which must already be known. Operands without a solution are treated as in
+/// `solveExpr`.
+static Optional<int32_t> evaluateExpr(Expr *expr) {
+  auto operand = [](Expr *arg) { return ExprSolution{arg->solution, false}; };
+  return TypeSwitch<Expr *, ExprSolution>(expr)
+      .Case<KnownExpr>(
+          [&](auto *expr) { return ExprSolution{*expr->solution, false}; })
+      .Case<VarExpr>([&](auto *expr) {
+        // Unconstrained variables produce no solution.
+        if (!expr->constraint)
+          return ExprSolution{llvm::None, false};
+        // Constrain variables >= 0.
+        auto solution = operand(expr->constraint);
+        if (solution.first && *solution.first < 0)
+          solution.first = 0;
+        return solution;
+      })
+      .Case<IdExpr>([&](auto *expr) { return operand(expr->arg); })
+      .Case<PowExpr>([&](auto *expr) {
+        return computeUnary(operand(expr->arg),
+                            [](int32_t arg) { return 1 << arg; });
+      })
+      .Case<AddExpr>([&](auto *expr) {
+        return computeBinary(
+            operand(expr->lhs()), operand(expr->rhs()),
+            [](int32_t lhs, int32_t rhs) { return lhs + rhs; });
+      })
+      .Case<MaxExpr>([&](auto *expr) {
+        return computeBinary(
+            operand(expr->lhs()), operand(expr->rhs()),
+            [](int32_t lhs, int32_t rhs) { return std::max(lhs, rhs); });
+      })
+      .Case<MinExpr>([&](auto *expr) {
+        return computeBinary(
+            operand(expr->lhs()), operand(expr->rhs()),
+            [](int32_t lhs, int32_t rhs) { return std::min(lhs, rhs); });
+      })
+      .Default([](auto) { return ExprSolution{llvm::None, false}; })
+      .first;
+}
+
+/// Solve the expressions of a component which contains a cycle. Every variable
+/// is solved with `solveExpr`, with the recursion broken at the variable
+/// itself, in the order the variables were created. A variable solved this way
+/// is memoized for the variables after it, e.g. `x >= max(y, 2)` with
+/// `y >= min(x, 10)` gives `x = 10` and then `y = 10`. The other expressions
+/// of the component are then computed from the variables.
+void ConstraintSolver::solveCycle(ArrayRef<Expr *> scc,
+                                  SmallPtrSetImpl<Expr *> &seenVars) {
+  SmallVector<VarExpr *> vars;
+  for (auto *expr : scc)
+    if (auto *var = dyn_cast<VarExpr>(expr))
+      vars.push_back(var);
+  llvm::sort(vars, [&](VarExpr *a, VarExpr *b) {
+    return exprIndices.lookup(a) < exprIndices.lookup(b);
+  });
+  numCycleVariables += vars.size();
+
+  for (auto *var : vars) {
+    if (!var->constraint)
+      continue;
+    seenVars.insert(var);
+    auto solution = solveExpr(var->constraint, seenVars);
+    seenVars.clear();
+    if (solution.first && *solution.first < 0)
+      solution.first = 0;
+    var->solution = solution.first;
+  }
+
+  // Every cycle goes through a variable, so the other expressions are computed
+  // from the memoized variables without breaking any cycle.
+  for (auto *expr : scc)
+    if (!isa<VarExpr, KnownExpr>(expr) && !expr->solution)
+      expr->solution = solveExpr(expr, seenVars).first;
+}
+
+/// Solve the constraint problem. The expressions are grouped into their
+/// strongly connected components, which are solved such that every expression
+/// is solved after the expressions it depends on. Expressions outside of cycles
+/// are computed once from their operands, and the variables of the components
+/// with cycles are solved one by one.
 LogicalResult ConstraintSolver::solve() {
+  // Gather the expressions of all sets, in the order of the modules, such that
+  // the diagnostics are reported in the order of the IR.
+  exprs.assign(shared.exprs.begin(), shared.exprs.end());
+  for (auto &set : moduleSets)
+    exprs.insert(exprs.end(), set->exprs.begin(), set->exprs.end());
+  for (auto [index, expr] : llvm::enumerate(exprs))
+    exprIndices[expr] = index;
+
   LLVM_DEBUG({
     llvm::dbgs() << "\n===----- Constraints -----===\n\n";
     dumpConstraints(llvm::dbgs());
   });
 
+  // Compute the strongly connected components of the expressions. They are
+  // visited in post order, such that every component comes after the
+  // components it depends on. The last component only holds the root.
+  SmallVector<std::vector<Expr *>> sccs;
+  SmallVector<bool> sccHasCycle;
+  for (auto it = llvm::scc_begin<Expr *>(&root); !it.isAtEnd(); ++it) {
+    const std::vector<Expr *> &scc = *it;
+    if (isa<RootExpr>(scc.front()))
+      continue;
+    for (auto *expr : scc)
+      sccIndices[expr] = sccs.size() + 1;
+    sccs.push_back(scc);
+    sccHasCycle.push_back(it.hasCycle());
+  }
+  numVariables = llvm::count_if(exprs, [](Expr *e) { return isa<VarExpr>(e); });
+  numCyclicSCCs = llvm::count(sccHasCycle, true);
+
   // Ensure that there are no adverse cycles around.
   LLVM_DEBUG(
       llvm::dbgs() << "\n===----- Checking for unbreakable loops -----===\n\n");
@@ -927,14 +1223,11 @@ LogicalResult ConstraintSolver::solve() {
     // us to easily determine if any recursion leads to an unsatisfiable
     // constraint. The `seenVars` set acts as a recursion breaker.
     seenVars.insert(var);
+    currentSCC = sccIndices.lookup(var);
     auto ineq = checkCycles(var, var->constraint, seenVars);
     seenVars.clear();
 
     // If the constraint is satisfiable, we're done.
-    // TODO: It's possible that this result is already sufficient to arrive at a
-    // solution for the constraint, and the second pass further down is not
-    // necessary. This would require more proper handling of `MinExpr` in the
-    // cycle checking code.
     if (ineq.sat()) {
       LLVM_DEBUG(llvm::dbgs()
                  << "  = Breakable since " << ineq << " satisfiable\n");
@@ -948,7 +1241,7 @@ LogicalResult ConstraintSolver::solve() {
     LLVM_DEBUG(llvm::dbgs()
                << "  = UNBREAKABLE since " << ineq << " unsatisfiable\n");
     anyFailed = true;
-    for (auto fieldRef : info.find(var)->second) {
+    for (auto fieldRef : getContextInfo(var)) {
       // Depending on whether this value stems from an operation or not, create
       // an appropriate diagnostic identifying the value.
       auto op = fieldRef.getDefiningOp();
@@ -959,55 +1252,51 @@ LogicalResult ConstraintSolver::solve() {
 
       // Re-run the cycle checking, but this time reporting into the diagnostic.
       seenVars.insert(var);
+      currentSCC = sccIndices.lookup(var);
       checkCycles(var, var->constraint, seenVars, &diag);
       seenVars.clear();
     }
   }
+  sccIneqs.clear();
 
   // If there were cycles, return now to avoid complaining to the user about
   // dependent widths not being inferred.
   if (anyFailed)
     return failure();
 
-  // Iterate over the constraint variables and solve each.
+  // Solve the components in order.
   LLVM_DEBUG(llvm::dbgs() << "\n===----- Solving constraints -----===\n\n");
+  for (unsigned i = 0, e = sccs.size(); i != e; ++i) {
+    if (!sccHasCycle[i]) {
+      auto *expr = sccs[i].front();
+      if (!isa<KnownExpr>(expr))
+        expr->solution = evaluateExpr(expr);
+      continue;
+    }
+    solveCycle(sccs[i], seenVars);
+  }
+
+  // Complain about the variables which could not be inferred. This might be
+  // the case if the width depends on an unconstrained variable.
   for (auto *expr : exprs) {
-    // Only work on variables.
     auto *var = dyn_cast<VarExpr>(expr);
     if (!var)
       continue;
-
-    // Complain about unconstrained variables.
     if (!var->constraint) {
       LLVM_DEBUG(llvm::dbgs() << "- Unconstrained " << *var << "\n");
       if (emitUninferredWidthError(var))
         anyFailed = true;
       continue;
     }
-
-    // Compute the value for the variable.
-    LLVM_DEBUG(llvm::dbgs()
-               << "- Solving " << *var << " >= " << *var->constraint << "\n");
-    seenVars.insert(var);
-    auto solution = solveExpr(var->constraint, seenVars);
-    seenVars.clear();
-
-    // Constrain variables >= 0.
-    if (solution.first && *solution.first < 0)
-      solution.first = 0;
-
-    // In case the width could not be inferred, complain to the user. This might
-    // be the case if the width depends on an unconstrained variable.
-    if (!solution.first) {
+    if (!var->solution) {
       LLVM_DEBUG(llvm::dbgs() << "  - UNSOLVED " << *var << "\n");
       if (emitUninferredWidthError(var))
         anyFailed = true;
-    } else {
-      LLVM_DEBUG(llvm::dbgs()
-                 << "  - Solved " << *var << " = " << solution.first << " ("
-                 << (solution.second ? "cycle broken" : "unique") << ")\n");
+      continue;
     }
-    var->solution = solution.first;
+    LLVM_DEBUG(llvm::dbgs() << "  - Solved " << *var << " >= "
+                            << *var->constraint << " = " << *var->solution
+                            << "\n");
   }
 
   return failure(anyFailed);
@@ -1016,7 +1305,7 @@ LogicalResult ConstraintSolver::solve() {
 // Emits the diagnostic to inform the user about an uninferred width in the
 // design. Returns true if an error was reported, false otherwise.
 bool ConstraintSolver::emitUninferredWidthError(VarExpr *var) {
-  FieldRef fieldRef = info.find(var)->second.back();
+  FieldRef fieldRef = getContextInfo(var).back();
   Value value = fieldRef.getValue();
 
   auto diag = mlir::emitError(value.getLoc(), "uninferred width:");
@@ -1048,7 +1337,7 @@ bool ConstraintSolver::emitUninferredWidthError(VarExpr *var) {
   } else {
     diag << " width cannot be determined";
     LLVM_DEBUG(llvm::dbgs() << *var->constraint << "\n");
-    auto loc = locs.find(var->constraint)->second.back();
+    auto loc = getLocations(var->constraint).back();
     diag.attachNote(loc) << "width is constrained by an uninferred width here:";
   }
 
@@ -1061,14 +1350,20 @@ bool ConstraintSolver::emitUninferredWidthError(VarExpr *var) {
 
 namespace {
 
+struct ModuleMapping;
+
 /// A helper class which maps the types and operations in a design to a set of
-/// variables and constraints to be solved later.
+/// variables and constraints to be solved later. The mapping of the circuit
+/// holds the variables of the module ports, and every module body is mapped
+/// by a mapping of its own, which looks up the ports in the former.
 class InferenceMapping {
 public:
-  InferenceMapping(ConstraintSolver &solver, SymbolTable &symtbl)
-      : solver(solver), symtbl(symtbl) {}
+  InferenceMapping(ConstraintSet &constraints, SymbolTable &symtbl,
+                   InferenceMapping *portMapping = nullptr)
+      : constraints(constraints), symtbl(symtbl), portMapping(portMapping) {}
 
-  LogicalResult map(CircuitOp op);
+  LogicalResult map(ModuleParallelDriver<ModuleMapping> &driver,
+                    ConstraintSolver &solver);
   LogicalResult mapOperation(Operation *op);
 
   /// Declare all the variables in the value. If the value is a ground type,
@@ -1119,25 +1414,31 @@ public:
   /// Set the expr associated with a specific field in a value.
   void setExpr(FieldRef fieldRef, Expr *expr);
 
-  /// Return whether a module was skipped due to being fully inferred already.
-  bool isModuleSkipped(ModuleOp module) { return skippedModules.count(module); }
-
   /// Return whether all modules in the mapping were fully inferred.
   bool areAllModulesSkipped() { return allModulesSkipped; }
 
 private:
-  /// The constraint solver into which we emit variables and constraints.
-  ConstraintSolver &solver;
+  /// The constraint set into which we emit variables and constraints.
+  ConstraintSet &constraints;
 
   /// The constraint exprs for each result type of an operation.
   DenseMap<FieldRef, Expr *> opExprs;
 
-  /// The fully inferred modules that were skipped entirely.
-  SmallPtrSet<Operation *, 16> skippedModules;
   bool allModulesSkipped = true;
 
   /// Cache of module symbols
   SymbolTable &symtbl;
+
+  /// The mapping of the module ports, if this maps a module body.
+  InferenceMapping *portMapping;
+};
+
+/// The mapping of a module body. Modules which are already fully inferred are
+/// skipped, and have none.
+struct ModuleMapping {
+  std::unique_ptr<InferenceMapping> mapping;
+  /// The constraints of the module, until they are merged into the solver.
+  std::unique_ptr<ConstraintSet> set;
 };
 
 } // namespace
@@ -1149,53 +1450,67 @@ static bool hasUninferredWidth(Type type) {
   return false;
 }
 
-LogicalResult InferenceMapping::map(CircuitOp op) {
+/// Check if a module contains *any* uninferred widths.
+static bool hasUninferredWidth(FModuleOp module) {
+  for (auto arg : module.getArguments())
+    if (hasUninferredWidth(arg.getType()))
+      return true;
+  auto result = module.walk([&](Operation *op) {
+    for (auto type : op->getResultTypes())
+      if (hasUninferredWidth(type))
+        return WalkResult::interrupt();
+    return WalkResult::advance();
+  });
+  return result.wasInterrupted();
+}
+
+LogicalResult
+InferenceMapping::map(ModuleParallelDriver<ModuleMapping> &driver,
+                      ConstraintSolver &solver) {
   LLVM_DEBUG(llvm::dbgs()
              << "\n===----- Mapping ops to constraint exprs -----===\n\n");
 
   // Ensure we have constraint variables established for all module ports.
-  op.walk<WalkOrder::PostOrder>([&](FModuleOp module) {
+  for (auto module : driver.getModules()) {
     for (auto arg : module.getArguments()) {
-      solver.setCurrentContextInfo(FieldRef(arg, 0));
+      constraints.setCurrentContextInfo(FieldRef(arg, 0));
       declareVars(arg, module.getLoc());
     }
-    return WalkResult::skip(); // no need to look inside the module
-  });
+  }
 
-  // Go through the module bodies and populate the constraint problem.
-  auto result = op.walk<WalkOrder::PostOrder>([&](FModuleOp module) {
-    // Check if the module contains *any* uninferred widths. This allows us to
-    // do an early skip if the module is already fully inferred.
-    bool anyUninferred = false;
-    for (auto arg : module.getArguments()) {
-      anyUninferred |= hasUninferredWidth(arg.getType());
-      if (anyUninferred)
-        break;
-    }
-    module.walk([&](Operation *op) {
-      for (auto type : op->getResultTypes())
-        anyUninferred |= hasUninferredWidth(type);
-      if (anyUninferred)
-        return WalkResult::interrupt();
-      return WalkResult::advance();
-    });
-    if (!anyUninferred) {
+  // Go through the module bodies in parallel, mapping each into a constraint
+  // set of its own. Check if the module contains *any* uninferred widths
+  // first, which allows us to do an early skip if the module is already fully
+  // inferred.
+  auto result = driver.summarize([&](FModuleOp module, ModuleMapping &summary) {
+    if (!hasUninferredWidth(module)) {
       LLVM_DEBUG(llvm::dbgs() << "Skipping fully-inferred module '"
                               << module.getName() << "'\n");
-      skippedModules.insert(module);
-      return WalkResult::skip();
+      return success();
     }
-    allModulesSkipped = false;
 
     // Go through operations in the module, creating type variables for results,
     // and generating constraints.
-    auto result = module.getBody()->walk(
-        [&](Operation *op) { return WalkResult(mapOperation(op)); });
-    if (result.wasInterrupted())
-      return WalkResult::interrupt();
-    return WalkResult::skip(); // walk above already visited module body
+    auto set = solver.createModuleSet();
+    summary.mapping = std::make_unique<InferenceMapping>(*set, symtbl, this);
+    auto result = module.getBody()->walk([&](Operation *op) {
+      return WalkResult(summary.mapping->mapOperation(op));
+    });
+    solver.finishModuleSet(*set);
+    summary.set = std::move(set);
+    return failure(result.wasInterrupted());
+  });
+  if (failed(result))
+    return failure();
+
+  // Merge the constraints of the modules into the problem, in order.
+  return driver.solve([&](FModuleOp module, ModuleMapping &summary) {
+    if (summary.mapping) {
+      allModulesSkipped = false;
+      solver.merge(std::move(summary.set));
+    }
+    return success();
   });
-  return failure(result.wasInterrupted());
 }
 
 LogicalResult InferenceMapping::mapOperation(Operation *op) {
@@ -1219,23 +1534,23 @@ LogicalResult InferenceMapping::mapOperation(Operation *op) {
 
   // Actually generate the necessary constraint expressions.
   bool mappingFailed = false;
-  solver.setCurrentContextInfo(
+  constraints.setCurrentContextInfo(
       op->getNumResults() > 0 ? FieldRef(op->getResults()[0], 0) : FieldRef());
-  solver.setCurrentLocation(op->getLoc());
+  constraints.setCurrentLocation(op->getLoc());
   TypeSwitch<Operation *>(op)
       .Case<ConstantOp>([&](auto op) {
         // If the constant has a known width, use that. Otherwise pick the
         // smallest number of bits necessary to represent the constant.
         Expr *e;
         if (auto width = op.getType().getWidth())
-          e = solver.known(*width);
+          e = constraints.known(*width);
         else {
           auto v = op.value();
           auto w = v.getBitWidth() - (v.isNegative() ? v.countLeadingOnes()
                                                      : v.countLeadingZeros());
           if (v.isSigned())
             w += 1;
-          e = solver.known(std::max(w, 1u));
+          e = constraints.known(std::max(w, 1u));
         }
         setExpr(op.getResult(), e);
       })
@@ -1294,20 +1609,21 @@ LogicalResult InferenceMapping::mapOperation(Operation *op) {
       .Case<AddPrimOp, SubPrimOp>([&](auto op) {
         auto lhs = getExpr(op.lhs());
         auto rhs = getExpr(op.rhs());
-        auto e = solver.add(solver.max(lhs, rhs), solver.known(1));
+        auto e =
+            constraints.add(constraints.max(lhs, rhs), constraints.known(1));
         setExpr(op.getResult(), e);
       })
       .Case<MulPrimOp>([&](auto op) {
         auto lhs = getExpr(op.lhs());
         auto rhs = getExpr(op.rhs());
-        auto e = solver.add(lhs, rhs);
+        auto e = constraints.add(lhs, rhs);
         setExpr(op.getResult(), e);
       })
       .Case<DivPrimOp>([&](auto op) {
         auto lhs = getExpr(op.lhs());
         Expr *e;
         if (op.getType().isSigned()) {
-          e = solver.add(lhs, solver.known(1));
+          e = constraints.add(lhs, constraints.known(1));
         } else {
           e = lhs;
         }
@@ -1316,13 +1632,13 @@ LogicalResult InferenceMapping::mapOperation(Operation *op) {
       .Case<RemPrimOp>([&](auto op) {
         auto lhs = getExpr(op.lhs());
         auto rhs = getExpr(op.rhs());
-        auto e = solver.min(lhs, rhs);
+        auto e = constraints.min(lhs, rhs);
         setExpr(op.getResult(), e);
       })
       .Case<AndPrimOp, OrPrimOp, XorPrimOp>([&](auto op) {
         auto lhs = getExpr(op.lhs());
         auto rhs = getExpr(op.rhs());
-        auto e = solver.max(lhs, rhs);
+        auto e = constraints.max(lhs, rhs);
         setExpr(op.getResult(), e);
       })
 
@@ -1330,13 +1646,14 @@ LogicalResult InferenceMapping::mapOperation(Operation *op) {
       .Case<CatPrimOp>([&](auto op) {
         auto lhs = getExpr(op.lhs());
         auto rhs = getExpr(op.rhs());
-        auto e = solver.add(lhs, rhs);
+        auto e = constraints.add(lhs, rhs);
         setExpr(op.getResult(), e);
       })
       .Case<DShlPrimOp>([&](auto op) {
         auto lhs = getExpr(op.lhs());
         auto rhs = getExpr(op.rhs());
-        auto e = solver.add(lhs, solver.add(solver.pow(rhs), solver.known(-1)));
+        auto e = constraints.add(
+            lhs, constraints.add(constraints.pow(rhs), constraints.known(-1)));
         setExpr(op.getResult(), e);
       })
       .Case<DShlwPrimOp, DShrPrimOp>([&](auto op) {
@@ -1347,42 +1664,44 @@ LogicalResult InferenceMapping::mapOperation(Operation *op) {
       // Unary operators
       .Case<NegPrimOp>([&](auto op) {
         auto input = getExpr(op.input());
-        auto e = solver.add(input, solver.known(1));
+        auto e = constraints.add(input, constraints.known(1));
         setExpr(op.getResult(), e);
       })
       .Case<CvtPrimOp>([&](auto op) {
         auto input = getExpr(op.input());
         auto e = op.input().getType().template cast<IntType>().isSigned()
                      ? input
-                     : solver.add(input, solver.known(1));
+                     : constraints.add(input, constraints.known(1));
         setExpr(op.getResult(), e);
       })
 
       // Miscellaneous
       .Case<BitsPrimOp>([&](auto op) {
-        setExpr(op.getResult(), solver.known(op.hi() - op.lo() + 1));
+        setExpr(op.getResult(), constraints.known(op.hi() - op.lo() + 1));
+      })
+      .Case<HeadPrimOp>([&](auto op) {
+        setExpr(op.getResult(), constraints.known(op.amount()));
       })
-      .Case<HeadPrimOp>(
-          [&](auto op) { setExpr(op.getResult(), solver.known(op.amount())); })
       .Case<TailPrimOp>([&](auto op) {
         auto input = getExpr(op.input());
-        auto e = solver.add(input, solver.known(-op.amount()));
+        auto e = constraints.add(input, constraints.known(-op.amount()));
         setExpr(op.getResult(), e);
       })
       .Case<PadPrimOp>([&](auto op) {
         auto input = getExpr(op.input());
-        auto e = solver.max(input, solver.known(op.amount()));
+        auto e = constraints.max(input, constraints.known(op.amount()));
         setExpr(op.getResult(), e);
       })
       .Case<ShlPrimOp>([&](auto op) {
         auto input = getExpr(op.input());
-        auto e = solver.add(input, solver.known(op.amount()));
+        auto e = constraints.add(input, constraints.known(op.amount()));
         setExpr(op.getResult(), e);
       })
       .Case<ShrPrimOp>([&](auto op) {
         auto input = getExpr(op.input());
-        auto e = solver.max(solver.add(input, solver.known(-op.amount())),
-                            solver.known(1));
+        auto e = constraints.max(
+            constraints.add(input, constraints.known(-op.amount())),
+            constraints.known(1));
         setExpr(op.getResult(), e);
       })
 
@@ -1399,12 +1718,12 @@ LogicalResult InferenceMapping::mapOperation(Operation *op) {
             XorRPrimOp>([&](auto op) {
         auto width = op.getType().getBitWidthOrSentinel();
         assert(width > 0 && "width should have been checked by verifier");
-        setExpr(op.getResult(), solver.known(width));
+        setExpr(op.getResult(), constraints.known(width));
       })
 
       .Case<MuxPrimOp>([&](auto op) {
         auto sel = getExpr(op.sel());
-        constrainTypes(sel, solver.known(1));
+        constrainTypes(sel, constraints.known(1));
         maximumOfTypes(op.getResult(), op.high(), op.low());
       })
 
@@ -1525,13 +1844,13 @@ void InferenceMapping::declareVars(Value value, Location loc) {
     auto width = type.getBitWidthOrSentinel();
     if (width >= 0) {
       // Known width integer create a known expression.
-      setExpr(FieldRef(value, fieldID), solver.known(width));
+      setExpr(FieldRef(value, fieldID), constraints.known(width));
       fieldID++;
     } else if (width == -1) {
       // Unknown width integers create a variable.
       FieldRef field(value, fieldID);
-      solver.setCurrentContextInfo(field);
-      setExpr(field, solver.var());
+      constraints.setCurrentContextInfo(field);
+      setExpr(field, constraints.var());
       fieldID++;
     } else if (auto bundleType = type.dyn_cast<BundleType>()) {
       // Bundle types recursively declare all bundle elements.
@@ -1571,8 +1890,8 @@ void InferenceMapping::maximumOfTypes(Value result, Value rhs, Value lhs) {
         maximize(vecType.getElementType());
       fieldID = save + vecType.getMaxFieldID();
     } else if (type.isGround()) {
-      auto *e = solver.max(getExpr(FieldRef(rhs, fieldID)),
-                           getExpr(FieldRef(lhs, fieldID)));
+      auto *e = constraints.max(getExpr(FieldRef(rhs, fieldID)),
+                                getExpr(FieldRef(lhs, fieldID)));
       setExpr(FieldRef(result, fieldID), e);
       fieldID++;
     } else {
@@ -1635,7 +1954,8 @@ void InferenceMapping::constrainTypes(Expr *larger, Expr *smaller) {
   // long as we don't want to do type checking itself here, but only width
   // inference, we should be fine ignoring expr we cannot constraint anyway.
   if (auto largerVar = dyn_cast<VarExpr>(larger)) {
-    LLVM_ATTRIBUTE_UNUSED auto c = solver.addGeqConstraint(largerVar, smaller);
+    LLVM_ATTRIBUTE_UNUSED auto c =
+        constraints.addGeqConstraint(largerVar, smaller);
     LLVM_DEBUG(llvm::dbgs()
                << "Constrained " << *largerVar << " >= " << *c << "\n");
   }
@@ -1660,7 +1980,7 @@ void InferenceMapping::unifyTypes(FieldRef lhs, FieldRef rhs, FIRRTLType type) {
                               << getFieldName(rhsFieldRef) << "\n");
       // Abandon variables becoming unconstrainable by the unification.
       if (auto *var = dyn_cast_or_null<VarExpr>(getExprOrNull(lhsFieldRef)))
-        solver.addGeqConstraint(var, solver.known(0));
+        constraints.addGeqConstraint(var, constraints.known(0));
       setExpr(lhsFieldRef, getExpr(rhsFieldRef));
       fieldID++;
     } else if (auto bundleType = type.dyn_cast<BundleType>()) {
@@ -1699,7 +2019,9 @@ Expr *InferenceMapping::getExpr(FieldRef fieldRef) {
 
 Expr *InferenceMapping::getExprOrNull(FieldRef fieldRef) {
   auto it = opExprs.find(fieldRef);
-  return it != opExprs.end() ? it->second : nullptr;
+  if (it != opExprs.end())
+    return it->second;
+  return portMapping ? portMapping->getExprOrNull(fieldRef) : nullptr;
 }
 
 /// Associate a constraint expression with a value.
@@ -1731,7 +2053,7 @@ class InferenceTypeUpdate {
 public:
   InferenceTypeUpdate(InferenceMapping &mapping) : mapping(mapping) {}
 
-  LogicalResult update(CircuitOp op);
+  LogicalResult update(FModuleOp module);
   bool updateOperation(Operation *op);
   bool updateValue(Value value);
   FIRRTLType updateType(FieldRef fieldRef, FIRRTLType type);
@@ -1743,16 +2065,10 @@ private:
 
 } // namespace
 
-/// Update the types throughout a circuit.
-LogicalResult InferenceTypeUpdate::update(CircuitOp op) {
-  LLVM_DEBUG(llvm::dbgs() << "\n===----- Update types -----===\n\n");
+/// Update the types throughout a module, including its ports.
+LogicalResult InferenceTypeUpdate::update(FModuleOp module) {
   anyFailed = false;
-  op.walk<WalkOrder::PreOrder>([&](Operation *op) {
-    // Skip this module if it had no widths to be inferred at all.
-    if (auto module = dyn_cast<ModuleOp>(op))
-      if (mapping.isModuleSkipped(module))
-        return WalkResult::skip();
-
+  module.walk<WalkOrder::PreOrder>([&](Operation *op) {
     updateOperation(op);
     return WalkResult(failure(anyFailed));
   });
@@ -2001,12 +2317,24 @@ class InferWidthsPass : public InferWidthsBase<InferWidthsPass> {
 };
 } // namespace
 
+/// Return the number of microseconds since a point in time.
+static unsigned getMicrosecondsSince(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - t)
+      .count();
+}
+
 void InferWidthsPass::runOnOperation() {
   // Collect variables and constraints
+  auto start = std::chrono::steady_clock::now();
   ConstraintSolver solver;
   SymbolTable symtbl(getOperation());
-  InferenceMapping mapping(solver, symtbl);
-  if (failed(mapping.map(getOperation()))) {
+  InferenceMapping mapping(solver.getSharedSet(), symtbl);
+  ModuleParallelDriver<ModuleMapping> driver(getOperation(),
+                                             getAnalysis<InstanceGraph>());
+  auto mapped = mapping.map(driver, solver);
+  mapTime = getMicrosecondsSince(start);
+  if (failed(mapped)) {
     signalPassFailure();
     return;
   }
@@ -2016,14 +2344,31 @@ void InferWidthsPass::runOnOperation() {
   }
 
   // Solve the constraints.
-  if (failed(solver.solve())) {
+  start = std::chrono::steady_clock::now();
+  auto solved = solver.solve();
+  solveTime = getMicrosecondsSince(start);
+  numVariables = solver.getNumVariables();
+  numCyclicSCCs = solver.getNumCyclicSCCs();
+  numCycleVariables = solver.getNumCycleVariables();
+  if (failed(solved)) {
     signalPassFailure();
     return;
   }
 
-  // Update the types with the inferred widths.
-  if (failed(InferenceTypeUpdate(mapping).update(getOperation())))
-    signalPassFailure();
+  // Update the types with the inferred widths, in parallel. The modules which
+  // were skipped only hold known widths, and are covered by the ports.
+  LLVM_DEBUG(llvm::dbgs() << "\n===----- Update types -----===\n\n");
+  start = std::chrono::steady_clock::now();
+  auto updated = driver.apply([&](FModuleOp module, ModuleMapping &summary) {
+    return InferenceTypeUpdate(summary.mapping ? *summary.mapping : mapping)
+        .update(module);
+  });
+  updateTime = getMicrosecondsSince(start);
+  if (failed(updated))
+    return signalPassFailure();
+
+  // Only the types of the modules and instances changed.
+  markAnalysesPreserved<InstanceGraph>();
 }
 
 std::unique_ptr<mlir::Pass> circt::firrtl::createInferWidthsPass() {
@@ -21,6 +21,7 @@
 #include "circt/Dialect/HW/HWAttributes.h"
 #include "circt/Support/LLVM.h"
 #include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/IR/Threading.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/SetOperations.h"
 #include "llvm/ADT/TypeSwitch.h"
@@ -379,6 +380,35 @@ static void mapResultsToWires(BlockAndValueMapping &mapper,
   }
 }
 
+/// Add a prefix to the name of an operation, if it has a "name" attribute.  We
+/// don't prefix memories since it will affect the name of the generated module.
+/// TODO: We should find a way to prefix the instance of a memory module.
+static void prefixName(StringRef prefix, Operation *op) {
+  if (isa<MemOp, SeqMemOp, CombMemOp, MemoryPortOp>(op))
+    return;
+  if (auto nameAttr = op->getAttrOfType<StringAttr>("name"))
+    op->setAttr("name", StringAttr::get(op->getContext(),
+                                        (prefix + nameAttr.getValue())));
+}
+
+/// Add a prefix to the name of an operation and of the operations nested in
+/// it.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void prefixNames(StringRef prefix, Operation *op) {
+  prefixName(prefix, op);
+  for (auto &region : op->getRegions())
+    for (auto &block : region)
+      for (auto &op : block)
+        prefixNames(prefix, &op);
+}
+
+/// Returns true if any of the annotations is non-local.
+static bool hasNonLocal(const AnnotationSet &annotations) {
+  return llvm::any_of(annotations, [](Annotation anno) {
+    return anno.getMember("circt.nonlocal");
+  });
+}
+
 //===----------------------------------------------------------------------===//
 // Inliner
 //===----------------------------------------------------------------------===//
@@ -401,6 +431,16 @@ static void mapResultsToWires(BlockAndValueMapping &mapper,
 /// attribute once. This means that we will not create any intermediate name
 /// attributes (which will be interned by the compiler), and helps keep down the
 /// total memory usage.
+///
+/// Flattening a module whose hierarchy has no inner symbols, no port symbols,
+/// no non-local annotations and no NLA roots does not involve any NLA, and only
+/// modifies the flattened module.  Such modules are flattened after the
+/// worklist is processed, in parallel, one level of the instance hierarchy at a
+/// time and starting with the lowest level.  Every module they instantiate is
+/// flattened once, in place if it is itself marked for flattening and in a
+/// detached scratch block otherwise, and each instance is replaced with a copy
+/// of this flattened body.  The modules whose hierarchy may be the target of an
+/// NLA are flattened by the worklist, with `flattenInstances`.
 namespace {
 class Inliner {
 public:
@@ -462,6 +502,44 @@ private:
   /// Inline any instances in the module which were marked for inlining.
   void inlineInstances(FModuleOp module);
 
+  /// Whether a module can be flattened without updating any NLA, and its
+  /// height in the instance hierarchy.
+  struct FlattenInfo {
+    bool local = true;
+    unsigned height = 0;
+  };
+
+  /// Return the flatten info of a module, computing it if needed.
+  FlattenInfo getFlattenInfo(FModuleOp module);
+
+  /// Flatten the modules which can be flattened without updating any NLA, in
+  /// parallel.
+  void flattenLocalModules(ArrayRef<FModuleOp> modules);
+
+  /// Rewrite the ports of a module as wires, mapping the arguments of its
+  /// flattened body to them, for a module which can be flattened without
+  /// updating any NLA.
+  SmallVector<Value> mapLocalPortsToWires(StringRef prefix, OpBuilder &b,
+                                          BlockAndValueMapping &mapper,
+                                          FModuleOp target, Block *body);
+
+  /// Replace every instance of a regular module in a block with a copy of the
+  /// flattened body of the instantiated module, which must already be built.
+  /// This only modifies the block, and may run in parallel for different
+  /// blocks.
+  void flattenLocalBlock(Block &block);
+
+  /// Build the flattened body of a module which can be flattened without
+  /// updating any NLA, in a detached block whose arguments stand for the
+  /// ports.  The module itself is not modified.
+  std::unique_ptr<Block> buildFlattenedBody(FModuleOp module);
+
+  /// Flatten all instances in a module which can be flattened without updating
+  /// any NLA.  The external modules which remain instantiated are added to
+  /// `liveExtModules`.
+  void flattenLocalInstances(FModuleOp module,
+                             SmallVectorImpl<Operation *> &liveExtModules);
+
   CircuitOp circuit;
   MLIRContext *context;
 
@@ -490,6 +568,14 @@ private:
   /// from the InnerRefAttr to the list of HierPathOp names. The InnerRefAttr
   /// corresponds to the InstanceOp.
   DenseMap<InnerRefAttr, SmallVector<StringAttr>> instOpHierPaths;
+
+  /// The flatten info of the modules, computed on demand.
+  DenseMap<Operation *, FlattenInfo> flattenInfos;
+
+  /// The flattened body of the modules instantiated by the modules flattened
+  /// by `flattenLocalModules`.  This is the body of the module if it was
+  /// flattened in place, and a scratch block otherwise.
+  DenseMap<Operation *, Block *> flattenedBodies;
 };
 } // namespace
 
@@ -522,14 +608,7 @@ bool Inliner::doesNLAMatchCurrentPath(HierPathOp nla) {
 // NOLINTNEXTLINE(misc-no-recursion)
 void Inliner::rename(StringRef prefix, Operation *op,
                      ModuleNamespace &moduleNamespace) {
-  // Add a prefix to things that has a "name" attribute.  We don't prefix
-  // memories since it will affect the name of the generated module.
-  // TODO: We should find a way to prefix the instance of a memory module.
-  if (!isa<MemOp, SeqMemOp, CombMemOp, MemoryPortOp>(op)) {
-    if (auto nameAttr = op->getAttrOfType<StringAttr>("name"))
-      op->setAttr("name", StringAttr::get(op->getContext(),
-                                          (prefix + nameAttr.getValue())));
-  }
+  prefixName(prefix, op);
 
   // Record the list of HierPathOps that the original op participates in, so
   // that they can be moved to the op after renaming.
@@ -960,6 +1039,161 @@ void Inliner::inlineInstances(FModuleOp parent) {
   }
 }
 
+// NOLINTNEXTLINE(misc-no-recursion)
+Inliner::FlattenInfo Inliner::getFlattenInfo(FModuleOp module) {
+  auto it = flattenInfos.find(module);
+  if (it != flattenInfos.end())
+    return it->second;
+
+  // A module is local if none of its operations and ports may be the target of
+  // an NLA, no NLA starts at it, and the modules it instantiates are local.
+  FlattenInfo info;
+  info.local = rootMap.lookup(module.getNameAttr()).empty();
+  for (size_t i = 0, e = module.getNumPorts(); i != e && info.local; ++i)
+    info.local = module.getPortSymbol(i).empty() &&
+                 !hasNonLocal(AnnotationSet::forPort(module, i));
+  if (info.local)
+    module.walk([&](Operation *op) {
+      if (op->hasAttr("inner_sym") || hasNonLocal(AnnotationSet(op))) {
+        info.local = false;
+        return WalkResult::interrupt();
+      }
+      return WalkResult::advance();
+    });
+
+  for (auto instance : module.getBody()->getOps<InstanceOp>()) {
+    auto *targetModule = symbolTable.lookup(instance.moduleName());
+    auto target = dyn_cast<FModuleOp>(targetModule);
+    if (!target)
+      continue;
+    auto targetInfo = getFlattenInfo(target);
+    info.local &= targetInfo.local;
+    info.height = std::max(info.height, targetInfo.height + 1);
+  }
+
+  flattenInfos[module] = info;
+  return info;
+}
+
+SmallVector<Value> Inliner::mapLocalPortsToWires(StringRef prefix, OpBuilder &b,
+                                                 BlockAndValueMapping &mapper,
+                                                 FModuleOp target,
+                                                 Block *body) {
+  SmallVector<Value> wires;
+  for (unsigned i = 0, e = target.getNumPorts(); i < e; ++i) {
+    auto arg = body->getArgument(i);
+    auto wire = b.create<WireOp>(
+        target.getLoc(), arg.getType().cast<FIRRTLType>(),
+        (prefix + target.getPortName(i)).str(), NameKindEnum::InterestingName,
+        target.getAnnotationsAttrForPort(i), StringAttr());
+    wires.push_back(wire);
+    mapper.map(arg, wire.getResult());
+  }
+  return wires;
+}
+
+void Inliner::flattenLocalBlock(Block &block) {
+  SmallString<64> prefix;
+  for (auto &op : llvm::make_early_inc_range(block)) {
+    // If its not an instance of a regular module, leave it as is.
+    auto instance = dyn_cast<InstanceOp>(op);
+    if (!instance)
+      continue;
+    auto target =
+        dyn_cast<FModuleOp>(symbolTable.lookup(instance.moduleName()));
+    if (!target)
+      continue;
+
+    // Create the wire mapping for results + ports. We RAUW the results instead
+    // of mapping them.
+    auto *body = flattenedBodies.lookup(target);
+    assert(body && "instantiated module must be flattened first");
+    BlockAndValueMapping mapper;
+    OpBuilder b(instance);
+    prefix = instance.name();
+    prefix += '_';
+    auto wires = mapLocalPortsToWires(prefix, b, mapper, target, body);
+    for (unsigned i = 0, e = instance.getNumResults(); i < e; ++i)
+      instance.getResult(i).replaceAllUsesWith(wires[i]);
+
+    // The annotations of a local module apply to every clone as they are.
+    for (auto &bodyOp : *body)
+      prefixNames(prefix, b.clone(bodyOp, mapper));
+    instance.erase();
+  }
+}
+
+std::unique_ptr<Block> Inliner::buildFlattenedBody(FModuleOp module) {
+  auto body = std::make_unique<Block>();
+  BlockAndValueMapping mapper;
+  for (auto arg : module.getBody()->getArguments())
+    mapper.map(arg, body->addArgument(arg.getType(), arg.getLoc()));
+  auto b = OpBuilder::atBlockEnd(body.get());
+  for (auto &op : *module.getBody())
+    b.clone(op, mapper);
+  flattenLocalBlock(*body);
+  return body;
+}
+
+void Inliner::flattenLocalInstances(
+    FModuleOp module, SmallVectorImpl<Operation *> &liveExtModules) {
+  flattenLocalBlock(*module.getBody());
+  // The remaining instances are of external modules. Mark them as live.
+  for (auto instance : module.getBody()->getOps<InstanceOp>())
+    liveExtModules.push_back(symbolTable.lookup(instance.moduleName()));
+  AnnotationSet::removeAnnotations(module,
+                                   "firrtl.transforms.FlattenAnnotation");
+}
+
+void Inliner::flattenLocalModules(ArrayRef<FModuleOp> modules) {
+  // Collect the modules to flatten and the modules they instantiate, whose
+  // flattened body is needed.  The entries of `flattenedBodies` are created
+  // up front, so that they can be filled in parallel.
+  SmallVector<FModuleOp> stack(modules.begin(), modules.end());
+  SmallVector<SmallVector<FModuleOp>> levels;
+  while (!stack.empty()) {
+    auto module = stack.pop_back_val();
+    if (!flattenedBodies.insert({module, nullptr}).second)
+      continue;
+    auto height = getFlattenInfo(module).height;
+    if (levels.size() <= height)
+      levels.resize(height + 1);
+    levels[height].push_back(module);
+    for (auto instance : module.getBody()->getOps<InstanceOp>())
+      if (auto target =
+              dyn_cast<FModuleOp>(symbolTable.lookup(instance.moduleName())))
+        stack.push_back(target);
+  }
+
+  // A module only instantiates modules of a lower height, so the modules of a
+  // level can be flattened in parallel once the levels below are.  The modules
+  // to flatten are flattened in place, and the other modules in a scratch
+  // block which is only used to flatten their instances.
+  DenseSet<Operation *> inPlace(modules.begin(), modules.end());
+  SmallVector<std::unique_ptr<Block>> scratchBodies;
+  for (auto &level : levels) {
+    SmallVector<std::unique_ptr<Block>> levelBodies(level.size());
+    SmallVector<SmallVector<Operation *>> liveExtModules(level.size());
+    mlir::parallelForEachN(context, 0, level.size(), [&](size_t i) {
+      auto module = level[i];
+      auto *body = module.getBody();
+      if (inPlace.count(module)) {
+        flattenLocalInstances(module, liveExtModules[i]);
+      } else {
+        levelBodies[i] = buildFlattenedBody(module);
+        body = levelBodies[i].get();
+      }
+      flattenedBodies.find(module)->second = body;
+    });
+    for (auto &extModules : liveExtModules)
+      liveModules.insert(extModules.begin(), extModules.end());
+    for (auto &body : levelBodies)
+      if (body)
+        scratchBodies.push_back(std::move(body));
+  }
+  flattenedBodies.clear();
+}
+
 Inliner::Inliner(CircuitOp circuit)
     : circuit(circuit), context(circuit.getContext()), symbolTable(circuit) {}
 
@@ -985,10 +1219,16 @@ void Inliner::run() {
   }
 
   // If the module is marked for flattening, flatten it. Otherwise, inline
-  // every instance marked to be inlined.
+  // every instance marked to be inlined.  The flattening of local modules is
+  // deferred until the worklist is processed.
+  SmallVector<FModuleOp> localFlattenModules;
   while (!worklist.empty()) {
     auto module = worklist.pop_back_val();
     if (shouldFlatten(module)) {
+      if (getFlattenInfo(module).local) {
+        localFlattenModules.push_back(module);
+        continue;
+      }
       flattenInstances(module);
       // Delete the flatten annotation, the transform was performed.
       // Even if visited again in our walk (for inlining),
@@ -999,6 +1239,7 @@ void Inliner::run() {
       inlineInstances(module);
     }
   }
+  flattenLocalModules(localFlattenModules);
 
   // Delete all unreferenced modules.  Mark any NLAs that originate from dead
   // modules as also dead.
@@ -0,0 +1,56 @@
+//===- HWPrintCombPaths.cpp - Print the combinational paths -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//===----------------------------------------------------------------------===//
+//
+// Print the combinational paths between the ports of modules.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassDetails.h"
+#include "circt/Analysis/CombPathsAnalysis.h"
+#include "circt/Dialect/HW/HWPasses.h"
+#include "llvm/ADT/Sequence.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace circt;
+using namespace hw;
+
+namespace {
+struct PrintCombPathsPass : public PrintCombPathsBase<PrintCombPathsPass> {
+  PrintCombPathsPass(raw_ostream &os) : os(os) {}
+  void runOnOperation() override;
+  raw_ostream &os;
+};
+} // end anonymous namespace
+
+void PrintCombPathsPass::runOnOperation() {
+  auto &combPaths = getAnalysis<analysis::CombPathsAnalysis>();
+  for (auto module : getOperation().getOps<HWModuleOp>()) {
+    auto &summary = combPaths.getCombPaths(module.getOperation());
+    if (!summary.hasCycle && summary.longestPath < minDepth)
+      continue;
+
+    os << "module " << module.getName() << ": ";
+    if (summary.hasCycle)
+      os << "combinational cycle\n";
+    else
+      os << "longest path " << summary.longestPath << "\n";
+    for (auto inputPort : llvm::seq(0u, (unsigned)summary.paths.size())) {
+      for (auto outputPort : summary.paths[inputPort].set_bits()) {
+        os << "  " << getModuleArgumentName(module, inputPort) << " -> "
+           << getModuleResultName(module, outputPort);
+        if (!summary.hasCycle)
+          os << ": " << summary.pathDepths[inputPort][outputPort];
+        os << "\n";
+      }
+    }
+  }
+  markAllAnalysesPreserved();
+}
+
+std::unique_ptr<mlir::Pass> circt::hw::createPrintCombPathsPass() {
+  return std::make_unique<PrintCombPathsPass>(llvm::errs());
+}
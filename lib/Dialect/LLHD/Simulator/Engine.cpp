@@ -12,24 +12,79 @@
 
 #include "circt/Dialect/LLHD/Simulator/Engine.h"
 #include "circt/Conversion/LLHDToLLVM.h"
+#include "circt/Dialect/LLHD/Simulator/Snapshot.h"
+#include "signals-runtime-wrappers.h"
 
 #include "mlir/ExecutionEngine/ExecutionEngine.h"
 #include "mlir/IR/Builders.h"
 
+#include "llvm/Support/Format.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+
+#include <atomic>
 
 using namespace circt::llhd::sim;
 
+void EngineStatistics::print(llvm::raw_ostream &os) const {
+  auto printCounter = [&](uint64_t value, StringRef desc) {
+    os << llvm::format_decimal(value, 12) << " llhd-sim - " << desc << "\n";
+  };
+  os << "===" << std::string(73, '-') << "===\n"
+     << "                        ... Statistics Collected ...\n"
+     << "===" << std::string(73, '-') << "===\n\n";
+  printCounter(signalWakeups, "Instance wakeups triggered by signal changes");
+  printCounter(ignoredTriggers,
+               "Signal changes ignored by processes not sensitive to them");
+  printCounter(scheduledWakeups, "Scheduled process wakeups");
+  printCounter(instanceRuns, "Instance evaluations");
+  printCounter(objectCacheHits, "Designs loaded from the object cache");
+  printCounter(objectCacheMisses, "Designs compiled and stored in the cache");
+}
+
 Engine::Engine(
     llvm::raw_ostream &out, ModuleOp module,
     llvm::function_ref<mlir::LogicalResult(mlir::ModuleOp)> mlirTransformer,
     llvm::function_ref<llvm::Error(llvm::Module *)> llvmTransformer,
-    std::string root, TraceMode tm, ArrayRef<StringRef> sharedLibPaths)
-    : out(out), root(root), traceMode(tm) {
+    std::string root, TraceMode tm, ArrayRef<StringRef> sharedLibPaths,
+    unsigned threads, StringRef objectCacheDir, StringRef transformerOptions)
+    : out(out), root(root), traceMode(tm), threads(threads) {
   state = std::make_unique<State>();
   state->root = root + '.' + root;
 
+  // Key the cached object on the design before it is modified below. Neither
+  // the cache nor the key are needed without a cache directory.
+  llvm::Optional<ObjectFileCache> cache;
+  std::string cacheKey;
+  if (!objectCacheDir.empty()) {
+    cache.emplace(objectCacheDir);
+    std::string design;
+    llvm::raw_string_ostream designOS(design);
+    module.print(designOS);
+    cacheKey = ObjectFileCache::computeKey(
+        designOS.str(), "root=" + root + " " + transformerOptions.str());
+  }
+
   buildLayout(module);
+  this->module = module;
+
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  // Reuse the cached object if there is one. The layout only depends on the
+  // LLHD module, such that neither the lowering nor the compilation are needed.
+  if (cache) {
+    if (auto object = cache->lookup(cacheKey)) {
+      auto maybeObject = ObjectJIT::create(std::move(object), sharedLibPaths);
+      if (maybeObject) {
+        ++stats.objectCacheHits;
+        cachedObject = std::move(*maybeObject);
+        return;
+      }
+      llvm::errs() << "Ignoring the cached object: "
+                   << llvm::toString(maybeObject.takeError()) << "\n";
+    }
+  }
 
   auto rootEntity = module.lookupSymbol<EntityOp>(root);
 
@@ -45,27 +100,47 @@ Engine::Engine(
     exit(EXIT_FAILURE);
   }
 
-  this->module = module;
-
-  llvm::InitializeNativeTarget();
-  llvm::InitializeNativeTargetAsmPrinter();
-
   mlir::ExecutionEngineOptions options;
   options.transformer = llvmTransformer;
   options.sharedLibPaths = sharedLibPaths;
+  options.enableObjectDump = cache.hasValue();
   auto maybeEngine = mlir::ExecutionEngine::create(this->module, options);
   assert(maybeEngine && "failed to create JIT");
   engine = std::move(*maybeEngine);
+
+  if (!cache)
+    return;
+
+  // The module is only compiled on the first lookup, force it before dumping
+  // the object to the cache.
+  ++stats.objectCacheMisses;
+  auto err = cache->store(cacheKey, [&](StringRef path) -> llvm::Error {
+    auto init = engine->lookupPacked("llhd_init");
+    if (!init)
+      return init.takeError();
+    engine->dumpToObjectFile(path);
+    return llvm::Error::success();
+  });
+  if (err)
+    llvm::errs() << "Failed to store the object in the cache: "
+                 << llvm::toString(std::move(err)) << "\n";
 }
 
 Engine::~Engine() = default;
 
+llvm::Expected<void (*)(void **)> Engine::lookupPacked(StringRef name) {
+  if (cachedObject)
+    return cachedObject->lookupPacked(name);
+  return engine->lookupPacked(name);
+}
+
 void Engine::dumpStateLayout() { state->dumpLayout(); }
 
 void Engine::dumpStateSignalTriggers() { state->dumpSignalTriggers(); }
 
-int Engine::simulate(int n, uint64_t maxTime) {
-  assert(engine && "engine not found");
+int Engine::simulate(int n, uint64_t maxTime, StringRef restorePath,
+                     StringRef checkpointPath) {
+  assert((engine || cachedObject) && "engine not found");
   assert(state && "state not found");
 
   auto tm = static_cast<TraceMode>(traceMode);
@@ -73,11 +148,22 @@ int Engine::simulate(int n, uint64_t maxTime) {
 
   SmallVector<void *, 1> arg({&state});
   // Initialize tbe simulation state.
-  auto invocationResult = engine->invokePacked("llhd_init", arg);
-  if (invocationResult) {
-    llvm::errs() << "Failed invocation of llhd_init: " << invocationResult;
+  auto init = lookupPacked("llhd_init");
+  if (!init) {
+    llvm::errs() << "Failed invocation of llhd_init: "
+                 << llvm::toString(init.takeError()) << "\n";
     return -1;
   }
+  (*init)(arg.data());
+
+  // Overwrite the initial state with the snapshot, if any.
+  if (!restorePath.empty()) {
+    if (auto err = restoreSnapshot(*state, restorePath)) {
+      llvm::errs() << "Failed to restore the simulation state: "
+                   << llvm::toString(std::move(err)) << "\n";
+      return -1;
+    }
+  }
 
   if (traceMode != TraceMode::None) {
     // Add changes for all the signals' initial values.
@@ -86,19 +172,23 @@ int Engine::simulate(int n, uint64_t maxTime) {
     }
   }
 
-  // Add a dummy event to get the simulation started.
-  state->queue.push_back(Slot(Time()));
-  ++state->queue.events;
+  // Add a dummy event to get the simulation started. A restored simulation
+  // continues with the events pending in the snapshot instead.
+  if (restorePath.empty())
+    state->queue.getOrCreateSlot(Time());
 
   // Keep track of the instances that need to wakeup.
   llvm::SmallVector<unsigned, 8> wakeupQueue;
+  // Buffer used to merge the changes of signals wider than 64 bits.
+  llvm::SmallVector<uint64_t, 4> wideBuff;
 
   // Add all instances to the wakeup queue for the first run and add the jitted
   // function pointers to all of the instances to make them readily available.
   for (size_t i = 0, e = state->instances.size(); i < e; ++i) {
-    wakeupQueue.push_back(i);
+    if (restorePath.empty())
+      wakeupQueue.push_back(i);
     auto &inst = state->instances[i];
-    auto expectedFPtr = engine->lookupPacked(inst.unit);
+    auto expectedFPtr = lookupPacked(inst.unit);
     if (!expectedFPtr) {
       llvm::errs() << "Could not lookup " << inst.unit << "!\n";
       return -1;
@@ -106,6 +196,32 @@ int Engine::simulate(int n, uint64_t maxTime) {
     inst.unitFPtr = *expectedFPtr;
   }
 
+  // Evaluate the woken up instances on multiple threads if requested. The
+  // events scheduled by each instance are buffered separately, and applied to
+  // the queue in the same order as a serial evaluation would.
+  std::unique_ptr<llvm::ThreadPool> threadPool;
+  std::vector<DeferredEvents> deferred;
+  if (threads > 1) {
+    threadPool =
+        std::make_unique<llvm::ThreadPool>(llvm::hardware_concurrency(threads));
+    deferred.resize(state->instances.size());
+  }
+
+  auto runInstance = [&](unsigned i) {
+    auto &inst = state->instances[i];
+    auto signalTable = inst.sensitivityList.data();
+
+    // Gather the instance arguments for unit invocation.
+    SmallVector<void *, 3> args;
+    if (inst.isEntity)
+      args.assign({&state, &inst.entityState, &signalTable});
+    else {
+      args.assign({&state, &inst.procState, &signalTable});
+    }
+    // Run the unit.
+    (*inst.unitFPtr)(args.data());
+  };
+
   int cycle = 0;
   while (state->queue.events > 0) {
     const auto &pop = state->queue.top();
@@ -127,44 +243,46 @@ int Engine::simulate(int n, uint64_t maxTime) {
     while (i < e) {
       const auto sigIndex = pop.changes[i].first;
       auto &curr = state->signals[sigIndex];
-      APInt buff(
-          curr.getSize() * 8,
-          llvm::makeArrayRef(reinterpret_cast<uint64_t *>(curr.getValue()),
-                             llvm::divideCeil(curr.getSize(), 8)));
+
+      // Merge the changes into a copy of the current value. Values of up to 64
+      // bits are handled in a single word, wider ones in a reused buffer.
+      unsigned width = curr.getSize() * 8;
+      uint64_t smallBuff = 0;
+      uint64_t *buff = &smallBuff;
+      if (width > 64) {
+        wideBuff.assign(llvm::divideCeil(width, 64), 0);
+        buff = wideBuff.data();
+      }
+      std::memcpy(buff, curr.getValue(), curr.getSize());
 
       // Apply the changes to the buffer until we reach the next signal.
       while (i < e && pop.changes[i].first == sigIndex) {
-        const auto &change = pop.buffers[pop.changes[i].second];
-        const auto offset = change.first;
-        const auto &drive = change.second;
-        if (drive.getBitWidth() < buff.getBitWidth())
-          buff.insertBits(drive, offset);
-        else
-          buff = drive;
-
+        pop.applyChange(pop.changes[i].second, buff, width);
         ++i;
       }
 
-      if (!curr.updateWhenChanged(buff.getRawData()))
+      if (!curr.updateWhenChanged(buff))
         continue;
 
-      // Add sensitive instances.
-      for (auto inst : curr.getTriggeredInstanceIndices()) {
+      // Add sensitive instances. The position of the signal in the sensitivity
+      // list of each process is precomputed, so checking whether the process
+      // is currently sensitive to it is a single lookup.
+      const auto &triggers = curr.getTriggeredInstanceIndices();
+      const auto &senseIndices = curr.getTriggeredSenseIndices();
+      for (size_t j = 0, f = triggers.size(); j < f; ++j) {
+        auto inst = triggers[j];
+        auto &instance = state->instances[inst];
         // Skip if the process is not currently sensible to the signal.
-        if (!state->instances[inst].isEntity) {
-          const auto &sensList = state->instances[inst].sensitivityList;
-          auto it = std::find_if(sensList.begin(), sensList.end(),
-                                 [sigIndex](const SignalDetail &sig) {
-                                   return sig.globalIndex == sigIndex;
-                                 });
-          if (sensList.end() != it &&
-              state->instances[inst].procState->senses[it - sensList.begin()] ==
-                  0)
+        if (!instance.isEntity) {
+          if (instance.procState->senses[senseIndices[j]] == 0) {
+            ++stats.ignoredTriggers;
             continue;
+          }
 
           // Invalidate scheduled wakeup
-          state->instances[inst].expectedWakeup = Time();
+          instance.expectedWakeup = Time();
         }
+        ++stats.signalWakeups;
         wakeupQueue.push_back(inst);
       }
 
@@ -175,8 +293,10 @@ int Engine::simulate(int n, uint64_t maxTime) {
 
     // Add scheduled process resumes to the wakeup queue.
     for (auto inst : pop.scheduled) {
-      if (state->time == state->instances[inst].expectedWakeup)
+      if (state->time == state->instances[inst].expectedWakeup) {
+        ++stats.scheduledWakeups;
         wakeupQueue.push_back(inst);
+      }
     }
 
     state->queue.pop();
@@ -184,21 +304,31 @@ int Engine::simulate(int n, uint64_t maxTime) {
     std::sort(wakeupQueue.begin(), wakeupQueue.end());
     wakeupQueue.erase(std::unique(wakeupQueue.begin(), wakeupQueue.end()),
                       wakeupQueue.end());
+    stats.instanceRuns += wakeupQueue.size();
 
     // Run the instances present in the wakeup queue.
-    for (auto i : wakeupQueue) {
-      auto &inst = state->instances[i];
-      auto signalTable = inst.sensitivityList.data();
-
-      // Gather the instance arguments for unit invocation.
-      SmallVector<void *, 3> args;
-      if (inst.isEntity)
-        args.assign({&state, &inst.entityState, &signalTable});
-      else {
-        args.assign({&state, &inst.procState, &signalTable});
-      }
-      // Run the unit.
-      (*inst.unitFPtr)(args.data());
+    if (!threadPool || wakeupQueue.size() < 2) {
+      for (auto i : wakeupQueue)
+        runInstance(i);
+    } else {
+      // Instances only communicate through the queue, so they can run
+      // concurrently. Each worker keeps picking the next instance to run until
+      // none are left, which balances the load between the threads.
+      std::atomic<size_t> next(0);
+      auto worker = [&]() {
+        for (size_t j = next++, e = wakeupQueue.size(); j < e; j = next++) {
+          llhdDeferEvents(&deferred[j]);
+          runInstance(wakeupQueue[j]);
+        }
+        llhdDeferEvents(nullptr);
+      };
+      for (unsigned t = 0, e = std::min<size_t>(threads, wakeupQueue.size());
+           t < e; ++t)
+        threadPool->async(worker);
+      threadPool->wait();
+
+      for (size_t j = 0, e = wakeupQueue.size(); j < e; ++j)
+        deferred[j].apply(*state);
     }
 
     // Clear wakeup queue.
@@ -211,6 +341,14 @@ int Engine::simulate(int n, uint64_t maxTime) {
     trace.flush(/*force=*/true);
   }
 
+  if (!checkpointPath.empty()) {
+    if (auto err = writeSnapshot(*state, checkpointPath)) {
+      llvm::errs() << "Failed to write the simulation state: "
+                   << llvm::toString(std::move(err)) << "\n";
+      return -1;
+    }
+  }
+
   llvm::errs() << "Finished at " << state->time.toString() << " (" << cycle
                << " cycles)\n";
   return 0;
@@ -235,11 +373,14 @@ void Engine::buildLayout(ModuleOp module) {
   // Store the root instance.
   state->instances.push_back(std::move(rootInst));
 
-  // Add triggers to signals.
+  // Add triggers to signals, along with the position of the signal in the
+  // instance's sensitivity list, which is needed to check whether a process is
+  // currently sensitive to it.
   for (size_t i = 0, e = state->instances.size(); i < e; ++i) {
     auto &inst = state->instances[i];
-    for (auto trigger : inst.sensitivityList) {
-      state->signals[trigger.globalIndex].pushInstanceIndex(i);
+    for (size_t j = 0, f = inst.sensitivityList.size(); j < f; ++j) {
+      auto globalIndex = inst.sensitivityList[j].globalIndex;
+      state->signals[globalIndex].pushInstanceIndex(i, j);
     }
   }
 }
@@ -0,0 +1,154 @@
+//===- ObjectCache.cpp - On-disk cache of simulation object code ----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the on-disk cache of the object code compiled by the
+// LLHD simulator, and the JIT used to run a cached object.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/LLHD/Simulator/ObjectCache.h"
+
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+/// Bump this whenever the generated code changes in a way not covered by the
+/// LLVM version, e.g. when the LLHD lowering changes.
+static constexpr StringLiteral cacheFormat = "llhd-sim-object-v1";
+
+//===----------------------------------------------------------------------===//
+// ObjectFileCache
+//===----------------------------------------------------------------------===//
+
+std::string ObjectFileCache::computeKey(StringRef design, StringRef options) {
+  SHA256 sha;
+  auto update = [&](StringRef str) {
+    // Hash the length first, such that the fields cannot run into each other.
+    uint64_t size = str.size();
+    sha.update(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(&size),
+                                 sizeof(size)));
+    sha.update(str);
+  };
+  update(cacheFormat);
+  update(LLVM_VERSION_STRING);
+  update(sys::getProcessTriple());
+  update(sys::getHostCPUName());
+  update(options);
+  update(design);
+  return toHex(sha.final(), /*LowerCase=*/true);
+}
+
+std::string ObjectFileCache::getPath(StringRef key) const {
+  SmallString<128> path(directory);
+  sys::path::append(path, key + ".o");
+  return std::string(path.str());
+}
+
+std::unique_ptr<MemoryBuffer> ObjectFileCache::lookup(StringRef key) const {
+  auto buffer = MemoryBuffer::getFile(getPath(key), /*IsText=*/false,
+                                      /*RequiresNullTerminator=*/false);
+  if (!buffer || (*buffer)->getBufferSize() == 0)
+    return nullptr;
+  return std::move(*buffer);
+}
+
+Error ObjectFileCache::store(
+    StringRef key, function_ref<Error(StringRef path)> writeObject) const {
+  if (auto ec = sys::fs::create_directories(directory))
+    return createStringError(ec, "cannot create object cache directory '%s'",
+                             directory.c_str());
+
+  SmallString<128> tempPath(directory);
+  sys::path::append(tempPath, key + "-%%%%%%.tmp");
+  int fd;
+  if (auto ec = sys::fs::createUniqueFile(tempPath, fd, tempPath))
+    return createStringError(ec, "cannot create temporary object file");
+  sys::fs::closeFile(fd);
+
+  auto removeTemp = make_scope_exit([&]() { sys::fs::remove(tempPath); });
+  if (auto err = writeObject(tempPath))
+    return err;
+
+  uint64_t size;
+  if (sys::fs::file_size(tempPath, size) || size == 0)
+    return createStringError(inconvertibleErrorCode(),
+                             "no object was written for the cache");
+  if (auto ec = sys::fs::rename(tempPath, getPath(key)))
+    return createStringError(ec, "cannot move object into the cache");
+  return Error::success();
+}
+
+//===----------------------------------------------------------------------===//
+// ObjectJIT
+//===----------------------------------------------------------------------===//
+
+ObjectJIT::~ObjectJIT() = default;
+
+Expected<std::unique_ptr<ObjectJIT>>
+ObjectJIT::create(std::unique_ptr<MemoryBuffer> object,
+                  ArrayRef<StringRef> sharedLibPaths) {
+  // Load the shared libraries in the process, such that their symbols are
+  // found along with the ones statically linked in the simulator.
+  for (auto libPath : sharedLibPaths) {
+    std::string errorMsg;
+    if (sys::DynamicLibrary::LoadLibraryPermanently(libPath.str().c_str(),
+                                                    &errorMsg))
+      return createStringError(inconvertibleErrorCode(),
+                               "cannot load '%s': %s", libPath.str().c_str(),
+                               errorMsg.c_str());
+  }
+
+  // Link the object the same way the mlir::ExecutionEngine does.
+  auto jit =
+      orc::LLJITBuilder()
+          .setObjectLinkingLayerCreator(
+              [](orc::ExecutionSession &session, const Triple &) {
+                return std::make_unique<orc::RTDyldObjectLinkingLayer>(
+                    session,
+                    []() { return std::make_unique<SectionMemoryManager>(); });
+              })
+          .create();
+  if (!jit)
+    return jit.takeError();
+
+  auto generator = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      (*jit)->getDataLayout().getGlobalPrefix());
+  if (!generator)
+    return generator.takeError();
+  (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+
+  if (auto err = (*jit)->addObjectFile(std::move(object)))
+    return std::move(err);
+
+  std::unique_ptr<ObjectJIT> objectJIT(new ObjectJIT());
+  objectJIT->jit = std::move(*jit);
+  return std::move(objectJIT);
+}
+
+Expected<void (*)(void **)> ObjectJIT::lookupPacked(StringRef name) const {
+  // The execution engine prefixes the packed wrappers with `_mlir_`.
+  auto symbol = jit->getExecutionSession().lookup(
+      {&jit->getMainJITDylib()}, jit->mangleAndIntern(("_mlir_" + name).str()));
+  if (!symbol)
+    return symbol.takeError();
+  return reinterpret_cast<void (*)(void **)>(symbol->getAddress());
+}
@@ -0,0 +1,390 @@
+//===- Snapshot.cpp - Simulation state snapshots --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements saving the state of a running LLHD simulation to a
+// file, and restoring it to continue the simulation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/LLHD/Simulator/Snapshot.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+static constexpr char snapshotMagic[8] = {'L', 'L', 'H', 'D',
+                                          'S', 'N', 'A', 'P'};
+static constexpr uint64_t snapshotVersion = 2;
+
+//===----------------------------------------------------------------------===//
+// Writing
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Write the native 64 bit words and 8 byte aligned byte arrays of a snapshot.
+class SnapshotWriter {
+public:
+  SnapshotWriter(raw_ostream &out) : out(out) {}
+
+  void write(uint64_t value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  void write(Time time) {
+    write(time.getTime());
+    write(time.getDelta());
+    write(time.getEps());
+  }
+
+  void writeBytes(const void *data, size_t size) {
+    write(size);
+    out.write(static_cast<const char *>(data), size);
+    out.write_zeros(alignTo(size, 8) - size);
+  }
+
+  void writeString(StringRef str) { writeBytes(str.data(), str.size()); }
+
+private:
+  raw_ostream &out;
+};
+} // namespace
+
+Error circt::llhd::sim::writeSnapshot(const State &state, StringRef path) {
+  std::error_code ec;
+  raw_fd_ostream out(path, ec, sys::fs::OF_None);
+  if (ec)
+    return createStringError(ec, "cannot open snapshot file '%s': %s",
+                             path.str().c_str(), ec.message().c_str());
+
+  SnapshotWriter writer(out);
+  out.write(snapshotMagic, sizeof(snapshotMagic));
+  writer.write(snapshotVersion);
+  writer.write(sizeof(void *));
+  writer.write(state.time);
+
+  // Store the signal values, along with their address in this run, needed to
+  // relocate the pointers to them persisted by the processes.
+  writer.write(state.signals.size());
+  for (const auto &sig : state.signals) {
+    writer.writeString(sig.getOwner());
+    writer.writeString(sig.getName());
+    writer.write(reinterpret_cast<uintptr_t>(sig.getValue()));
+    writer.writeBytes(sig.getValue(), sig.getSize());
+  }
+
+  writer.write(state.instances.size());
+  for (const auto &inst : state.instances) {
+    writer.writeString(inst.name);
+    writer.write(inst.isEntity);
+    writer.write(inst.expectedWakeup);
+    writer.write(reinterpret_cast<uintptr_t>(inst.sensitivityList.data()));
+    writer.write(inst.sensitivityList.size() * sizeof(SignalDetail));
+    if (inst.isEntity) {
+      writer.write(uint64_t(0));
+      writer.writeBytes(inst.entityState.get(), inst.stateSize);
+      writer.writeBytes(nullptr, 0);
+    } else {
+      writer.write(reinterpret_cast<uintptr_t>(inst.procState.get()));
+      writer.writeBytes(inst.procState.get(), inst.stateSize);
+      writer.writeBytes(inst.procState->senses, inst.nArgs);
+    }
+  }
+
+  // Store the pending events. The changes of a slot are stored in the order
+  // they were inserted, as later drives of the same bits take precedence.
+  size_t numSlots = 0;
+  state.queue.forEachSlot([&](const Slot &) { ++numSlots; });
+  writer.write(numSlots);
+  state.queue.forEachSlot([&](const Slot &slot) {
+    writer.write(slot.time);
+    SmallVector<std::pair<unsigned, unsigned>, 32> changes(
+        slot.changes.begin(), slot.changes.begin() + slot.changesSize);
+    llvm::sort(changes, [](const auto &a, const auto &b) {
+      return a.second < b.second;
+    });
+    writer.write(changes.size());
+    for (auto change : changes) {
+      const auto &buffer = slot.buffers[change.second];
+      const uint64_t *value = buffer.width <= 64
+                                  ? &buffer.value
+                                  : slot.wideValues.data() + buffer.value;
+      writer.write(change.first);
+      writer.write(buffer.bitOffset);
+      writer.write(buffer.width);
+      writer.writeBytes(value, divideCeil(buffer.width, 64) * 8);
+    }
+    writer.write(slot.scheduled.size());
+    for (auto inst : slot.scheduled)
+      writer.write(inst);
+  });
+
+  out.close();
+  if (out.has_error()) {
+    ec = out.error();
+    out.clear_error();
+    return createStringError(ec, "cannot write snapshot file '%s': %s",
+                             path.str().c_str(), ec.message().c_str());
+  }
+  return Error::success();
+}
+
+//===----------------------------------------------------------------------===//
+// Restoring
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Read the fields of a snapshot in place, checking that they do not run past
+/// the end of the file.
+class SnapshotReader {
+public:
+  SnapshotReader(StringRef data) : data(data) {}
+
+  bool read(uint64_t &value) {
+    if (data.size() < sizeof(value))
+      return false;
+    std::memcpy(&value, data.data(), sizeof(value));
+    data = data.drop_front(sizeof(value));
+    return true;
+  }
+
+  bool read(Time &time) {
+    uint64_t t, delta, eps;
+    if (!read(t) || !read(delta) || !read(eps))
+      return false;
+    time = Time(t, delta, eps);
+    return true;
+  }
+
+  bool readBytes(StringRef &bytes) {
+    uint64_t size;
+    if (!read(size) || data.size() < alignTo(size, 8))
+      return false;
+    bytes = data.take_front(size);
+    data = data.drop_front(alignTo(size, 8));
+    return true;
+  }
+
+  bool readPrefix(StringRef prefix) {
+    if (!data.startswith(prefix))
+      return false;
+    data = data.drop_front(prefix.size());
+    return true;
+  }
+
+private:
+  StringRef data;
+};
+
+/// A map from the memory owned by the simulator when a snapshot was taken to
+/// the same memory in the restored simulation.
+class Relocations {
+public:
+  void add(uint64_t oldBase, uint64_t size, uint8_t *newBase) {
+    if (size > 0)
+      ranges.push_back({oldBase, size, reinterpret_cast<uintptr_t>(newBase)});
+  }
+
+  void finalize() {
+    llvm::sort(ranges, [](const auto &a, const auto &b) {
+      return a.oldBase < b.oldBase;
+    });
+  }
+
+  /// Relocate the pointers stored at the given offsets of the given memory,
+  /// if they point into one of the ranges. Other pointers, e.g. null ones, are
+  /// left untouched.
+  void apply(uint8_t *data, ArrayRef<uint64_t> offsets) const {
+    for (auto i : offsets) {
+      uintptr_t word;
+      std::memcpy(&word, data + i, sizeof(word));
+      auto it = llvm::upper_bound(ranges, word, [](uint64_t w, const auto &r) {
+        return w < r.oldBase;
+      });
+      if (it == ranges.begin())
+        continue;
+      --it;
+      if (word - it->oldBase >= it->size)
+        continue;
+      word = word - it->oldBase + it->newBase;
+      std::memcpy(data + i, &word, sizeof(word));
+    }
+  }
+
+private:
+  struct Range {
+    uint64_t oldBase;
+    uint64_t size;
+    uint64_t newBase;
+  };
+  SmallVector<Range, 0> ranges;
+};
+} // namespace
+
+Error circt::llhd::sim::restoreSnapshot(State &state, StringRef path) {
+  auto buffer = MemoryBuffer::getFile(path, /*IsText=*/false,
+                                      /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return createStringError(buffer.getError(),
+                             "cannot open snapshot file '%s': %s",
+                             path.str().c_str(),
+                             buffer.getError().message().c_str());
+
+  auto fail = [&](const Twine &msg) {
+    return createStringError(inconvertibleErrorCode(), "snapshot '%s': %s",
+                             path.str().c_str(), msg.str().c_str());
+  };
+  auto truncated = [&]() { return fail("unexpected end of file"); };
+
+  if (!state.queue.empty())
+    return fail("cannot restore a snapshot into a running simulation");
+
+  SnapshotReader reader((*buffer)->getBuffer());
+  uint64_t version, pointerSize;
+  if (!reader.readPrefix(StringRef(snapshotMagic, sizeof(snapshotMagic))))
+    return fail("not a simulation snapshot");
+  if (!reader.read(version) || !reader.read(pointerSize))
+    return truncated();
+  if (version != snapshotVersion || pointerSize != sizeof(void *))
+    return fail("unsupported snapshot version or platform");
+
+  Time time;
+  if (!reader.read(time))
+    return truncated();
+
+  // Restore the signal values, checking that the design matches.
+  uint64_t numSignals;
+  if (!reader.read(numSignals))
+    return truncated();
+  if (numSignals != state.signals.size())
+    return fail("the number of signals does not match the design");
+
+  Relocations relocations;
+  for (auto &sig : state.signals) {
+    StringRef owner, name, value;
+    uint64_t oldBase;
+    if (!reader.readBytes(owner) || !reader.readBytes(name) ||
+        !reader.read(oldBase) || !reader.readBytes(value))
+      return truncated();
+    if (owner != sig.getOwner() || name != sig.getName() ||
+        value.size() != sig.getSize())
+      return fail("signal " + sig.getOwner() + "/" + sig.getName() +
+                  " does not match the design");
+    std::memcpy(sig.getValue(), value.data(), value.size());
+    // Pointers to a signal can be offset by up to twice its size, as the
+    // lowering allocates that much memory for it.
+    relocations.add(oldBase, 2 * sig.getSize(), sig.getValue());
+  }
+
+  // Restore the instance states. The instance tables are read first, as the
+  // relocations need to be known before restoring the process states.
+  uint64_t numInstances;
+  if (!reader.read(numInstances))
+    return truncated();
+  if (numInstances != state.instances.size())
+    return fail("the number of instances does not match the design");
+
+  struct InstanceData {
+    Time expectedWakeup;
+    StringRef unitState;
+    StringRef senses;
+  };
+  SmallVector<InstanceData, 0> instanceData;
+  for (auto &inst : state.instances) {
+    StringRef name;
+    uint64_t isEntity, oldTable, tableSize, oldState;
+    InstanceData data;
+    if (!reader.readBytes(name) || !reader.read(isEntity) ||
+        !reader.read(data.expectedWakeup) || !reader.read(oldTable) ||
+        !reader.read(tableSize) || !reader.read(oldState) ||
+        !reader.readBytes(data.unitState) || !reader.readBytes(data.senses))
+      return truncated();
+    if (name != inst.name || isEntity != inst.isEntity ||
+        data.unitState.size() != inst.stateSize ||
+        (!inst.isEntity && data.senses.size() != inst.nArgs))
+      return fail("instance " + inst.name + " does not match the design");
+    relocations.add(oldTable, tableSize,
+                    reinterpret_cast<uint8_t *>(inst.sensitivityList.data()));
+    if (!inst.isEntity)
+      relocations.add(oldState, inst.stateSize,
+                      reinterpret_cast<uint8_t *>(inst.procState.get()));
+    instanceData.push_back(data);
+  }
+  relocations.finalize();
+
+  for (size_t i = 0, e = state.instances.size(); i < e; ++i) {
+    auto &inst = state.instances[i];
+    auto &data = instanceData[i];
+    inst.expectedWakeup = data.expectedWakeup;
+    if (inst.isEntity) {
+      std::memcpy(inst.entityState.get(), data.unitState.data(),
+                  data.unitState.size());
+      continue;
+    }
+
+    // Keep the instance index and the senses table of the new process state,
+    // and relocate the pointers persisted across suspensions. Their offsets
+    // are recorded by the lowering, as a persisted integer may just as well
+    // hold a value that looks like an address.
+    auto *procState = inst.procState.get();
+    auto instIndex = procState->inst;
+    auto *senses = procState->senses;
+    std::memcpy(procState, data.unitState.data(), data.unitState.size());
+    procState->inst = instIndex;
+    procState->senses = senses;
+    std::memcpy(senses, data.senses.data(), data.senses.size());
+    for (auto offset : inst.procStatePointers)
+      if (offset + sizeof(uintptr_t) > inst.stateSize)
+        return fail("instance " + inst.name + " has an invalid pointer");
+    relocations.apply(reinterpret_cast<uint8_t *>(procState),
+                      inst.procStatePointers);
+  }
+
+  // Restore the pending events.
+  uint64_t numSlots;
+  if (!reader.read(numSlots))
+    return truncated();
+  for (uint64_t i = 0; i < numSlots; ++i) {
+    Time slotTime;
+    uint64_t numChanges, numScheduled;
+    if (!reader.read(slotTime) || !reader.read(numChanges))
+      return truncated();
+    auto &slot = state.queue.getOrCreateSlot(slotTime);
+    for (uint64_t j = 0; j < numChanges; ++j) {
+      uint64_t sigIndex, bitOffset, width;
+      StringRef value;
+      if (!reader.read(sigIndex) || !reader.read(bitOffset) ||
+          !reader.read(width) || !reader.readBytes(value))
+        return truncated();
+      if (sigIndex >= numSignals || value.size() * 8 < width)
+        return fail("invalid signal change");
+      slot.insertChange(sigIndex, bitOffset,
+                        reinterpret_cast<uint8_t *>(
+                            const_cast<char *>(value.data())),
+                        width);
+    }
+    if (!reader.read(numScheduled))
+      return truncated();
+    for (uint64_t j = 0; j < numScheduled; ++j) {
+      uint64_t inst;
+      if (!reader.read(inst))
+        return truncated();
+      if (inst >= numInstances)
+        return fail("invalid scheduled wakeup");
+      slot.insertChange(static_cast<unsigned>(inst));
+    }
+  }
+
+  state.time = time;
+  return Error::success();
+}
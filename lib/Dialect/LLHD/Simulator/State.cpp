@@ -14,8 +14,11 @@
 #include "circt/Dialect/LLHD/Simulator/State.h"
 
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 using namespace llvm;
@@ -66,28 +69,71 @@ bool Slot::operator>(const Slot &rhs) const { return rhs.time < time; }
 
 void Slot::insertChange(int index, int bitOffset, uint8_t *bytes,
                         unsigned width) {
-  // Get the amount of 64 bit words required to store the value in an APInt.
-  auto size = llvm::divideCeil(width, 64);
-
-  if (changesSize >= buffers.size()) {
-    // Create a new change buffer if we don't have any unused one available for
-    // reuse.
-    buffers.push_back(std::make_pair(
-        bitOffset,
-        APInt(width, makeArrayRef(reinterpret_cast<uint64_t *>(bytes), size))));
+  Change change{static_cast<unsigned>(bitOffset), width, 0};
+
+  if (width <= 64) {
+    // Store small values inline, only reading the bytes holding the value.
+    std::memcpy(&change.value, bytes, llvm::divideCeil(width, 8));
+    change.value &= llvm::maskTrailingOnes<uint64_t>(width);
   } else {
-    // Reuse the first available buffer.
-    buffers[changesSize] = std::make_pair(
-        bitOffset,
-        APInt(width, makeArrayRef(reinterpret_cast<uint64_t *>(bytes), size)));
+    // Store wide values in the arena, which keeps its storage across pops.
+    auto size = llvm::divideCeil(width, 64);
+    auto *words = reinterpret_cast<uint64_t *>(bytes);
+    change.value = wideValues.size();
+    wideValues.append(words, words + size);
   }
 
   // Map the signal index to the change buffer so we can retrieve
   // it after sorting.
+  buffers.push_back(change);
   changes.push_back(std::make_pair(index, changesSize));
   ++changesSize;
 }
 
+void Slot::applyChange(unsigned buffer, uint64_t *value, unsigned width) const {
+  const auto &change = buffers[buffer];
+  const uint64_t *src = change.width <= 64 ? &change.value
+                                           : wideValues.data() + change.value;
+
+  // Fast path for signals of up to 64 bits.
+  if (width <= 64) {
+    if (change.width >= width) {
+      value[0] = src[0];
+      return;
+    }
+    auto mask = llvm::maskTrailingOnes<uint64_t>(change.width)
+                << change.bitOffset;
+    value[0] = (value[0] & ~mask) | ((src[0] << change.bitOffset) & mask);
+    return;
+  }
+
+  if (change.width >= width) {
+    std::memcpy(value, src, llvm::divideCeil(width, 64) * 8);
+    return;
+  }
+
+  // Copy the driven bits in chunks that do not cross a word boundary in either
+  // the source or the destination.
+  for (unsigned done = 0; done < change.width;) {
+    unsigned dstBit = change.bitOffset + done;
+    unsigned shift = dstBit % 64;
+    unsigned n = std::min({64 - shift, 64 - done % 64, change.width - done});
+    auto mask = llvm::maskTrailingOnes<uint64_t>(n);
+    auto bits = (src[done / 64] >> (done % 64)) & mask;
+    auto &word = value[dstBit / 64];
+    word = (word & ~(mask << shift)) | (bits << shift);
+    done += n;
+  }
+}
+
+void Slot::clear() {
+  changesSize = 0;
+  changes.clear();
+  buffers.clear();
+  wideValues.clear();
+  scheduled.clear();
+}
+
 void Slot::insertChange(unsigned inst) { scheduled.push_back(inst); }
 
 //===----------------------------------------------------------------------===//
@@ -105,84 +151,217 @@ void UpdateQueue::insertOrUpdate(Time time, unsigned inst) {
 }
 
 Slot &UpdateQueue::getOrCreateSlot(Time time) {
-  auto &top = begin()[topSlot];
-
-  // Directly add to top slot.
-  if (!top.unused && time == top.time) {
-    return top;
+  auto &group = groups[getOrCreateGroup(time.getTime())];
+
+  // Search the group for a slot with the same timestamp. Groups only hold the
+  // delta steps pending for one real-time value, so they are very short.
+  auto it = llvm::find_if(
+      group.slots, [&](unsigned slot) { return !(slots[slot].time < time); });
+  if (it != group.slots.end() && slots[*it].time == time)
+    return slots[*it];
+
+  // Spawn new event, reusing an existing slot if available.
+  unsigned newSlot;
+  if (!unusedSlots.empty()) {
+    newSlot = unusedSlots.pop_back_val();
+    slots[newSlot].unused = false;
+    slots[newSlot].time = time;
+  } else {
+    newSlot = slots.size();
+    slots.push_back(Slot(time));
   }
+  group.slots.insert(it, newSlot);
 
-  // We need to search through the queue for an existing slot only if we're
-  // spawning an event later than the top slot. Adding to an existing slot
-  // scheduled earlier than the top slot should never happens, as then it should
-  // be the top.
-  if (events > 0 && top.time < time) {
-    for (size_t i = 0, e = size(); i < e; ++i) {
-      if (time == begin()[i].time) {
-        return begin()[i];
-      }
-    }
+  ++events;
+  return slots[newSlot];
+}
+
+unsigned UpdateQueue::getOrCreateGroup(uint64_t time) {
+  // An empty queue can be freely repositioned at any time.
+  if (events == 0)
+    wheelTime = time;
+  else if (time == wheelTime)
+    return currentGroup;
+  else if (time < wheelTime)
+    rewind(time);
+
+  auto it = groupIndex.find(time);
+  if (it != groupIndex.end())
+    return it->second;
+
+  unsigned newGroup;
+  if (!unusedGroups.empty()) {
+    newGroup = unusedGroups.pop_back_val();
+  } else {
+    newGroup = groups.size();
+    groups.push_back(Group());
   }
+  groups[newGroup].time = time;
+  groupIndex.insert({time, newGroup});
+
+  if (time == wheelTime)
+    currentGroup = newGroup;
+  else
+    placeInWheel(newGroup);
+  return newGroup;
+}
 
-  // Spawn new event using an existing slot.
-  if (!unused.empty()) {
-    auto firstUnused = unused.pop_back_val();
-    auto &newSlot = begin()[firstUnused];
-    newSlot.unused = false;
-    newSlot.time = time;
+void UpdateQueue::placeInWheel(unsigned group) {
+  auto time = groups[group].time;
+  assert(time > wheelTime && "only future groups are stored in the wheel");
+
+  // The level is given by the most significant bit in which the group's time
+  // differs from the wheel time. All the more significant bits are shared, such
+  // that the bucket index is greater than the wheel time's one at that level.
+  unsigned level = llvm::Log2_64(time ^ wheelTime) / wheelBits;
+  unsigned bucket = (time >> (level * wheelBits)) & (wheelSize - 1);
+  wheel[level][bucket].push_back(group);
+  occupied[level] |= uint64_t(1) << bucket;
+}
 
-    // Update the top of the queue either if it is currently unused or the new
-    // timestamp is earlier than it.
-    if (top.unused || time < top.time)
-      topSlot = firstUnused;
+void UpdateQueue::releaseGroup(unsigned group) {
+  groupIndex.erase(groups[group].time);
+  unusedGroups.push_back(group);
+}
 
-    ++events;
-    return newSlot;
+void UpdateQueue::rewind(uint64_t time) {
+  assert(time < wheelTime && "can only rewind to an earlier time");
+
+  // Gather all the pending groups and place them again relative to the new
+  // wheel time. This only happens if events are scheduled before the current
+  // top of the queue, e.g. while initializing the simulation, so it does not
+  // need to be fast.
+  llvm::SmallVector<unsigned, 8> pending;
+  if (groups[currentGroup].slots.empty())
+    releaseGroup(currentGroup);
+  else
+    pending.push_back(currentGroup);
+  for (unsigned level = 0; level < wheelLevels; ++level) {
+    for (auto &bucket : wheel[level]) {
+      pending.append(bucket.begin(), bucket.end());
+      bucket.clear();
+    }
+    occupied[level] = 0;
   }
 
-  // We do not have pre-allocated slots available, generate a new one.
-  push_back(Slot(time));
+  wheelTime = time;
+  for (auto group : pending)
+    placeInWheel(group);
+}
 
-  // Update the top of the queue either if it is currently unused or the new
-  // timestamp is earlier than it.
-  if (top.unused || time < top.time)
-    topSlot = size() - 1;
+void UpdateQueue::advance() {
+  while (true) {
+    // The lowest non-empty level holds the earliest groups.
+    unsigned level = 0;
+    while (level < wheelLevels && occupied[level] == 0)
+      ++level;
+    assert(level < wheelLevels && "no pending groups in the wheel");
+
+    unsigned bucket = llvm::countTrailingZeros(occupied[level]);
+    occupied[level] &= ~(uint64_t(1) << bucket);
+    auto pending = std::move(wheel[level][bucket]);
+    wheel[level][bucket].clear();
+
+    // Buckets of the first level hold exactly one real-time value.
+    if (level == 0) {
+      assert(pending.size() == 1 && "expected a single group per bucket");
+      currentGroup = pending.front();
+      wheelTime = groups[currentGroup].time;
+      return;
+    }
 
-  ++events;
-  return back();
+    // Move the wheel to the start of the bucket and cascade its groups down to
+    // the lower levels. The group at the very start of the bucket, if any,
+    // becomes the current one.
+    unsigned shift = level * wheelBits;
+    uint64_t mask = shift + wheelBits >= 64
+                        ? ~uint64_t(0)
+                        : (uint64_t(1) << (shift + wheelBits)) - 1;
+    wheelTime = (wheelTime & ~mask) | (uint64_t(bucket) << shift);
+
+    bool found = false;
+    for (auto group : pending) {
+      if (groups[group].time == wheelTime) {
+        currentGroup = group;
+        found = true;
+        continue;
+      }
+      placeInWheel(group);
+    }
+    if (found)
+      return;
+  }
 }
 
 const Slot &UpdateQueue::top() {
-  assert(topSlot < size() && "top is pointing out of bounds!");
+  assert(events > 0 && "the event queue is empty");
 
   // Sort the changes of the top slot such that all changes to the same signal
   // are in succession.
-  auto &top = begin()[topSlot];
+  // Move on to the next real-time value once all the delta steps of the current
+  // one are done. This is deferred until here, as the instances woken up by
+  // the last popped slot still schedule events relative to its time.
+  if (groups[currentGroup].slots.empty()) {
+    releaseGroup(currentGroup);
+    advance();
+  }
+
+  auto &top = slots[groups[currentGroup].slots.front()];
   llvm::sort(top.changes.begin(), top.changes.begin() + top.changesSize);
   return top;
 }
 
 void UpdateQueue::pop() {
+  assert(events > 0 && "the event queue is empty");
+
   // Reset internal structures and decrease the event counter.
-  auto &curr = begin()[topSlot];
+  auto &group = groups[currentGroup];
+  auto topSlot = group.slots.front();
+  auto &curr = slots[topSlot];
   curr.unused = true;
-  curr.changesSize = 0;
-  curr.scheduled.clear();
-  curr.changes.clear();
+  curr.clear();
   curr.time = Time();
   --events;
 
   // Add to unused slots list for easy retrieval.
-  unused.push_back(topSlot);
-
-  // Update the current top of the queue.
-  topSlot = std::distance(
-      begin(),
-      std::min_element(begin(), end(), [](const auto &a, const auto &b) {
-        // a is "smaller" than b if either a's timestamp is earlier than b's, or
-        // b is unused (i.e. b has no actual meaning).
-        return !a.unused && (a < b || b.unused);
-      }));
+  unusedSlots.push_back(topSlot);
+  group.slots.erase(group.slots.begin());
+
+  // An empty queue does not keep any group around, otherwise the empty group
+  // is released on the next call to top().
+  if (events == 0)
+    releaseGroup(currentGroup);
+}
+
+void UpdateQueue::forEachSlot(llvm::function_ref<void(const Slot &)> fn) const {
+  for (const auto &slot : slots)
+    if (!slot.unused)
+      fn(slot);
+}
+
+//===----------------------------------------------------------------------===//
+// DeferredEvents
+//===----------------------------------------------------------------------===//
+
+void DeferredEvents::insertDrive(Time time, unsigned index, int bitOffset,
+                                 uint8_t *bytes, unsigned width) {
+  // The change buffers read the value as 64 bit words, but only the bytes
+  // holding the value can be read from the source. Copy those in a zero-padded
+  // buffer.
+  llvm::SmallVector<uint64_t, 1> value(llvm::divideCeil(width, 64), 0);
+  std::memcpy(value.data(), bytes, llvm::divideCeil(width, 8));
+  drives.push_back(Drive{time, index, bitOffset, width, std::move(value)});
+}
+
+void DeferredEvents::apply(State &state) {
+  for (auto &drive : drives)
+    state.queue.insertOrUpdate(drive.time, drive.index, drive.bitOffset,
+                               reinterpret_cast<uint8_t *>(drive.value.data()),
+                               drive.width);
+  for (auto &wakeup : wakeups)
+    state.pushQueue(wakeup.first, wakeup.second);
+  drives.clear();
+  wakeups.clear();
 }
 
 //===----------------------------------------------------------------------===//
@@ -226,12 +405,14 @@ int State::addSignal(std::string name, std::string owner) {
   return signals.size() - 1;
 }
 
-void State::addProcPtr(std::string name, ProcState *procStatePtr) {
+void State::addProcPtr(std::string name, ProcState *procStatePtr,
+                       uint64_t size) {
   auto it = getInstanceIterator(name);
 
   // Store instance index in process state.
   procStatePtr->inst = it - instances.begin();
   (*it).procState = std::unique_ptr<ProcState>(procStatePtr);
+  (*it).stateSize = size;
 }
 
 int State::addSignalData(int index, std::string owner, uint8_t *value,
@@ -246,13 +427,11 @@ int State::addSignalData(int index, std::string owner, uint8_t *value,
 
   // Add the value pointer to the signal detail struct for each instance this
   // signal appears in.
-  for (auto inst : signals[globalIdx].getTriggeredInstanceIndices()) {
-    for (auto &detail : instances[inst].sensitivityList) {
-      if (detail.globalIndex == globalIdx) {
-        detail.value = sig.getValue();
-      }
-    }
-  }
+  const auto &triggers = sig.getTriggeredInstanceIndices();
+  const auto &senseIndices = sig.getTriggeredSenseIndices();
+  for (size_t i = 0, e = triggers.size(); i < e; ++i)
+    instances[triggers[i]].sensitivityList[senseIndices[i]].value =
+        sig.getValue();
   return globalIdx;
 }
 
@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "circt/Dialect/LLHD/Simulator/Trace.h"
+#include "circt/Dialect/LLHD/Simulator/Waveform.h"
 
 #include "llvm/Support/raw_ostream.h"
 
@@ -20,6 +21,13 @@ using namespace circt::llhd::sim;
 Trace::Trace(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
              TraceMode mode)
     : out(out), state(state), mode(mode) {
+  // The waveform formats trace all the signals, streaming them directly from
+  // the state.
+  if (mode == TraceMode::VCD)
+    writer = createVCDWriter(*state, out);
+  else if (mode == TraceMode::Binary)
+    writer = createBinaryWaveWriter(*state, out);
+
   auto root = state->root;
   for (auto &sig : state->signals) {
     bool done = (mode != TraceMode::Full && mode != TraceMode::Merged &&
@@ -29,6 +37,8 @@ Trace::Trace(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
   }
 }
 
+Trace::~Trace() = default;
+
 //===----------------------------------------------------------------------===//
 // Changes gathering methods
 //===----------------------------------------------------------------------===//
@@ -73,6 +83,11 @@ void Trace::pushAllChanges(unsigned inst, unsigned sigIndex) {
 }
 
 void Trace::addChange(unsigned sigIndex) {
+  if (writer) {
+    writer->addChange(sigIndex);
+    return;
+  }
+
   currentTime = state->time;
   if (isTraced[sigIndex]) {
     if (mode == TraceMode::Full) {
@@ -119,6 +134,11 @@ void Trace::sortChanges() {
 }
 
 void Trace::flush(bool force) {
+  if (writer) {
+    writer->flush(force);
+    return;
+  }
+
   if (mode == TraceMode::Full || mode == TraceMode::Reduced)
     flushFull();
   else if (mode == TraceMode::Merged || mode == TraceMode::MergedReduce ||
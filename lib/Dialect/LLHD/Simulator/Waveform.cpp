@@ -0,0 +1,331 @@
+//===- Waveform.cpp - Simulation waveform writers -------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the streaming waveform writers used by the llhd-sim
+// tool to dump signal traces in the VCD and in a compact binary format.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/LLHD/Simulator/Waveform.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+//===----------------------------------------------------------------------===//
+// WaveformWriter
+//===----------------------------------------------------------------------===//
+
+void WaveformWriter::initialize() {
+  initialized = true;
+
+  size_t valueOffset = 0;
+  for (unsigned i = 0, e = state.signals.size(); i < e; ++i) {
+    auto &sig = state.signals[i];
+    firstEntry.push_back(entries.size());
+    if (sig.hasElement()) {
+      for (unsigned j = 0, f = sig.getElementSize(); j < f; ++j) {
+        auto elem = sig.getElement(j);
+        entries.push_back({i, elem.first, elem.second, valueOffset});
+        valueOffset += elem.second;
+      }
+    } else {
+      entries.push_back({i, 0, static_cast<unsigned>(sig.getSize()),
+                         valueOffset});
+      valueOffset += sig.getSize();
+    }
+  }
+  firstEntry.push_back(entries.size());
+
+  lastValues.resize(valueOffset);
+  isDirty.resize(state.signals.size());
+  writeHeader();
+}
+
+std::string WaveformWriter::getEntryName(unsigned entry, unsigned inst) const {
+  auto &sig = state.signals[entries[entry].sigIndex];
+  std::string name;
+  raw_string_ostream ss(name);
+  ss << state.instances[inst].path << '/' << sig.getName();
+  if (sig.hasElement())
+    ss << '[' << entry - firstEntry[entries[entry].sigIndex] << ']';
+  return ss.str();
+}
+
+SmallVector<unsigned, 4>
+WaveformWriter::getSignalInstances(unsigned sigIndex) const {
+  auto &insts = state.signals[sigIndex].getTriggeredInstanceIndices();
+  SmallVector<unsigned, 4> result(insts.begin(), insts.end());
+  llvm::sort(result);
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+void WaveformWriter::addChange(unsigned sigIndex) {
+  if (!initialized)
+    initialize();
+
+  currentTime = state.time.getTime();
+  if (!isDirty.test(sigIndex)) {
+    isDirty.set(sigIndex);
+    dirty.push_back(sigIndex);
+  }
+}
+
+void WaveformWriter::flush(bool force) {
+  if (!initialized || (!force && state.time.getTime() <= currentTime))
+    return;
+
+  // Write the entries of the changed signals in index order, skipping the ones
+  // that changed back to their last written value within the time step.
+  llvm::sort(dirty);
+  bool stepStarted = false;
+  for (auto sigIndex : dirty) {
+    isDirty.reset(sigIndex);
+    auto *sigValue = state.signals[sigIndex].getValue();
+    for (unsigned i = firstEntry[sigIndex], e = firstEntry[sigIndex + 1];
+         i < e; ++i) {
+      auto &entry = entries[i];
+      auto *value = sigValue + entry.offset;
+      auto *last = lastValues.data() + entry.lastValue;
+      if (!firstStep && std::memcmp(value, last, entry.size) == 0)
+        continue;
+
+      if (!stepStarted) {
+        beginTimeStep(currentTime);
+        stepStarted = true;
+      }
+      writeChange(i, value);
+      std::memcpy(last, value, entry.size);
+    }
+  }
+  dirty.clear();
+
+  if (stepStarted) {
+    endTimeStep();
+    firstStep = false;
+  }
+  if (force)
+    flushBuffers();
+}
+
+//===----------------------------------------------------------------------===//
+// VCDWriter
+//===----------------------------------------------------------------------===//
+
+namespace {
+class VCDWriter : public WaveformWriter {
+public:
+  using WaveformWriter::WaveformWriter;
+
+private:
+  /// One level of the instance hierarchy.
+  struct Scope {
+    std::map<std::string, std::unique_ptr<Scope>> children;
+    std::vector<std::pair<std::string, unsigned>> vars;
+  };
+
+  /// Write the printable identifier code of an entry. Codes are the base 94
+  /// representation of the entry index, using the characters '!' to '~'.
+  void writeCode(unsigned entry);
+
+  void writeScope(StringRef name, const Scope &scope);
+
+  void writeHeader() override;
+  void beginTimeStep(uint64_t time) override;
+  void writeChange(unsigned entry, const uint8_t *value) override;
+  void flushBuffers() override { out.flush(); }
+};
+} // namespace
+
+void VCDWriter::writeCode(unsigned entry) {
+  char buffer[8];
+  unsigned size = 0;
+  do {
+    buffer[size++] = '!' + entry % 94;
+    entry /= 94;
+  } while (entry > 0);
+  out.write(buffer, size);
+}
+
+void VCDWriter::writeScope(StringRef name, const Scope &scope) {
+  out << "$scope module " << name << " $end\n";
+  for (auto &var : scope.vars) {
+    out << "$var wire " << entries[var.second].size * 8 << ' ';
+    writeCode(var.second);
+    out << ' ' << var.first << " $end\n";
+  }
+  for (auto &child : scope.children)
+    writeScope(child.first, *child.second);
+  out << "$upscope $end\n";
+}
+
+void VCDWriter::writeHeader() {
+  // Build the instance hierarchy from the instance paths, and declare each
+  // entry in every instance its signal appears in, always with the same code.
+  Scope top;
+  for (unsigned i = 0, e = entries.size(); i < e; ++i) {
+    for (auto inst : getSignalInstances(entries[i].sigIndex)) {
+      auto *scope = &top;
+      SmallVector<StringRef, 4> path;
+      StringRef(state.instances[inst].path).split(path, '/');
+      for (auto name : path) {
+        auto &child = scope->children[name.str()];
+        if (!child)
+          child = std::make_unique<Scope>();
+        scope = child.get();
+      }
+      auto name = StringRef(getEntryName(i, inst)).rsplit('/').second;
+      scope->vars.push_back(std::make_pair(name.str(), i));
+    }
+  }
+
+  out << "$version llhd-sim $end\n";
+  out << "$timescale 1ps $end\n";
+  for (auto &child : top.children)
+    writeScope(child.first, *child.second);
+  out << "$enddefinitions $end\n";
+}
+
+void VCDWriter::beginTimeStep(uint64_t time) { out << '#' << time << '\n'; }
+
+void VCDWriter::writeChange(unsigned entry, const uint8_t *value) {
+  // Write the value in binary, omitting the leading zeros.
+  SmallString<64> bits;
+  for (int i = entries[entry].size - 1; i >= 0; --i)
+    for (int j = 7; j >= 0; --j)
+      if (!bits.empty() || (value[i] >> j) & 1)
+        bits.push_back((value[i] >> j) & 1 ? '1' : '0');
+  if (bits.empty())
+    bits.push_back('0');
+
+  out << 'b' << bits << ' ';
+  writeCode(entry);
+  out << '\n';
+}
+
+std::unique_ptr<WaveformWriter>
+circt::llhd::sim::createVCDWriter(const State &state, llvm::raw_ostream &out) {
+  return std::make_unique<VCDWriter>(state, out);
+}
+
+//===----------------------------------------------------------------------===//
+// BinaryWaveWriter
+//===----------------------------------------------------------------------===//
+
+namespace {
+class BinaryWaveWriter : public WaveformWriter {
+public:
+  BinaryWaveWriter(const State &state, llvm::raw_ostream &out)
+      : WaveformWriter(state, out), blockOS(block) {}
+
+private:
+  /// The block size after which a new block is started.
+  static constexpr size_t blockSizeLimit = 1 << 16;
+  static constexpr unsigned formatVersion = 1;
+
+  /// Write a length-prefixed string.
+  void writeString(StringRef str);
+
+  void writeHeader() override;
+  void beginTimeStep(uint64_t time) override;
+  void writeChange(unsigned entry, const uint8_t *value) override;
+  void endTimeStep() override;
+  void flushBuffers() override;
+
+  // The block currently being built.
+  SmallVector<char, 0> block;
+  raw_svector_ostream blockOS;
+  uint64_t blockStart = 0;
+  uint64_t numSteps = 0;
+  uint64_t prevTime = 0;
+  // The index of the entry following the last written one in the time step.
+  unsigned nextEntry = 0;
+};
+} // namespace
+
+void BinaryWaveWriter::writeString(StringRef str) {
+  encodeULEB128(str.size(), out);
+  out << str;
+}
+
+void BinaryWaveWriter::writeHeader() {
+  out << "LLHDWAVE";
+  encodeULEB128(formatVersion, out);
+
+  // Declare the size and all the hierarchical names of each entry.
+  encodeULEB128(entries.size(), out);
+  for (unsigned i = 0, e = entries.size(); i < e; ++i) {
+    auto insts = getSignalInstances(entries[i].sigIndex);
+    encodeULEB128(entries[i].size, out);
+    encodeULEB128(insts.size(), out);
+    for (auto inst : insts)
+      writeString(getEntryName(i, inst));
+  }
+}
+
+void BinaryWaveWriter::beginTimeStep(uint64_t time) {
+  if (numSteps == 0) {
+    blockStart = time;
+    prevTime = time;
+  }
+  encodeULEB128(time - prevTime, blockOS);
+  prevTime = time;
+  nextEntry = 0;
+  ++numSteps;
+}
+
+void BinaryWaveWriter::writeChange(unsigned entry, const uint8_t *value) {
+  // Entries are written in increasing order, such that the distance from the
+  // next expected one is encoded, offset by one to leave zero as terminator.
+  encodeULEB128(entry - nextEntry + 1, blockOS);
+  nextEntry = entry + 1;
+
+  // Store the bytes that differ from the last value, up to the highest one.
+  auto &desc = entries[entry];
+  auto *last = lastValues.data() + desc.lastValue;
+  unsigned size = desc.size;
+  while (size > 0 && value[size - 1] == last[size - 1])
+    --size;
+  encodeULEB128(size, blockOS);
+  for (unsigned i = 0; i < size; ++i)
+    blockOS << static_cast<char>(value[i] ^ last[i]);
+}
+
+void BinaryWaveWriter::endTimeStep() {
+  encodeULEB128(0, blockOS);
+  if (block.size() >= blockSizeLimit)
+    flushBuffers();
+}
+
+void BinaryWaveWriter::flushBuffers() {
+  if (numSteps > 0) {
+    out << 'B';
+    encodeULEB128(blockStart, out);
+    encodeULEB128(numSteps, out);
+    encodeULEB128(block.size(), out);
+    out << StringRef(block.data(), block.size());
+    block.clear();
+    numSteps = 0;
+  }
+  out.flush();
+}
+
+std::unique_ptr<WaveformWriter>
+circt::llhd::sim::createBinaryWaveWriter(const State &state,
+                                         llvm::raw_ostream &out) {
+  return std::make_unique<BinaryWaveWriter>(state, out);
+}
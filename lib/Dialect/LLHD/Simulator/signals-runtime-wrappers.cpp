@@ -18,6 +18,10 @@
 using namespace llvm;
 using namespace circt::llhd::sim;
 
+/// The buffer collecting the events scheduled by the instance currently running
+/// on this thread, if the instances are evaluated in parallel.
+static thread_local DeferredEvents *deferredEvents = nullptr;
+
 //===----------------------------------------------------------------------===//
 // Runtime interface
 //===----------------------------------------------------------------------===//
@@ -41,16 +45,25 @@ void addSigStructElement(State *state, unsigned index, unsigned offset,
   state->addSignalElement(index, offset, size);
 }
 
-void allocProc(State *state, char *owner, ProcState *procState) {
+void allocProc(State *state, char *owner, ProcState *procState,
+               int64_t size) {
   assert(state && "alloc_proc: state not found");
   std::string sOwner(owner);
-  state->addProcPtr(sOwner, procState);
+  state->addProcPtr(sOwner, procState, size);
 }
 
-void allocEntity(State *state, char *owner, uint8_t *entityState) {
+void addProcPointer(State *state, char *owner, int64_t offset) {
+  assert(state && "add_proc_pointer: state not found");
+  auto it = state->getInstanceIterator(owner);
+  (*it).procStatePointers.push_back(offset);
+}
+
+void allocEntity(State *state, char *owner, uint8_t *entityState,
+                 int64_t size) {
   assert(state && "alloc_entity: state not found");
   auto it = state->getInstanceIterator(owner);
   (*it).entityState = std::unique_ptr<uint8_t>(entityState);
+  (*it).stateSize = size;
 }
 
 void driveSignal(State *state, SignalDetail *detail, uint8_t *value,
@@ -64,8 +77,13 @@ void driveSignal(State *state, SignalDetail *detail, uint8_t *value,
       (detail->value - state->signals[globalIndex].getValue()) * 8 + offset;
 
   // Spawn a new event.
-  state->queue.insertOrUpdate(state->time + Time(time, delta, eps), globalIndex,
-                              bitOffset, value, width);
+  auto driveTime = state->time + Time(time, delta, eps);
+  if (deferredEvents)
+    deferredEvents->insertDrive(driveTime, globalIndex, bitOffset, value,
+                                width);
+  else
+    state->queue.insertOrUpdate(driveTime, globalIndex, bitOffset, value,
+                                width);
 }
 
 void llhdSuspend(State *state, ProcState *procState, int time, int delta,
@@ -73,6 +91,11 @@ void llhdSuspend(State *state, ProcState *procState, int time, int delta,
   // Add a new scheduled wake up if a time is specified.
   if (time || delta || eps) {
     Time sTime(time, delta, eps);
-    state->pushQueue(sTime, procState->inst);
+    if (deferredEvents)
+      deferredEvents->insertWakeup(sTime, procState->inst);
+    else
+      state->pushQueue(sTime, procState->inst);
   }
 }
+
+void llhdDeferEvents(DeferredEvents *events) { deferredEvents = events; }
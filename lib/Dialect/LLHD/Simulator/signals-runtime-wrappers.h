@@ -36,13 +36,20 @@ void addSigArrayElements(circt::llhd::sim::State *state, unsigned index,
 void addSigStructElement(circt::llhd::sim::State *state, unsigned index,
                          unsigned offset, unsigned size);
 
-/// Add allocated constructs to a process instance.
+/// Add allocated constructs to a process instance. The size of the process
+/// state, including its persistence struct, is given in bytes.
 void allocProc(circt::llhd::sim::State *state, char *owner,
-               circt::llhd::sim::ProcState *procState);
+               circt::llhd::sim::ProcState *procState, int64_t size);
 
-/// Add allocated entity state to the given instance.
+/// Record that the process state of the given instance holds a pointer at the
+/// given offset in bytes.
+void addProcPointer(circt::llhd::sim::State *state, char *owner,
+                    int64_t offset);
+
+/// Add allocated entity state of the given size in bytes to the given
+/// instance.
 void allocEntity(circt::llhd::sim::State *state, char *owner,
-                 uint8_t *entityState);
+                 uint8_t *entityState, int64_t size);
 
 /// Drive a value onto a signal.
 void driveSignal(circt::llhd::sim::State *state,
@@ -53,6 +60,11 @@ void driveSignal(circt::llhd::sim::State *state,
 void llhdSuspend(circt::llhd::sim::State *state,
                  circt::llhd::sim::ProcState *procState, int time, int delta,
                  int eps);
+
+/// Buffer the events scheduled on the calling thread in the given structure
+/// instead of inserting them in the queue. Passing null restores the default
+/// behavior.
+void llhdDeferEvents(circt::llhd::sim::DeferredEvents *events);
 }
 
 #endif // CIRCT_DIALECT_LLHD_SIMULATOR_SIGNALS_RUNTIME_WRAPPERS_H
@@ -0,0 +1,1067 @@
+//===- BinaryIR.cpp - Binary IR serialization -----------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the binary serialization of MLIR operations.  A file
+// is laid out as follows, where all integers are LEB128 varints:
+//
+//   file       ::= magic version strings dialects opNames types attributes
+//                  locations op
+//   strings    ::= count (size bytes)*
+//   dialects   ::= count string*
+//   opNames    ::= count string*
+//   types      ::= count string*                     (textual form)
+//   attributes ::= count (kind payload)*
+//   locations  ::= count (kind payload)*
+//   op         ::= opName location attrDict+1 results operands successors
+//                  regions
+//   results    ::= count type*
+//   operands   ::= count (value type?)*
+//   successors ::= count block*
+//   regions    ::= count (isolated (size region* | region*))?
+//   region     ::= count (count (type location)* count op*)*
+//
+// Attributes and locations only refer to the entries before them in their
+// table.  Values are numbered in the order in which they are defined within a
+// section: the arguments of a block before its operations, and the results of
+// an operation after its regions.  An operand whose value is not defined yet
+// is followed by the type of the value.  The regions of an operation isolated
+// from above form a new section, whose size is stored first.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Support/BinaryIR.h"
+#include "mlir/IR/BuiltinAttributes.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/Diagnostics.h"
+#include "mlir/IR/Dialect.h"
+#include "mlir/IR/Location.h"
+#include "mlir/IR/SubElementInterfaces.h"
+#include "mlir/IR/Threading.h"
+#include "mlir/IR/Verifier.h"
+#include "mlir/Parser/Parser.h"
+#include "mlir/Tools/mlir-translate/Translation.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+
+using namespace circt;
+using namespace mlir;
+
+/// The magic number at the start of every binary IR file.  The first byte is
+/// not valid in textual MLIR.
+static constexpr StringLiteral magic = "\x89"
+                                       "CIRCTIR";
+
+/// Bump this whenever the format changes.
+static constexpr uint64_t version = 1;
+
+namespace {
+/// The kinds of entries of the attribute table.
+enum class AttrKind : uint8_t {
+  Text,
+  String,
+  FlatSymbolRef,
+  Array,
+  Dictionary,
+  Integer,
+  Type,
+  Unit
+};
+
+/// The kinds of entries of the location table.
+enum class LocKind : uint8_t { Unknown, FileLineCol, Name, CallSite, Fused };
+} // namespace
+
+bool circt::isBinaryIR(StringRef buffer) { return buffer.startswith(magic); }
+
+//===----------------------------------------------------------------------===//
+// Writer
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// An in-memory buffer of encoded data.
+struct Encoder {
+  void emitByte(uint8_t byte) { data.push_back(byte); }
+  void emitVarInt(uint64_t value) {
+    uint8_t bytes[16];
+    unsigned size = llvm::encodeULEB128(value, bytes);
+    data.append(bytes, bytes + size);
+  }
+  void emitSignedVarInt(int64_t value) {
+    uint8_t bytes[16];
+    unsigned size = llvm::encodeSLEB128(value, bytes);
+    data.append(bytes, bytes + size);
+  }
+  void emitBytes(StringRef bytes) { data.append(bytes.begin(), bytes.end()); }
+  void emitEncoder(const Encoder &other) {
+    data.append(other.data.begin(), other.data.end());
+  }
+  StringRef getData() const {
+    return StringRef(reinterpret_cast<const char *>(data.data()), data.size());
+  }
+
+  SmallVector<uint8_t, 0> data;
+};
+
+/// A table of uniqued entries, along with their encoding.
+template <typename T>
+struct EncoderTable {
+  DenseMap<T, unsigned> ids;
+  unsigned size = 0;
+  Encoder encoder;
+};
+
+/// The values of a section, numbered in their order of definition.
+struct WriterSection {
+  DenseMap<Value, unsigned> valueIDs;
+  /// The number of values which were encoded so far.
+  unsigned numDefined = 0;
+};
+
+class BinaryIRWriter {
+public:
+  void write(Operation *root, raw_ostream &os);
+
+private:
+  unsigned getString(StringRef string);
+  void addDialect(Dialect *dialect);
+  void addDialects(Type type);
+  void addDialects(Attribute attr);
+  unsigned getOpName(OperationName name);
+  unsigned getType(Type type);
+  unsigned getAttr(Attribute attr);
+  unsigned getLoc(Location loc);
+
+  void numberRegions(Operation *op, WriterSection &section);
+  void encodeOp(Operation *op, WriterSection &section, Encoder &encoder);
+  void encodeRegion(Region &region, WriterSection &section,
+                    Encoder &encoder);
+
+  llvm::StringMap<unsigned> stringIDs;
+  SmallVector<StringRef> strings;
+  EncoderTable<Dialect *> dialects;
+  EncoderTable<OperationName> opNames;
+  EncoderTable<Type> types;
+  EncoderTable<Attribute> attrs;
+  EncoderTable<Location> locs;
+};
+} // namespace
+
+unsigned BinaryIRWriter::getString(StringRef string) {
+  auto [it, inserted] = stringIDs.try_emplace(string, strings.size());
+  if (inserted)
+    strings.push_back(it->getKey());
+  return it->second;
+}
+
+void BinaryIRWriter::addDialect(Dialect *dialect) {
+  if (dialects.ids.try_emplace(dialect, dialects.size).second) {
+    dialects.encoder.emitVarInt(getString(dialect->getNamespace()));
+    ++dialects.size;
+  }
+}
+
+/// Add the dialects of a type stored as text, and of the types and attributes
+/// nested in it, which must all be loaded to parse it back.
+void BinaryIRWriter::addDialects(Type type) {
+  addDialect(&type.getDialect());
+  if (auto elements = type.dyn_cast<SubElementTypeInterface>())
+    elements.walkSubElements(
+        [&](Attribute attr) { addDialect(&attr.getDialect()); },
+        [&](Type type) { addDialect(&type.getDialect()); });
+}
+
+/// Add the dialects of an attribute stored as text, and of the types and
+/// attributes nested in it.
+void BinaryIRWriter::addDialects(Attribute attr) {
+  addDialect(&attr.getDialect());
+  if (auto elements = attr.dyn_cast<SubElementAttrInterface>())
+    elements.walkSubElements(
+        [&](Attribute attr) { addDialect(&attr.getDialect()); },
+        [&](Type type) { addDialect(&type.getDialect()); });
+}
+
+unsigned BinaryIRWriter::getOpName(OperationName name) {
+  auto it = opNames.ids.find(name);
+  if (it != opNames.ids.end())
+    return it->second;
+  if (auto *dialect = name.getDialect())
+    addDialect(dialect);
+  opNames.encoder.emitVarInt(getString(name.getStringRef()));
+  opNames.ids.insert({name, opNames.size});
+  return opNames.size++;
+}
+
+unsigned BinaryIRWriter::getType(Type type) {
+  auto it = types.ids.find(type);
+  if (it != types.ids.end())
+    return it->second;
+  addDialects(type);
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  type.print(os);
+  types.encoder.emitVarInt(getString(os.str()));
+  types.ids.insert({type, types.size});
+  return types.size++;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+unsigned BinaryIRWriter::getAttr(Attribute attr) {
+  auto it = attrs.ids.find(attr);
+  if (it != attrs.ids.end())
+    return it->second;
+
+  // The entries this one refers to are added to the table first.
+  Encoder entry;
+  if (auto string = attr.dyn_cast<StringAttr>();
+      string && string.getType().isa<NoneType>()) {
+    entry.emitByte(uint8_t(AttrKind::String));
+    entry.emitVarInt(getString(string.getValue()));
+  } else if (auto symbol = attr.dyn_cast<FlatSymbolRefAttr>()) {
+    entry.emitByte(uint8_t(AttrKind::FlatSymbolRef));
+    entry.emitVarInt(getString(symbol.getValue()));
+  } else if (auto array = attr.dyn_cast<ArrayAttr>()) {
+    SmallVector<unsigned> elements;
+    for (auto element : array)
+      elements.push_back(getAttr(element));
+    entry.emitByte(uint8_t(AttrKind::Array));
+    entry.emitVarInt(elements.size());
+    for (auto element : elements)
+      entry.emitVarInt(element);
+  } else if (auto dict = attr.dyn_cast<DictionaryAttr>()) {
+    SmallVector<std::pair<unsigned, unsigned>> elements;
+    for (auto namedAttr : dict)
+      elements.emplace_back(getString(namedAttr.getName().getValue()),
+                            getAttr(namedAttr.getValue()));
+    entry.emitByte(uint8_t(AttrKind::Dictionary));
+    entry.emitVarInt(elements.size());
+    for (auto [name, value] : elements) {
+      entry.emitVarInt(name);
+      entry.emitVarInt(value);
+    }
+  } else if (auto integer = attr.dyn_cast<IntegerAttr>();
+             integer && integer.getType().isSignlessIntOrIndex() &&
+             integer.getValue().getBitWidth() != 0 &&
+             integer.getValue().getBitWidth() <= 64) {
+    auto type = getType(integer.getType());
+    entry.emitByte(uint8_t(AttrKind::Integer));
+    entry.emitVarInt(type);
+    entry.emitSignedVarInt(integer.getValue().getSExtValue());
+  } else if (auto typeAttr = attr.dyn_cast<TypeAttr>()) {
+    auto type = getType(typeAttr.getValue());
+    entry.emitByte(uint8_t(AttrKind::Type));
+    entry.emitVarInt(type);
+  } else if (attr.isa<UnitAttr>()) {
+    entry.emitByte(uint8_t(AttrKind::Unit));
+  } else {
+    addDialects(attr);
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    attr.print(os);
+    entry.emitByte(uint8_t(AttrKind::Text));
+    entry.emitVarInt(getString(os.str()));
+  }
+
+  attrs.encoder.emitEncoder(entry);
+  attrs.ids.insert({attr, attrs.size});
+  return attrs.size++;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+unsigned BinaryIRWriter::getLoc(Location loc) {
+  auto it = locs.ids.find(loc);
+  if (it != locs.ids.end())
+    return it->second;
+
+  // Opaque locations cannot be serialized, keep their fallback.
+  if (auto opaque = loc.dyn_cast<OpaqueLoc>()) {
+    auto id = getLoc(opaque.getFallbackLocation());
+    locs.ids.insert({loc, id});
+    return id;
+  }
+
+  Encoder entry;
+  if (auto fileLoc = loc.dyn_cast<FileLineColLoc>()) {
+    entry.emitByte(uint8_t(LocKind::FileLineCol));
+    entry.emitVarInt(getString(fileLoc.getFilename().getValue()));
+    entry.emitVarInt(fileLoc.getLine());
+    entry.emitVarInt(fileLoc.getColumn());
+  } else if (auto nameLoc = loc.dyn_cast<NameLoc>()) {
+    auto child = getLoc(nameLoc.getChildLoc());
+    entry.emitByte(uint8_t(LocKind::Name));
+    entry.emitVarInt(getString(nameLoc.getName().getValue()));
+    entry.emitVarInt(child);
+  } else if (auto callSite = loc.dyn_cast<CallSiteLoc>()) {
+    auto callee = getLoc(callSite.getCallee());
+    auto caller = getLoc(callSite.getCaller());
+    entry.emitByte(uint8_t(LocKind::CallSite));
+    entry.emitVarInt(callee);
+    entry.emitVarInt(caller);
+  } else if (auto fused = loc.dyn_cast<FusedLoc>()) {
+    unsigned metadata = 0;
+    if (auto attr = fused.getMetadata())
+      metadata = getAttr(attr) + 1;
+    SmallVector<unsigned> children;
+    for (auto child : fused.getLocations())
+      children.push_back(getLoc(child));
+    entry.emitByte(uint8_t(LocKind::Fused));
+    entry.emitVarInt(metadata);
+    entry.emitVarInt(children.size());
+    for (auto child : children)
+      entry.emitVarInt(child);
+  } else {
+    entry.emitByte(uint8_t(LocKind::Unknown));
+  }
+
+  locs.encoder.emitEncoder(entry);
+  locs.ids.insert({loc, locs.size});
+  return locs.size++;
+}
+
+/// Number the values defined in the regions of an operation, in the order in
+/// which they are encoded, without entering nested sections.
+// NOLINTNEXTLINE(misc-no-recursion)
+void BinaryIRWriter::numberRegions(Operation *op, WriterSection &section) {
+  for (auto &region : op->getRegions()) {
+    for (auto &block : region) {
+      for (auto arg : block.getArguments())
+        section.valueIDs.insert({arg, section.valueIDs.size()});
+      for (auto &nested : block) {
+        if (!nested.hasTrait<OpTrait::IsIsolatedFromAbove>())
+          numberRegions(&nested, section);
+        for (auto result : nested.getResults())
+          section.valueIDs.insert({result, section.valueIDs.size()});
+      }
+    }
+  }
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void BinaryIRWriter::encodeOp(Operation *op, WriterSection &section,
+                              Encoder &encoder) {
+  encoder.emitVarInt(getOpName(op->getName()));
+  encoder.emitVarInt(getLoc(op->getLoc()));
+  auto attrDict = op->getAttrDictionary();
+  encoder.emitVarInt(attrDict.empty() ? 0 : getAttr(attrDict) + 1);
+
+  encoder.emitVarInt(op->getNumResults());
+  for (auto type : op->getResultTypes())
+    encoder.emitVarInt(getType(type));
+
+  encoder.emitVarInt(op->getNumOperands());
+  for (auto operand : op->getOperands()) {
+    unsigned id = section.valueIDs.lookup(operand);
+    encoder.emitVarInt(id);
+    if (id >= section.numDefined)
+      encoder.emitVarInt(getType(operand.getType()));
+  }
+
+  encoder.emitVarInt(op->getNumSuccessors());
+  for (auto *successor : op->getSuccessors()) {
+    auto &blocks = successor->getParent()->getBlocks();
+    encoder.emitVarInt(std::distance(blocks.begin(), successor->getIterator()));
+  }
+
+  encoder.emitVarInt(op->getNumRegions());
+  if (op->getNumRegions() != 0) {
+    bool isolated = op->hasTrait<OpTrait::IsIsolatedFromAbove>();
+    encoder.emitByte(isolated);
+    if (isolated) {
+      WriterSection nestedSection;
+      numberRegions(op, nestedSection);
+      Encoder nested;
+      for (auto &region : op->getRegions())
+        encodeRegion(region, nestedSection, nested);
+      encoder.emitVarInt(nested.data.size());
+      encoder.emitEncoder(nested);
+    } else {
+      for (auto &region : op->getRegions())
+        encodeRegion(region, section, encoder);
+    }
+  }
+  section.numDefined += op->getNumResults();
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void BinaryIRWriter::encodeRegion(Region &region, WriterSection &section,
+                                  Encoder &encoder) {
+  encoder.emitVarInt(region.getBlocks().size());
+  for (auto &block : region) {
+    encoder.emitVarInt(block.getNumArguments());
+    for (auto arg : block.getArguments()) {
+      encoder.emitVarInt(getType(arg.getType()));
+      encoder.emitVarInt(getLoc(arg.getLoc()));
+    }
+    section.numDefined += block.getNumArguments();
+    encoder.emitVarInt(block.getOperations().size());
+    for (auto &op : block)
+      encodeOp(&op, section, encoder);
+  }
+}
+
+void BinaryIRWriter::write(Operation *root, raw_ostream &os) {
+  // Encode the operation first, which fills the tables.
+  WriterSection section;
+  if (!root->hasTrait<OpTrait::IsIsolatedFromAbove>())
+    numberRegions(root, section);
+  Encoder body;
+  encodeOp(root, section, body);
+
+  Encoder header;
+  header.emitBytes(magic);
+  header.emitVarInt(version);
+  header.emitVarInt(strings.size());
+  for (auto string : strings) {
+    header.emitVarInt(string.size());
+    header.emitBytes(string);
+  }
+  auto emitTable = [&](auto &table) {
+    header.emitVarInt(table.size);
+    header.emitEncoder(table.encoder);
+  };
+  emitTable(dialects);
+  emitTable(opNames);
+  emitTable(types);
+  emitTable(attrs);
+  emitTable(locs);
+
+  os << header.getData() << body.getData();
+}
+
+void circt::writeBinaryIR(Operation *op, raw_ostream &os) {
+  BinaryIRWriter().write(op, os);
+}
+
+//===----------------------------------------------------------------------===//
+// Reader
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A bounds-checked cursor into encoded data.  Reading past the end, or an
+/// index out of the bounds of a table, marks the data as malformed and moves
+/// the cursor to the end.
+struct Decoder {
+  Decoder(StringRef data) : ptr(data.bytes_begin()), end(data.bytes_end()) {}
+
+  uint8_t readByte() {
+    if (ptr == end) {
+      fail();
+      return 0;
+    }
+    return *ptr++;
+  }
+  uint64_t readVarInt() {
+    unsigned size;
+    const char *error = nullptr;
+    uint64_t value = llvm::decodeULEB128(ptr, &size, end, &error);
+    if (error) {
+      fail();
+      return 0;
+    }
+    ptr += size;
+    return value;
+  }
+  int64_t readSignedVarInt() {
+    unsigned size;
+    const char *error = nullptr;
+    int64_t value = llvm::decodeSLEB128(ptr, &size, end, &error);
+    if (error) {
+      fail();
+      return 0;
+    }
+    ptr += size;
+    return value;
+  }
+  /// Read an index into a table of the given size.
+  size_t readIndex(size_t size) {
+    uint64_t index = readVarInt();
+    if (index >= size) {
+      fail();
+      return 0;
+    }
+    return index;
+  }
+  /// Read an index into the given table, and return the entry.  Returns a
+  /// default-constructed entry on failure.
+  template <typename T>
+  T readEntry(ArrayRef<T> table) {
+    uint64_t index = readVarInt();
+    if (index >= table.size()) {
+      fail();
+      return T();
+    }
+    return table[index];
+  }
+  StringRef readBytes(uint64_t size) {
+    if (uint64_t(end - ptr) < size) {
+      fail();
+      return {};
+    }
+    StringRef bytes(reinterpret_cast<const char *>(ptr), size);
+    ptr += size;
+    return bytes;
+  }
+  StringRef getRemaining() const {
+    return StringRef(reinterpret_cast<const char *>(ptr), end - ptr);
+  }
+  bool atEnd() const { return ptr == end; }
+  void fail() {
+    failed = true;
+    ptr = end;
+  }
+
+  const uint8_t *ptr, *end;
+  bool failed = false;
+};
+
+/// An operation whose isolated regions are yet to be decoded.
+struct PendingSection {
+  Operation *op;
+  StringRef data;
+};
+
+/// The tables of a binary IR file, shared by all sections.
+struct ReaderTables {
+  SmallVector<StringRef> strings;
+  SmallVector<OperationName> opNames;
+  SmallVector<Type> types;
+  SmallVector<Attribute> attrs;
+  SmallVector<LocationAttr> locs;
+};
+
+/// Decodes the operations of one section.
+class SectionReader {
+public:
+  SectionReader(const ReaderTables &tables, MLIRContext *context,
+                StringRef data, bool deferSections)
+      : tables(tables), context(context), decoder(data),
+        deferSections(deferSections) {}
+
+  /// Decode the root operation.  Returns null if the data is malformed.
+  Operation *decodeRoot();
+
+  /// Decode the regions of an operation isolated from above.
+  LogicalResult decodeSection(Operation *op);
+
+  /// The operations whose sections were deferred.
+  SmallVector<PendingSection> pending;
+
+private:
+  Operation *decodeOp(ArrayRef<Block *> regionBlocks);
+  void decodeRegion(Region &region);
+  LogicalResult finish();
+
+  Location readLoc();
+  Value readValue();
+  void defineValue(Value value);
+
+  const ReaderTables &tables;
+  MLIRContext *context;
+  Decoder decoder;
+  bool deferSections;
+
+  /// The values of the section, and the placeholders of the values which are
+  /// used before they are defined.
+  SmallVector<Value> values;
+  DenseMap<unsigned, Operation *> forwardRefs;
+};
+} // namespace
+
+Location SectionReader::readLoc() {
+  if (auto loc = decoder.readEntry<LocationAttr>(tables.locs))
+    return loc;
+  return UnknownLoc::get(context);
+}
+
+Value SectionReader::readValue() {
+  // The largest IDs are reserved by the map of forward references.
+  unsigned id = decoder.readIndex(std::numeric_limits<unsigned>::max() - 1);
+  if (id < values.size())
+    return values[id];
+
+  // Create a placeholder for a value defined further down, which is replaced
+  // once the value is defined.
+  auto type = decoder.readEntry<Type>(tables.types);
+  if (!type)
+    return {};
+  auto &placeholder = forwardRefs[id];
+  if (!placeholder) {
+    OperationState state(UnknownLoc::get(context),
+                         UnrealizedConversionCastOp::getOperationName());
+    state.addTypes(type);
+    placeholder = Operation::create(state);
+  }
+  return placeholder->getResult(0);
+}
+
+void SectionReader::defineValue(Value value) {
+  values.push_back(value);
+  if (forwardRefs.empty())
+    return;
+  auto it = forwardRefs.find(values.size() - 1);
+  if (it == forwardRefs.end())
+    return;
+  it->second->getResult(0).replaceAllUsesWith(value);
+  it->second->destroy();
+  forwardRefs.erase(it);
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+Operation *SectionReader::decodeOp(ArrayRef<Block *> regionBlocks) {
+  auto nameIndex = decoder.readIndex(tables.opNames.size());
+  auto loc = readLoc();
+  auto attrIndex = decoder.readIndex(tables.attrs.size() + 1);
+  if (decoder.failed)
+    return nullptr;
+  OperationState state(loc, tables.opNames[nameIndex]);
+  if (attrIndex) {
+    auto dict = tables.attrs[attrIndex - 1].dyn_cast<DictionaryAttr>();
+    if (!dict) {
+      decoder.fail();
+      return nullptr;
+    }
+    state.attributes.append(dict.begin(), dict.end());
+  }
+
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed; ++i)
+    state.types.push_back(decoder.readEntry<Type>(tables.types));
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed; ++i)
+    state.operands.push_back(readValue());
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed; ++i)
+    state.successors.push_back(decoder.readEntry<Block *>(regionBlocks));
+
+  uint64_t numRegions = decoder.readVarInt();
+  bool isolated = numRegions != 0 && decoder.readByte();
+  for (uint64_t i = 0; i < numRegions && !decoder.failed; ++i)
+    state.addRegion();
+  StringRef sectionData;
+  if (isolated) {
+    sectionData = decoder.readBytes(decoder.readVarInt());
+  } else {
+    for (auto &region : state.regions)
+      decodeRegion(*region);
+  }
+  if (decoder.failed)
+    return nullptr;
+
+  auto *op = Operation::create(state);
+  for (auto result : op->getResults())
+    defineValue(result);
+
+  // Decode the regions of isolated operations later, possibly in parallel.
+  if (isolated) {
+    if (deferSections) {
+      pending.push_back({op, sectionData});
+    } else {
+      SectionReader nested(tables, context, sectionData, deferSections);
+      if (failed(nested.decodeSection(op)))
+        decoder.fail();
+    }
+  }
+  return op;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void SectionReader::decodeRegion(Region &region) {
+  // Create all the blocks first, such that successors can refer to them.
+  SmallVector<Block *> blocks;
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed;
+       ++i) {
+    blocks.push_back(new Block());
+    region.push_back(blocks.back());
+  }
+
+  for (auto *block : blocks) {
+    for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed;
+         ++i) {
+      auto type = decoder.readEntry<Type>(tables.types);
+      auto loc = readLoc();
+      if (!decoder.failed)
+        defineValue(block->addArgument(type, loc));
+    }
+    for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed;
+         ++i)
+      if (auto *op = decodeOp(blocks))
+        block->push_back(op);
+  }
+}
+
+LogicalResult SectionReader::finish() {
+  // Every value used must have been defined.  The placeholders of the others
+  // are dropped, leaving their users without an operand, which is fine since
+  // the IR is discarded.
+  bool malformed = decoder.failed || !decoder.atEnd() || !forwardRefs.empty();
+  for (auto &forwardRef : forwardRefs) {
+    forwardRef.second->getResult(0).dropAllUses();
+    forwardRef.second->destroy();
+  }
+  forwardRefs.clear();
+  return failure(malformed);
+}
+
+Operation *SectionReader::decodeRoot() {
+  auto *op = decodeOp({});
+  if (failed(finish())) {
+    if (op)
+      op->destroy();
+    return nullptr;
+  }
+  return op;
+}
+
+LogicalResult SectionReader::decodeSection(Operation *op) {
+  for (auto &region : op->getRegions())
+    decodeRegion(region);
+  return finish();
+}
+
+namespace {
+/// Reads a binary IR file.
+class BinaryIRReader {
+public:
+  BinaryIRReader(StringRef data, MLIRContext *context, Location errorLoc)
+      : decoder(data), context(context), errorLoc(errorLoc) {}
+
+  /// Read the tables at the start of the file.
+  LogicalResult readTables();
+
+  /// Read the operation following the tables.  Returns null on failure.
+  Operation *readRoot();
+
+private:
+  LogicalResult readAttributes();
+  void readLocations();
+
+  InFlightDiagnostic emitMalformedError(const Twine &message) {
+    return mlir::emitError(errorLoc, "malformed binary IR: ") << message;
+  }
+
+  Decoder decoder;
+  MLIRContext *context;
+  Location errorLoc;
+  ReaderTables tables;
+};
+} // namespace
+
+LogicalResult BinaryIRReader::readTables() {
+  decoder.readBytes(magic.size());
+  if (decoder.readVarInt() != version)
+    return mlir::emitError(errorLoc, "unsupported binary IR version");
+
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed; ++i)
+    tables.strings.push_back(decoder.readBytes(decoder.readVarInt()));
+  auto readString = [&]() {
+    return decoder.readEntry<StringRef>(tables.strings);
+  };
+
+  // Load all the dialects up front, since dialects cannot be loaded while
+  // types and attributes are parsed in parallel.
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed;
+       ++i) {
+    auto name = readString();
+    if (!decoder.failed && !context->getOrLoadDialect(name) &&
+        !context->allowsUnregisteredDialects())
+      return mlir::emitError(errorLoc, "dialect '")
+             << name << "' is not registered";
+  }
+
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed;
+       ++i) {
+    auto name = readString();
+    if (decoder.failed)
+      break;
+    OperationName opName(name, context);
+    if (!opName.isRegistered() && !context->allowsUnregisteredDialects())
+      return mlir::emitError(errorLoc, "operation '")
+             << name << "' is not registered";
+    tables.opNames.push_back(opName);
+  }
+
+  // Types are independent of each other, parse them in parallel.
+  SmallVector<StringRef> typeTexts;
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed; ++i)
+    typeTexts.push_back(readString());
+  if (decoder.failed)
+    return emitMalformedError("truncated type table");
+  tables.types.resize(typeTexts.size());
+  std::atomic<bool> typesFailed(false);
+  parallelForEachN(context, 0, typeTexts.size(), [&](size_t i) {
+    tables.types[i] = parseType(typeTexts[i], context);
+    if (!tables.types[i])
+      typesFailed = true;
+  });
+  if (typesFailed)
+    return emitMalformedError("invalid type");
+
+  if (failed(readAttributes()))
+    return failure();
+  readLocations();
+  if (decoder.failed)
+    return emitMalformedError("invalid location table");
+  return success();
+}
+
+LogicalResult BinaryIRReader::readAttributes() {
+  // Record where each entry starts, and parse the textual ones in parallel,
+  // since they do not refer to other entries.
+  SmallVector<std::pair<AttrKind, StringRef>> entries;
+  SmallVector<std::pair<size_t, StringRef>> texts;
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed;
+       ++i) {
+    auto kind = AttrKind(decoder.readByte());
+    entries.emplace_back(kind, decoder.getRemaining());
+    switch (kind) {
+    case AttrKind::Text:
+      texts.emplace_back(i, decoder.readEntry<StringRef>(tables.strings));
+      break;
+    case AttrKind::String:
+    case AttrKind::FlatSymbolRef:
+    case AttrKind::Type:
+      decoder.readVarInt();
+      break;
+    case AttrKind::Array:
+      for (uint64_t j = 0, e = decoder.readVarInt(); j < e && !decoder.failed;
+           ++j)
+        decoder.readVarInt();
+      break;
+    case AttrKind::Dictionary:
+      for (uint64_t j = 0, e = decoder.readVarInt(); j < e && !decoder.failed;
+           ++j) {
+        decoder.readVarInt();
+        decoder.readVarInt();
+      }
+      break;
+    case AttrKind::Integer:
+      decoder.readVarInt();
+      decoder.readSignedVarInt();
+      break;
+    case AttrKind::Unit:
+      break;
+    default:
+      decoder.fail();
+      break;
+    }
+  }
+  if (decoder.failed)
+    return emitMalformedError("truncated attribute table");
+
+  tables.attrs.resize(entries.size());
+  std::atomic<bool> textsFailed(false);
+  parallelForEach(context, texts, [&](std::pair<size_t, StringRef> &text) {
+    tables.attrs[text.first] = parseAttribute(text.second, context);
+    if (!tables.attrs[text.first])
+      textsFailed = true;
+  });
+  if (textsFailed)
+    return emitMalformedError("invalid attribute");
+
+  // Build the other entries in order, since they refer to earlier ones.
+  for (size_t i = 0, e = entries.size(); i != e; ++i) {
+    auto kind = entries[i].first;
+    Decoder entry(entries[i].second);
+    auto earlierAttrs = ArrayRef<Attribute>(tables.attrs).take_front(i);
+    auto readString = [&]() {
+      return entry.readEntry<StringRef>(tables.strings);
+    };
+    auto &attr = tables.attrs[i];
+    switch (kind) {
+    case AttrKind::Text:
+      break;
+    case AttrKind::String:
+      attr = StringAttr::get(context, readString());
+      break;
+    case AttrKind::FlatSymbolRef:
+      attr = FlatSymbolRefAttr::get(context, readString());
+      break;
+    case AttrKind::Array: {
+      SmallVector<Attribute> elements;
+      for (uint64_t j = 0, e = entry.readVarInt(); j < e && !entry.failed; ++j)
+        elements.push_back(entry.readEntry(earlierAttrs));
+      if (!entry.failed)
+        attr = ArrayAttr::get(context, elements);
+      break;
+    }
+    case AttrKind::Dictionary: {
+      SmallVector<NamedAttribute> elements;
+      for (uint64_t j = 0, e = entry.readVarInt(); j < e && !entry.failed;
+           ++j) {
+        auto name = StringAttr::get(context, readString());
+        elements.emplace_back(name, entry.readEntry(earlierAttrs));
+      }
+      if (!entry.failed)
+        attr = DictionaryAttr::getWithSorted(context, elements);
+      break;
+    }
+    case AttrKind::Integer: {
+      auto type = entry.readEntry<Type>(tables.types);
+      int64_t value = entry.readSignedVarInt();
+      if (!type || !type.isSignlessIntOrIndex())
+        break;
+      unsigned width = type.isIndex() ? IndexType::kInternalStorageBitWidth
+                                      : type.getIntOrFloatBitWidth();
+      attr = IntegerAttr::get(type, APInt(64, value).sextOrTrunc(width));
+      break;
+    }
+    case AttrKind::Type:
+      if (auto type = entry.readEntry<Type>(tables.types))
+        attr = TypeAttr::get(type);
+      break;
+    case AttrKind::Unit:
+      attr = UnitAttr::get(context);
+      break;
+    }
+    if (entry.failed || !attr)
+      return emitMalformedError("invalid attribute table entry ") << i;
+  }
+  return success();
+}
+
+void BinaryIRReader::readLocations() {
+  for (uint64_t i = 0, e = decoder.readVarInt(); i < e && !decoder.failed;
+       ++i) {
+    auto readLoc = [&]() -> Location {
+      if (auto loc = decoder.readEntry<LocationAttr>(tables.locs))
+        return loc;
+      return UnknownLoc::get(context);
+    };
+    auto readString = [&]() {
+      return decoder.readEntry<StringRef>(tables.strings);
+    };
+    Location loc = UnknownLoc::get(context);
+    switch (LocKind(decoder.readByte())) {
+    case LocKind::Unknown:
+      break;
+    case LocKind::FileLineCol: {
+      auto filename = readString();
+      unsigned line = decoder.readVarInt();
+      unsigned column = decoder.readVarInt();
+      loc = FileLineColLoc::get(context, filename, line, column);
+      break;
+    }
+    case LocKind::Name: {
+      auto name = StringAttr::get(context, readString());
+      loc = NameLoc::get(name, readLoc());
+      break;
+    }
+    case LocKind::CallSite: {
+      auto callee = readLoc();
+      loc = CallSiteLoc::get(callee, readLoc());
+      break;
+    }
+    case LocKind::Fused: {
+      Attribute metadata;
+      if (auto index = decoder.readIndex(tables.attrs.size() + 1))
+        metadata = tables.attrs[index - 1];
+      SmallVector<Location> children;
+      for (uint64_t j = 0, e = decoder.readVarInt(); j < e && !decoder.failed;
+           ++j)
+        children.push_back(readLoc());
+      loc = FusedLoc::get(context, children, metadata);
+      break;
+    }
+    default:
+      decoder.fail();
+      break;
+    }
+    tables.locs.push_back(loc);
+  }
+}
+
+Operation *BinaryIRReader::readRoot() {
+  // Decode the root operation, then the sections of the isolated operations
+  // it holds, one level of nesting at a time.  The sections of a level are
+  // independent of each other, and are decoded in parallel.
+  SectionReader rootReader(tables, context, decoder.getRemaining(),
+                           context->isMultithreadingEnabled());
+  auto *root = rootReader.decodeRoot();
+  if (!root) {
+    emitMalformedError("invalid operation");
+    return nullptr;
+  }
+
+  std::vector<PendingSection> worklist(rootReader.pending.begin(),
+                                       rootReader.pending.end());
+  std::atomic<bool> sectionsFailed(false);
+  while (!worklist.empty() && !sectionsFailed) {
+    std::vector<PendingSection> next;
+    std::mutex nextMutex;
+    parallelForEach(context, worklist, [&](PendingSection &section) {
+      SectionReader reader(tables, context, section.data,
+                           /*deferSections=*/true);
+      if (failed(reader.decodeSection(section.op)))
+        sectionsFailed = true;
+      std::lock_guard<std::mutex> lock(nextMutex);
+      next.insert(next.end(), reader.pending.begin(), reader.pending.end());
+    });
+    worklist = std::move(next);
+  }
+  if (sectionsFailed) {
+    root->destroy();
+    emitMalformedError("invalid operation");
+    return nullptr;
+  }
+  return root;
+}
+
+OwningOpRef<ModuleOp> circt::readBinaryIR(llvm::SourceMgr &sourceMgr,
+                                          MLIRContext *context) {
+  auto *buffer = sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID());
+  auto errorLoc =
+      FileLineColLoc::get(context, buffer->getBufferIdentifier(), 0, 0);
+  if (!isBinaryIR(buffer->getBuffer())) {
+    mlir::emitError(errorLoc, "not a binary IR file");
+    return {};
+  }
+
+  BinaryIRReader reader(buffer->getBuffer(), context, errorLoc);
+  if (failed(reader.readTables()))
+    return {};
+  auto *root = reader.readRoot();
+  if (!root)
+    return {};
+
+  OwningOpRef<ModuleOp> module(dyn_cast<ModuleOp>(root));
+  if (!module) {
+    root->destroy();
+    mlir::emitError(errorLoc, "binary IR does not hold a builtin module");
+    return {};
+  }
+  if (failed(verify(*module)))
+    return {};
+  return module;
+}
+
+//===----------------------------------------------------------------------===//
+// Translations
+//===----------------------------------------------------------------------===//
+
+void circt::registerBinaryIRTranslations(
+    const std::function<void(DialectRegistry &)> &registerDialects) {
+  static TranslateFromMLIRRegistration toBinaryIR(
+      "export-binary-ir",
+      [](ModuleOp module, raw_ostream &os) {
+        writeBinaryIR(module, os);
+        return success();
+      },
+      registerDialects);
+
+  static TranslateToMLIRRegistration fromBinaryIR(
+      "import-binary-ir",
+      [registerDialects](llvm::SourceMgr &sourceMgr, MLIRContext *context) {
+        DialectRegistry registry;
+        registerDialects(registry);
+        context->appendDialectRegistry(registry);
+        return readBinaryIR(sourceMgr, context);
+      });
+}
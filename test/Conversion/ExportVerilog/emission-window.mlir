@@ -0,0 +1,51 @@
+// RUN: circt-opt %s -export-verilog='emission-window-size=2' | FileCheck %s
+// RUN: circt-opt %s -export-verilog='emission-window-size=2' --mlir-disable-threading | FileCheck %s
+
+// A window smaller than the design, with binds emitted serially while the
+// modules around them are rendered in parallel. The output is in order.
+
+// CHECK-LABEL: module Child(
+hw.module @Child(%a: i8) -> (b: i8) {
+  %0 = comb.add %a, %a : i8
+  hw.output %0 : i8
+}
+
+// CHECK-LABEL: module Bound(
+hw.module @Bound(%a: i8) {
+  hw.output
+}
+
+// CHECK-LABEL: module Parent(
+// CHECK:         Child child (
+// CHECK:       /* This instance is elsewhere emitted as a bind statement
+// CHECK-NEXT:    Bound bound (
+// CHECK:       */
+// CHECK:       endmodule
+hw.module @Parent(%a: i8) -> (b: i8) {
+  %b = hw.instance "child" @Child(a: %a: i8) -> (b: i8)
+  hw.instance "bound" sym @bound @Bound(a: %b: i8) -> () {doNotPrint = true}
+  hw.output %b : i8
+}
+
+// CHECK-LABEL: bind Parent Bound bound (
+// CHECK-NEXT:    .a (
+// CHECK-NEXT:  );
+sv.bind #hw.innerNameRef<@Parent::@bound>
+
+// CHECK-LABEL: module Sibling1(
+hw.module @Sibling1(%a: i8) -> (b: i8) {
+  %b = hw.instance "child" @Child(a: %a: i8) -> (b: i8)
+  hw.output %b : i8
+}
+
+// CHECK-LABEL: module Sibling2(
+hw.module @Sibling2(%a: i8) -> (b: i8) {
+  %b = hw.instance "child" @Child(a: %a: i8) -> (b: i8)
+  hw.output %b : i8
+}
+
+// CHECK-LABEL: module Sibling3(
+hw.module @Sibling3(%a: i8) -> (b: i8) {
+  %b = hw.instance "child" @Child(a: %a: i8) -> (b: i8)
+  hw.output %b : i8
+}
@@ -0,0 +1,53 @@
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-check-comb-cycles)' --split-input-file --verify-diagnostics %s
+
+// The preconditions are checked before any cycle is looked for, and every
+// offending operation is reported once.
+
+firrtl.circuit "Subfield" {
+  firrtl.module @Subfield(in %a: !firrtl.bundle<x: uint<1>>, out %b: !firrtl.uint<1>) {
+    %w = firrtl.wire : !firrtl.uint<1>
+    firrtl.connect %w, %w : !firrtl.uint<1>, !firrtl.uint<1>
+    // expected-error @+1 {{'firrtl.subfield' op input must be a port of a MemOp, please run -firrtl-lower-types first}}
+    %0 = firrtl.subfield %a(0) : (!firrtl.bundle<x: uint<1>>) -> !firrtl.uint<1>
+    %1 = firrtl.and %0, %w : (!firrtl.uint<1>, !firrtl.uint<1>) -> !firrtl.uint<1>
+    firrtl.connect %b, %1 : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+}
+
+// -----
+
+firrtl.circuit "MemoryPort" {
+  firrtl.module @MemoryPort(in %clk: !firrtl.clock, out %b: !firrtl.uint<1>) {
+    %m_r = firrtl.mem Undefined  {depth = 2 : i64, name = "m", portNames = ["r"], readLatency = 0 : i32, writeLatency = 1 : i32} : !firrtl.bundle<addr: uint<1>, en: uint<1>, clk: clock, data flip: uint<1>>
+    %w = firrtl.wire : !firrtl.bundle<addr: uint<1>, en: uint<1>, clk: clock, data flip: uint<1>>
+    // expected-error @+1 {{'firrtl.connect' op MemOp must be used by SubfieldOp, please run -firrtl-lower-types first}}
+    firrtl.connect %m_r, %w : !firrtl.bundle<addr: uint<1>, en: uint<1>, clk: clock, data flip: uint<1>>, !firrtl.bundle<addr: uint<1>, en: uint<1>, clk: clock, data flip: uint<1>>
+    %0 = firrtl.subfield %m_r(3) : (!firrtl.bundle<addr: uint<1>, en: uint<1>, clk: clock, data flip: uint<1>>) -> !firrtl.uint<1>
+    firrtl.connect %b, %0 : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+}
+
+// -----
+
+// Every module is checked, even once one of them failed.
+
+firrtl.circuit "Modules" {
+  firrtl.module @First(in %a: !firrtl.bundle<x: uint<1>>, out %b: !firrtl.uint<1>) {
+    // expected-error @+1 {{'firrtl.subfield' op input must be a port of a MemOp, please run -firrtl-lower-types first}}
+    %0 = firrtl.subfield %a(0) : (!firrtl.bundle<x: uint<1>>) -> !firrtl.uint<1>
+    firrtl.connect %b, %0 : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+  firrtl.module @Second(in %a: !firrtl.bundle<x: uint<1>>, out %b: !firrtl.uint<1>) {
+    // expected-error @+1 {{'firrtl.subfield' op input must be a port of a MemOp, please run -firrtl-lower-types first}}
+    %0 = firrtl.subfield %a(0) : (!firrtl.bundle<x: uint<1>>) -> !firrtl.uint<1>
+    firrtl.connect %b, %0 : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+  firrtl.module @Modules(in %a: !firrtl.bundle<x: uint<1>>, out %b: !firrtl.uint<1>, out %c: !firrtl.uint<1>) {
+    %first_a, %first_b = firrtl.instance first @First(in a: !firrtl.bundle<x: uint<1>>, out b: !firrtl.uint<1>)
+    %second_a, %second_b = firrtl.instance second @Second(in a: !firrtl.bundle<x: uint<1>>, out b: !firrtl.uint<1>)
+    firrtl.connect %first_a, %a : !firrtl.bundle<x: uint<1>>, !firrtl.bundle<x: uint<1>>
+    firrtl.connect %second_a, %a : !firrtl.bundle<x: uint<1>>, !firrtl.bundle<x: uint<1>>
+    firrtl.connect %b, %first_b : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.connect %c, %second_b : !firrtl.uint<1>, !firrtl.uint<1>
+  }
+}
@@ -175,4 +175,83 @@ firrtl.circuit "strictConnectAndConnect" {
     firrtl.connect %a, %b : !firrtl.uint<11>, !firrtl.uint<11>
     firrtl.strictconnect %b, %a : !firrtl.uint<11>
   }
-}
\ No newline at end of file
+}
+
+// -----
+
+module  {
+  // Combinational loop through two levels of instances
+  // CHECK-NOT: firrtl.circuit "hasloops"
+  firrtl.circuit "hasloops"   {
+    firrtl.module @leaf(in %in: !firrtl.uint<1>, out %out: !firrtl.uint<1>) {
+      firrtl.connect %out, %in : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+    firrtl.module @mid(in %in: !firrtl.uint<1>, out %out: !firrtl.uint<1>) {
+      %leaf_in, %leaf_out = firrtl.instance leaf @leaf(in in: !firrtl.uint<1>, out out: !firrtl.uint<1>)
+      firrtl.connect %leaf_in, %in : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %out, %leaf_out : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+    // expected-error @+1 {{detected combinational cycle in a FIRRTL module}}
+    firrtl.module @hasloops(out %o: !firrtl.uint<1>) {
+      // expected-note @+1 {{this operation is part of the combinational cycle}}
+      %y = firrtl.wire  : !firrtl.uint<1>
+      // expected-note @+1 {{this operation is part of the combinational cycle}}
+      %mid_in, %mid_out = firrtl.instance mid @mid(in in: !firrtl.uint<1>, out out: !firrtl.uint<1>)
+      firrtl.connect %mid_in, %y : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %y, %mid_out : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %o, %y : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+  }
+}
+
+// -----
+
+module  {
+  // A register in an instance breaks the path between its ports
+  // CHECK: firrtl.circuit "noloops"
+  firrtl.circuit "noloops"   {
+    firrtl.module @delay(in %clk: !firrtl.clock, in %in: !firrtl.uint<1>, out %out: !firrtl.uint<1>) {
+      %r = firrtl.reg %clk  : !firrtl.uint<1>
+      firrtl.connect %r, %in : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %out, %r : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+    firrtl.module @mid(in %clk: !firrtl.clock, in %in: !firrtl.uint<1>, out %out: !firrtl.uint<1>) {
+      %delay_clk, %delay_in, %delay_out = firrtl.instance delay @delay(in clk: !firrtl.clock, in in: !firrtl.uint<1>, out out: !firrtl.uint<1>)
+      firrtl.connect %delay_clk, %clk : !firrtl.clock, !firrtl.clock
+      firrtl.connect %delay_in, %in : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %out, %delay_out : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+    firrtl.module @noloops(in %clk: !firrtl.clock, out %o: !firrtl.uint<1>) {
+      %y = firrtl.wire  : !firrtl.uint<1>
+      %mid_clk, %mid_in, %mid_out = firrtl.instance mid @mid(in clk: !firrtl.clock, in in: !firrtl.uint<1>, out out: !firrtl.uint<1>)
+      firrtl.connect %mid_clk, %clk : !firrtl.clock, !firrtl.clock
+      firrtl.connect %mid_in, %y : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %y, %mid_out : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %o, %y : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+  }
+}
+
+// -----
+
+module  {
+  // A cycle inside of a module is only reported in that module, however many
+  // times it is instantiated
+  // CHECK-NOT: firrtl.circuit "hasloops"
+  firrtl.circuit "hasloops"   {
+    // expected-error @+1 {{detected combinational cycle in a FIRRTL module}}
+    firrtl.module @loop(in %in: !firrtl.uint<1>, out %out: !firrtl.uint<1>) {
+      // expected-note @+1 {{this operation is part of the combinational cycle}}
+      %w = firrtl.wire  : !firrtl.uint<1>
+      firrtl.connect %w, %w : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %out, %in : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+    firrtl.module @hasloops(in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>) {
+      %loop1_in, %loop1_out = firrtl.instance loop1 @loop(in in: !firrtl.uint<1>, out out: !firrtl.uint<1>)
+      %loop2_in, %loop2_out = firrtl.instance loop2 @loop(in in: !firrtl.uint<1>, out out: !firrtl.uint<1>)
+      firrtl.connect %loop1_in, %a : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %loop2_in, %loop1_out : !firrtl.uint<1>, !firrtl.uint<1>
+      firrtl.connect %b, %loop2_out : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+  }
+}
@@ -0,0 +1,15 @@
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-dedup)' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s
+
+// CHECK-LABEL: Dedup
+// CHECK-DAG: (S) 1 num-erased-modules
+// CHECK-DAG: (S) 2 num-modules-hashed
+// CHECK-DAG: (S) {{[0-9]+}} hash-time-us
+
+firrtl.circuit "Statistics" {
+  firrtl.module @A(in %a: !firrtl.uint<1>) { }
+  firrtl.module @B(in %a: !firrtl.uint<1>) { }
+  firrtl.module @Statistics() {
+    %a_a = firrtl.instance a @A(in a: !firrtl.uint<1>)
+    %b_a = firrtl.instance b @B(in a: !firrtl.uint<1>)
+  }
+}
@@ -489,3 +489,33 @@ firrtl.circuit "MustDedup" attributes {annotations = [{
     firrtl.instance simple1 @Simple1()
   }
 }
+
+// Check that modules are deduplicated through several levels of instances, and
+// that modules with a different number of ports are not.
+// CHECK-LABEL: firrtl.circuit "Levels"
+firrtl.circuit "Levels" {
+  // CHECK: firrtl.module @Leaf0
+  firrtl.module @Leaf0(in %a: !firrtl.uint<1>) { }
+  // CHECK-NOT: firrtl.module @Leaf1
+  firrtl.module @Leaf1(in %b: !firrtl.uint<1>) { }
+  // CHECK: firrtl.module @Leaf2
+  firrtl.module @Leaf2(in %a: !firrtl.uint<1>, in %b: !firrtl.uint<1>) { }
+  // CHECK: firrtl.module @Mid0
+  firrtl.module @Mid0() {
+    // CHECK: firrtl.instance leaf @Leaf0
+    %leaf_a = firrtl.instance leaf @Leaf0(in a: !firrtl.uint<1>)
+  }
+  // CHECK-NOT: firrtl.module @Mid1
+  firrtl.module @Mid1() {
+    %leaf_b = firrtl.instance leaf @Leaf1(in b: !firrtl.uint<1>)
+  }
+  // CHECK: firrtl.module @Levels
+  firrtl.module @Levels() {
+    // CHECK: firrtl.instance mid0 @Mid0
+    // CHECK: firrtl.instance mid1 @Mid0
+    // CHECK: firrtl.instance leaf2 @Leaf2
+    firrtl.instance mid0 @Mid0()
+    firrtl.instance mid1 @Mid1()
+    %leaf2_a, %leaf2_b = firrtl.instance leaf2 @Leaf2(in a: !firrtl.uint<1>, in b: !firrtl.uint<1>)
+  }
+}
@@ -0,0 +1,24 @@
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl.module(firrtl-expand-whens))' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s
+
+// The nested when blocks are 2 scopes of depth 1 and 1 of depth 2.  The 9
+// lookups are the declaration of the port, the 3 connects, the merge of each
+// when block with its outer scope, the 2 connects they create, and the
+// initialization check of the port.
+
+// CHECK-LABEL: ExpandWhens
+// CHECK-DAG: (S) 3 num-scopes
+// CHECK-DAG: (S) 4 total-scope-depth
+// CHECK-DAG: (S) 9 num-lookups
+
+firrtl.circuit "Statistics" {
+  firrtl.module @Statistics(in %p: !firrtl.uint<1>, in %q: !firrtl.uint<1>, in %a: !firrtl.uint<1>, out %o: !firrtl.uint<1>) {
+    firrtl.connect %o, %a : !firrtl.uint<1>, !firrtl.uint<1>
+    firrtl.when %p {
+      firrtl.when %q {
+        firrtl.connect %o, %p : !firrtl.uint<1>, !firrtl.uint<1>
+      }
+    } else {
+      firrtl.connect %o, %q : !firrtl.uint<1>, !firrtl.uint<1>
+    }
+  }
+}
@@ -573,3 +573,106 @@ firrtl.circuit "dntOutput" {
     firrtl.connect %b, %const : !firrtl.uint<3>, !firrtl.uint<3>
   }
 }
+
+// -----
+
+// Constants cross several levels of instances, down to the leaf and back up.
+firrtl.circuit "MultiLevel" {
+  // CHECK-LABEL: firrtl.module private @MultiLevelLeaf
+  firrtl.module private @MultiLevelLeaf(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>) {
+    // CHECK: firrtl.connect %out, %c5_ui4
+    firrtl.connect %out, %in : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module private @MultiLevelMid
+  firrtl.module private @MultiLevelMid(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>) {
+    %leaf_in, %leaf_out = firrtl.instance leaf @MultiLevelLeaf(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    // CHECK: firrtl.connect %leaf_in, %c5_ui4
+    firrtl.connect %leaf_in, %in : !firrtl.uint<4>, !firrtl.uint<4>
+    // CHECK: firrtl.connect %out, %c5_ui4
+    firrtl.connect %out, %leaf_out : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module @MultiLevel
+  firrtl.module @MultiLevel(out %out: !firrtl.uint<4>) {
+    %c5_ui4 = firrtl.constant 5 : !firrtl.uint<4>
+    %mid_in, %mid_out = firrtl.instance mid @MultiLevelMid(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    firrtl.connect %mid_in, %c5_ui4 : !firrtl.uint<4>, !firrtl.uint<4>
+    // CHECK: firrtl.connect %out, %c5_ui4
+    firrtl.connect %out, %mid_out : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+}
+
+// -----
+
+// Only the instances in executable modules, outside of `when`s, drive the
+// ports of the modules they instantiate. The leaf becomes executable through
+// the middle module, which becomes executable itself through the top module.
+firrtl.circuit "Executable" {
+  // CHECK-LABEL: firrtl.module private @ExecutableLeaf
+  firrtl.module private @ExecutableLeaf(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>) {
+    // CHECK: firrtl.connect %out, %c3_ui4
+    firrtl.connect %out, %in : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module private @ExecutableDead
+  firrtl.module private @ExecutableDead() {
+    %c7_ui4 = firrtl.constant 7 : !firrtl.uint<4>
+    %leaf_in, %leaf_out = firrtl.instance leaf @ExecutableLeaf(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    firrtl.connect %leaf_in, %c7_ui4 : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module private @ExecutableMid
+  firrtl.module private @ExecutableMid(out %out: !firrtl.uint<4>) {
+    %c3_ui4 = firrtl.constant 3 : !firrtl.uint<4>
+    %leaf_in, %leaf_out = firrtl.instance leaf @ExecutableLeaf(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    firrtl.connect %leaf_in, %c3_ui4 : !firrtl.uint<4>, !firrtl.uint<4>
+    // CHECK: firrtl.connect %out, %c3_ui4
+    firrtl.connect %out, %leaf_out : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module @Executable
+  firrtl.module @Executable(in %p: !firrtl.uint<1>, out %out: !firrtl.uint<4>) {
+    %mid_out = firrtl.instance mid @ExecutableMid(out out: !firrtl.uint<4>)
+    // CHECK: firrtl.connect %out, %c3_ui4
+    firrtl.connect %out, %mid_out : !firrtl.uint<4>, !firrtl.uint<4>
+    firrtl.when %p {
+      %c9_ui4 = firrtl.constant 9 : !firrtl.uint<4>
+      %leaf_in, %leaf_out = firrtl.instance leaf @ExecutableLeaf(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+      firrtl.connect %leaf_in, %c9_ui4 : !firrtl.uint<4>, !firrtl.uint<4>
+    }
+  }
+}
+
+// -----
+
+// The input ports of a module instantiated several times are constant if all
+// the instances drive the same constant.
+firrtl.circuit "MultipleInstances" {
+  // CHECK-LABEL: firrtl.module private @Same
+  firrtl.module private @Same(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>) {
+    // CHECK: firrtl.connect %out, %c1_ui4
+    firrtl.connect %out, %in : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module private @Different
+  firrtl.module private @Different(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>) {
+    // CHECK: firrtl.connect %out, %in
+    firrtl.connect %out, %in : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module @MultipleInstances
+  firrtl.module @MultipleInstances(out %a: !firrtl.uint<4>, out %b: !firrtl.uint<4>, out %c: !firrtl.uint<4>, out %d: !firrtl.uint<4>) {
+    %c1_ui4 = firrtl.constant 1 : !firrtl.uint<4>
+    %c2_ui4 = firrtl.constant 2 : !firrtl.uint<4>
+    %s1_in, %s1_out = firrtl.instance s1 @Same(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    %s2_in, %s2_out = firrtl.instance s2 @Same(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    %d1_in, %d1_out = firrtl.instance d1 @Different(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    %d2_in, %d2_out = firrtl.instance d2 @Different(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    firrtl.connect %s1_in, %c1_ui4 : !firrtl.uint<4>, !firrtl.uint<4>
+    firrtl.connect %s2_in, %c1_ui4 : !firrtl.uint<4>, !firrtl.uint<4>
+    firrtl.connect %d1_in, %c1_ui4 : !firrtl.uint<4>, !firrtl.uint<4>
+    firrtl.connect %d2_in, %c2_ui4 : !firrtl.uint<4>, !firrtl.uint<4>
+    // CHECK: firrtl.connect %a, %c1_ui4
+    // CHECK: firrtl.connect %b, %c1_ui4
+    // CHECK: firrtl.connect %c, %d1_out
+    // CHECK: firrtl.connect %d, %d2_out
+    firrtl.connect %a, %s1_out : !firrtl.uint<4>, !firrtl.uint<4>
+    firrtl.connect %b, %s2_out : !firrtl.uint<4>, !firrtl.uint<4>
+    firrtl.connect %c, %d1_out : !firrtl.uint<4>, !firrtl.uint<4>
+    firrtl.connect %d, %d2_out : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+}
@@ -0,0 +1,23 @@
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-infer-widths)' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s
+
+// CHECK-LABEL: InferWidths
+// CHECK-DAG: (S) 3 num-variables
+// CHECK-DAG: (S) 1 num-cyclic-sccs
+// CHECK-DAG: (S) 2 num-cycle-variables
+// CHECK-DAG: (S) {{[0-9]+}} map-time-us
+// CHECK-DAG: (S) {{[0-9]+}} solve-time-us
+// CHECK-DAG: (S) {{[0-9]+}} update-time-us
+
+firrtl.circuit "Statistics" {
+  firrtl.module @Statistics(in %in: !firrtl.uint<4>) {
+    // Two variables in a cycle.
+    %a = firrtl.wire : !firrtl.uint
+    %b = firrtl.wire : !firrtl.uint
+    firrtl.connect %a, %b : !firrtl.uint, !firrtl.uint
+    firrtl.connect %b, %a : !firrtl.uint, !firrtl.uint
+    firrtl.connect %b, %in : !firrtl.uint, !firrtl.uint<4>
+    // A variable outside of any cycle.
+    %w = firrtl.wire : !firrtl.uint
+    firrtl.connect %w, %a : !firrtl.uint, !firrtl.uint
+  }
+}
@@ -800,5 +800,45 @@ firrtl.circuit "Foo" {
     firrtl.connect %a, %2 : !firrtl.uint, !firrtl.uint
   }
 
+  // Cycles are solved one variable at a time, in the order of the variables,
+  // with the recursion broken at the variable being solved.
+  // CHECK-LABEL: @CycleThroughMin
+  firrtl.module @CycleThroughMin() {
+    // CHECK: %x = firrtl.wire : !firrtl.uint<10>
+    // CHECK: %y = firrtl.wire : !firrtl.uint<10>
+    %x = firrtl.wire : !firrtl.uint
+    %y = firrtl.wire : !firrtl.uint
+    %c2_ui2 = firrtl.constant 2 : !firrtl.uint<2>
+    %c0_ui10 = firrtl.constant 0 : !firrtl.uint<10>
+    firrtl.connect %x, %c2_ui2 : !firrtl.uint, !firrtl.uint<2>
+    firrtl.connect %x, %y : !firrtl.uint, !firrtl.uint
+    // CHECK: firrtl.rem {{.*}} -> !firrtl.uint<10>
+    %0 = firrtl.rem %x, %c0_ui10 : (!firrtl.uint, !firrtl.uint<10>) -> !firrtl.uint
+    firrtl.connect %y, %0 : !firrtl.uint, !firrtl.uint
+  }
+
+  // CHECK-LABEL: @CycleOfWires
+  firrtl.module @CycleOfWires(in %in: !firrtl.uint<4>) {
+    // CHECK: %a = firrtl.wire : !firrtl.uint<5>
+    // CHECK: %b = firrtl.wire : !firrtl.uint<5>
+    // CHECK: %c = firrtl.wire : !firrtl.uint<5>
+    // CHECK: %d = firrtl.wire : !firrtl.uint<6>
+    %a = firrtl.wire : !firrtl.uint
+    %b = firrtl.wire : !firrtl.uint
+    %c = firrtl.wire : !firrtl.uint
+    %d = firrtl.wire : !firrtl.uint
+    %c0_ui3 = firrtl.constant 0 : !firrtl.uint<3>
+    %c0_ui5 = firrtl.constant 0 : !firrtl.uint<5>
+    firrtl.connect %a, %b : !firrtl.uint, !firrtl.uint
+    firrtl.connect %a, %c0_ui3 : !firrtl.uint, !firrtl.uint<3>
+    firrtl.connect %b, %c : !firrtl.uint, !firrtl.uint
+    firrtl.connect %b, %in : !firrtl.uint, !firrtl.uint<4>
+    firrtl.connect %c, %a : !firrtl.uint, !firrtl.uint
+    firrtl.connect %c, %c0_ui5 : !firrtl.uint, !firrtl.uint<5>
+    // The components after a cycle use its solution.
+    %0 = firrtl.add %c, %a : (!firrtl.uint, !firrtl.uint) -> !firrtl.uint
+    firrtl.connect %d, %0 : !firrtl.uint, !firrtl.uint
+  }
+
   firrtl.module @Foo() {}
 }
@@ -711,3 +711,110 @@ firrtl.circuit "Inline2"  {
     firrtl.strictconnect %o, %bar_o : !firrtl.uint<1>
   }
 }
+
+// Test flattening a module which instantiates another flattened module, which
+// is reused once flattened, and keeping the external modules they instantiate.
+// CHECK-LABEL: firrtl.circuit "FlattenLevels"
+firrtl.circuit "FlattenLevels" {
+  // CHECK:      firrtl.module @FlattenLevels
+  // CHECK-NEXT:   %mid_a = firrtl.wire
+  // CHECK-NEXT:   %mid_b = firrtl.wire
+  // CHECK-NEXT:   %mid_leaf_a = firrtl.wire
+  // CHECK-NEXT:   %mid_leaf_b = firrtl.wire
+  // CHECK-NEXT:   %mid_leaf_w = firrtl.wire
+  // CHECK:        firrtl.instance mid_ext @Ext(in a: !firrtl.uint<1>)
+  firrtl.module @FlattenLevels(in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>) attributes {annotations = [{class = "firrtl.transforms.FlattenAnnotation"}]} {
+    %mid_a, %mid_b = firrtl.instance mid @Mid(in a: !firrtl.uint<1>, out b: !firrtl.uint<1>)
+    firrtl.strictconnect %mid_a, %a : !firrtl.uint<1>
+    firrtl.strictconnect %b, %mid_b : !firrtl.uint<1>
+  }
+  // CHECK:      firrtl.module @Mid
+  // CHECK-NEXT:   %leaf_a = firrtl.wire
+  // CHECK-NEXT:   %leaf_b = firrtl.wire
+  // CHECK-NEXT:   %leaf_w = firrtl.wire
+  // CHECK:        firrtl.instance ext @Ext(in a: !firrtl.uint<1>)
+  firrtl.module @Mid(in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>) attributes {annotations = [{class = "firrtl.transforms.FlattenAnnotation"}]} {
+    %leaf_a, %leaf_b = firrtl.instance leaf @Leaf(in a: !firrtl.uint<1>, out b: !firrtl.uint<1>)
+    %ext_a = firrtl.instance ext @Ext(in a: !firrtl.uint<1>)
+    firrtl.strictconnect %leaf_a, %a : !firrtl.uint<1>
+    firrtl.strictconnect %ext_a, %leaf_b : !firrtl.uint<1>
+    firrtl.strictconnect %b, %leaf_b : !firrtl.uint<1>
+  }
+  // CHECK-NOT:  firrtl.module private @Leaf
+  firrtl.module private @Leaf(in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>) {
+    %w = firrtl.wire : !firrtl.uint<1>
+    firrtl.strictconnect %w, %a : !firrtl.uint<1>
+    firrtl.strictconnect %b, %w : !firrtl.uint<1>
+  }
+  // CHECK:      firrtl.extmodule private @Ext
+  firrtl.extmodule private @Ext(in a: !firrtl.uint<1>)
+}
+
+// Test flattening a hierarchy with an inner symbol, which is not flattened in
+// parallel, and whose symbol is made unique for every instance.
+// CHECK-LABEL: firrtl.circuit "FlattenInnerSym"
+firrtl.circuit "FlattenInnerSym" {
+  // CHECK:      firrtl.module @FlattenInnerSym
+  // CHECK:        %c1_w = firrtl.wire sym @w
+  // CHECK:        %c2_w = firrtl.wire sym @w_{{[0-9]+}}
+  // CHECK-NOT:    firrtl.instance
+  firrtl.module @FlattenInnerSym(in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>) attributes {annotations = [{class = "firrtl.transforms.FlattenAnnotation"}]} {
+    %c1_a, %c1_b = firrtl.instance c1 @Child(in a: !firrtl.uint<1>, out b: !firrtl.uint<1>)
+    %c2_a, %c2_b = firrtl.instance c2 @Child(in a: !firrtl.uint<1>, out b: !firrtl.uint<1>)
+    firrtl.strictconnect %c1_a, %a : !firrtl.uint<1>
+    firrtl.strictconnect %c2_a, %c1_b : !firrtl.uint<1>
+    firrtl.strictconnect %b, %c2_b : !firrtl.uint<1>
+  }
+  // CHECK-NOT:  firrtl.module private @Child
+  firrtl.module private @Child(in %a: !firrtl.uint<1>, out %b: !firrtl.uint<1>) {
+    %w = firrtl.wire sym @w : !firrtl.uint<1>
+    firrtl.strictconnect %w, %a : !firrtl.uint<1>
+    firrtl.strictconnect %b, %w : !firrtl.uint<1>
+  }
+}
+
+// Test flattening a module which instantiates an unmarked module several
+// times, whose flattened body is copied for each instance.
+// CHECK-LABEL: firrtl.circuit "FlattenShared"
+firrtl.circuit "FlattenShared" {
+  // CHECK:      firrtl.module @FlattenShared
+  // CHECK-NEXT:   %p0_a = firrtl.wire
+  // CHECK-NEXT:   %p0_l0_a = firrtl.wire
+  // CHECK-NEXT:   %p0_l0_w = firrtl.wire
+  // CHECK-NEXT:   firrtl.strictconnect %p0_l0_w, %p0_l0_a
+  // CHECK-NEXT:   %p0_l1_a = firrtl.wire
+  // CHECK-NEXT:   %p0_l1_w = firrtl.wire
+  // CHECK-NEXT:   firrtl.strictconnect %p0_l1_w, %p0_l1_a
+  // CHECK-NEXT:   firrtl.strictconnect %p0_l0_a, %p0_a
+  // CHECK-NEXT:   firrtl.strictconnect %p0_l1_a, %p0_a
+  // CHECK-NEXT:   %p1_a = firrtl.wire
+  // CHECK-NEXT:   %p1_l0_a = firrtl.wire
+  // CHECK-NEXT:   %p1_l0_w = firrtl.wire
+  // CHECK-NEXT:   firrtl.strictconnect %p1_l0_w, %p1_l0_a
+  // CHECK-NEXT:   %p1_l1_a = firrtl.wire
+  // CHECK-NEXT:   %p1_l1_w = firrtl.wire
+  // CHECK-NEXT:   firrtl.strictconnect %p1_l1_w, %p1_l1_a
+  // CHECK-NEXT:   firrtl.strictconnect %p1_l0_a, %p1_a
+  // CHECK-NEXT:   firrtl.strictconnect %p1_l1_a, %p1_a
+  // CHECK-NEXT:   firrtl.strictconnect %p0_a, %a
+  // CHECK-NEXT:   firrtl.strictconnect %p1_a, %a
+  // CHECK-NEXT: }
+  firrtl.module @FlattenShared(in %a: !firrtl.uint<1>) attributes {annotations = [{class = "firrtl.transforms.FlattenAnnotation"}]} {
+    %p0_a = firrtl.instance p0 @Pair(in a: !firrtl.uint<1>)
+    %p1_a = firrtl.instance p1 @Pair(in a: !firrtl.uint<1>)
+    firrtl.strictconnect %p0_a, %a : !firrtl.uint<1>
+    firrtl.strictconnect %p1_a, %a : !firrtl.uint<1>
+  }
+  // CHECK-NOT:  firrtl.module private @Pair
+  firrtl.module private @Pair(in %a: !firrtl.uint<1>) {
+    %l0_a = firrtl.instance l0 @Leaf(in a: !firrtl.uint<1>)
+    %l1_a = firrtl.instance l1 @Leaf(in a: !firrtl.uint<1>)
+    firrtl.strictconnect %l0_a, %a : !firrtl.uint<1>
+    firrtl.strictconnect %l1_a, %a : !firrtl.uint<1>
+  }
+  // CHECK-NOT:  firrtl.module private @Leaf
+  firrtl.module private @Leaf(in %a: !firrtl.uint<1>) {
+    %w = firrtl.wire : !firrtl.uint<1>
+    firrtl.strictconnect %w, %a : !firrtl.uint<1>
+  }
+}
@@ -0,0 +1,89 @@
+// RUN: circt-opt -hw-print-comb-paths %s -o %t 2>&1 | FileCheck %s
+// RUN: circt-opt -hw-print-comb-paths=min-depth=3 %s -o %t 2>&1 | FileCheck %s --check-prefix=DEEP
+
+// CHECK-LABEL: module Leaf: longest path 2
+// CHECK-NEXT:    a -> x: 2
+// CHECK-NEXT:    b -> x: 2
+// DEEP-NOT:    module Leaf
+hw.module @Leaf(%a: i8, %b: i8, %clk: i1) -> (x: i8, y: i8) {
+  %0 = comb.add %a, %b : i8
+  %1 = comb.xor %0, %a : i8
+  %r = seq.compreg %b, %clk : i8
+  %2 = comb.mul %r, %r : i8
+  hw.output %1, %2 : i8, i8
+}
+
+// The paths through the instance add the depth of the paths in Leaf, and the
+// register of Leaf starts a path of depth 1 at the output y.
+// CHECK-LABEL: module Top: longest path 4
+// CHECK-NEXT:    in -> out: 3
+// CHECK-NEXT:    in -> out2: 4
+// DEEP-LABEL:  module Top: longest path 4
+hw.module @Top(%in: i8, %clk: i1) -> (out: i8, out2: i8) {
+  %c1_i8 = hw.constant 1 : i8
+  %w = sv.wire : !hw.inout<i8>
+  %0 = comb.add %in, %c1_i8 : i8
+  sv.assign %w, %0 : i8
+  %1 = sv.read_inout %w : !hw.inout<i8>
+  %x, %y = hw.instance "leaf" @Leaf(a: %1: i8, b: %in: i8, clk: %clk: i1) -> (x: i8, y: i8)
+  %2 = comb.and %y, %x : i8
+  %e = hw.instance "ext" @Ext(a: %2: i8) -> (b: i8)
+  hw.output %x, %2 : i8, i8
+}
+
+// External modules have no combinational paths, and are not reported.
+// CHECK-NOT:   module Ext
+hw.module.extern @Ext(%a: i8) -> (b: i8)
+
+// CHECK-LABEL: module Loop: combinational cycle
+// CHECK-NEXT:    a -> x
+// DEEP-LABEL:  module Loop: combinational cycle
+hw.module @Loop(%a: i1) -> (x: i1) {
+  %w = sv.wire : !hw.inout<i1>
+  %0 = sv.read_inout %w : !hw.inout<i1>
+  %1 = comb.or %a, %0 : i1
+  sv.assign %w, %1 : i1
+  hw.output %1 : i1
+}
+
+// The assignments of an alwayscomb block are combinational, the ones of an
+// alwaysff block and of an always block with a sensitivity list are not.
+// CHECK-LABEL: module Procedural: longest path 1
+// CHECK-NEXT:    a -> x: 1
+// CHECK-NOT:     -> y
+// CHECK-NOT:     -> z
+// DEEP-NOT:    module Procedural
+hw.module @Procedural(%a: i1, %clk: i1) -> (x: i1, y: i1, z: i1) {
+  %c = sv.reg : !hw.inout<i1>
+  sv.alwayscomb {
+    %0 = comb.xor %a, %a : i1
+    sv.bpassign %c, %0 : i1
+  }
+  %0 = sv.read_inout %c : !hw.inout<i1>
+  %f = sv.reg : !hw.inout<i1>
+  sv.alwaysff(posedge %clk) {
+    sv.passign %f, %a : i1
+  }
+  %1 = sv.read_inout %f : !hw.inout<i1>
+  %s = sv.reg : !hw.inout<i1>
+  sv.always posedge %clk {
+    sv.passign %s, %a : i1
+  }
+  %2 = sv.read_inout %s : !hw.inout<i1>
+  hw.output %0, %1, %2 : i1, i1, i1
+}
+
+// An sv.reg assigned in an alwaysff block starts paths like a seq.compreg.
+// CHECK-LABEL: module SvReg: longest path 2
+// CHECK-NOT:     ->
+// DEEP-NOT:    module SvReg
+hw.module @SvReg(%a: i8, %clk: i1) -> (x: i8) {
+  %r = sv.reg : !hw.inout<i8>
+  sv.alwaysff(posedge %clk) {
+    sv.passign %r, %a : i8
+  }
+  %0 = sv.read_inout %r : !hw.inout<i8>
+  %1 = comb.add %0, %0 : i8
+  %2 = comb.mul %1, %1 : i8
+  hw.output %2 : i8
+}
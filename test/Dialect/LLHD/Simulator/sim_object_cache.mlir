@@ -0,0 +1,36 @@
+// REQUIRES: llhd-sim
+// RUN: rm -rf %t.cache
+// RUN: llhd-sim %s -T 2000 --object-cache-dir=%t.cache -stats -o %t.miss -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext 2>&1 | FileCheck %s --check-prefix=MISS
+// RUN: llhd-sim %s -T 2000 --object-cache-dir=%t.cache -stats -o %t.hit -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext 2>&1 | FileCheck %s --check-prefix=HIT
+// RUN: FileCheck %s --input-file=%t.miss
+// RUN: FileCheck %s --input-file=%t.hit
+
+// The second run loads the design compiled by the first one, and simulates it
+// the same way.
+
+// CHECK: 0ps 0d 0e  root/toggle  0x01
+// CHECK: 1000ps 0d 1e  root/toggle  0x00
+// CHECK: 2000ps 0d 1e  root/toggle  0x01
+// MISS: 0 llhd-sim - Designs loaded from the object cache
+// MISS: 1 llhd-sim - Designs compiled and stored in the cache
+// HIT:  1 llhd-sim - Designs loaded from the object cache
+// HIT:  0 llhd-sim - Designs compiled and stored in the cache
+llhd.entity @root () -> () {
+  %0 = hw.constant 1 : i1
+  %1 = llhd.sig "toggle" %0 : i1
+  llhd.inst "proc" @p () -> (%1) : () -> (!llhd.sig<i1>)
+}
+
+llhd.proc @p () -> (%a : !llhd.sig<i1>) {
+  cf.br ^wait
+^wait:
+  %t = llhd.constant_time #llhd.time<1ns, 0d, 0e>
+  llhd.wait for %t, ^drive
+^drive:
+  %0 = llhd.prb %a : !llhd.sig<i1>
+  %1 = hw.constant 1 : i1
+  %2 = comb.xor %0, %1 : i1
+  %dt = llhd.constant_time #llhd.time<0ns, 0d, 1e>
+  llhd.drv %a, %2 after %dt : !llhd.sig<i1>
+  cf.br ^wait
+}
@@ -0,0 +1,51 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -T 5000 --trace-format=merged-reduce -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefixes=STRAIGHT,CHECK
+// RUN: llhd-sim %s -T 2000 --trace-format=none --checkpoint=%t.snap -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext
+// RUN: llhd-sim %s -T 5000 --trace-format=merged-reduce --restore=%t.snap -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefixes=RESTORED,CHECK
+
+// The process persists the signal extracted in its entry block across its
+// suspensions, which holds a pointer into the signal memory that is relocated
+// when restoring the snapshot.
+
+// STRAIGHT:      0ps
+// STRAIGHT-NEXT:   root/s  0x04
+// STRAIGHT-NEXT: 1000ps
+// STRAIGHT-NEXT:   root/s  0x14
+// STRAIGHT-NEXT: 2000ps
+// STRAIGHT-NEXT:   root/s  0x17
+// RESTORED-NOT:  1000ps
+// RESTORED:      2000ps
+// RESTORED-NEXT:   root/s  0x17
+// CHECK-NEXT:    3000ps
+// CHECK-NEXT:      root/s  0x07
+// CHECK-NEXT:    4000ps
+// CHECK-NEXT:      root/s  0x0a
+// CHECK-NEXT:    5000ps
+// CHECK-NEXT:      root/s  0x1a
+llhd.entity @root () -> () {
+  %0 = hw.constant 1 : i8
+  %s = llhd.sig "s" %0 : i8
+  llhd.inst "foo" @foo () -> (%s) : () -> (!llhd.sig<i8>)
+}
+
+llhd.proc @foo () -> (%s : !llhd.sig<i8>) {
+  %c4 = hw.constant 4 : i3
+  %hi = llhd.sig.extract %s from %c4 : (!llhd.sig<i8>) -> !llhd.sig<i4>
+  %t = llhd.constant_time #llhd.time<1ns, 0d, 0e>
+  %dt = llhd.constant_time #llhd.time<0ns, 0d, 1e>
+  cf.br ^add
+^add:
+  // Add 3 to the signal.
+  %0 = llhd.prb %s : !llhd.sig<i8>
+  %c3 = hw.constant 3 : i8
+  %1 = comb.add %0, %c3 : i8
+  llhd.drv %s, %1 after %dt : !llhd.sig<i8>
+  llhd.wait for %t, ^flip
+^flip:
+  // Flip the lowest bit of the upper half of the signal.
+  %2 = llhd.prb %hi : !llhd.sig<i4>
+  %c1 = hw.constant 1 : i4
+  %3 = comb.xor %2, %c1 : i4
+  llhd.drv %hi, %3 after %dt : !llhd.sig<i4>
+  llhd.wait for %t, ^add
+}
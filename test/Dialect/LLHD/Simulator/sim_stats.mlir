@@ -0,0 +1,27 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -T 2000 --trace-format=none -stats -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext 2>&1 | FileCheck %s
+
+// CHECK: ... Statistics Collected ...
+// CHECK: {{[0-9]+}} llhd-sim - Instance wakeups triggered by signal changes
+// CHECK: {{[0-9]+}} llhd-sim - Signal changes ignored by processes not sensitive to them
+// CHECK: {{[0-9]+}} llhd-sim - Scheduled process wakeups
+// CHECK: {{[0-9]+}} llhd-sim - Instance evaluations
+llhd.entity @root () -> () {
+  %0 = hw.constant 1 : i1
+  %1 = llhd.sig "toggle" %0 : i1
+  llhd.inst "proc" @p () -> (%1) : () -> (!llhd.sig<i1>)
+}
+
+llhd.proc @p () -> (%a : !llhd.sig<i1>) {
+  cf.br ^wait
+^wait:
+  %t = llhd.constant_time #llhd.time<1ns, 0d, 0e>
+  llhd.wait for %t, ^drive
+^drive:
+  %0 = llhd.prb %a : !llhd.sig<i1>
+  %1 = hw.constant 1 : i1
+  %2 = comb.xor %0, %1 : i1
+  %dt = llhd.constant_time #llhd.time<0ns, 0d, 1e>
+  llhd.drv %a, %2 after %dt : !llhd.sig<i1>
+  cf.br ^wait
+}
@@ -0,0 +1,59 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -n 40 -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext -o %t.serial
+// RUN: llhd-sim %s -n 40 --threads=4 -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext -o %t.parallel
+// RUN: diff %t.serial %t.parallel
+// RUN: FileCheck %s --input-file=%t.parallel
+
+// The processes drive signals narrower than a 64 bit word, which are buffered
+// while the instances are evaluated in parallel.
+
+// CHECK: 0ps 0d 0e  root/a  0x00
+// CHECK: 0ps 0d 0e  root/b  0x0000
+// CHECK: 0ps 0d 0e  root/c  0x00
+// CHECK: 1000ps 0d 0e  root/a  0x01
+// CHECK: 1000ps 0d 0e  root/b  0x0002
+// CHECK: 1000ps 0d 0e  root/c  0x01
+llhd.entity @root () -> () {
+  %0 = hw.constant 0 : i1
+  %1 = hw.constant 0 : i16
+  %2 = hw.constant 0 : i3
+  %a = llhd.sig "a" %0 : i1
+  %b = llhd.sig "b" %1 : i16
+  %c = llhd.sig "c" %2 : i3
+  llhd.inst "pa" @toggle () -> (%a) : () -> (!llhd.sig<i1>)
+  llhd.inst "pb" @count16 () -> (%b) : () -> (!llhd.sig<i16>)
+  llhd.inst "pc" @count3 () -> (%c) : () -> (!llhd.sig<i3>)
+}
+
+llhd.proc @toggle () -> (%s : !llhd.sig<i1>) {
+  cf.br ^wait
+^wait:
+  %0 = llhd.prb %s : !llhd.sig<i1>
+  %1 = hw.constant 1 : i1
+  %2 = comb.xor %0, %1 : i1
+  %t = llhd.constant_time #llhd.time<1ns, 0d, 0e>
+  llhd.drv %s, %2 after %t : !llhd.sig<i1>
+  llhd.wait for %t, ^wait
+}
+
+llhd.proc @count16 () -> (%s : !llhd.sig<i16>) {
+  cf.br ^wait
+^wait:
+  %0 = llhd.prb %s : !llhd.sig<i16>
+  %1 = hw.constant 2 : i16
+  %2 = comb.add %0, %1 : i16
+  %t = llhd.constant_time #llhd.time<1ns, 0d, 0e>
+  llhd.drv %s, %2 after %t : !llhd.sig<i16>
+  llhd.wait for %t, ^wait
+}
+
+llhd.proc @count3 () -> (%s : !llhd.sig<i3>) {
+  cf.br ^wait
+^wait:
+  %0 = llhd.prb %s : !llhd.sig<i3>
+  %1 = hw.constant 1 : i3
+  %2 = comb.add %0, %1 : i3
+  %t = llhd.constant_time #llhd.time<1ns, 0d, 0e>
+  llhd.drv %s, %2 after %t : !llhd.sig<i3>
+  llhd.wait for %t, ^wait
+}
@@ -0,0 +1,45 @@
+// REQUIRES: llhd-sim
+// RUN: llhd-sim %s -T 2000 --trace-format=vcd -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext | FileCheck %s --check-prefix=VCD
+// RUN: llhd-sim %s -T 2000 --trace-format=binary -shared-libs=%shlibdir/libcirct-llhd-signals-runtime-wrappers%shlibext -o %t.wave
+// RUN: FileCheck %s --check-prefix=BIN --input-file=%t.wave
+
+// The signal `s` is passed twice to the process, and is only declared once in
+// its scope.
+
+// VCD:      $timescale 1ps $end
+// VCD-NEXT: $scope module root $end
+// VCD-NEXT: $var wire 8 ! s $end
+// VCD-NEXT: $scope module foo $end
+// VCD-NEXT: $var wire 8 ! s $end
+// VCD-NEXT: $upscope $end
+// VCD-NEXT: $upscope $end
+// VCD-NEXT: $enddefinitions $end
+// VCD-NEXT: #0
+// VCD-NEXT: b1 !
+// VCD-NEXT: #1000
+// VCD-NEXT: b10 !
+// VCD-NEXT: #2000
+// VCD-NEXT: b100 !
+
+// BIN:      LLHDWAVE
+// BIN-SAME: root/s
+// BIN:      root/foo/s
+// BIN-NOT:  root/foo/s
+llhd.entity @root () -> () {
+  %0 = hw.constant 1 : i8
+  %s = llhd.sig "s" %0 : i8
+  llhd.inst "foo" @foo () -> (%s, %s) : () -> (!llhd.sig<i8>, !llhd.sig<i8>)
+}
+
+llhd.proc @foo () -> (%a : !llhd.sig<i8>, %b : !llhd.sig<i8>) {
+  cf.br ^entry
+^entry:
+  %t = llhd.constant_time #llhd.time<1ns, 0d, 0e>
+  llhd.wait for %t, ^drive
+^drive:
+  %0 = llhd.prb %a : !llhd.sig<i8>
+  %1 = comb.add %0, %0 : i8
+  %t0 = llhd.constant_time #llhd.time<0ns, 0d, 1e>
+  llhd.drv %b, %1 after %t0 : !llhd.sig<i8>
+  cf.br ^entry
+}
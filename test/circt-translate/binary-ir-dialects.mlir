@@ -0,0 +1,12 @@
+// RUN: circt-translate %s --export-binary-ir -o %t.bin
+// RUN: circt-translate %t.bin --import-binary-ir | FileCheck %s
+
+// The dialects of the types nested in a builtin type are loaded before the
+// types are parsed in parallel.
+
+// CHECK-LABEL: hw.module @Nested
+// CHECK-NEXT: builtin.unrealized_conversion_cast %a : i1 to tuple<!firrtl.uint<4>>
+hw.module @Nested(%a: i1) {
+  %0 = builtin.unrealized_conversion_cast %a : i1 to tuple<!firrtl.uint<4>>
+  hw.output
+}
@@ -0,0 +1,43 @@
+// RUN: circt-translate %s --export-binary-ir -o %t.bin
+// RUN: circt-translate %t.bin --import-binary-ir --mlir-print-debuginfo | FileCheck %s
+// RUN: firtool %t.bin --format=mlir --parse-only --emit-binary-ir -o %t.2.bin
+// RUN: cmp %t.bin %t.2.bin
+// RUN: not circt-translate %s --import-binary-ir 2>&1 | FileCheck %s --check-prefix=NOT-BINARY
+
+// NOT-BINARY: error: not a binary IR file
+
+// CHECK-LABEL: firrtl.circuit "Top"
+firrtl.circuit "Top" {
+  // CHECK: firrtl.module @Child(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>)
+  firrtl.module @Child(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>) {
+    // CHECK-NEXT: firrtl.connect %out, %in
+    firrtl.connect %out, %in : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+  // CHECK: firrtl.module @Top
+  // CHECK-SAME: annotations = [{class = "test", data = [1 : i64, "two", @Child, unit]}]
+  firrtl.module @Top(in %clock: !firrtl.clock, in %a: !firrtl.uint<4>, out %b: !firrtl.uint<4>) attributes {annotations = [{class = "test", data = [1, "two", @Child, unit]}]} {
+    // CHECK-NEXT: %child_in, %child_out = firrtl.instance child @Child
+    %child_in, %child_out = firrtl.instance child @Child(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    // CHECK-NEXT: firrtl.connect %child_in, %a
+    firrtl.connect %child_in, %a : !firrtl.uint<4>, !firrtl.uint<4>
+    // CHECK-NEXT: %r = firrtl.reg %clock : !firrtl.uint<4> loc(#[[LOC:.+]])
+    %r = firrtl.reg %clock : !firrtl.uint<4> loc(fused<"info">["Top.fir":3:5, "Top.fir":4:7])
+    // CHECK-NEXT: %c-1_si4 = firrtl.constant -1 : !firrtl.sint<4>
+    %c-1_si4 = firrtl.constant -1 : !firrtl.sint<4>
+    firrtl.connect %r, %child_out : !firrtl.uint<4>, !firrtl.uint<4>
+    firrtl.connect %b, %r : !firrtl.uint<4>, !firrtl.uint<4>
+  }
+}
+
+// Values used before they are defined are resolved.
+// CHECK-LABEL: hw.module @Cycle(%a: i8) -> (out: i8)
+hw.module @Cycle(%a: i8) -> (out: i8) {
+  // CHECK-NEXT: %0 = comb.add %1, %a : i8
+  // CHECK-NEXT: %1 = comb.xor %0, %a : i8
+  // CHECK-NEXT: hw.output %1 : i8
+  %0 = comb.add %1, %a : i8
+  %1 = comb.xor %0, %a : i8
+  hw.output %1 : i8
+}
+
+// CHECK: #[[LOC]] = loc(fused<"info">["Top.fir":3:5, "Top.fir":4:7])
@@ -3,6 +3,8 @@
 // CHECK: OVERVIEW: CIRCT Translation Testing Tool
 
 // CHECK: Translation to perform
+// CHECK: --export-binary-ir
 // CHECK: --export-calyx
 // CHECK: --export-firrtl
+// CHECK: --import-binary-ir
 // CHECK: --import-firrtl
@@ -0,0 +1,31 @@
+// RUN: rm -rf %t %t.mlir
+// RUN: sed -e 's/BAR_OUT/%a/' %s > %t.mlir
+// RUN: firtool %t.mlir --format=mlir -split-verilog -o=%t --skip-unchanged-files -mlir-pass-statistics 2>&1 | FileCheck %s --check-prefix=FIRST
+// RUN: firtool %t.mlir --format=mlir -split-verilog -o=%t --skip-unchanged-files -mlir-pass-statistics 2>&1 | FileCheck %s --check-prefix=SECOND
+// RUN: sed -e 's/BAR_OUT/%c/' %s > %t.mlir
+// RUN: firtool %t.mlir --format=mlir -split-verilog -o=%t --skip-unchanged-files -mlir-pass-statistics 2>&1 | FileCheck %s --check-prefix=CHANGED
+// RUN: FileCheck %s --check-prefix=BAR < %t/Bar.sv
+// RUN: firtool %t.mlir --format=mlir -split-verilog -o=%t -mlir-pass-statistics 2>&1 | FileCheck %s --check-prefix=FIRST
+
+// FIRST-LABEL: ExportSplitVerilog
+// FIRST-DAG: 0 num-files-reused
+// FIRST-DAG: 3 num-files-written
+
+// SECOND-LABEL: ExportSplitVerilog
+// SECOND-DAG: 3 num-files-reused
+// SECOND-DAG: 0 num-files-written
+
+// CHANGED-LABEL: ExportSplitVerilog
+// CHANGED-DAG: 2 num-files-reused
+// CHANGED-DAG: 1 num-files-written
+
+// BAR: assign b = c;
+
+hw.module @Bar(%a: i1, %c: i1) -> (b: i1) {
+  hw.output BAR_OUT : i1
+}
+
+hw.module @Foo(%a: i1, %c: i1) -> (b: i1) {
+  %0 = hw.instance "bar" @Bar(a: %a: i1, c: %c: i1) -> (b: i1)
+  hw.output %0 : i1
+}
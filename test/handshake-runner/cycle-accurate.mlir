@@ -0,0 +1,40 @@
+// RUN: circt-opt -lower-std-to-handshake %s \
+// RUN: | circt-opt --handshake-insert-buffers="strategy=all" \
+// RUN: | handshake-runner --mode=cycle 2>/dev/null | FileCheck %s
+// RUN: circt-opt -lower-std-to-handshake %s \
+// RUN: | circt-opt --handshake-insert-buffers="strategy=all" \
+// RUN: | handshake-runner --mode=cycle --latency=arith.addi=3,arith.cmpi=1 \
+// RUN:   2>/dev/null | FileCheck %s
+// RUN: circt-opt -lower-std-to-handshake %s \
+// RUN: | circt-opt --handshake-insert-buffers="strategy=all" \
+// RUN: | handshake-runner --mode=cycle --latency=arith.addi=3 2>&1 >/dev/null \
+// RUN: | FileCheck %s --check-prefix=REPORT
+// RUN: not handshake-runner --mode=cycle --latency=arith.addi %s 2>&1 \
+// RUN: | FileCheck %s --check-prefix=INVALID
+// CHECK: 42
+
+// REPORT:      Cycle-accurate simulation of @main: {{[0-9]+}} cycles
+// REPORT:      Channels:
+// REPORT:      transfers, occupancy {{[0-9]+\.[0-9]+}}, {{[0-9]+}} stalls, II
+// REPORT:      Buffers and pipelined operations:
+// REPORT:      (arith.addi, capacity 3, latency 3): average fill
+// REPORT:      Achieved II: {{[0-9]+\.[0-9]+}}
+
+// INVALID: Invalid latency 'arith.addi', expected <op name>=<cycles>
+
+module {
+  func.func @main() -> index {
+    %c1 = arith.constant 1 : index
+    %c42 = arith.constant 42 : index
+    %c1_0 = arith.constant 1 : index
+    cf.br ^bb1(%c1 : index)
+  ^bb1(%0: index):	// 2 preds: ^bb0, ^bb2
+    %1 = arith.cmpi slt, %0, %c42 : index
+    cf.cond_br %1, ^bb2, ^bb3
+  ^bb2:	// pred: ^bb1
+    %2 = arith.addi %0, %c1_0 : index
+    cf.br ^bb1(%2 : index)
+  ^bb3:	// pred: ^bb1
+    return %0 : index
+  }
+}
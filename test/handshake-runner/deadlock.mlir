@@ -0,0 +1,15 @@
+// RUN: not handshake-runner %s 2>&1 | FileCheck %s
+// RUN: not handshake-runner --mode=compile %s 2>&1 | FileCheck %s
+// RUN: not handshake-runner --mode=cycle %s 2>&1 | FileCheck %s
+// CHECK: 'handshake.func' op deadlocked before reaching its return
+
+module {
+  handshake.func @main(%ctrl: none, ...) -> (i32, none) {
+    %0:3 = fork [3] %ctrl : none
+    %cond = constant %0#0 {value = 0 : i1} : i1
+    %true, %false = cond_br %cond, %0#1 : none
+    sink %false : none
+    %value = constant %true {value = 42 : i32} : i32
+    return %value, %0#2 : i32, none
+  }
+}
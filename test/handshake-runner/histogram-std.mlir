@@ -1,5 +1,6 @@
 // RUN: handshake-runner %s | FileCheck %s
 // RUN: circt-opt -lower-std-to-handshake %s | handshake-runner | FileCheck %s
+// RUN: circt-opt -lower-std-to-handshake %s | handshake-runner --mode=compile | FileCheck %s
 // CHECK: 0
 
 module {
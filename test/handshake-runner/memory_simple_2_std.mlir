@@ -1,5 +1,6 @@
 // RUN: handshake-runner %s 2,3,4,5 | FileCheck %s
 // RUN: circt-opt -lower-std-to-handshake %s | handshake-runner - 2,3,4,5 | FileCheck %s
+// RUN: circt-opt -lower-std-to-handshake %s | handshake-runner --mode=compile - 2,3,4,5 | FileCheck %s
 // CHECK: 5 5,3,4,5
 
 module {
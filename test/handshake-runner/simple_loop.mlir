@@ -1,5 +1,6 @@
 // RUN: mlir-opt --convert-func-to-llvm %s | mlir-cpu-runner --entry-point-result=i64 | FileCheck %s
 // RUN: circt-opt -lower-std-to-handshake %s | handshake-runner | FileCheck %s
+// RUN: circt-opt -lower-std-to-handshake %s | handshake-runner --mode=compile | FileCheck %s
 // RUN: handshake-runner %s | FileCheck %s
 // CHECK: 42
 module {
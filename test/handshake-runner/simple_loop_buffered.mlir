@@ -1,6 +1,9 @@
 // RUN: circt-opt -lower-std-to-handshake %s \
 // RUN: | circt-opt --handshake-insert-buffers="strategy=all" \
 // RUN: | handshake-runner | FileCheck %s
+// RUN: circt-opt -lower-std-to-handshake %s \
+// RUN: | circt-opt --handshake-insert-buffers="strategy=all" \
+// RUN: | handshake-runner --mode=compile | FileCheck %s
 // CHECK: 42
 module {
   func.func @main() -> index {
@@ -1,4 +1,5 @@
 // RUN: handshake-runner %s "(64, 32, 64)" | FileCheck %s
+// RUN: handshake-runner --mode=compile %s "(64, 32, 64)" | FileCheck %s
 // CHECK: (128, 32)
 
 module {
@@ -0,0 +1,12 @@
+// RUN: handshake-runner %s | FileCheck %s
+// RUN: circt-opt -lower-std-to-handshake %s | handshake-runner | FileCheck %s
+// RUN: circt-opt -lower-std-to-handshake %s | handshake-runner --mode=compile | FileCheck %s
+// CHECK: 3.500000e+00
+module {
+  func.func @main() -> f64 {
+    %0 = arith.constant 5.5 : f64
+    %1 = arith.constant 2.0 : f64
+    %2 = arith.subf %0, %1 : f64
+    return %2 : f64
+  }
+}
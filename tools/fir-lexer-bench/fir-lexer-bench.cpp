@@ -0,0 +1,80 @@
+//===- fir-lexer-bench.cpp - FIR lexer benchmark --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This is a command line utility which measures the throughput of the .fir
+// lexer on its own, without parsing the tokens or building any IR.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/FIRParser.h"
+#include "mlir/IR/Diagnostics.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/Support/FileUtilities.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+
+using namespace llvm;
+using namespace circt;
+
+static cl::opt<std::string> inputFilename(cl::Positional,
+                                          cl::desc("<input .fir file>"),
+                                          cl::init("-"));
+
+static cl::opt<unsigned> repeat("repeat",
+                                cl::desc("Number of times to lex the input"),
+                                cl::init(1));
+
+int main(int argc, char **argv) {
+  InitLLVM y(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "FIR lexer benchmark\n");
+
+  // The input is mapped into memory rather than read, and the lexer works on
+  // the mapping directly.
+  std::string errorMessage;
+  auto input = mlir::openInputFile(inputFilename, &errorMessage);
+  if (!input) {
+    errs() << errorMessage << "\n";
+    return 1;
+  }
+  size_t numBytes = input->getBufferSize();
+
+  SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(std::move(input), SMLoc());
+  mlir::MLIRContext context(mlir::MLIRContext::Threading::DISABLED);
+  mlir::SourceMgrDiagnosticHandler diagHandler(sourceMgr, &context);
+
+  // Report the fastest of the runs, which is the least disturbed by the rest
+  // of the system.
+  unsigned numRuns = std::max(1u, repeat.getValue());
+  Optional<size_t> numTokens;
+  double bestTime = 0;
+  for (unsigned i = 0; i < numRuns; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    numTokens = firrtl::lexFIRFile(sourceMgr, &context);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (!numTokens)
+      return 1;
+    if (i == 0 || elapsed.count() < bestTime)
+      bestTime = elapsed.count();
+  }
+
+  outs() << inputFilename << ": " << numBytes << " bytes, " << *numTokens
+         << " tokens\n";
+  outs() << "best of " << numRuns << ": "
+         << format("%.6f", bestTime) << " s, "
+         << format("%.1f", numBytes / (1024.0 * 1024.0) / bestTime)
+         << " MiB/s\n";
+  return 0;
+}
@@ -0,0 +1,288 @@
+//===- IncrementalCache.cpp - Incremental compilation cache ---------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the on-disk cache of the outputs produced by firtool.
+//
+//===----------------------------------------------------------------------===//
+
+#include "IncrementalCache.h"
+#include "circt/Dialect/FIRRTL/FIRRTLInstanceGraph.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/FIRRTL/FIRRTLStructuralHash.h"
+#include "circt/Support/Path.h"
+#include "circt/Support/Version.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace mlir;
+using namespace circt;
+using namespace firtool;
+
+/// Bump this whenever the contents of the cache change in a way not covered by
+/// the CIRCT version.
+static constexpr StringLiteral cacheFormat = "firtool-cache-v1";
+
+//===----------------------------------------------------------------------===//
+// Fingerprinting
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A SHA256 hash of a sequence of delimited fields.
+struct KeyHasher {
+  void update(StringRef str) {
+    // Hash the length first, such that the fields cannot run into each other.
+    uint64_t size = str.size();
+    sha.update(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(&size),
+                                 sizeof(size)));
+    sha.update(str);
+  }
+  void update(ArrayRef<uint8_t> bytes) {
+    update(StringRef(reinterpret_cast<const char *>(bytes.data()),
+                     bytes.size()));
+  }
+  std::string final() { return toHex(sha.final(), /*LowerCase=*/true); }
+
+  SHA256 sha;
+};
+} // namespace
+
+/// Hash the contents of the black box files referenced by the path annotations
+/// found in the given attribute, which are not part of the input itself.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void hashBlackBoxFiles(Attribute attr, StringRef blackBoxRoot,
+                              KeyHasher &hasher) {
+  if (auto array = attr.dyn_cast<ArrayAttr>()) {
+    for (auto element : array)
+      hashBlackBoxFiles(element, blackBoxRoot, hasher);
+    return;
+  }
+  auto dict = attr.dyn_cast<DictionaryAttr>();
+  if (!dict)
+    return;
+  auto annoClass = dict.getAs<StringAttr>("class");
+  auto path = dict.getAs<StringAttr>("path");
+  if (annoClass && path &&
+      annoClass.getValue() == "firrtl.transforms.BlackBoxPathAnno") {
+    SmallString<128> inputPath(blackBoxRoot);
+    appendPossiblyAbsolutePath(inputPath, path.getValue());
+    hasher.update(inputPath);
+    // A missing file is reported by the BlackBoxReader pass, which never
+    // happens on a cache hit, so it has to make a difference to the key.
+    if (auto buffer = MemoryBuffer::getFile(inputPath))
+      hasher.update((*buffer)->getBuffer());
+    else
+      hasher.update("<missing>");
+    return;
+  }
+  for (auto namedAttr : dict)
+    hashBlackBoxFiles(namedAttr.getValue(), blackBoxRoot, hasher);
+}
+
+InputFingerprint firtool::fingerprintInput(ModuleOp module, StringRef options,
+                                           StringRef blackBoxRoot) {
+  InputFingerprint input;
+  KeyHasher keyHasher;
+  keyHasher.update(cacheFormat);
+  keyHasher.update(getCirctVersion());
+  keyHasher.update(options);
+
+  firrtl::StructuralHasher hasher(module.getContext(),
+                                  firrtl::StructuralHasher::Mode::Persistent);
+  for (auto &op : *module.getBody()) {
+    auto circuit = dyn_cast<firrtl::CircuitOp>(op);
+    if (!circuit) {
+      keyHasher.update(hasher.hash(&op));
+      continue;
+    }
+
+    // The attributes of the circuit hold the annotations which are not yet
+    // scattered to the modules.
+    input.circuitName = circuit.name().str();
+    keyHasher.update(input.circuitName);
+    std::string attributes;
+    raw_string_ostream os(attributes);
+    circuit->getAttrDictionary().print(os);
+    keyHasher.update(os.str());
+    hashBlackBoxFiles(circuit->getAttrDictionary(), blackBoxRoot, keyHasher);
+
+    // Fingerprint the modules bottom-up, such that the fingerprints of the
+    // children of a module are known when it is fingerprinted.
+    firrtl::InstanceGraph instanceGraph(circuit);
+    DenseMap<firrtl::InstanceGraphNode *, std::array<uint8_t, 32>>
+        fingerprints;
+    SmallPtrSet<firrtl::InstanceGraphNode *, 16> visited;
+    for (auto *root : instanceGraph) {
+      for (auto *node : llvm::post_order_ext(root, visited)) {
+        Operation *moduleOp = node->getModule().getOperation();
+        KeyHasher moduleHasher;
+        moduleHasher.update(hasher.hash(moduleOp));
+        for (auto *record : *node) {
+          auto it = fingerprints.find(record->getTarget());
+          if (it != fingerprints.end())
+            moduleHasher.update(it->second);
+        }
+        fingerprints[node] = moduleHasher.sha.final();
+        hashBlackBoxFiles(moduleOp->getAttrDictionary(), blackBoxRoot,
+                          keyHasher);
+      }
+    }
+
+    for (auto moduleLike : circuit.getBody()->getOps<firrtl::FModuleLike>()) {
+      auto &fingerprint =
+          fingerprints[instanceGraph.lookup(moduleLike.moduleNameAttr())];
+      keyHasher.update(fingerprint);
+      input.modules.emplace_back(moduleLike.moduleName().str(),
+                                 toHex(fingerprint, /*LowerCase=*/true));
+    }
+  }
+
+  input.key = keyHasher.final();
+  return input;
+}
+
+//===----------------------------------------------------------------------===//
+// IncrementalCache
+//===----------------------------------------------------------------------===//
+
+/// Return the path of a file of the given cache directory.
+static std::string getCachePath(StringRef directory, const Twine &name) {
+  SmallString<128> path(directory);
+  sys::path::append(path, name);
+  return std::string(path.str());
+}
+
+/// Write a file of the given cache directory.
+static Error writeAtomically(StringRef directory, const Twine &name,
+                             StringRef contents) {
+  if (auto ec = sys::fs::create_directories(directory))
+    return createStringError(ec, "cannot create cache directory '%s'",
+                             directory.str().c_str());
+
+  // Write to a temporary file first, and move it in place, such that
+  // concurrent compilations never see a partially written entry.
+  SmallString<128> tempPath(directory);
+  sys::path::append(tempPath, name + "-%%%%%%.tmp");
+  int fd;
+  if (auto ec = sys::fs::createUniqueFile(tempPath, fd, tempPath))
+    return createStringError(ec, "cannot create temporary cache file");
+  auto removeTemp = make_scope_exit([&]() { sys::fs::remove(tempPath); });
+  {
+    raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << contents;
+    os.close();
+    if (os.has_error())
+      return createStringError(os.error(), "cannot write cache file");
+  }
+  if (auto ec = sys::fs::rename(tempPath, getCachePath(directory, name)))
+    return createStringError(ec, "cannot move file into the cache");
+  return Error::success();
+}
+
+std::string IncrementalCache::getPath(const Twine &name) const {
+  return getCachePath(directory, name);
+}
+
+/// Return the name of the manifest listing the module fingerprints of the last
+/// cached compilation of a circuit.
+static std::string getManifestName(StringRef circuitName) {
+  KeyHasher hasher;
+  hasher.update(circuitName);
+  return hasher.final() + ".modules";
+}
+
+std::unique_ptr<MemoryBuffer>
+IncrementalCache::lookup(const InputFingerprint &input) const {
+  auto buffer = MemoryBuffer::getFile(getPath(input.key + ".out"),
+                                      /*IsText=*/false,
+                                      /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return nullptr;
+  return std::move(*buffer);
+}
+
+Error IncrementalCache::store(const InputFingerprint &input,
+                              StringRef output) const {
+  if (auto err = writeAtomically(directory, input.key + ".out", output))
+    return err;
+  if (input.circuitName.empty())
+    return Error::success();
+
+  std::string manifest;
+  raw_string_ostream os(manifest);
+  for (auto &module : input.modules)
+    os << module.second << " " << module.first << "\n";
+  return writeAtomically(directory, getManifestName(input.circuitName),
+                         os.str());
+}
+
+SmallVector<std::string>
+IncrementalCache::getChangedModules(const InputFingerprint &input) const {
+  SmallVector<std::string> changed;
+  StringMap<StringRef> cachedFingerprints;
+  auto manifest =
+      MemoryBuffer::getFile(getPath(getManifestName(input.circuitName)));
+  if (manifest) {
+    SmallVector<StringRef> lines;
+    (*manifest)->getBuffer().split(lines, '\n', /*MaxSplit=*/-1,
+                                   /*KeepEmpty=*/false);
+    for (auto line : lines) {
+      auto [fingerprint, name] = line.split(' ');
+      cachedFingerprints[name] = fingerprint;
+    }
+  }
+  for (auto &module : input.modules)
+    if (cachedFingerprints.lookup(module.first) != module.second)
+      changed.push_back(module.first);
+  return changed;
+}
+
+//===----------------------------------------------------------------------===//
+// ModuleVerilogCache
+//===----------------------------------------------------------------------===//
+
+ModuleVerilogCache::ModuleVerilogCache(StringRef directory)
+    : directory(getCachePath(directory, "modules")) {}
+
+std::string ModuleVerilogCache::getName(StringRef key) const {
+  // The key given by ExportVerilog covers the lowered module, but not the
+  // version of the emitter.
+  KeyHasher hasher;
+  hasher.update(cacheFormat);
+  hasher.update(getCirctVersion());
+  hasher.update(key);
+  return hasher.final() + ".v";
+}
+
+Optional<std::string> ModuleVerilogCache::lookup(StringRef key) {
+  auto buffer = MemoryBuffer::getFile(getCachePath(directory, getName(key)),
+                                      /*IsText=*/false,
+                                      /*RequiresNullTerminator=*/false);
+  if (!buffer) {
+    ++numMisses;
+    return None;
+  }
+  ++numHits;
+  return (*buffer)->getBuffer().str();
+}
+
+void ModuleVerilogCache::store(StringRef key, StringRef text) {
+  // Failing to populate the cache does not fail the compilation.
+  if (auto err = writeAtomically(directory, getName(key), text))
+    consumeError(std::move(err));
+}
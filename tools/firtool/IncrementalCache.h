@@ -0,0 +1,118 @@
+//===- IncrementalCache.h - Incremental compilation cache -------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the on-disk cache of the outputs produced by firtool,
+// keyed by the structural fingerprints of the modules of the input.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_FIRTOOL_INCREMENTALCACHE_H
+#define CIRCT_FIRTOOL_INCREMENTALCACHE_H
+
+#include "circt/Conversion/ExportVerilog.h"
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace llvm {
+class MemoryBuffer;
+} // namespace llvm
+
+namespace circt {
+namespace firtool {
+
+/// The fingerprints of an input of firtool.
+struct InputFingerprint {
+  /// The name of the circuit, or empty if the input has none.
+  std::string circuitName;
+  /// The fingerprint of every module of the circuit, by name, in the order of
+  /// the circuit. The fingerprint of a module covers its body, its ports, its
+  /// annotations and its locations, and the fingerprints of the modules it
+  /// instantiates.
+  SmallVector<std::pair<std::string, std::string>> modules;
+  /// The key of the input, covering the fingerprints of its modules, the
+  /// attributes and annotations of its circuit, any other top-level operation,
+  /// the black box files referenced by its annotations, and the given options.
+  std::string key;
+};
+
+/// Fingerprint the given input of firtool. The black box files referenced by
+/// path annotations are resolved relative to the given root.
+InputFingerprint fingerprintInput(mlir::ModuleOp module, StringRef options,
+                                  StringRef blackBoxRoot);
+
+/// An on-disk cache of the outputs produced by firtool. Since the passes of
+/// the pipeline propagate information across the module hierarchy, e.g. the
+/// constants of IMConstProp, the prefixes of PrefixModules or the modules kept
+/// by Dedup, the output of a module is not a function of its FIRRTL
+/// fingerprint and of the ones of its children. This cache is therefore keyed
+/// by the entire input, and records the fingerprints of its modules to report
+/// the modules which changed since the last cached compilation of the same
+/// circuit. The Verilog of the individual modules is cached separately, once
+/// lowered, by the `ModuleVerilogCache`.
+class IncrementalCache {
+public:
+  /// Create a cache storing its entries in the given directory. The directory
+  /// is created when the first entry is stored.
+  IncrementalCache(StringRef directory) : directory(directory) {}
+
+  /// Return the output cached for the given input, or null if there is none.
+  std::unique_ptr<llvm::MemoryBuffer>
+  lookup(const InputFingerprint &input) const;
+
+  /// Store the output produced for the given input.
+  llvm::Error store(const InputFingerprint &input, StringRef output) const;
+
+  /// Return the names of the modules which were added or changed since the
+  /// last compilation of the same circuit stored in the cache.
+  SmallVector<std::string>
+  getChangedModules(const InputFingerprint &input) const;
+
+private:
+  std::string getPath(const Twine &name) const;
+
+  std::string directory;
+};
+
+/// An on-disk cache of the Verilog emitted for the individual modules of a
+/// design, used by ExportVerilog when the whole input missed in the
+/// `IncrementalCache`. The entries are keyed by the lowered HW modules, such
+/// that the modules whose lowering did not change are not emitted again.
+class ModuleVerilogCache : public ExportVerilogModuleCache {
+public:
+  /// Create a cache storing its entries in the `modules` subdirectory of the
+  /// given directory.
+  ModuleVerilogCache(StringRef directory);
+
+  Optional<std::string> lookup(StringRef key) override;
+  void store(StringRef key, StringRef text) override;
+
+  /// The number of modules whose Verilog was found in the cache.
+  unsigned getNumHits() const { return numHits; }
+  /// The number of modules which were emitted.
+  unsigned getNumMisses() const { return numMisses; }
+
+private:
+  std::string getName(StringRef key) const;
+
+  std::string directory;
+  std::atomic<unsigned> numHits = 0;
+  std::atomic<unsigned> numMisses = 0;
+};
+
+} // namespace firtool
+} // namespace circt
+
+#endif // CIRCT_FIRTOOL_INCREMENTALCACHE_H
@@ -0,0 +1,272 @@
+//===- PassProfile.cpp - Per-pass memory and IR size profile --------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the profile of the passes run by firtool.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassProfile.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/resource.h>
+#endif
+
+using namespace llvm;
+using namespace mlir;
+using namespace circt;
+using namespace firtool;
+
+//===----------------------------------------------------------------------===//
+// Measurements
+//===----------------------------------------------------------------------===//
+
+MemoryUsage MemoryUsage::get() {
+  MemoryUsage usage;
+  usage.heap = sys::Process::GetMallocUsage();
+
+  // The second field of statm is the number of resident pages.
+  if (auto statm = MemoryBuffer::getFileAsStream("/proc/self/statm")) {
+    StringRef resident = (*statm)->getBuffer().split(' ').second;
+    int64_t pages;
+    if (!resident.split(' ').first.getAsInteger(10, pages))
+      usage.rss = pages * sys::Process::getPageSizeEstimate();
+  }
+
+#ifdef LLVM_ON_UNIX
+  struct rusage rusage;
+  if (getrusage(RUSAGE_SELF, &rusage) == 0) {
+#ifdef __APPLE__
+    // macOS reports bytes, where Linux reports kilobytes.
+    usage.peakRSS = rusage.ru_maxrss;
+#else
+    usage.peakRSS = int64_t(rusage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return usage;
+}
+
+IRSize IRSize::get(Operation *op) {
+  IRSize size;
+  DenseMap<OperationName, int64_t> opCounts;
+  DenseSet<Type> types;
+  DenseSet<Attribute> attrs;
+  op->walk([&](Operation *nested) {
+    ++opCounts[nested->getName()];
+    types.insert(nested->getResultTypes().begin(),
+                 nested->getResultTypes().end());
+    for (auto &region : nested->getRegions())
+      for (auto &block : region)
+        types.insert(block.getArgumentTypes().begin(),
+                     block.getArgumentTypes().end());
+    for (auto attr : nested->getAttrs())
+      attrs.insert(attr.getValue());
+  });
+  for (auto &count : opCounts) {
+    size.opCounts[count.first.getStringRef()] = count.second;
+    size.numOps += count.second;
+  }
+  size.numTypes = types.size();
+  size.numAttrs = attrs.size();
+  return size;
+}
+
+//===----------------------------------------------------------------------===//
+// PassProfile
+//===----------------------------------------------------------------------===//
+
+PassProfile::PassProfile() : startTime(sys::TimePoint<>::clock::now()) {}
+
+namespace {
+/// The count of operations of a kind before and after a pass.
+struct CountChange {
+  int64_t before = 0;
+  int64_t after = 0;
+};
+} // namespace
+
+/// Collect the changes of the op counts by operation name and by dialect,
+/// sorted by name such that reports can be diffed.
+static void
+collectCountChanges(const PassProfile::Entry &entry,
+                    std::map<std::string, CountChange> &byName,
+                    std::map<std::string, CountChange> &byDialect) {
+  for (auto &count : entry.sizeBefore.opCounts) {
+    byName[count.getKey().str()].before += count.getValue();
+    byDialect[count.getKey().split('.').first.str()].before +=
+        count.getValue();
+  }
+  for (auto &count : entry.sizeAfter.opCounts) {
+    byName[count.getKey().str()].after += count.getValue();
+    byDialect[count.getKey().split('.').first.str()].after += count.getValue();
+  }
+}
+
+void PassProfile::writeJSON(raw_ostream &os) const {
+  json::OStream j(os, 2);
+  auto writeCounts = [&](const std::map<std::string, CountChange> &counts) {
+    for (auto &count : counts) {
+      j.attributeObject(count.first, [&] {
+        j.attribute("count", count.second.after);
+        j.attribute("delta", count.second.after - count.second.before);
+      });
+    }
+  };
+
+  j.object([&] {
+    j.attribute("version", 1);
+    j.attributeArray("passes", [&] {
+      for (auto &entry : entries) {
+        std::map<std::string, CountChange> byName, byDialect;
+        collectCountChanges(entry, byName, byDialect);
+        j.object([&] {
+          j.attribute("pass", entry.pass);
+          j.attribute("op", entry.op);
+          j.attribute("depth", entry.depth);
+          j.attribute("failed", entry.failed);
+          j.attribute("startUs", entry.start);
+          j.attribute("durationUs", entry.duration);
+          j.attributeObject("memory", [&] {
+            j.attribute("rss", entry.memoryAfter.rss);
+            j.attribute("rssDelta",
+                        entry.memoryAfter.rss - entry.memoryBefore.rss);
+            j.attribute("peakRSS", entry.memoryAfter.peakRSS);
+            j.attribute("peakRSSDelta",
+                        entry.memoryAfter.peakRSS - entry.memoryBefore.peakRSS);
+            j.attribute("heap", entry.memoryAfter.heap);
+            j.attribute("heapDelta",
+                        entry.memoryAfter.heap - entry.memoryBefore.heap);
+          });
+          j.attributeObject("ir", [&] {
+            j.attribute("ops", entry.sizeAfter.numOps);
+            j.attribute("opsDelta",
+                        entry.sizeAfter.numOps - entry.sizeBefore.numOps);
+            j.attribute("types", entry.sizeAfter.numTypes);
+            j.attribute("typesDelta",
+                        entry.sizeAfter.numTypes - entry.sizeBefore.numTypes);
+            j.attribute("attributes", entry.sizeAfter.numAttrs);
+            j.attribute("attributesDelta",
+                        entry.sizeAfter.numAttrs - entry.sizeBefore.numAttrs);
+          });
+          j.attributeObject("dialects", [&] { writeCounts(byDialect); });
+          j.attributeObject("operations", [&] { writeCounts(byName); });
+        });
+      }
+    });
+  });
+  os << "\n";
+}
+
+void PassProfile::writeChromeTrace(raw_ostream &os) const {
+  json::OStream j(os);
+  j.object([&] {
+    j.attribute("displayTimeUnit", "ms");
+    j.attributeArray("traceEvents", [&] {
+      for (auto &entry : entries) {
+        // A complete event spanning the pass.
+        j.object([&] {
+          j.attribute("name", entry.pass);
+          j.attribute("cat", entry.op);
+          j.attribute("ph", "X");
+          j.attribute("pid", 1);
+          j.attribute("tid", 0);
+          j.attribute("ts", entry.start);
+          j.attribute("dur", entry.duration);
+          j.attributeObject("args", [&] {
+            j.attribute("opsBefore", entry.sizeBefore.numOps);
+            j.attribute("opsAfter", entry.sizeAfter.numOps);
+            j.attribute("rssBefore", entry.memoryBefore.rss);
+            j.attribute("rssAfter", entry.memoryAfter.rss);
+            j.attribute("failed", entry.failed);
+          });
+        });
+
+        // Counters sampled at the end of the pass.
+        auto writeCounter = [&](StringRef name,
+                                function_ref<void()> writeValues) {
+          j.object([&] {
+            j.attribute("name", name);
+            j.attribute("ph", "C");
+            j.attribute("pid", 1);
+            j.attribute("ts", entry.start + entry.duration);
+            j.attributeObject("args", writeValues);
+          });
+        };
+        writeCounter("memory (MiB)", [&] {
+          j.attribute("rss", entry.memoryAfter.rss / double(1 << 20));
+          j.attribute("heap", entry.memoryAfter.heap / double(1 << 20));
+        });
+        writeCounter("IR", [&] {
+          j.attribute("ops", entry.sizeAfter.numOps);
+          j.attribute("types", entry.sizeAfter.numTypes);
+          j.attribute("attributes", entry.sizeAfter.numAttrs);
+        });
+      }
+    });
+  });
+  os << "\n";
+}
+
+//===----------------------------------------------------------------------===//
+// PassProfileInstrumentation
+//===----------------------------------------------------------------------===//
+
+void PassProfileInstrumentation::runBeforePass(Pass *pass, Operation *op) {
+  // Passes on the operations held by circuits and modules run in parallel.
+  if (!isa<firrtl::CircuitOp, mlir::ModuleOp>(op))
+    return;
+
+  running.push_back(profile.entries.size());
+  auto &entry = profile.entries.emplace_back();
+  raw_string_ostream os(entry.pass);
+  pass->printAsTextualPipeline(os);
+  os.flush();
+  entry.op = op->getName().getStringRef().str();
+  entry.depth = running.size() - 1;
+  entry.sizeBefore = IRSize::get(op);
+  // Sample the memory last, such that it does not cover the walk of the IR.
+  entry.memoryBefore = MemoryUsage::get();
+  entry.start = std::chrono::duration_cast<std::chrono::microseconds>(
+                    sys::TimePoint<>::clock::now() - profile.startTime)
+                    .count();
+}
+
+void PassProfileInstrumentation::finishEntry(Operation *op, bool failed) {
+  if (!isa<firrtl::CircuitOp, mlir::ModuleOp>(op))
+    return;
+
+  auto &entry = profile.entries[running.pop_back_val()];
+  auto end = std::chrono::duration_cast<std::chrono::microseconds>(
+                 sys::TimePoint<>::clock::now() - profile.startTime)
+                 .count();
+  entry.duration = end - entry.start;
+  entry.memoryAfter = MemoryUsage::get();
+  entry.failed = failed;
+  entry.sizeAfter = IRSize::get(op);
+}
+
+void PassProfileInstrumentation::runAfterPass(Pass *pass, Operation *op) {
+  finishEntry(op, /*failed=*/false);
+}
+
+void PassProfileInstrumentation::runAfterPassFailed(Pass *pass,
+                                                    Operation *op) {
+  finishEntry(op, /*failed=*/true);
+}
@@ -0,0 +1,117 @@
+//===- PassProfile.h - Per-pass memory and IR size profile ------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pass instrumentation which records the time, the memory
+// usage and the size of the IR around every pass run by firtool, and writes
+// them as a JSON report or as a Chrome trace.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_FIRTOOL_PASSPROFILE_H
+#define CIRCT_FIRTOOL_PASSPROFILE_H
+
+#include "circt/Support/LLVM.h"
+#include "mlir/Pass/PassInstrumentation.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Chrono.h"
+
+#include <string>
+#include <vector>
+
+namespace circt {
+namespace firtool {
+
+/// The memory usage of the process at some point in time, in bytes. Fields
+/// which cannot be measured on the host are zero.
+struct MemoryUsage {
+  /// The resident set size.
+  int64_t rss = 0;
+  /// The peak resident set size since the process started.
+  int64_t peakRSS = 0;
+  /// The number of bytes allocated by malloc.
+  int64_t heap = 0;
+
+  static MemoryUsage get();
+};
+
+/// The size of an operation and of the IR it holds.
+struct IRSize {
+  /// The number of operations, by operation name.
+  llvm::StringMap<int64_t> opCounts;
+  /// The total number of operations.
+  int64_t numOps = 0;
+  /// The number of distinct types of the values, and of distinct attributes
+  /// of the operations. The context does not expose the contents of its
+  /// uniquer, so these stand for its growth.
+  int64_t numTypes = 0;
+  int64_t numAttrs = 0;
+
+  static IRSize get(Operation *op);
+};
+
+/// A profile of the passes run by firtool.
+class PassProfile {
+public:
+  PassProfile();
+
+  /// The measurements of one pass run.
+  struct Entry {
+    std::string pass;
+    std::string op;
+    /// The nesting depth of the pass, e.g. 1 for a pass run by a pass adaptor
+    /// on the root operation.
+    unsigned depth = 0;
+    bool failed = false;
+    /// The start time and duration, in microseconds.
+    int64_t start = 0;
+    int64_t duration = 0;
+    MemoryUsage memoryBefore, memoryAfter;
+    IRSize sizeBefore, sizeAfter;
+  };
+
+  /// Write the profile as a JSON report, listing the measurements of every
+  /// pass, along with the op counts by name and by dialect.
+  void writeJSON(raw_ostream &os) const;
+
+  /// Write the profile in the Chrome trace event format, which can be loaded
+  /// in chrome://tracing or Perfetto.
+  void writeChromeTrace(raw_ostream &os) const;
+
+private:
+  friend class PassProfileInstrumentation;
+
+  llvm::sys::TimePoint<> startTime;
+  std::vector<Entry> entries;
+};
+
+/// A pass instrumentation recording the passes run on builtin modules and
+/// FIRRTL circuits into a profile. Passes on the operations they hold run in
+/// parallel, and are covered by the pass adaptor which runs them. Measuring
+/// the IR takes a walk before and after every pass, which is included in the
+/// duration of the enclosing pass adaptors.
+class PassProfileInstrumentation : public mlir::PassInstrumentation {
+public:
+  PassProfileInstrumentation(PassProfile &profile) : profile(profile) {}
+
+  void runBeforePass(Pass *pass, Operation *op) override;
+  void runAfterPass(Pass *pass, Operation *op) override;
+  void runAfterPassFailed(Pass *pass, Operation *op) override;
+
+private:
+  void finishEntry(Operation *op, bool failed);
+
+  PassProfile &profile;
+  /// The indices of the entries of the passes which are running.
+  SmallVector<size_t> running;
+};
+
+} // namespace firtool
+} // namespace circt
+
+#endif // CIRCT_FIRTOOL_PASSPROFILE_H
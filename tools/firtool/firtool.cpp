@@ -11,6 +11,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "IncrementalCache.h"
+#include "PassProfile.h"
 #include "circt/Conversion/ExportVerilog.h"
 #include "circt/Conversion/Passes.h"
 #include "circt/Dialect/Comb/CombDialect.h"
@@ -23,6 +25,7 @@
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/SV/SVDialect.h"
 #include "circt/Dialect/SV/SVPasses.h"
+#include "circt/Support/BinaryIR.h"
 #include "circt/Support/LoweringOptions.h"
 #include "circt/Support/Version.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
@@ -37,6 +40,7 @@
 #include "mlir/Support/ToolUtilities.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "mlir/Transforms/Passes.h"
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/Support/Chrono.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
@@ -97,6 +101,12 @@ static cl::opt<bool> enableAnnotationWarning(
     cl::desc("Warn about annotations that were not removed by lower-to-hw"),
     cl::init(false), cl::cat(mainCategory));
 
+static cl::opt<bool> streamAnnotationFiles(
+    "stream-annotation-files",
+    cl::desc("Import annotation files one annotation at a time, converting "
+             "them to attributes in parallel"),
+    cl::init(false), cl::cat(mainCategory));
+
 static cl::opt<bool> disableAnnotationsClassless(
     "disable-annotation-classless",
     cl::desc("Ignore annotations without a class when parsing"),
@@ -290,6 +300,13 @@ static cl::opt<OutputFormatKind> outputFormat(
         clEnumValN(OutputDisabled, "disable-output", "Do not output anything")),
     cl::init(OutputVerilog), cl::cat(mainCategory));
 
+static cl::opt<bool> skipUnchangedFiles(
+    "skip-unchanged-files",
+    cl::desc("Do not rewrite the split Verilog files whose contents did not "
+             "change, such that incremental builds do not see them as "
+             "modified"),
+    cl::init(false), cl::cat(mainCategory));
+
 static cl::opt<bool>
     verifyPasses("verify-each",
                  cl::desc("Run the verifier after each transformation pass"),
@@ -314,6 +331,12 @@ static cl::opt<std::string>
                 cl::init(""), cl::value_desc("filename"),
                 cl::cat(mainCategory));
 
+static cl::opt<bool> emitBinaryIR(
+    "emit-binary-ir",
+    cl::desc("Write the .mlir outputs as binary IR, which is faster to load "
+             "than text"),
+    cl::init(false), cl::cat(mainCategory));
+
 static cl::opt<std::string> blackBoxRootPath(
     "blackbox-path",
     cl::desc("Optional path to use as the root of black box annotations"),
@@ -324,6 +347,28 @@ static cl::opt<bool>
                           cl::desc("Log executions of toplevel module passes"),
                           cl::init(false), cl::cat(mainCategory));
 
+static cl::opt<std::string> passProfileFile(
+    "pass-profile",
+    cl::desc("Write a JSON report of the time, memory usage and op counts "
+             "around every pass into the given file"),
+    cl::value_desc("filename"), cl::init(""), cl::cat(mainCategory));
+
+static cl::opt<std::string> passProfileTraceFile(
+    "pass-profile-trace",
+    cl::desc("Write the time, memory usage and op counts around every pass "
+             "into the given file, in the Chrome trace event format"),
+    cl::value_desc("filename"), cl::init(""), cl::cat(mainCategory));
+
+static cl::opt<std::string> incrementalCacheDir(
+    "incremental-cache-dir",
+    cl::desc("Reuse the output of previous compilations of a structurally "
+             "identical input, cached in the given directory"),
+    cl::value_desc("directory"), cl::init(""), cl::cat(mainCategory));
+
+/// The command line options, which are part of the key of the incremental
+/// cache.
+static std::string cacheOptions;
+
 static cl::opt<bool> stripDebugInfo(
     "strip-debug-info",
     cl::desc("Disable source locator information in output Verilog"),
@@ -382,6 +427,35 @@ public:
   }
 };
 
+/// Print a .mlir output, as text or as binary IR.
+static void printMLIR(ModuleOp module, raw_ostream &os) {
+  if (emitBinaryIR)
+    writeBinaryIR(module, os);
+  else
+    module->print(os);
+}
+
+/// Write the profile of the passes into the files requested on the command
+/// line. Failing to do so does not fail the compilation.
+static void writePassProfile(const firtool::PassProfile &profile) {
+  auto write = [&](StringRef filename, auto writeProfile) {
+    if (filename.empty())
+      return;
+    std::string errorMessage;
+    auto file = openOutputFile(filename, &errorMessage);
+    if (!file) {
+      llvm::errs() << "warning: cannot write the pass profile: "
+                   << errorMessage << "\n";
+      return;
+    }
+    writeProfile(file->os());
+    file->keep();
+  };
+  write(passProfileFile, [&](raw_ostream &os) { profile.writeJSON(os); });
+  write(passProfileTraceFile,
+        [&](raw_ostream &os) { profile.writeChromeTrace(os); });
+}
+
 /// Process a single buffer of the input.
 static LogicalResult
 processBuffer(MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
@@ -425,11 +499,18 @@ processBuffer(MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
     firrtl::FIRParserOptions options;
     options.ignoreInfoLocators = ignoreFIRLocations;
     options.numAnnotationFiles = numAnnotationFiles;
+    options.streamAnnotationFiles = streamAnnotationFiles;
     module = importFIRFile(sourceMgr, &context, parserTimer, options);
   } else {
-    auto parserTimer = ts.nest("MLIR Parser");
     assert(inputFormat == InputMLIRFile);
-    module = parseSourceFile<ModuleOp>(sourceMgr, &context);
+    auto *buffer = sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID());
+    if (isBinaryIR(buffer->getBuffer())) {
+      auto readerTimer = ts.nest("Binary IR Reader");
+      module = readBinaryIR(sourceMgr, &context);
+    } else {
+      auto parserTimer = ts.nest("MLIR Parser");
+      module = parseSourceFile<ModuleOp>(sourceMgr, &context);
+    }
   }
   if (!module)
     return failure();
@@ -446,16 +527,82 @@ processBuffer(MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
   if (outputFormat == OutputParseOnly) {
     mlir::ModuleOp theModule = module.release();
     auto outputTimer = ts.nest("Print .mlir output");
-    theModule->print(outputFile.getValue()->os());
+    printMLIR(theModule, outputFile.getValue()->os());
     return success();
   }
 
+  StringRef blackBoxRoot = blackBoxRootPath.empty()
+                               ? llvm::sys::path::parent_path(inputFilename)
+                               : blackBoxRootPath;
+
+  // Reuse the output of a previous compilation of the same input, if any. The
+  // cache only covers the outputs written to the output file: it is bypassed
+  // if the compilation writes other files, or if the diagnostics it emits
+  // matter.
+  Optional<firtool::IncrementalCache> cache;
+  Optional<firtool::ModuleVerilogCache> moduleCache;
+  firtool::InputFingerprint fingerprint;
+  if (!incrementalCacheDir.empty() && outputFormat != OutputSplitVerilog &&
+      outputFormat != OutputDisabled && mlirOutFile.empty() &&
+      !exportModuleHierarchy && !verifyDiagnostics) {
+    auto cacheTimer = ts.nest("Incremental cache lookup");
+    cache.emplace(incrementalCacheDir);
+    fingerprint =
+        firtool::fingerprintInput(module.get(), cacheOptions, blackBoxRoot);
+    if (auto output = cache->lookup(fingerprint)) {
+      if (verbosePassExecutions)
+        llvm::errs() << "[firtool] Reusing the cached output of "
+                     << fingerprint.modules.size() << " modules\n";
+      outputFile.getValue()->os() << output->getBuffer();
+      (void)module.release();
+      return success();
+    }
+    if (verbosePassExecutions) {
+      auto changed = cache->getChangedModules(fingerprint);
+      llvm::errs() << "[firtool] " << changed.size() << " of "
+                   << fingerprint.modules.size()
+                   << " modules changed since the last cached compilation";
+      if (!changed.empty()) {
+        llvm::errs() << ": ";
+        llvm::interleaveComma(changed, llvm::errs());
+      }
+      llvm::errs() << "\n";
+    }
+    // On a miss, the Verilog of the modules whose lowering did not change is
+    // reused.
+    if (outputFormat == OutputVerilog)
+      moduleCache.emplace(incrementalCacheDir);
+  }
+
+  // With the cache enabled, the output is collected to be cached before being
+  // written to the output file.
+  std::string cachedOutput;
+  llvm::raw_string_ostream cachedOutputStream(cachedOutput);
+  auto getOutputStream = [&]() -> raw_ostream & {
+    if (cache)
+      return cachedOutputStream;
+    return outputFile.getValue()->os();
+  };
+
+  // Record a profile of the passes if requested. It is written when processing
+  // stops, such that the passes leading to a failure are covered as well.
+  Optional<firtool::PassProfile> passProfile;
+  if (!passProfileFile.empty() || !passProfileTraceFile.empty())
+    passProfile.emplace();
+  auto passProfileWriter = llvm::make_scope_exit([&]() {
+    if (passProfile)
+      writePassProfile(*passProfile);
+  });
+
   // Apply any pass manager command line options.
   PassManager pm(&context);
   pm.enableVerifier(verifyPasses);
   pm.enableTiming(ts);
   if (verbosePassExecutions)
     pm.addInstrumentation(std::make_unique<FirtoolPassInstrumentation>());
+  if (passProfile)
+    pm.addInstrumentation(
+        std::make_unique<firtool::PassProfileInstrumentation>(*passProfile));
   applyPassManagerCLOptions(pm);
 
   pm.nest<firrtl::CircuitOp>().addPass(firrtl::createLowerFIRRTLAnnotationsPass(
@@ -559,9 +706,6 @@ processBuffer(MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
   }
 
   // Read black box source files into the IR.
-  StringRef blackBoxRoot = blackBoxRootPath.empty()
-                               ? llvm::sys::path::parent_path(inputFilename)
-                               : blackBoxRootPath;
   pm.nest<firrtl::CircuitOp>().addPass(
       firrtl::createBlackBoxReaderPass(blackBoxRoot));
 
@@ -633,6 +777,9 @@ processBuffer(MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
     if (verbosePassExecutions)
       exportPm.addInstrumentation(
           std::make_unique<FirtoolPassInstrumentation>());
+    if (passProfile)
+      exportPm.addInstrumentation(
+          std::make_unique<firtool::PassProfileInstrumentation>(*passProfile));
     // Legalize unsupported operations within the modules.
     exportPm.nest<hw::HWModuleOp>().addPass(sv::createHWLegalizeModulesPass());
 
@@ -650,10 +797,12 @@ processBuffer(MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
     default:
       llvm_unreachable("can't reach this");
     case OutputVerilog:
-      exportPm.addPass(createExportVerilogPass(outputFile.getValue()->os()));
+      exportPm.addPass(createExportVerilogPass(
+          getOutputStream(), moduleCache ? moduleCache.getPointer() : nullptr));
       break;
     case OutputSplitVerilog:
-      exportPm.addPass(createExportSplitVerilogPass(outputFilename));
+      exportPm.addPass(
+          createExportSplitVerilogPass(outputFilename, skipUnchangedFiles));
       break;
     case OutputIRVerilog:
       // Run the ExportVerilog pass to get its lowering, but discard the output.
@@ -677,7 +826,22 @@ processBuffer(MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
   if (outputFormat == OutputIRFir || outputFormat == OutputIRHW ||
       outputFormat == OutputIRSV || outputFormat == OutputIRVerilog) {
     auto outputTimer = ts.nest("Print .mlir output");
-    module->print(outputFile.getValue()->os());
+    printMLIR(module.get(), getOutputStream());
+  }
+
+  if (moduleCache && verbosePassExecutions) {
+    auto numHits = moduleCache->getNumHits();
+    llvm::errs() << "[firtool] Reused the Verilog of " << numHits << " of "
+                 << numHits + moduleCache->getNumMisses() << " modules\n";
+  }
+
+  if (cache) {
+    outputFile.getValue()->os() << cachedOutputStream.str();
+    // Failing to populate the cache does not fail the compilation.
+    if (auto err = cache->store(fingerprint, cachedOutput))
+      llvm::errs() << "warning: cannot store the output in the incremental "
+                      "cache: "
+                   << toString(std::move(err)) << "\n";
   }
 
   // If requested, print the final MLIR into mlirOutFile.
@@ -689,7 +853,7 @@ processBuffer(MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
       return failure();
     }
 
-    module->print(mlirFile->os());
+    printMLIR(module.get(), mlirFile->os());
     mlirFile->keep();
   }
 
@@ -840,6 +1004,36 @@ int main(int argc, char **argv) {
   // Parse pass names in main to ensure static initialization completed.
   cl::ParseCommandLineOptions(argc, argv, "MLIR-based FIRRTL compiler\n");
 
+  // The name of the input makes no difference to the output, beyond the
+  // locations and black box paths which are part of the fingerprint. Neither
+  // do the paths of the output file and of the cache.
+  // The value of an option is either the next argument, or attached to the
+  // option with or without an `=`, so the parsed values are matched against
+  // the arguments.
+  auto isPathOption = [](StringRef option, StringRef name, StringRef value) {
+    if (!option.consume_front(name))
+      return false;
+    option.consume_front("=");
+    return option == value;
+  };
+  for (int i = 1; i < argc; ++i) {
+    StringRef arg = argv[i];
+    if (arg == inputFilename)
+      continue;
+    auto option = arg.ltrim('-');
+    if (option.size() != arg.size()) {
+      if (option == "o" || option == "incremental-cache-dir") {
+        ++i;
+        continue;
+      }
+      if (isPathOption(option, "o", outputFilename) ||
+          isPathOption(option, "incremental-cache-dir", incrementalCacheDir))
+        continue;
+    }
+    cacheOptions += arg;
+    cacheOptions += '\n';
+  }
+
   MLIRContext context;
 
   // Do the guts of the firtool process.
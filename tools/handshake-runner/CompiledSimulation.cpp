@@ -0,0 +1,1105 @@
+//===- CompiledSimulation.cpp - Compiled handshake simulation -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the compiled execution modes of the handshake runner.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompiledSimulation.h"
+#include "mlir/Dialect/Arithmetic/IR/Arithmetic.h"
+#include "mlir/IR/AsmState.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+
+#include <deque>
+
+#define DEBUG_TYPE "runner"
+
+#define INDEX_WIDTH 32
+
+STATISTIC(microOpsFired, "Micro-ops fired in compiled mode");
+
+using namespace llvm;
+using namespace mlir;
+
+namespace circt {
+namespace handshake {
+
+/// Return whether values of the given type can be held in a slot.
+static bool isSupportedType(Type type) {
+  return type.isa<IntegerType, IndexType, NoneType, MemRefType>() ||
+         type.isF32() || type.isF64();
+}
+
+//===----------------------------------------------------------------------===//
+// Compilation
+//===----------------------------------------------------------------------===//
+
+CompiledFunction::~CompiledFunction() = default;
+
+std::unique_ptr<CompiledFunction>
+CompiledFunction::compile(FuncOp func, const SimulationOptions &options) {
+  bool cycleAccurate = options.mode == SimulationMode::CycleAccurate;
+  std::unique_ptr<CompiledFunction> compiled(
+      new CompiledFunction(func, cycleAccurate));
+  Block &entryBlock = func.getBody().front();
+
+  // Assign a slot to every value, the arguments first.
+  DenseMap<Value, unsigned> slots;
+  auto &values = compiled->values;
+  auto addSlot = [&](Value value) {
+    slots[value] = values.size();
+    values.push_back(value);
+    return isSupportedType(value.getType());
+  };
+  for (auto arg : entryBlock.getArguments())
+    if (!addSlot(arg))
+      return nullptr;
+  for (auto &op : entryBlock)
+    for (auto result : op.getResults())
+      if (!addSlot(result))
+        return nullptr;
+  compiled->numArguments = entryBlock.getNumArguments();
+  compiled->numSlots = values.size();
+
+  // Lower every operation to a micro-op.
+  DenseMap<Operation *, unsigned> opIndices;
+  for (auto &op : entryBlock) {
+    MicroOp microOp;
+    microOp.op = &op;
+    auto supported =
+        TypeSwitch<Operation *, bool>(&op)
+            .Case<ForkOp>([&](auto) {
+              microOp.opcode = Opcode::Fork;
+              microOp.latency = 1;
+              return true;
+            })
+            .Case<BranchOp>([&](auto) {
+              microOp.opcode = Opcode::Forward;
+              return true;
+            })
+            .Case<JoinOp>([&](auto) {
+              microOp.opcode = Opcode::Forward;
+              microOp.latency = 1;
+              return true;
+            })
+            .Case<BufferOp>([&](auto bufferOp) {
+              microOp.opcode = Opcode::Forward;
+              microOp.latency = bufferOp.getNumSlots();
+              // Sequential buffers register their tokens, while FIFOs are
+              // transparent when empty.
+              microOp.capacity = bufferOp.getNumSlots();
+              microOp.cycleLatency = bufferOp.isSequential() ? 1 : 0;
+              if (!bufferOp.initValues().hasValue())
+                return true;
+              auto initValues = bufferOp.getInitValues();
+              if (!cycleAccurate && initValues.size() != 1)
+                return false;
+              unsigned width =
+                  bufferOp.getResult().getType().getIntOrFloatBitWidth();
+              SmallVector<APInt, 1> inits;
+              for (auto value : initValues)
+                inits.push_back(APInt(width, value));
+              compiled->bufferInits.emplace_back(compiled->microOps.size(),
+                                                 std::move(inits));
+              return true;
+            })
+            .Case<ConstantOp>([&](auto constantOp) {
+              microOp.opcode = Opcode::Constant;
+              microOp.immediate = compiled->constants.size();
+              compiled->constants.push_back(
+                  constantOp->template getAttrOfType<IntegerAttr>("value")
+                      .getValue());
+              return true;
+            })
+            .Case<StoreOp>([&](auto) {
+              microOp.opcode = Opcode::Store;
+              microOp.latency = 1;
+              return op.getNumOperands() == 3;
+            })
+            .Case<LoadOp>([&](auto) {
+              microOp.opcode = Opcode::Load;
+              microOp.needsAllOperands = false;
+              return op.getNumOperands() == 3;
+            })
+            .Case<MergeOp>([&](auto) {
+              microOp.opcode = Opcode::Merge;
+              microOp.needsAllOperands = false;
+              return true;
+            })
+            .Case<MuxOp>([&](auto) {
+              microOp.opcode = Opcode::Mux;
+              microOp.needsAllOperands = false;
+              return true;
+            })
+            .Case<ControlMergeOp>([&](auto) {
+              microOp.opcode = Opcode::ControlMerge;
+              microOp.needsAllOperands = false;
+              return true;
+            })
+            .Case<ConditionalBranchOp>([&](auto) {
+              microOp.opcode = Opcode::ConditionalBranch;
+              return true;
+            })
+            .Case<SinkOp>([&](auto) {
+              microOp.opcode = Opcode::Sink;
+              microOp.needsAllOperands = false;
+              return true;
+            })
+            .Case<MemoryOp>([&](auto memoryOp) {
+              microOp.opcode = Opcode::Memory;
+              microOp.needsAllOperands = false;
+              microOp.immediate = compiled->memories.size();
+              microOp.numStores = memoryOp.stCount();
+              compiled->memories.push_back(memoryOp);
+              return true;
+            })
+            .Case<ExternalMemoryOp>([&](auto memoryOp) {
+              microOp.opcode = Opcode::ExternalMemory;
+              microOp.needsAllOperands = false;
+              microOp.numStores = memoryOp.stCount();
+              return true;
+            })
+            .Case<ReturnOp>([&](auto) {
+              microOp.opcode = Opcode::Return;
+              return true;
+            })
+            .Case<arith::AddIOp>([&](auto) {
+              microOp.opcode = Opcode::AddI;
+              return true;
+            })
+            .Case<arith::SubIOp>([&](auto) {
+              microOp.opcode = Opcode::SubI;
+              return true;
+            })
+            .Case<arith::MulIOp>([&](auto) {
+              microOp.opcode = Opcode::MulI;
+              return true;
+            })
+            .Case<arith::DivSIOp>([&](auto) {
+              microOp.opcode = Opcode::DivSI;
+              return true;
+            })
+            .Case<arith::DivUIOp>([&](auto) {
+              microOp.opcode = Opcode::DivUI;
+              return true;
+            })
+            .Case<arith::XOrIOp>([&](auto) {
+              microOp.opcode = Opcode::XOrI;
+              return true;
+            })
+            .Case<arith::CmpIOp>([&](auto cmpOp) {
+              microOp.opcode = Opcode::CmpI;
+              microOp.immediate = static_cast<unsigned>(cmpOp.getPredicate());
+              return true;
+            })
+            .Case<arith::AddFOp>([&](auto) {
+              microOp.opcode = Opcode::AddF;
+              return true;
+            })
+            .Case<arith::SubFOp>([&](auto) {
+              microOp.opcode = Opcode::SubF;
+              return true;
+            })
+            .Case<arith::MulFOp>([&](auto) {
+              microOp.opcode = Opcode::MulF;
+              return true;
+            })
+            .Case<arith::DivFOp>([&](auto) {
+              microOp.opcode = Opcode::DivF;
+              return true;
+            })
+            .Case<arith::CmpFOp>([&](auto cmpOp) {
+              microOp.opcode = Opcode::CmpF;
+              microOp.immediate = static_cast<unsigned>(cmpOp.getPredicate());
+              return true;
+            })
+            .Case<arith::IndexCastOp>([&](auto castOp) {
+              microOp.opcode = Opcode::IndexCast;
+              Type type = castOp.getOut().getType();
+              microOp.immediate = type.isIndex()
+                                      ? IndexType::kInternalStorageBitWidth
+                                      : type.getIntOrFloatBitWidth();
+              return true;
+            })
+            .Case<arith::ExtSIOp>([&](auto extOp) {
+              microOp.opcode = Opcode::ExtSI;
+              microOp.immediate = extOp.getType().getIntOrFloatBitWidth();
+              return true;
+            })
+            .Case<arith::ExtUIOp>([&](auto extOp) {
+              microOp.opcode = Opcode::ExtUI;
+              microOp.immediate = extOp.getType().getIntOrFloatBitWidth();
+              return true;
+            })
+            .Default([](auto) { return false; });
+    if (!supported) {
+      LLVM_DEBUG(dbgs() << "Cannot compile " << op << "\n");
+      return nullptr;
+    }
+
+    // The operations with a single firing rule may be given a latency, in
+    // which case they are fully pipelined.
+    bool hasSingleRule =
+        microOp.opcode == Opcode::Fork || microOp.opcode == Opcode::Forward ||
+        microOp.opcode == Opcode::Constant || microOp.opcode == Opcode::Store ||
+        microOp.opcode >= Opcode::AddI;
+    if (cycleAccurate && hasSingleRule && !isa<BufferOp>(op)) {
+      microOp.cycleLatency =
+          options.latencies.lookup(op.getName().getStringRef());
+      microOp.capacity = microOp.cycleLatency;
+    }
+
+    microOp.operands = compiled->slotLists.size();
+    microOp.numOperands = op.getNumOperands();
+    for (auto operand : op.getOperands())
+      compiled->slotLists.push_back(slots[operand]);
+    microOp.results = compiled->slotLists.size();
+    microOp.numResults = op.getNumResults();
+    for (auto result : op.getResults())
+      compiled->slotLists.push_back(slots[result]);
+
+    opIndices[&op] = compiled->microOps.size();
+    compiled->microOps.push_back(microOp);
+  }
+  compiled->producers.assign(compiled->numArguments, noProducer);
+  for (auto it : llvm::enumerate(compiled->microOps))
+    compiled->producers.resize(
+        compiled->producers.size() + it.value().numResults, it.index());
+
+  // Record the users of every slot, in use list order.
+  compiled->userOffsets.reserve(values.size() + 1);
+  compiled->isF32.reserve(values.size());
+  for (auto value : values) {
+    compiled->userOffsets.push_back(compiled->users.size());
+    compiled->isF32.push_back(value.getType().isF32());
+    for (auto *user : value.getUsers())
+      compiled->users.push_back(opIndices[user]);
+  }
+  compiled->userOffsets.push_back(compiled->users.size());
+
+  LLVM_DEBUG(dbgs() << "Compiled " << func.getName() << " to "
+                    << compiled->microOps.size() << " micro-ops over "
+                    << compiled->numSlots << " slots\n");
+  return compiled;
+}
+
+//===----------------------------------------------------------------------===//
+// Execution
+//===----------------------------------------------------------------------===//
+
+class CompiledFunction::Execution {
+public:
+  Execution(const CompiledFunction &fn, DenseMap<Value, Any> &valueMap,
+            DenseMap<Value, double> &timeMap,
+            std::vector<std::vector<Any>> &store,
+            std::vector<double> &storeTimes);
+
+  /// Execute the function until it returns.
+  LogicalResult run(std::vector<Any> &results,
+                    std::vector<double> &resultTimes);
+
+  /// Write the memories back to the store.
+  void writeBack(std::vector<std::vector<Any>> &store) const;
+
+  /// Print the throughput report of a cycle-accurate execution.
+  void printReport(raw_ostream &os) const;
+
+private:
+  /// The results of a micro-op, held for its latency in cycle-accurate mode.
+  struct PendingResults {
+    uint64_t readyCycle;
+    SmallVector<Cell, 2> values;
+  };
+
+  /// The activity of a slot in cycle-accurate mode.
+  struct ChannelStats {
+    uint64_t transfers = 0;
+    uint64_t firstTransfer = 0;
+    uint64_t lastTransfer = 0;
+    /// The number of cycles ending with a token in the slot.
+    uint64_t occupiedCycles = 0;
+    /// The number of cycles ending with a token which arrived in an earlier
+    /// cycle, waiting for its consumer.
+    uint64_t stalledCycles = 0;
+    uint64_t arrival = 0;
+  };
+
+  /// The activity of a micro-op holding results in cycle-accurate mode.
+  struct PipelineStats {
+    /// The number of results held at the end of every cycle, summed.
+    uint64_t heldResults = 0;
+    size_t maxHeldResults = 0;
+    /// The number of cycles ending with a result which is ready but blocked by
+    /// the consumers.
+    uint64_t stalledCycles = 0;
+  };
+
+  ArrayRef<unsigned> getOperands(const MicroOp &microOp) const {
+    return ArrayRef<unsigned>(fn.slotLists.data() + microOp.operands,
+                              microOp.numOperands);
+  }
+  ArrayRef<unsigned> getResults(const MicroOp &microOp) const {
+    return ArrayRef<unsigned>(fn.slotLists.data() + microOp.results,
+                              microOp.numResults);
+  }
+
+  /// Return whether a micro-op has the operands it needs to fire, or results
+  /// to deliver.
+  bool mayFire(unsigned opIndex) const;
+  void enqueue(unsigned opIndex);
+  void scheduleUses(unsigned slot);
+  /// Update the counters of the users of a slot whose token arrived or left,
+  /// and queue the micro-ops which may fire as a result.
+  void propagate(unsigned slot);
+
+  /// Deliver the results of a micro-op to its result slots, and fire it.
+  LogicalResult visit(unsigned opIndex);
+  /// Fire a micro-op. Return whether it fired.
+  FailureOr<bool> fire(unsigned opIndex);
+  /// Fire the ports of a memory, in the same order as the interpreter.
+  /// Return whether all the ports fired.
+  FailureOr<bool> fireMemory(const MicroOp &microOp, ArrayRef<unsigned> ins,
+                             ArrayRef<unsigned> outs,
+                             std::vector<Cell> &buffer, unsigned index);
+  /// Return whether a micro-op can produce new results.
+  bool canAccept(unsigned opIndex) const;
+  /// Produce the results of a micro-op, either in its result slots, or held in
+  /// the micro-op for its latency.
+  void emit(unsigned opIndex, SmallVector<Cell, 2> values, double time);
+  /// Move the oldest results held in a micro-op to its result slots, if they
+  /// are ready and the slots are free.
+  void deliver(unsigned opIndex);
+  void produce(unsigned slot, const Cell &value, double time);
+  Cell makeFloat(unsigned slot, double value) const;
+  bool isFree(ArrayRef<unsigned> slots) const {
+    return llvm::none_of(slots, [&](unsigned slot) { return valid[slot]; });
+  }
+  /// Collect the statistics at the end of a cycle.
+  void endCycle();
+
+  const CompiledFunction &fn;
+  FuncOp func;
+  bool cycleAccurate;
+
+  // The memories, and the buffer of each memory micro-op.
+  std::vector<std::vector<Cell>> buffers;
+  SmallVector<unsigned> memoryBuffers;
+
+  // The slots, and whether they currently hold a token.
+  std::vector<Cell> slots;
+  std::vector<double> times;
+  std::vector<bool> valid;
+
+  /// The number of operands holding a token, for every micro-op.
+  std::vector<unsigned> numTokens;
+  /// The micro-ops which may be ready to fire, in a ring buffer. Every
+  /// micro-op is queued at most once, and only when the tokens on its operands
+  /// or results change and it may fire.
+  std::vector<unsigned> readyQueue;
+  std::vector<bool> queued;
+  unsigned readyHead = 0, readySize = 0;
+  SmallVector<bool, 8> tokensBefore;
+
+  std::vector<Any> *results = nullptr;
+  std::vector<double> *resultTimes = nullptr;
+  bool returned = false;
+
+  // The state of a cycle-accurate execution.
+  uint64_t cycle = 0;
+  /// Whether any token moved in the current cycle.
+  bool activity = false;
+  std::vector<uint64_t> lastFired;
+  std::vector<uint64_t> lastDelivered;
+  /// The micro-ops which fired in the current cycle and are ready to fire
+  /// again in the next one.
+  std::vector<unsigned> deferred;
+  std::vector<bool> isDeferred;
+  std::vector<std::deque<PendingResults>> pipelines;
+  SmallVector<unsigned> pipelinedOps;
+  std::vector<ChannelStats> channelStats;
+  std::vector<PipelineStats> pipelineStats;
+};
+
+CompiledFunction::Execution::Execution(const CompiledFunction &fn,
+                                       DenseMap<Value, Any> &valueMap,
+                                       DenseMap<Value, double> &timeMap,
+                                       std::vector<std::vector<Any>> &store,
+                                       std::vector<double> &storeTimes)
+    : fn(fn), func(fn.func), cycleAccurate(fn.cycleAccurate) {
+  // Pre-allocate the memories the same way the interpreter does, and copy the
+  // store into typed cells.
+  DenseMap<unsigned, unsigned> memoryMap;
+  for (auto memory : fn.memories)
+    if (!memory.allocateMemory(memoryMap, store, storeTimes))
+      llvm_unreachable("Memory op does not have unique ID!\n");
+  for (auto memory : fn.memories)
+    memoryBuffers.push_back(memoryMap[memory.id()]);
+
+  auto toCell = [](const Any &value) {
+    Cell cell;
+    if (any_isa<APInt>(value))
+      cell.intValue = any_cast<APInt>(value);
+    else if (any_isa<APFloat>(value))
+      cell.floatValue = any_cast<APFloat>(value).convertToDouble();
+    else
+      cell.intValue = APInt(INDEX_WIDTH, any_cast<unsigned>(value));
+    return cell;
+  };
+  buffers.resize(store.size());
+  for (auto it : llvm::enumerate(store)) {
+    buffers[it.index()].reserve(it.value().size());
+    for (auto &value : it.value())
+      buffers[it.index()].push_back(toCell(value));
+  }
+
+  slots.resize(fn.numSlots);
+  times.resize(fn.numSlots, 0.0);
+  valid.resize(fn.numSlots, false);
+  Block &entryBlock = func.getBody().front();
+  for (unsigned i = 0; i < fn.numArguments; ++i) {
+    auto arg = entryBlock.getArgument(i);
+    auto it = valueMap.find(arg);
+    if (it == valueMap.end())
+      continue;
+    slots[i] = toCell(it->second);
+    times[i] = timeMap.lookup(arg);
+    valid[i] = true;
+  }
+
+  unsigned numOps = fn.microOps.size();
+  if (cycleAccurate) {
+    lastFired.resize(numOps, ~0ULL);
+    lastDelivered.resize(numOps, ~0ULL);
+    isDeferred.resize(numOps, false);
+    pipelines.resize(numOps);
+    pipelineStats.resize(numOps);
+    channelStats.resize(fn.numSlots);
+    for (unsigned i = 0; i < numOps; ++i)
+      if (fn.microOps[i].capacity)
+        pipelinedOps.push_back(i);
+  }
+
+  // Buffers with initial values hold them from the start.
+  for (auto &init : fn.bufferInits) {
+    if (cycleAccurate) {
+      for (auto &value : init.second) {
+        PendingResults pending;
+        pending.readyCycle = 0;
+        pending.values.push_back(Cell{value, 0});
+        pipelines[init.first].push_back(std::move(pending));
+      }
+      continue;
+    }
+    unsigned slot = fn.slotLists[fn.microOps[init.first].results];
+    slots[slot].intValue = init.second.front();
+    valid[slot] = true;
+  }
+
+  numTokens.resize(numOps, 0);
+  for (unsigned slot = 0; slot < fn.numSlots; ++slot)
+    if (valid[slot])
+      for (unsigned i = fn.userOffsets[slot], e = fn.userOffsets[slot + 1];
+           i != e; ++i)
+        ++numTokens[fn.users[i]];
+  readyQueue.resize(numOps);
+  queued.resize(numOps, false);
+}
+
+bool CompiledFunction::Execution::mayFire(unsigned opIndex) const {
+  if (cycleAccurate && !pipelines[opIndex].empty())
+    return true;
+  const MicroOp &microOp = fn.microOps[opIndex];
+  return microOp.needsAllOperands ? numTokens[opIndex] == microOp.numOperands
+                                  : numTokens[opIndex] != 0;
+}
+
+void CompiledFunction::Execution::enqueue(unsigned opIndex) {
+  if (opIndex == noProducer || queued[opIndex] || !mayFire(opIndex))
+    return;
+  queued[opIndex] = true;
+  readyQueue[(readyHead + readySize++) % readyQueue.size()] = opIndex;
+}
+
+void CompiledFunction::Execution::scheduleUses(unsigned slot) {
+  for (unsigned i = fn.userOffsets[slot], e = fn.userOffsets[slot + 1]; i != e;
+       ++i)
+    enqueue(fn.users[i]);
+}
+
+void CompiledFunction::Execution::propagate(unsigned slot) {
+  for (unsigned i = fn.userOffsets[slot], e = fn.userOffsets[slot + 1]; i != e;
+       ++i) {
+    auto &count = numTokens[fn.users[i]];
+    count = valid[slot] ? count + 1 : count - 1;
+  }
+
+  if (cycleAccurate) {
+    auto &stats = channelStats[slot];
+    if (valid[slot]) {
+      stats.arrival = cycle;
+    } else {
+      if (stats.transfers++ == 0)
+        stats.firstTransfer = cycle;
+      stats.lastTransfer = cycle;
+    }
+  }
+
+  if (valid[slot])
+    scheduleUses(slot);
+  else
+    // The producer may have been waiting for its result to be consumed.
+    enqueue(fn.producers[slot]);
+}
+
+CompiledFunction::Cell
+CompiledFunction::Execution::makeFloat(unsigned slot, double value) const {
+  Cell cell;
+  cell.floatValue = fn.isF32[slot] ? (double)(float)value : value;
+  return cell;
+}
+
+void CompiledFunction::Execution::produce(unsigned slot, const Cell &value,
+                                          double time) {
+  slots[slot] = value;
+  times[slot] = cycleAccurate ? cycle : time;
+  valid[slot] = true;
+}
+
+bool CompiledFunction::Execution::canAccept(unsigned opIndex) const {
+  const MicroOp &microOp = fn.microOps[opIndex];
+  if (cycleAccurate && microOp.capacity)
+    return pipelines[opIndex].size() < microOp.capacity;
+  return isFree(getResults(microOp));
+}
+
+void CompiledFunction::Execution::emit(unsigned opIndex,
+                                       SmallVector<Cell, 2> values,
+                                       double time) {
+  const MicroOp &microOp = fn.microOps[opIndex];
+  if (cycleAccurate && microOp.capacity) {
+    PendingResults pending;
+    pending.readyCycle = cycle + microOp.cycleLatency;
+    pending.values = std::move(values);
+    pipelines[opIndex].push_back(std::move(pending));
+    activity = true;
+    return;
+  }
+  for (auto it : llvm::zip(getResults(microOp), values))
+    produce(std::get<0>(it), std::get<1>(it), time);
+}
+
+void CompiledFunction::Execution::deliver(unsigned opIndex) {
+  auto &pipeline = pipelines[opIndex];
+  if (pipeline.empty() || pipeline.front().readyCycle > cycle ||
+      lastDelivered[opIndex] == cycle)
+    return;
+  auto outs = getResults(fn.microOps[opIndex]);
+  if (!isFree(outs))
+    return;
+  for (auto it : llvm::zip(outs, pipeline.front().values))
+    produce(std::get<0>(it), std::get<1>(it), cycle);
+  pipeline.pop_front();
+  lastDelivered[opIndex] = cycle;
+}
+
+FailureOr<bool> CompiledFunction::Execution::fireMemory(
+    const MicroOp &microOp, ArrayRef<unsigned> ins, ArrayRef<unsigned> outs,
+    std::vector<Cell> &buffer, unsigned index) {
+  unsigned numLoads = (microOp.numResults - microOp.numStores) / 2;
+  bool notReady = false;
+  for (unsigned i = 0; i < microOp.numStores; ++i) {
+    unsigned data = ins[index++];
+    unsigned address = ins[index++];
+    unsigned nonce = outs[numLoads + i];
+    if (!valid[data] || !valid[address] ||
+        (cycleAccurate && valid[nonce])) {
+      notReady = true;
+      continue;
+    }
+    uint64_t offset = slots[address].intValue.getZExtValue();
+    if (offset >= buffer.size()) {
+      microOp.op->emitOpError()
+          << "out-of-bounds store to element " << offset << " of a memory with "
+          << buffer.size() << " elements";
+      return failure();
+    }
+    buffer[offset] = slots[data];
+    Cell none;
+    none.intValue = APInt(1, 0);
+    produce(nonce, none, std::max(times[address], times[data]));
+    valid[data] = valid[address] = false;
+  }
+  for (unsigned i = 0; i < numLoads; ++i) {
+    unsigned address = ins[index++];
+    unsigned data = outs[i], nonce = outs[numLoads + microOp.numStores + i];
+    if (!valid[address] || (cycleAccurate && (valid[data] || valid[nonce]))) {
+      notReady = true;
+      continue;
+    }
+    uint64_t offset = slots[address].intValue.getZExtValue();
+    if (offset >= buffer.size()) {
+      microOp.op->emitOpError()
+          << "out-of-bounds load of element " << offset << " of a memory with "
+          << buffer.size() << " elements";
+      return failure();
+    }
+    Cell none;
+    none.intValue = APInt(1, 0);
+    produce(data, buffer[offset], times[address]);
+    produce(nonce, none, times[address]);
+    valid[address] = false;
+  }
+  return !notReady;
+}
+
+FailureOr<bool> CompiledFunction::Execution::fire(unsigned opIndex) {
+  const MicroOp &microOp = fn.microOps[opIndex];
+  auto ins = getOperands(microOp);
+  auto outs = getResults(microOp);
+  auto allInsValid = [&]() {
+    return llvm::all_of(ins, [&](unsigned in) { return valid[in]; });
+  };
+  // Consume all inputs and return the time of the latest one.
+  auto consumeAll = [&]() {
+    double time = 0;
+    for (auto in : ins) {
+      time = std::max(time, times[in]);
+      valid[in] = false;
+    }
+    return time;
+  };
+
+  switch (microOp.opcode) {
+  // Operations with a single firing rule, which wait for all their inputs and
+  // for their outputs to be free.
+  case Opcode::Fork:
+  case Opcode::Forward:
+  case Opcode::Constant:
+  case Opcode::Store: {
+    if (!allInsValid() || !canAccept(opIndex))
+      return false;
+    SmallVector<Cell, 2> values;
+    if (microOp.opcode == Opcode::Constant) {
+      Cell constant;
+      constant.intValue = fn.constants[microOp.immediate];
+      values.push_back(constant);
+    } else if (microOp.opcode == Opcode::Store) {
+      values.push_back(slots[ins[1]]);
+      values.push_back(slots[ins[0]]);
+    } else {
+      values.assign(outs.size(), slots[ins[0]]);
+    }
+    emit(opIndex, std::move(values), consumeAll() + microOp.latency);
+    return true;
+  }
+
+  case Opcode::Merge:
+  case Opcode::ControlMerge: {
+    // In cycle-accurate mode, merges wait for their outputs to be free, and
+    // forward a single token per cycle.
+    if (cycleAccurate && !isFree(outs))
+      return false;
+    bool found = false;
+    for (auto it : llvm::enumerate(ins)) {
+      unsigned in = it.value();
+      if (!valid[in])
+        continue;
+      if (found)
+        microOp.op->emitOpError("More than one valid input to ")
+            << (microOp.opcode == Opcode::Merge ? "Merge!" : "CMerge!");
+      produce(outs[0], slots[in], times[in]);
+      if (microOp.opcode == Opcode::ControlMerge) {
+        Cell index;
+        index.intValue = APInt(INDEX_WIDTH, it.index());
+        produce(outs[1], index, times[in]);
+      }
+      valid[in] = false;
+      found = true;
+      if (cycleAccurate)
+        break;
+    }
+    if (!found)
+      microOp.op->emitOpError("No valid input to ")
+          << (microOp.opcode == Opcode::Merge ? "Merge!" : "CMerge!");
+    return true;
+  }
+
+  case Opcode::Mux: {
+    unsigned control = ins[0];
+    if (!valid[control] || (cycleAccurate && !isFree(outs)))
+      return false;
+    uint64_t index = slots[control].intValue.getZExtValue();
+    if (index >= ins.size() - 1)
+      return microOp.op->emitOpError()
+             << "selects non-existing data operand " << index;
+    unsigned in = ins[index + 1];
+    if (!valid[in])
+      return false;
+    produce(outs[0], slots[in], std::max(times[control], times[in]));
+    valid[control] = valid[in] = false;
+    return true;
+  }
+
+  case Opcode::ConditionalBranch: {
+    if (!allInsValid())
+      return false;
+    unsigned out = slots[ins[0]].intValue != 0 ? outs[0] : outs[1];
+    if (cycleAccurate && valid[out])
+      return false;
+    produce(out, slots[ins[1]], consumeAll());
+    return true;
+  }
+
+  case Opcode::Sink:
+    valid[ins[0]] = false;
+    return true;
+
+  case Opcode::Load: {
+    unsigned address = ins[0], data = ins[1], nonce = ins[2];
+    if (valid[address] && valid[nonce]) {
+      if (cycleAccurate && valid[outs[1]])
+        return false;
+      produce(outs[1], slots[address], std::max(times[address], times[nonce]));
+      valid[address] = valid[nonce] = false;
+      return true;
+    }
+    if (!valid[address] && !valid[nonce] && valid[data]) {
+      if (cycleAccurate && valid[outs[0]])
+        return false;
+      produce(outs[0], slots[data], times[data]);
+      valid[data] = false;
+      return true;
+    }
+    return false;
+  }
+
+  case Opcode::Memory:
+  case Opcode::ExternalMemory: {
+    bool external = microOp.opcode == Opcode::ExternalMemory;
+    unsigned buffer = external ? slots[ins[0]].intValue.getZExtValue()
+                               : memoryBuffers[microOp.immediate];
+    return fireMemory(microOp, ins, outs, buffers[buffer], external ? 1 : 0);
+  }
+
+  case Opcode::Return: {
+    if (!allInsValid())
+      return false;
+    for (unsigned i = 0, e = results->size(); i < e; ++i) {
+      unsigned in = ins[i];
+      if (func.getFunctionType().getResult(i).isa<FloatType>())
+        (*results)[i] = APFloat(slots[in].floatValue);
+      else
+        (*results)[i] = slots[in].intValue;
+      (*resultTimes)[i] = times[in];
+    }
+    returned = true;
+    return true;
+  }
+
+  // Arithmetic operations, which only wait for their inputs outside of
+  // cycle-accurate mode.
+  default: {
+    if (!allInsValid() || (cycleAccurate && !canAccept(opIndex)))
+      return false;
+    const Cell &lhs = slots[ins[0]];
+    const Cell &rhs = slots[ins.back()];
+    unsigned out = outs[0];
+    Cell result;
+    switch (microOp.opcode) {
+    case Opcode::AddI:
+      result.intValue = lhs.intValue + rhs.intValue;
+      break;
+    case Opcode::SubI:
+      result.intValue = lhs.intValue - rhs.intValue;
+      break;
+    case Opcode::MulI:
+      result.intValue = lhs.intValue * rhs.intValue;
+      break;
+    case Opcode::DivSI:
+    case Opcode::DivUI:
+      if (rhs.intValue.isZero())
+        return microOp.op->emitOpError() << "Division By Zero!";
+      result.intValue = microOp.opcode == Opcode::DivSI
+                            ? lhs.intValue.sdiv(rhs.intValue)
+                            : lhs.intValue.udiv(rhs.intValue);
+      break;
+    case Opcode::XOrI:
+      result.intValue = lhs.intValue ^ rhs.intValue;
+      break;
+    case Opcode::CmpI:
+      result.intValue = APInt(
+          1, arith::applyCmpPredicate(
+                 static_cast<arith::CmpIPredicate>(microOp.immediate),
+                 lhs.intValue, rhs.intValue));
+      break;
+    case Opcode::AddF:
+      result = makeFloat(out, lhs.floatValue + rhs.floatValue);
+      break;
+    case Opcode::SubF:
+      result = makeFloat(out, lhs.floatValue - rhs.floatValue);
+      break;
+    case Opcode::MulF:
+      result = makeFloat(out, lhs.floatValue * rhs.floatValue);
+      break;
+    case Opcode::DivF:
+      result = makeFloat(out, lhs.floatValue / rhs.floatValue);
+      break;
+    case Opcode::CmpF:
+      result.intValue = APInt(
+          1, arith::applyCmpPredicate(
+                 static_cast<arith::CmpFPredicate>(microOp.immediate),
+                 APFloat(lhs.floatValue), APFloat(rhs.floatValue)));
+      break;
+    case Opcode::IndexCast:
+      result.intValue = APInt(microOp.immediate, lhs.intValue.getZExtValue());
+      break;
+    case Opcode::ExtSI:
+      result.intValue = lhs.intValue.sext(microOp.immediate);
+      break;
+    case Opcode::ExtUI:
+      result.intValue = lhs.intValue.zext(microOp.immediate);
+      break;
+    default:
+      llvm_unreachable("unhandled micro-op");
+    }
+    SmallVector<Cell, 2> values;
+    values.push_back(std::move(result));
+    emit(opIndex, std::move(values), consumeAll() + 1);
+    return true;
+  }
+  }
+  llvm_unreachable("unhandled micro-op");
+}
+
+LogicalResult CompiledFunction::Execution::visit(unsigned opIndex) {
+  const MicroOp &microOp = fn.microOps[opIndex];
+  auto ins = getOperands(microOp);
+  auto outs = getResults(microOp);
+  tokensBefore.clear();
+  for (auto slot : llvm::concat<const unsigned>(ins, outs))
+    tokensBefore.push_back(valid[slot]);
+
+  bool fired = false;
+  if (cycleAccurate && lastFired[opIndex] == cycle) {
+    // Every micro-op fires at most once per cycle.
+    deliver(opIndex);
+    if (mayFire(opIndex) && !isDeferred[opIndex]) {
+      isDeferred[opIndex] = true;
+      deferred.push_back(opIndex);
+    }
+  } else if (cycleAccurate) {
+    deliver(opIndex);
+    size_t pending = pipelines[opIndex].size();
+    auto result = fire(opIndex);
+    if (failed(result))
+      return failure();
+    fired = *result;
+    // Transparent buffers deliver their results in the same cycle.
+    deliver(opIndex);
+    if (fired || pipelines[opIndex].size() != pending)
+      lastFired[opIndex] = cycle;
+  } else {
+    auto result = fire(opIndex);
+    if (failed(result))
+      return failure();
+    fired = *result;
+  }
+  if (fired)
+    ++microOpsFired;
+
+  // Memories may fire some of their ports without firing all of them, so look
+  // for changed tokens even if the micro-op did not fire.
+  unsigned i = 0;
+  for (auto slot : llvm::concat<const unsigned>(ins, outs)) {
+    if (tokensBefore[i++] == valid[slot])
+      continue;
+    if (cycleAccurate)
+      lastFired[opIndex] = cycle;
+    activity = true;
+    propagate(slot);
+  }
+  return success();
+}
+
+void CompiledFunction::Execution::endCycle() {
+  for (unsigned slot = 0; slot < fn.numSlots; ++slot) {
+    if (!valid[slot])
+      continue;
+    auto &stats = channelStats[slot];
+    ++stats.occupiedCycles;
+    if (stats.arrival < cycle)
+      ++stats.stalledCycles;
+  }
+  for (auto opIndex : pipelinedOps) {
+    auto &pipeline = pipelines[opIndex];
+    auto &stats = pipelineStats[opIndex];
+    stats.heldResults += pipeline.size();
+    stats.maxHeldResults = std::max(stats.maxHeldResults, pipeline.size());
+    if (!pipeline.empty() && pipeline.front().readyCycle <= cycle &&
+        lastDelivered[opIndex] != cycle)
+      ++stats.stalledCycles;
+  }
+}
+
+LogicalResult
+CompiledFunction::Execution::run(std::vector<Any> &results,
+                                 std::vector<double> &resultTimes) {
+  this->results = &results;
+  this->resultTimes = &resultTimes;
+  if (!cycleAccurate)
+    for (auto &init : fn.bufferInits)
+      scheduleUses(fn.slotLists[fn.microOps[init.first].results]);
+  for (unsigned i = 0; i < fn.numArguments; ++i)
+    scheduleUses(i);
+
+  while (true) {
+    if (cycleAccurate) {
+      // Retry the micro-ops which could not fire again in the last cycle, and
+      // the ones holding results which may have become ready.
+      auto retry = std::move(deferred);
+      deferred.clear();
+      for (auto opIndex : retry) {
+        isDeferred[opIndex] = false;
+        enqueue(opIndex);
+      }
+      for (auto opIndex : pipelinedOps)
+        enqueue(opIndex);
+      activity = false;
+    }
+
+    while (readySize != 0 && !returned) {
+      unsigned opIndex = readyQueue[readyHead];
+      readyHead = (readyHead + 1) % readyQueue.size();
+      --readySize;
+      queued[opIndex] = false;
+      if (failed(visit(opIndex)))
+        return failure();
+    }
+
+    if (cycleAccurate)
+      endCycle();
+    if (returned)
+      return success();
+
+    // Micro-ops are only queued when a token arrives or leaves, so an empty
+    // queue means that no micro-op will ever be able to fire again. In
+    // cycle-accurate mode, this is the case once a cycle passes without any
+    // token moving, unless some results are still held for their latency.
+    if (!cycleAccurate)
+      return func.emitOpError() << "deadlocked before reaching its return";
+    bool waiting = llvm::any_of(pipelinedOps, [&](unsigned opIndex) {
+      return llvm::any_of(pipelines[opIndex], [&](auto &pending) {
+        return pending.readyCycle > cycle;
+      });
+    });
+    if (!activity && deferred.empty() && !waiting)
+      return func.emitOpError()
+             << "deadlocked before reaching its return, in cycle " << cycle;
+    ++cycle;
+  }
+}
+
+void CompiledFunction::Execution::writeBack(
+    std::vector<std::vector<Any>> &store) const {
+  for (auto it : llvm::enumerate(buffers))
+    for (auto cell : llvm::enumerate(it.value())) {
+      auto &value = store[it.index()][cell.index()];
+      if (any_isa<APFloat>(value))
+        value = APFloat(cell.value().floatValue);
+      else
+        value = cell.value().intValue;
+    }
+}
+
+void CompiledFunction::Execution::printReport(raw_ostream &os) const {
+  uint64_t numCycles = cycle + 1;
+  AsmState state(func);
+  auto printName = [&](unsigned slot) {
+    Value value = fn.values[slot];
+    value.printAsOperand(os, state);
+  };
+  auto getII = [&](const ChannelStats &stats) {
+    return double(stats.lastTransfer - stats.firstTransfer) /
+           double(stats.transfers - 1);
+  };
+
+  os << "Cycle-accurate simulation of @" << func.getName() << ": "
+     << numCycles << " cycles\n";
+
+  // Report the channels which carried tokens. The channel which carried the
+  // most tokens is the innermost loop, whose initiation interval is the one
+  // achieved by the function.
+  os << "\nChannels:\n";
+  Optional<unsigned> critical;
+  for (unsigned slot = 0; slot < fn.numSlots; ++slot) {
+    auto &stats = channelStats[slot];
+    if (stats.transfers == 0 && stats.occupiedCycles == 0)
+      continue;
+    os << "  ";
+    printName(slot);
+    os << ": " << stats.transfers << " transfers, occupancy "
+       << format("%.2f", double(stats.occupiedCycles) / numCycles) << ", "
+       << stats.stalledCycles << " stalls";
+    if (stats.transfers < 2) {
+      os << "\n";
+      continue;
+    }
+    os << ", II " << format("%.2f", getII(stats)) << "\n";
+    if (!critical || stats.transfers > channelStats[*critical].transfers ||
+        (stats.transfers == channelStats[*critical].transfers &&
+         getII(stats) > getII(channelStats[*critical])))
+      critical = slot;
+  }
+
+  if (!pipelinedOps.empty()) {
+    os << "\nBuffers and pipelined operations:\n";
+    for (auto opIndex : pipelinedOps) {
+      auto &microOp = fn.microOps[opIndex];
+      auto &stats = pipelineStats[opIndex];
+      os << "  ";
+      printName(fn.slotLists[microOp.results]);
+      os << " (" << microOp.op->getName() << ", capacity " << microOp.capacity
+         << ", latency " << microOp.cycleLatency << "): average fill "
+         << format("%.2f", double(stats.heldResults) / numCycles)
+         << ", max fill " << stats.maxHeldResults << ", "
+         << stats.stalledCycles << " stalls\n";
+    }
+  }
+
+  if (critical) {
+    os << "\nAchieved II: " << format("%.2f", getII(channelStats[*critical]))
+       << " (";
+    printName(*critical);
+    os << ")\n";
+  }
+}
+
+LogicalResult CompiledFunction::run(DenseMap<Value, Any> &valueMap,
+                                    DenseMap<Value, double> &timeMap,
+                                    std::vector<Any> &results,
+                                    std::vector<double> &resultTimes,
+                                    std::vector<std::vector<Any>> &store,
+                                    std::vector<double> &storeTimes,
+                                    raw_ostream &report) {
+  Execution execution(*this, valueMap, timeMap, store, storeTimes);
+  if (failed(execution.run(results, resultTimes)))
+    return failure();
+  execution.writeBack(store);
+  if (cycleAccurate)
+    execution.printReport(report);
+  return success();
+}
+
+} // namespace handshake
+} // namespace circt
@@ -0,0 +1,171 @@
+//===- CompiledSimulation.h - Compiled handshake simulation -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the compiled execution modes of the handshake runner,
+// which lower a handshake function to a flat array of micro-ops operating on
+// slot-indexed, typed storage instead of interpreting its operations.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_HANDSHAKE_RUNNER_COMPILEDSIMULATION_H
+#define CIRCT_HANDSHAKE_RUNNER_COMPILEDSIMULATION_H
+
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+#include "circt/Dialect/Handshake/Simulation.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/Any.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace circt {
+namespace handshake {
+
+/// A handshake function lowered to micro-ops. Every SSA value of the function
+/// is assigned a slot, holding its token if there is one, and every operation
+/// is lowered to a micro-op referring to the slots of its operands and results
+/// by index.
+///
+/// By default, the micro-ops implement the same firing rules as the
+/// `ExecutableOpInterface` of the handshake operations, such that the compiled
+/// function produces the same results and times as the interpreter. In
+/// cycle-accurate mode, every micro-op fires at most once per cycle, respects
+/// the backpressure of its consumers, and holds its results for its latency;
+/// buffers hold as many tokens as they have slots.
+class CompiledFunction {
+public:
+  ~CompiledFunction();
+
+  /// Compile the given function. Return null if the function contains an
+  /// operation or a type the micro-ops do not support, in which case it has to
+  /// be interpreted.
+  static std::unique_ptr<CompiledFunction>
+  compile(handshake::FuncOp func, const SimulationOptions &options);
+
+  /// Execute the function. The arguments are read from the value and time
+  /// maps, the memories from the store, and the results are returned the same
+  /// way the interpreter does. The memories are written back to the store. In
+  /// cycle-accurate mode, the result times are cycles, and the throughput
+  /// report is printed to the given stream.
+  mlir::LogicalResult run(llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
+                          llvm::DenseMap<mlir::Value, double> &timeMap,
+                          std::vector<llvm::Any> &results,
+                          std::vector<double> &resultTimes,
+                          std::vector<std::vector<llvm::Any>> &store,
+                          std::vector<double> &storeTimes,
+                          llvm::raw_ostream &report);
+
+private:
+  enum class Opcode : uint8_t {
+    // Handshake operations.
+    Fork,
+    Forward,
+    Constant,
+    Store,
+    Merge,
+    Mux,
+    ControlMerge,
+    ConditionalBranch,
+    Sink,
+    Load,
+    Memory,
+    ExternalMemory,
+    Return,
+    // Arithmetic operations.
+    AddI,
+    SubI,
+    MulI,
+    DivSI,
+    DivUI,
+    XOrI,
+    CmpI,
+    AddF,
+    SubF,
+    MulF,
+    DivF,
+    CmpF,
+    IndexCast,
+    ExtSI,
+    ExtUI,
+  };
+
+  struct MicroOp {
+    Opcode opcode;
+    /// The first operand and result slots in `slotLists`.
+    unsigned operands = 0;
+    unsigned results = 0;
+    unsigned numOperands = 0;
+    unsigned numResults = 0;
+    /// An opcode-specific immediate: the constant index of constants, the
+    /// predicate of comparisons, the result width of casts, and the memory
+    /// index of memories.
+    unsigned immediate = 0;
+    /// The number of store ports of memories.
+    unsigned numStores = 0;
+    /// The latency of the forwarding operations.
+    double latency = 0;
+    /// Whether the micro-op waits for all its operands to fire, rather than
+    /// for some of them.
+    bool needsAllOperands = true;
+    /// In cycle-accurate mode, the number of cycles the results are held in
+    /// the micro-op, and the number of results it can hold. Micro-ops with no
+    /// capacity are combinational.
+    unsigned cycleLatency = 0;
+    unsigned capacity = 0;
+    mlir::Operation *op;
+  };
+
+  /// The value stored in a slot or in a memory cell. Integers, indices and
+  /// none tokens are held as APInts, memrefs as the APInt index of their
+  /// buffer in the store, and floats as doubles.
+  struct Cell {
+    llvm::APInt intValue;
+    double floatValue = 0;
+  };
+
+  /// The state of one execution of the function.
+  class Execution;
+
+  CompiledFunction(handshake::FuncOp func, bool cycleAccurate)
+      : func(func), cycleAccurate(cycleAccurate) {}
+
+  handshake::FuncOp func;
+  bool cycleAccurate;
+  std::vector<MicroOp> microOps;
+  /// The operand and result slots of all micro-ops.
+  std::vector<unsigned> slotLists;
+  /// The micro-ops using each slot, in use list order, with
+  /// `userOffsets[slot]` the first user of a slot.
+  std::vector<unsigned> users;
+  std::vector<unsigned> userOffsets;
+  /// The micro-op producing each slot, or `noProducer` for the arguments.
+  std::vector<unsigned> producers;
+  static constexpr unsigned noProducer = ~0u;
+  /// Whether each slot holds a single precision float, whose results are
+  /// rounded accordingly.
+  std::vector<bool> isF32;
+  /// The value held in each slot, for the throughput report.
+  std::vector<mlir::Value> values;
+  unsigned numArguments = 0;
+  unsigned numSlots = 0;
+  std::vector<llvm::APInt> constants;
+  /// The memory operations, indexed by the immediate of their micro-op.
+  std::vector<handshake::MemoryOp> memories;
+  /// The buffers with initial values, by micro-op. Outside of cycle-accurate
+  /// mode, buffers have a single initial value, placed in their result slot.
+  std::vector<std::pair<unsigned, llvm::SmallVector<llvm::APInt, 1>>>
+      bufferInits;
+};
+
+} // namespace handshake
+} // namespace circt
+
+#endif // CIRCT_HANDSHAKE_RUNNER_COMPILEDSIMULATION_H
@@ -11,8 +11,9 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include <list>
+#include <deque>
 
+#include "CompiledSimulation.h"
 #include "circt/Dialect/Handshake/HandshakeOps.h"
 #include "circt/Dialect/Handshake/Simulation.h"
 #include "mlir/Dialect/Arithmetic/IR/Arithmetic.h"
@@ -158,21 +159,129 @@ void printAnyValueWithType(llvm::raw_ostream &out, mlir::Type type,
   }
 }
 
-void scheduleIfNeeded(std::list<mlir::Operation *> &readyList,
-                      llvm::DenseMap<mlir::Value, Any> & /*valueMap*/,
-                      mlir::Operation *op) {
-  if (std::find(readyList.begin(), readyList.end(), op) == readyList.end()) {
-    readyList.push_back(op);
+namespace {
+/// A worklist of the operations of a handshake function which may be ready to
+/// execute. Every operation counts how many of its operands hold a token, and
+/// is only revisited when a token arrives on one of its operands, or when one
+/// of its results is consumed, provided it has the operands it needs to fire.
+class ReadyQueue {
+public:
+  /// Create a queue for the operations of the given block, counting the tokens
+  /// already held in the value map.
+  ReadyQueue(mlir::Block &block, llvm::DenseMap<mlir::Value, Any> &valueMap);
+
+  bool empty() const { return queue.empty(); }
+
+  /// Pop the next operation to execute.
+  mlir::Operation *pop();
+
+  /// Queue the users of a value which holds a token.
+  void scheduleUses(mlir::Value value);
+
+  /// Return whether each operand and result of an operation holds a token.
+  SmallVector<bool, 8> getTokens(mlir::Operation *op) const;
+
+  /// Update the operand counters with the tokens an operation produced and
+  /// consumed when it executed, given the tokens it held before, and queue the
+  /// operations which may fire as a result.
+  void propagate(mlir::Operation *op, ArrayRef<bool> tokensBefore);
+
+  void print(llvm::raw_ostream &os) const {
+    for (auto *op : queue)
+      os << "READY: " << *op << "\n";
   }
-}
-void scheduleUses(std::list<mlir::Operation *> &readyList,
-                  llvm::DenseMap<mlir::Value, Any> &valueMap,
-                  mlir::Value value) {
-  for (auto &use : value.getUses()) {
-    scheduleIfNeeded(readyList, valueMap, use.getOwner());
+
+private:
+  struct OpState {
+    /// The number of operands holding a token.
+    unsigned numTokens = 0;
+    /// Whether the operation waits for all its operands to fire.
+    bool needsAllOperands = true;
+    bool queued = false;
+  };
+
+  void schedule(mlir::Operation *op);
+
+  llvm::DenseMap<mlir::Value, Any> &valueMap;
+  llvm::DenseMap<mlir::Operation *, OpState> states;
+  std::deque<mlir::Operation *> queue;
+};
+} // namespace
+
+ReadyQueue::ReadyQueue(mlir::Block &block,
+                       llvm::DenseMap<mlir::Value, Any> &valueMap)
+    : valueMap(valueMap) {
+  for (auto &op : block) {
+    auto &state = states[&op];
+    for (auto operand : op.getOperands())
+      state.numTokens += valueMap.count(operand);
+    // These operations fire as soon as some of their operands hold a token.
+    state.needsAllOperands =
+        !isa<handshake::MergeOp, handshake::ControlMergeOp, handshake::MuxOp,
+             handshake::SinkOp, handshake::LoadOp, handshake::MemoryOp,
+             handshake::ExternalMemoryOp>(op);
   }
 }
 
+mlir::Operation *ReadyQueue::pop() {
+  auto *op = queue.front();
+  queue.pop_front();
+  states[op].queued = false;
+  return op;
+}
+
+void ReadyQueue::schedule(mlir::Operation *op) {
+  auto it = states.find(op);
+  if (it == states.end())
+    return;
+  auto &state = it->second;
+  if (state.queued)
+    return;
+  if (state.needsAllOperands ? state.numTokens != op->getNumOperands()
+                             : state.numTokens == 0)
+    return;
+  state.queued = true;
+  queue.push_back(op);
+}
+
+void ReadyQueue::scheduleUses(mlir::Value value) {
+  for (auto *user : value.getUsers())
+    schedule(user);
+}
+
+SmallVector<bool, 8> ReadyQueue::getTokens(mlir::Operation *op) const {
+  SmallVector<bool, 8> tokens;
+  for (auto operand : op->getOperands())
+    tokens.push_back(valueMap.count(operand));
+  for (auto result : op->getResults())
+    tokens.push_back(valueMap.count(result));
+  return tokens;
+}
+
+void ReadyQueue::propagate(mlir::Operation *op, ArrayRef<bool> tokensBefore) {
+  unsigned i = 0;
+  auto update = [&](mlir::Value value) {
+    bool hadToken = tokensBefore[i++];
+    bool hasToken = valueMap.count(value);
+    if (hadToken == hasToken)
+      return;
+    for (auto *user : value.getUsers()) {
+      auto &numTokens = states[user].numTokens;
+      numTokens = hasToken ? numTokens + 1 : numTokens - 1;
+    }
+    if (hasToken) {
+      scheduleUses(value);
+    } else if (auto *producer = value.getDefiningOp()) {
+      // The producer may have been waiting for its result to be consumed.
+      schedule(producer);
+    }
+  };
+  for (auto operand : op->getOperands())
+    update(operand);
+  for (auto result : op->getResults())
+    update(result);
+}
+
 // Allocate a new matrix with dimensions given by the type, in the
 // given store.  Return the pseudo-pointer to the new matrix in the
 // store (i.e. the first dimension index).
@@ -373,7 +482,7 @@ LogicalResult HandshakeExecuter::execute(mlir::arith::SubIOp,
 LogicalResult HandshakeExecuter::execute(mlir::arith::SubFOp,
                                          std::vector<Any> &in,
                                          std::vector<Any> &out) {
-  out[0] = any_cast<APFloat>(in[0]) + any_cast<APFloat>(in[1]);
+  out[0] = any_cast<APFloat>(in[0]) - any_cast<APFloat>(in[1]);
   return success();
 }
 
@@ -776,8 +885,6 @@ HandshakeExecuter::HandshakeExecuter(
   mlir::Block &entryBlock = func.getBody().front();
   // The arguments of the entry block.
   mlir::Block::BlockArgListType blockArgs = entryBlock.getArguments();
-  // A list of operations which might be ready to execute.
-  std::list<mlir::Operation *> readyList;
   // A map of memory ops
   llvm::DenseMap<unsigned, unsigned> memoryMap;
 
@@ -789,6 +896,7 @@ HandshakeExecuter::HandshakeExecuter(
   });
 
   // Initialize the value map for buffers with initial values.
+  SmallVector<Value> initializedBuffers;
   for (auto bufferOp : func.getOps<handshake::BufferOp>()) {
     if (bufferOp.initValues().hasValue()) {
       auto initValues = bufferOp.getInitValues();
@@ -798,35 +906,41 @@ HandshakeExecuter::HandshakeExecuter(
       Value bufferRes = bufferOp.getResult();
       valueMap[bufferRes] = APInt(bufferRes.getType().getIntOrFloatBitWidth(),
                                   initValues.front());
-      scheduleUses(readyList, valueMap, bufferRes);
+      initializedBuffers.push_back(bufferRes);
     }
   }
 
+  // The operations which might be ready to execute.
+  ReadyQueue readyQueue(entryBlock, valueMap);
+  for (auto bufferRes : initializedBuffers)
+    readyQueue.scheduleUses(bufferRes);
   for (auto blockArg : blockArgs)
-    scheduleUses(readyList, valueMap, blockArg);
+    readyQueue.scheduleUses(blockArg);
 
 #define EXTRA_DEBUG
   while (true) {
 #ifdef EXTRA_DEBUG
     LLVM_DEBUG(
-        for (auto t
-             : readyList) { dbgs() << "READY: " << *t << "\n"; } dbgs()
-            << "Live: " << valueMap.size() << "\n";
+        readyQueue.print(dbgs()); dbgs() << "Live: " << valueMap.size() << "\n";
         for (auto t
              : valueMap) { debugArg("Value:", t.first, t.second, 0.0); });
 #endif
-    assert(readyList.size() > 0 &&
-           "Expected some instruction to be ready for execution");
-    mlir::Operation &op = *readyList.front();
-    readyList.pop_front();
+    // Operations are only queued when a token arrives or leaves, so an empty
+    // queue means that no operation will ever be able to fire again.
+    if (readyQueue.empty()) {
+      func.emitOpError() << "deadlocked before reaching its return";
+      successFlag = false;
+      return;
+    }
+    mlir::Operation &op = *readyQueue.pop();
+    auto tokensBefore = readyQueue.getTokens(&op);
 
-    // Execute handshake ops through ExecutableOpInterface
+    // Execute handshake ops through ExecutableOpInterface. An operation which
+    // cannot fire is not requeued; it is revisited when its tokens change.
     if (auto handshakeOp = dyn_cast<handshake::ExecutableOpInterface>(op)) {
       std::vector<mlir::Value> scheduleList;
-      if (!handshakeOp.tryExecute(valueMap, memoryMap, timeMap, store,
-                                  scheduleList))
-        readyList.push_back(&op);
-      else {
+      if (handshakeOp.tryExecute(valueMap, memoryMap, timeMap, store,
+                                 scheduleList)) {
         LLVM_DEBUG({
           dbgs() << "EXECUTED: " << op << "\n";
           for (auto out : op.getResults()) {
@@ -836,32 +950,22 @@ HandshakeExecuter::HandshakeExecuter(
           }
         });
       }
-      for (mlir::Value out : scheduleList)
-        scheduleUses(readyList, valueMap, out);
+      readyQueue.propagate(&op, tokensBefore);
       continue;
     }
 
-    int64_t i = 0;
     std::vector<Any> inValues(op.getNumOperands());
     std::vector<Any> outValues(op.getNumResults());
-    bool reschedule = false;
     LLVM_DEBUG(dbgs() << "OP: (" << op.getNumOperands() << "->"
                       << op.getNumResults() << ")" << op << "\n");
     time = 0;
-    for (mlir::Value in : op.getOperands()) {
-      if (valueMap.count(in) == 0) {
-        reschedule = true;
-        continue;
-      }
-      inValues[i] = valueMap[in];
-      time = std::max(time, timeMap[in]);
-      LLVM_DEBUG(debugArg("IN", in, inValues[i], timeMap[in]));
-      ++i;
-    }
-    if (reschedule) {
-      LLVM_DEBUG(dbgs() << "Rescheduling data...\n");
-      readyList.push_back(&op);
-      continue;
+    for (auto in : enumerate(op.getOperands())) {
+      assert(valueMap.count(in.value()) &&
+             "operation queued before all its operands were available");
+      inValues[in.index()] = valueMap[in.value()];
+      time = std::max(time, timeMap[in.value()]);
+      LLVM_DEBUG(debugArg("IN", in.value(), inValues[in.index()],
+                          timeMap[in.value()]));
     }
     // Consume the inputs.
     for (mlir::Value in : op.getOperands())
@@ -903,8 +1007,8 @@ HandshakeExecuter::HandshakeExecuter(
       assert(outValues[out.index()].hasValue());
       valueMap[out.value()] = outValues[out.index()];
       timeMap[out.value()] = time + 1;
-      scheduleUses(readyList, valueMap, out.value());
     }
+    readyQueue.propagate(&op, tokensBefore);
     ++instructionsExecuted;
   }
 }
@@ -914,7 +1018,8 @@ HandshakeExecuter::HandshakeExecuter(
 //===----------------------------------------------------------------------===//
 
 bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
-              mlir::OwningOpRef<mlir::ModuleOp> &module, mlir::MLIRContext &) {
+              mlir::OwningOpRef<mlir::ModuleOp> &module, mlir::MLIRContext &,
+              const SimulationOptions &options) {
   // The store associates each allocation in the program
   // (represented by a int) with a vector of values which can be
   // accessed by it.  Currently values are assumed to be an integer.
@@ -1023,9 +1128,25 @@ bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
                     .succeeded();
   } else if (handshake::FuncOp toplevel =
                  module->lookupSymbol<handshake::FuncOp>(toplevelFunction)) {
-    succeeded = HandshakeExecuter(toplevel, valueMap, timeMap, results,
-                                  resultTimes, store, storeTimes, module)
-                    .succeeded();
+    std::unique_ptr<CompiledFunction> compiled;
+    if (options.mode != SimulationMode::Interpreted)
+      compiled = CompiledFunction::compile(toplevel, options);
+    // The interpreter has no notion of cycles to fall back to.
+    if (!compiled && options.mode == SimulationMode::CycleAccurate) {
+      toplevel.emitOpError()
+          << "cannot be simulated cycle-accurately, as it contains "
+             "operations or types the compiled mode does not support";
+      return 1;
+    }
+    if (compiled)
+      succeeded = compiled
+                      ->run(valueMap, timeMap, results, resultTimes, store,
+                            storeTimes, errs())
+                      .succeeded();
+    else
+      succeeded = HandshakeExecuter(toplevel, valueMap, timeMap, results,
+                                    resultTimes, store, storeTimes, module)
+                      .succeeded();
   }
 
   if (!succeeded)
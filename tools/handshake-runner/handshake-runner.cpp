@@ -41,6 +41,23 @@ static cl::opt<std::string>
                      cl::desc("The top-level function to execute"),
                      cl::init("main"), cl::cat(mainCategory));
 
+static cl::opt<handshake::SimulationMode> simulationMode(
+    "mode", cl::desc("How to execute handshake functions"),
+    cl::values(clEnumValN(handshake::SimulationMode::Interpreted, "interpret",
+                          "Interpret the operations one by one"),
+               clEnumValN(handshake::SimulationMode::Compiled, "compile",
+                          "Compile the function to micro-ops, if supported"),
+               clEnumValN(handshake::SimulationMode::CycleAccurate, "cycle",
+                          "Simulate the function cycle by cycle and report "
+                          "its throughput")),
+    cl::init(handshake::SimulationMode::Interpreted), cl::cat(mainCategory));
+
+static cl::list<std::string>
+    latencies("latency", cl::CommaSeparated,
+              cl::desc("The latency of an operation in cycle-accurate mode, "
+                       "as <op name>=<cycles>"),
+              cl::value_desc("name=cycles"), cl::cat(mainCategory));
+
 int main(int argc, char **argv) {
   InitLLVM y(argc, argv);
   cl::ParseCommandLineOptions(
@@ -51,6 +68,19 @@ int main(int argc, char **argv) {
       "results are returned on stdout.\n"
       "Memref types are specified as a comma-separated list of values.\n");
 
+  handshake::SimulationOptions options;
+  options.mode = simulationMode;
+  for (StringRef latency : latencies) {
+    auto [name, cycles] = latency.split('=');
+    unsigned value;
+    if (name.empty() || cycles.getAsInteger(10, value)) {
+      errs() << "Invalid latency '" << latency
+             << "', expected <op name>=<cycles>\n";
+      return 1;
+    }
+    options.latencies[name] = value;
+  }
+
   auto file_or_err = MemoryBuffer::getFileOrSTDIN(inputFileName.c_str());
   if (std::error_code error = file_or_err.getError()) {
     errs() << argv[0] << ": could not open input file '" << inputFileName
@@ -83,5 +113,6 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  return handshake::simulate(toplevelFunction, inputArgs, module, context);
+  return handshake::simulate(toplevelFunction, inputArgs, module, context,
+                             options);
 }
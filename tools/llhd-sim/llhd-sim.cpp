@@ -27,6 +27,7 @@
 #include "mlir/Target/LLVMIR/Export.h"
 #include "mlir/Transforms/Passes.h"
 
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/SourceMgr.h"
@@ -111,9 +112,36 @@ static cl::opt<TraceMode> traceMode(
             TraceMode::NamedOnly, "named-only",
             "Only dump changes for real-time steps, only for top-level "
             "instance and signals not having the default name '(sig)?[0-9]*'"),
+        clEnumValN(TraceMode::VCD, "vcd",
+                   "Dump all signals in the Value Change Dump format"),
+        clEnumValN(TraceMode::Binary, "binary",
+                   "Dump all signals in a compact block-based binary format"),
         clEnumValN(TraceMode::None, "none", "Don't dump a signal trace")),
     cl::cat(mainCategory));
 
+static cl::opt<unsigned>
+    threads("threads",
+            cl::desc("Number of threads used to evaluate the instances woken "
+                     "up in the same delta step"),
+            cl::init(1), cl::cat(mainCategory));
+
+static cl::opt<std::string> restoreFilename(
+    "restore",
+    cl::desc("Continue the simulation from the state stored in a snapshot "
+             "file, written by a previous run with --checkpoint"),
+    cl::value_desc("filename"), cl::cat(mainCategory));
+
+static cl::opt<std::string> checkpointFilename(
+    "checkpoint",
+    cl::desc("Write a snapshot of the simulation state to the given file when "
+             "the simulation stops"),
+    cl::value_desc("filename"), cl::cat(mainCategory));
+
+static cl::opt<std::string> objectCacheDir(
+    "object-cache-dir",
+    cl::desc("Directory in which the compiled designs are cached across runs"),
+    cl::value_desc("directory"), cl::cat(mainCategory));
+
 static cl::list<std::string>
     sharedLibs("shared-libs",
                cl::desc("Libraries to link dynamically. Specify absolute path "
@@ -201,10 +229,16 @@ int main(int argc, char **argv) {
   SmallVector<StringRef, 1> sharedLibPaths(sharedLibs.begin(),
                                            sharedLibs.end());
 
+  // The dumps need the lowered module, which a cached design does not have.
+  StringRef cacheDir = objectCacheDir;
+  if (dumpLLVMDialect || dumpLLVMIR)
+    cacheDir = "";
+
   llhd::sim::Engine engine(
       output->os(), *module, &applyMLIRPasses,
       makeOptimizingTransformer(optimizationLevel, 0, nullptr), root, traceMode,
-      sharedLibPaths);
+      sharedLibPaths, threads, cacheDir,
+      "opt-level=" + std::to_string(optimizationLevel));
 
   if (dumpLLVMDialect || dumpLLVMIR) {
     return dumpLLVM(engine.getModule(), context);
@@ -216,7 +250,13 @@ int main(int argc, char **argv) {
     return 0;
   }
 
-  engine.simulate(nSteps, maxTime);
+  if (engine.simulate(nSteps, maxTime, restoreFilename, checkpointFilename))
+    return 1;
+
+  // The engine counters are collected in all builds, unlike the LLVM
+  // statistics, but are printed behind the same -stats flag.
+  if (llvm::AreStatisticsEnabled())
+    engine.getStatistics().print(llvm::errs());
 
   output->keep();
   return 0;
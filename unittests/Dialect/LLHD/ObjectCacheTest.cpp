@@ -0,0 +1,68 @@
+//===- ObjectCacheTest.cpp - LLHD simulator object cache unit tests -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/LLHD/Simulator/ObjectCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+namespace {
+
+TEST(ObjectCacheTest, KeyCoversDesignAndOptions) {
+  auto key = ObjectFileCache::computeKey("llhd.entity @root", "opt-level=2");
+  EXPECT_EQ(key, ObjectFileCache::computeKey("llhd.entity @root",
+                                             "opt-level=2"));
+  EXPECT_NE(key, ObjectFileCache::computeKey("llhd.entity @top",
+                                             "opt-level=2"));
+  EXPECT_NE(key, ObjectFileCache::computeKey("llhd.entity @root",
+                                             "opt-level=3"));
+  // The fields are delimited, such that moving text from one to the other
+  // changes the key.
+  EXPECT_NE(ObjectFileCache::computeKey("ab", "c"),
+            ObjectFileCache::computeKey("a", "bc"));
+}
+
+TEST(ObjectCacheTest, StoreAndLookup) {
+  SmallString<128> dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("llhd-object-cache", dir));
+  sys::path::append(dir, "nested");
+  ObjectFileCache cache(dir);
+
+  auto key = ObjectFileCache::computeKey("design", "");
+  EXPECT_EQ(cache.lookup(key), nullptr);
+
+  // A writer failing to produce an object leaves the cache untouched.
+  auto err = cache.store(key, [](StringRef) { return Error::success(); });
+  EXPECT_TRUE(errorToBool(std::move(err)));
+  EXPECT_EQ(cache.lookup(key), nullptr);
+
+  err = cache.store(key, [](StringRef path) -> Error {
+    std::error_code ec;
+    raw_fd_ostream os(path, ec);
+    if (ec)
+      return errorCodeToError(ec);
+    os << "object";
+    return Error::success();
+  });
+  ASSERT_FALSE(errorToBool(std::move(err)));
+
+  auto object = cache.lookup(key);
+  ASSERT_NE(object, nullptr);
+  EXPECT_EQ(object->getBuffer(), "object");
+  EXPECT_EQ(cache.lookup(ObjectFileCache::computeKey("other", "")), nullptr);
+
+  sys::fs::remove_directories(sys::path::parent_path(dir));
+}
+
+} // namespace
@@ -0,0 +1,162 @@
+//===- SlotTest.cpp - LLHD simulator change buffer unit tests -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/LLHD/Simulator/State.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <random>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+namespace {
+
+/// A drive of a signal, as issued by the simulated design.
+struct Drive {
+  unsigned signal;
+  unsigned bitOffset;
+  unsigned width;
+  uint64_t value[4];
+};
+
+/// Generate random drives to signals of different widths, either covering the
+/// whole signal or a random slice of it.
+static std::vector<Drive> generateDrives(ArrayRef<unsigned> widths,
+                                         unsigned numDrives) {
+  std::mt19937_64 rng(42);
+  std::vector<Drive> drives;
+  for (unsigned i = 0; i < numDrives; ++i) {
+    Drive drive;
+    drive.signal = rng() % widths.size();
+    unsigned width = widths[drive.signal];
+    if (rng() % 2) {
+      drive.bitOffset = 0;
+      drive.width = width;
+    } else {
+      drive.bitOffset = rng() % width;
+      drive.width = 1 + rng() % (width - drive.bitOffset);
+    }
+    for (auto &word : drive.value)
+      word = rng();
+    drives.push_back(drive);
+  }
+  return drives;
+}
+
+/// Merge the drives into the signal values the way the simulator used to,
+/// using an APInt per change buffer and per merged signal.
+static void mergeWithAPInt(ArrayRef<Drive> drives, ArrayRef<unsigned> widths,
+                           std::vector<APInt> &values) {
+  SmallVector<std::pair<unsigned, unsigned>, 32> changes;
+  SmallVector<std::pair<unsigned, APInt>, 32> buffers;
+  for (auto &drive : drives) {
+    buffers.push_back(std::make_pair(
+        drive.bitOffset,
+        APInt(drive.width, makeArrayRef(drive.value,
+                                        divideCeil(drive.width, 64)))));
+    changes.push_back(std::make_pair(drive.signal, buffers.size() - 1));
+  }
+  llvm::sort(changes);
+
+  for (size_t i = 0, e = changes.size(); i < e;) {
+    auto sigIndex = changes[i].first;
+    APInt buff = values[sigIndex];
+    for (; i < e && changes[i].first == sigIndex; ++i) {
+      const auto &change = buffers[changes[i].second];
+      if (change.second.getBitWidth() < buff.getBitWidth())
+        buff.insertBits(change.second, change.first);
+      else
+        buff = change.second.zextOrTrunc(buff.getBitWidth());
+    }
+    values[sigIndex] = buff;
+  }
+}
+
+/// Merge the drives into the signal values using the slot change buffers.
+static void mergeWithSlot(Slot &slot, ArrayRef<Drive> drives,
+                          ArrayRef<unsigned> widths,
+                          std::vector<SmallVector<uint64_t, 4>> &values) {
+  for (auto &drive : drives)
+    slot.insertChange(drive.signal, drive.bitOffset,
+                      reinterpret_cast<uint8_t *>(
+                          const_cast<uint64_t *>(drive.value)),
+                      drive.width);
+  llvm::sort(slot.changes);
+
+  for (size_t i = 0, e = slot.changesSize; i < e;) {
+    auto sigIndex = slot.changes[i].first;
+    auto *buff = values[sigIndex].data();
+    for (; i < e && slot.changes[i].first == sigIndex; ++i)
+      slot.applyChange(slot.changes[i].second, buff, widths[sigIndex]);
+  }
+  slot.clear();
+}
+
+TEST(SlotTest, MatchesAPIntMerge) {
+  SmallVector<unsigned> widths = {8, 16, 32, 64, 72, 128, 200, 256};
+  auto drives = generateDrives(widths, 5000);
+
+  std::vector<APInt> expected;
+  std::vector<SmallVector<uint64_t, 4>> actual;
+  for (auto width : widths) {
+    expected.push_back(APInt(width, 0));
+    actual.push_back(SmallVector<uint64_t, 4>(divideCeil(width, 64), 0));
+  }
+
+  // Merge in small batches, such that the partial drives are applied to
+  // non-trivial values.
+  Slot slot(Time(0, 0, 0));
+  for (size_t i = 0, e = drives.size(); i < e; i += 10) {
+    auto batch = makeArrayRef(drives).slice(i, std::min<size_t>(10, e - i));
+    mergeWithAPInt(batch, widths, expected);
+    mergeWithSlot(slot, batch, widths, actual);
+    for (size_t j = 0, f = widths.size(); j < f; ++j)
+      ASSERT_EQ(expected[j],
+                APInt(widths[j], makeArrayRef(actual[j].data(),
+                                              actual[j].size())))
+          << "mismatch on signal " << j << " after drive " << i;
+  }
+}
+
+TEST(SlotTest, Benchmark) {
+  SmallVector<unsigned> widths = {1, 8, 16, 32, 32, 64, 64, 128};
+  auto drives = generateDrives(widths, 64);
+  const unsigned numRounds = 20000;
+
+  std::vector<APInt> apintValues;
+  std::vector<SmallVector<uint64_t, 4>> slotValues;
+  for (auto width : widths) {
+    apintValues.push_back(APInt(width, 0));
+    slotValues.push_back(SmallVector<uint64_t, 4>(divideCeil(width, 64), 0));
+  }
+
+  auto measure = [&](auto merge) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < numRounds; ++i)
+      merge();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return numRounds * drives.size() / elapsed.count();
+  };
+
+  double before =
+      measure([&]() { mergeWithAPInt(drives, widths, apintValues); });
+  Slot slot(Time(0, 0, 0));
+  double after =
+      measure([&]() { mergeWithSlot(slot, drives, widths, slotValues); });
+
+  llvm::errs() << "Slot change buffers benchmark (drives/second):\n"
+               << "  APInt buffers:  " << before << "\n"
+               << "  inline buffers: " << after << "\n";
+}
+
+} // namespace
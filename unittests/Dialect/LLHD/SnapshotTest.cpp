@@ -0,0 +1,173 @@
+//===- SnapshotTest.cpp - LLHD simulator snapshot unit tests --------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/LLHD/Simulator/Snapshot.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <cstdlib>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+namespace {
+
+/// The state of a small design, with a root entity driving an 8 bit and a 128
+/// bit signal, and a process sensitive to both. The unit states are allocated
+/// the way the jitted code does.
+struct TestDesign {
+  TestDesign(StringRef dataName = "data", bool persistsPointer = true) {
+    state.time = Time(0, 0, 0);
+    state.addSignal("clk", "root");
+    state.addSignal(dataName.str(), "root");
+    state.signals[0].store(clk, sizeof(clk));
+    state.signals[1].store(reinterpret_cast<uint8_t *>(data), 16);
+
+    Instance root("root");
+    root.isEntity = true;
+    root.entityState = std::unique_ptr<uint8_t>(new uint8_t(0));
+    root.stateSize = 1;
+    root.sensitivityList.push_back({clk, 0, 0, 0});
+    root.sensitivityList.push_back({state.signals[1].getValue(), 0, 1, 1});
+    state.instances.push_back(std::move(root));
+
+    Instance proc("root.proc");
+    proc.isEntity = false;
+    proc.nArgs = 2;
+    proc.sensitivityList.push_back({clk, 0, 0, 0});
+    proc.sensitivityList.push_back({state.signals[1].getValue(), 0, 1, 1});
+    state.instances.push_back(std::move(proc));
+
+    // The process persists a pointer into the 128 bit signal.
+    auto *procState = new ProcState();
+    procState->resume = 0;
+    procState->senses = static_cast<bool *>(std::malloc(2));
+    procState->senses[0] = procState->senses[1] = true;
+    procState->resumeState = nullptr;
+    state.addProcPtr("root.proc", procState, sizeof(ProcState));
+    if (persistsPointer)
+      state.instances[1].procStatePointers.push_back(
+          offsetof(ProcState, resumeState));
+  }
+
+  ProcState &getProcState() { return *state.instances[1].procState; }
+
+  uint8_t clk[1] = {0};
+  uint64_t data[4] = {0, 0, 0, 0};
+  State state;
+};
+
+/// Return the path of a new temporary file for a snapshot.
+static SmallString<128> getSnapshotPath() {
+  SmallString<128> path;
+  int fd;
+  EXPECT_FALSE(sys::fs::createTemporaryFile("snapshot", "llhd", fd, path));
+  sys::fs::closeFile(fd);
+  return path;
+}
+
+TEST(SnapshotTest, RoundTrip) {
+  TestDesign before;
+  before.state.time = Time(100, 2, 0);
+  before.clk[0] = 1;
+  before.data[0] = 0x0123456789abcdefULL;
+  before.data[1] = 0xfedcba9876543210ULL;
+  *before.state.instances[0].entityState = 1;
+  before.getProcState().resume = 3;
+  before.getProcState().senses[1] = false;
+  before.getProcState().resumeState =
+      reinterpret_cast<uint8_t *>(before.data) + 4;
+  before.state.instances[1].expectedWakeup = Time(150, 0, 0);
+
+  uint64_t wide[2] = {~0ULL, 42};
+  uint8_t byte = 0xab;
+  before.state.queue.insertOrUpdate(Time(101, 0, 0), 1, 0,
+                                    reinterpret_cast<uint8_t *>(wide), 128);
+  before.state.queue.insertOrUpdate(Time(101, 0, 0), 0, 0, &byte, 1);
+  before.state.queue.insertOrUpdate(Time(101, 0, 0), 1, 4, &byte, 8);
+  before.state.queue.insertOrUpdate(Time(150, 0, 0), 1);
+
+  auto path = getSnapshotPath();
+  ASSERT_FALSE(errorToBool(writeSnapshot(before.state, path)));
+
+  TestDesign after;
+  auto err = restoreSnapshot(after.state, path);
+  sys::fs::remove(path);
+  ASSERT_FALSE(err) << toString(std::move(err));
+
+  EXPECT_EQ(after.state.time, Time(100, 2, 0));
+  EXPECT_EQ(after.clk[0], 1);
+  EXPECT_EQ(after.data[0], before.data[0]);
+  EXPECT_EQ(after.data[1], before.data[1]);
+  EXPECT_EQ(*after.state.instances[0].entityState, 1);
+  EXPECT_EQ(after.getProcState().inst, 1u);
+  EXPECT_EQ(after.getProcState().resume, 3);
+  EXPECT_TRUE(after.getProcState().senses[0]);
+  EXPECT_FALSE(after.getProcState().senses[1]);
+  EXPECT_EQ(after.state.instances[1].expectedWakeup, Time(150, 0, 0));
+
+  // The persisted pointer is relocated to the restored signal.
+  EXPECT_EQ(after.getProcState().resumeState,
+            reinterpret_cast<uint8_t *>(after.data) + 4);
+
+  // The pending events are restored, in the order they were scheduled.
+  ASSERT_EQ(after.state.queue.events, 2u);
+  const auto &first = after.state.queue.top();
+  EXPECT_EQ(first.time, Time(101, 0, 0));
+  ASSERT_EQ(first.changesSize, 3u);
+  uint64_t clkValue = 0, dataValue[2] = {0, 0};
+  for (size_t i = 0; i < first.changesSize; ++i) {
+    if (first.changes[i].first == 0)
+      first.applyChange(first.changes[i].second, &clkValue, 8);
+    else
+      first.applyChange(first.changes[i].second, dataValue, 128);
+  }
+  EXPECT_EQ(clkValue, 1u);
+  EXPECT_EQ(dataValue[0], (~0ULL & ~(0xffULL << 4)) | (0xabULL << 4));
+  EXPECT_EQ(dataValue[1], 42u);
+  after.state.queue.pop();
+
+  const auto &second = after.state.queue.top();
+  EXPECT_EQ(second.time, Time(150, 0, 0));
+  ASSERT_EQ(second.scheduled.size(), 1u);
+  EXPECT_EQ(second.scheduled[0], 1u);
+}
+
+TEST(SnapshotTest, KeepsWordsLookingLikePointers) {
+  // Without a recorded pointer, the persisted word is data which happens to
+  // look like an address, and is restored as is.
+  TestDesign before("data", /*persistsPointer=*/false);
+  auto *word = reinterpret_cast<uint8_t *>(before.data) + 4;
+  before.getProcState().resumeState = word;
+
+  auto path = getSnapshotPath();
+  ASSERT_FALSE(errorToBool(writeSnapshot(before.state, path)));
+
+  TestDesign after("data", /*persistsPointer=*/false);
+  auto err = restoreSnapshot(after.state, path);
+  sys::fs::remove(path);
+  ASSERT_FALSE(err) << toString(std::move(err));
+  EXPECT_EQ(after.getProcState().resumeState, word);
+}
+
+TEST(SnapshotTest, RejectsOtherDesign) {
+  TestDesign before;
+  auto path = getSnapshotPath();
+  ASSERT_FALSE(errorToBool(writeSnapshot(before.state, path)));
+
+  TestDesign other("other");
+  auto err = restoreSnapshot(other.state, path);
+  sys::fs::remove(path);
+  ASSERT_TRUE(!!err);
+  EXPECT_NE(toString(std::move(err)).find("root/other does not match"),
+            std::string::npos);
+}
+
+} // namespace
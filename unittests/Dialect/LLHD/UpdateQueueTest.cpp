@@ -0,0 +1,200 @@
+//===- UpdateQueueTest.cpp - LLHD simulator event queue unit tests --------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/LLHD/Simulator/State.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <random>
+
+using namespace circt::llhd::sim;
+
+namespace {
+
+/// The original event queue of the simulator, which linearly scans all the
+/// slots to insert an event and to find the new top of the queue. Used as a
+/// reference for the ordering of the events and as a performance baseline.
+class LinearScanQueue : public llvm::SmallVector<Slot, 8> {
+  unsigned topSlot = 0;
+  llvm::SmallVector<unsigned, 4> unused;
+
+public:
+  Slot &getOrCreateSlot(Time time) {
+    if (empty()) {
+      push_back(Slot(time));
+      ++events;
+      return back();
+    }
+
+    auto &top = begin()[topSlot];
+    if (!top.unused && time == top.time)
+      return top;
+
+    if (events > 0 && top.time < time)
+      for (size_t i = 0, e = size(); i < e; ++i)
+        if (time == begin()[i].time)
+          return begin()[i];
+
+    if (!unused.empty()) {
+      auto firstUnused = unused.pop_back_val();
+      auto &newSlot = begin()[firstUnused];
+      newSlot.unused = false;
+      newSlot.time = time;
+      if (top.unused || time < top.time)
+        topSlot = firstUnused;
+      ++events;
+      return newSlot;
+    }
+
+    push_back(Slot(time));
+    if (begin()[topSlot].unused || time < begin()[topSlot].time)
+      topSlot = size() - 1;
+    ++events;
+    return back();
+  }
+
+  const Slot &top() { return begin()[topSlot]; }
+
+  void pop() {
+    auto &curr = begin()[topSlot];
+    curr.unused = true;
+    curr.scheduled.clear();
+    curr.time = Time();
+    --events;
+    unused.push_back(topSlot);
+    topSlot = std::distance(
+        begin(),
+        std::min_element(begin(), end(), [](const auto &a, const auto &b) {
+          return !a.unused && (a < b || b.unused);
+        }));
+  }
+
+  unsigned events = 0;
+};
+
+/// Generate a random time offset, mixing delta steps and real-time steps
+/// spanning several levels of the timing wheel.
+static Time randomOffset(std::mt19937_64 &rng) {
+  switch (rng() % 4) {
+  case 0:
+    return Time(0, 1, 0);
+  case 1:
+    return Time(rng() % 64, 0, rng() % 2);
+  case 2:
+    return Time(1 + rng() % 10000, 0, 0);
+  default:
+    return Time(1 + (rng() % 1000) * 1000000, 0, 0);
+  }
+}
+
+/// Run an event loop similar to the simulation engine one: pop the top of the
+/// queue and schedule `fanout` new events relative to its time.
+template <typename QueueT>
+static void runEventLoop(QueueT &queue, unsigned numPending, unsigned numPops,
+                         unsigned fanout, std::vector<Time> *popped) {
+  std::mt19937_64 rng(42);
+  unsigned inst = 0;
+  for (unsigned i = 0; i < numPending; ++i)
+    queue.getOrCreateSlot(randomOffset(rng)).insertChange(inst++);
+
+  for (unsigned i = 0; i < numPops && queue.events > 0; ++i) {
+    auto now = queue.top().time;
+    if (popped)
+      popped->push_back(now);
+    queue.pop();
+    for (unsigned j = 0; j < fanout; ++j)
+      queue.getOrCreateSlot(now + randomOffset(rng)).insertChange(inst++);
+  }
+}
+
+TEST(UpdateQueueTest, PopInTimeOrder) {
+  UpdateQueue queue;
+  queue.insertOrUpdate(Time(10, 0, 0), 0);
+  queue.insertOrUpdate(Time(5, 1, 0), 1);
+  queue.insertOrUpdate(Time(1ULL << 40, 0, 0), 2);
+  queue.insertOrUpdate(Time(5, 0, 1), 3);
+  queue.insertOrUpdate(Time(10, 0, 0), 4);
+  queue.insertOrUpdate(Time(300, 0, 0), 5);
+  ASSERT_EQ(queue.events, 5u);
+
+  std::vector<std::pair<Time, llvm::SmallVector<unsigned, 4>>> expected = {
+      {Time(5, 0, 1), {3}},
+      {Time(5, 1, 0), {1}},
+      {Time(10, 0, 0), {0, 4}},
+      {Time(300, 0, 0), {5}},
+      {Time(1ULL << 40, 0, 0), {2}}};
+  for (auto &exp : expected) {
+    ASSERT_FALSE(queue.empty());
+    const auto &top = queue.top();
+    EXPECT_EQ(top.time, exp.first);
+    EXPECT_EQ(top.scheduled, exp.second);
+    queue.pop();
+  }
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(UpdateQueueTest, InsertIntoCurrentTime) {
+  UpdateQueue queue;
+  queue.insertOrUpdate(Time(7, 0, 0), 0);
+  queue.insertOrUpdate(Time(100, 0, 0), 1);
+  EXPECT_EQ(queue.top().time, Time(7, 0, 0));
+  queue.pop();
+
+  // Schedule delta steps at the current real time, out of order.
+  queue.insertOrUpdate(Time(100, 2, 0), 2);
+  queue.insertOrUpdate(Time(100, 1, 0), 3);
+  EXPECT_EQ(queue.top().time, Time(100, 0, 0));
+  queue.pop();
+  EXPECT_EQ(queue.top().time, Time(100, 1, 0));
+  queue.pop();
+  EXPECT_EQ(queue.top().time, Time(100, 2, 0));
+  queue.pop();
+  EXPECT_TRUE(queue.empty());
+
+  // An empty queue can be reused from an earlier time.
+  queue.insertOrUpdate(Time(3, 0, 0), 4);
+  EXPECT_EQ(queue.top().time, Time(3, 0, 0));
+}
+
+TEST(UpdateQueueTest, MatchesLinearScanQueue) {
+  std::vector<Time> expected, actual;
+  LinearScanQueue reference;
+  runEventLoop(reference, 500, 20000, 1, &expected);
+  UpdateQueue queue;
+  runEventLoop(queue, 500, 20000, 1, &actual);
+
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0, e = expected.size(); i < e; ++i)
+    ASSERT_EQ(expected[i], actual[i]) << "mismatch at pop " << i;
+}
+
+TEST(UpdateQueueTest, Benchmark) {
+  const unsigned numPending = 2000, numPops = 20000;
+
+  auto measure = [&](auto &queue) {
+    auto start = std::chrono::steady_clock::now();
+    runEventLoop(queue, numPending, numPops, 1, nullptr);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  };
+
+  LinearScanQueue reference;
+  double linearScan = measure(reference);
+  UpdateQueue queue;
+  double timingWheel = measure(queue);
+
+  llvm::errs() << "UpdateQueue benchmark (" << numPending << " pending, "
+               << numPops << " pops):\n"
+               << "  linear scan:  " << linearScan << "s\n"
+               << "  timing wheel: " << timingWheel << "s\n";
+  EXPECT_EQ(reference.events, queue.events);
+}
+
+} // namespace
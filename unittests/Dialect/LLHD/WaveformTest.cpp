@@ -0,0 +1,107 @@
+//===- WaveformTest.cpp - LLHD simulator waveform writer unit tests -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/LLHD/Simulator/Waveform.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace circt::llhd::sim;
+
+namespace {
+
+/// Build a state with a root instance owning two signals, the first of which
+/// is also connected to a child instance.
+static void buildState(State &state, uint8_t *a, uint8_t *b) {
+  state.time = Time(0, 0, 0);
+  Instance root("root.root");
+  root.path = "root";
+  state.instances.push_back(std::move(root));
+  Instance child("root.child");
+  child.path = "root/child";
+  state.instances.push_back(std::move(child));
+
+  state.signals.push_back(Signal("a", "root.root", a, 1));
+  state.signals.push_back(Signal("b", "root.root", b, 2));
+  state.signals[0].pushInstanceIndex(0, 0);
+  state.signals[0].pushInstanceIndex(1, 0);
+  state.signals[1].pushInstanceIndex(0, 1);
+}
+
+TEST(WaveformTest, VCD) {
+  uint8_t a[8] = {1}, b[8] = {0};
+  State state;
+  buildState(state, a, b);
+
+  std::string output;
+  llvm::raw_string_ostream os(output);
+  auto writer = createVCDWriter(state, os);
+
+  writer->addChange(0);
+  writer->addChange(1);
+  state.time = Time(10, 0, 0);
+  writer->flush();
+
+  // Changes within the same real-time step are merged, and values changing
+  // back to the last written one are skipped.
+  a[0] = 0;
+  b[1] = 0x80;
+  writer->addChange(0);
+  writer->addChange(1);
+  state.time = Time(10, 1, 0);
+  a[0] = 1;
+  writer->addChange(0);
+  writer->flush();
+  state.time = Time(20, 0, 0);
+  writer->flush(/*force=*/true);
+
+  EXPECT_EQ(os.str(), "$version llhd-sim $end\n"
+                      "$timescale 1ps $end\n"
+                      "$scope module root $end\n"
+                      "$var wire 8 ! a $end\n"
+                      "$var wire 16 \" b $end\n"
+                      "$scope module child $end\n"
+                      "$var wire 8 ! a $end\n"
+                      "$upscope $end\n"
+                      "$upscope $end\n"
+                      "$enddefinitions $end\n"
+                      "#0\n"
+                      "b1 !\n"
+                      "b0 \"\n"
+                      "#10\n"
+                      "b1000000000000000 \"\n");
+}
+
+TEST(WaveformTest, Binary) {
+  uint8_t a[8] = {1}, b[8] = {0};
+  State state;
+  buildState(state, a, b);
+
+  std::string output;
+  llvm::raw_string_ostream os(output);
+  auto writer = createBinaryWaveWriter(state, os);
+
+  writer->addChange(0);
+  writer->addChange(1);
+  state.time = Time(10, 0, 0);
+  writer->flush();
+  b[0] = 3;
+  writer->addChange(1);
+  writer->flush(/*force=*/true);
+
+  std::string expected("LLHDWAVE\x01\x02", 10);
+  // Entry table.
+  expected += std::string("\x01\x02\x06root/a\x0croot/child/a", 22);
+  expected += std::string("\x02\x01\x06root/b", 9);
+  // One block starting at time 0 with two steps.
+  expected += std::string("B\x00\x02\x0c", 4);
+  expected += std::string("\x00\x01\x01\x01\x01\x00\x00", 7);
+  expected += std::string("\x0a\x02\x01\x03\x00", 5);
+  EXPECT_EQ(os.str(), expected);
+}
+
+} // namespace
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+##===- utils/bench-annotation-import.py - Annotation import bench *- py -*-===##
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+##===----------------------------------------------------------------------===##
+#
+# This script compares the time and peak memory of importing a large annotation
+# file with firtool, parsing it as a single JSON document and streaming it one
+# annotation at a time (--stream-annotation-files).
+#
+# Usage bench-annotation-import.py [--firtool path] [--modules N]
+#                                  [--annotations N] [--disable-threading]
+#
+##===----------------------------------------------------------------------===##
+
+import argparse
+import json
+import os
+import tempfile
+
+from firtool_bench import best_of, run_firtool, write_circuit
+
+
+def write_chain(path, num_modules):
+  """Write a circuit with a chain of modules, each holding a few wires."""
+
+  def write_module(f, i):
+    f.write("    wire a : UInt<1>\n")
+    f.write("    wire b : UInt<8>[4]\n")
+    if i > 0:
+      f.write(f"    inst child of M{i - 1}\n")
+    else:
+      f.write("    skip\n")
+
+  def write_top(f):
+    f.write(f"    inst child of M{num_modules - 1}\n")
+
+  write_circuit(path, num_modules, write_module, write_top)
+
+
+def write_annotations(path, num_modules, num_annotations):
+  """Write an annotation file mixing module, reference, subindex and
+  non-local targets, with payloads of the size found in real designs."""
+  with open(path, "w") as f:
+    f.write("[\n")
+    for i in range(num_annotations):
+      module = i % num_modules
+      kind = i % 4
+      if kind == 0:
+        target = f"~Top|M{module}"
+      elif kind == 1:
+        target = f"~Top|M{module}>a"
+      elif kind == 2:
+        target = f"~Top|M{module}>b[{(i // 4) % 4}]"
+      else:
+        target = f"~Top|Top/child:M{num_modules - 1}"
+      annotation = {
+          "class": "sifive.enterprise.firrtl.BenchmarkAnnotation",
+          "target": target,
+          "id": i,
+          "description": f"annotation {i} " + "x" * 64,
+          "payload": {
+              "values": list(range(16)),
+              "nested": json.dumps({"key": i, "flag": bool(i % 2)}),
+          },
+      }
+      if i:
+        f.write(",\n")
+      json.dump(annotation, f)
+    f.write("\n]\n")
+
+
+def run(firtool, circuit, annotations, disable_threading, stream):
+  """Run firtool once, returning its wall time in seconds and its peak
+  resident memory in MiB."""
+  args = [
+      firtool, circuit, "--parse-only", "--annotation-file", annotations,
+      "-o", os.devnull
+  ]
+  if stream:
+    args.append("--stream-annotation-files")
+  if disable_threading:
+    args.append("--mlir-disable-threading")
+  return run_firtool(args)
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Compare the document and streaming annotation import")
+  parser.add_argument("--firtool", default="firtool")
+  parser.add_argument("--modules", type=int, default=1000)
+  parser.add_argument("--annotations", type=int, default=200000)
+  parser.add_argument("--disable-threading", action="store_true")
+  parser.add_argument("--repeat", type=int, default=3)
+  args = parser.parse_args()
+
+  with tempfile.TemporaryDirectory() as tmp:
+    circuit = os.path.join(tmp, "Top.fir")
+    annotations = os.path.join(tmp, "Top.anno.json")
+    write_chain(circuit, args.modules)
+    write_annotations(annotations, args.modules, args.annotations)
+    size = os.path.getsize(annotations) / (1024 * 1024)
+    print(f"{args.annotations} annotations, {size:.1f} MiB")
+
+    for stream in (False, True):
+      results = [
+          run(args.firtool, circuit, annotations, args.disable_threading,
+              stream)
+          for _ in range(args.repeat)
+      ]
+      best_time, best_rss = best_of(results)
+      name = "streaming" if stream else "document"
+      print(f"{name:>10}: {best_time:8.3f} s {best_rss:10.1f} MiB peak RSS")
+
+
+if __name__ == "__main__":
+  main()
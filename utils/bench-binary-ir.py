@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+##===- utils/bench-binary-ir.py - Binary IR load benchmark -------*- py -*-===##
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+##===----------------------------------------------------------------------===##
+#
+# This script compares the size of a design saved as textual MLIR and as binary
+# IR (--emit-binary-ir), and the time and peak memory of loading it back into
+# firtool.  The design is either given as a .fir file, or generated.
+#
+# Usage bench-binary-ir.py [--firtool path] [--input file.fir] [--modules N]
+#                          [--disable-threading]
+#
+##===----------------------------------------------------------------------===##
+
+import argparse
+import os
+import tempfile
+
+from firtool_bench import best_of, run_firtool, write_circuit
+
+
+def write_chain(path, num_modules):
+  """Write a circuit with a chain of modules, each holding some logic."""
+
+  def write_module(f, i):
+    f.write("    input clock : Clock\n")
+    f.write("    input a : UInt<8>\n")
+    f.write("    output b : UInt<8>\n")
+    f.write("    reg r : UInt<8>[4], clock @[M.scala 1:2]\n")
+    for j in range(4):
+      f.write(f"    r[{j}] <= add(a, UInt<8>({j})) @[M.scala {j + 2}:4]\n")
+    if i > 0:
+      f.write(f"    inst child of M{i - 1}\n")
+      f.write("    child.clock <= clock\n")
+      f.write("    child.a <= xor(r[0], r[1])\n")
+      f.write("    b <= and(child.b, r[2])\n")
+    else:
+      f.write("    b <= or(r[2], r[3])\n")
+
+  def write_top(f):
+    f.write("    input clock : Clock\n")
+    f.write("    input a : UInt<8>\n")
+    f.write("    output b : UInt<8>\n")
+    f.write(f"    inst child of M{num_modules - 1}\n")
+    f.write("    child.clock <= clock\n")
+    f.write("    child.a <= a\n")
+    f.write("    b <= child.b\n")
+
+  write_circuit(path, num_modules, write_module, write_top)
+
+
+def run(firtool, args):
+  """Run firtool once, returning its wall time in seconds and its peak
+  resident memory in MiB."""
+  return run_firtool([firtool] + args)
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Compare loading textual MLIR and binary IR")
+  parser.add_argument("--firtool", default="firtool")
+  parser.add_argument("--input", help="a .fir file, generated if omitted")
+  parser.add_argument("--modules", type=int, default=20000)
+  parser.add_argument("--disable-threading", action="store_true")
+  parser.add_argument("--repeat", type=int, default=3)
+  args = parser.parse_args()
+
+  with tempfile.TemporaryDirectory() as tmp:
+    circuit = args.input
+    if not circuit:
+      circuit = os.path.join(tmp, "Top.fir")
+      write_chain(circuit, args.modules)
+    text = os.path.join(tmp, "Top.mlir")
+    binary = os.path.join(tmp, "Top.bin.mlir")
+    run(args.firtool, [circuit, "--parse-only", "-o", text])
+    run(args.firtool,
+        [circuit, "--parse-only", "--emit-binary-ir", "-o", binary])
+
+    for name, path in (("text", text), ("binary", binary)):
+      load = [path, "--format=mlir", "--parse-only", "-o", os.devnull]
+      if args.disable_threading:
+        load.append("--mlir-disable-threading")
+      results = [run(args.firtool, load) for _ in range(args.repeat)]
+      best_time, best_rss = best_of(results)
+      size = os.path.getsize(path) / (1024 * 1024)
+      print(f"{name:>7}: {size:8.1f} MiB {best_time:8.3f} s "
+            f"{best_rss:10.1f} MiB peak RSS")
+
+
+if __name__ == "__main__":
+  main()
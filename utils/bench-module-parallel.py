@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+##===- utils/bench-module-parallel.py - Module-parallel scaling --*- py -*-===##
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+##===----------------------------------------------------------------------===##
+#
+# This script measures how the FIRRTL passes which summarize the modules of a
+# circuit in parallel scale with the number of threads.  firtool is run on the
+# design with --mlir-disable-threading, and then restricted to an increasing
+# number of CPUs, and the durations of the passes are read from the report of
+# --pass-profile.  The design is either given as a .fir file, or generated
+# with uninferred widths and resets.
+#
+# Usage bench-module-parallel.py [--firtool path] [--input file.fir]
+#                                [--modules N] [--threads 1,2,4,8]
+#
+##===----------------------------------------------------------------------===##
+
+import argparse
+import json
+import os
+import tempfile
+
+from firtool_bench import run_firtool, write_circuit
+
+PASSES = ["firrtl-infer-widths", "firrtl-infer-resets"]
+
+
+def write_tree(path, num_modules):
+  """Write a circuit with a tree of modules, each holding some logic with
+  uninferred widths and an abstract reset."""
+
+  def write_module(f, i):
+    f.write("    input clock : Clock\n")
+    f.write("    input reset : Reset\n")
+    f.write("    input a : UInt\n")
+    f.write("    output b : UInt\n")
+    f.write("    reg r : UInt[8], clock\n")
+    f.write("    reg s : UInt, clock with : (reset => (reset, UInt(0)))\n")
+    f.write("    s <= a\n")
+    f.write("    wire w : { x : UInt, y : SInt }\n")
+    for j in range(8):
+      f.write(f"    r[{j}] <= add(a, UInt({j}))\n")
+    f.write("    w.x <= cat(r[0], r[1])\n")
+    f.write("    w.y <= asSInt(r[2])\n")
+    children = [c for c in (2 * i + 1, 2 * i + 2) if c < num_modules]
+    for k, c in enumerate(children):
+      f.write(f"    inst c{k} of M{c}\n")
+      f.write(f"    c{k}.clock <= clock\n")
+      f.write(f"    c{k}.reset <= reset\n")
+      f.write(f"    c{k}.a <= xor(w.x, r[{k + 3}])\n")
+    if len(children) == 2:
+      f.write("    b <= or(c0.b, c1.b)\n")
+    elif len(children) == 1:
+      f.write("    b <= or(c0.b, asUInt(w.y))\n")
+    else:
+      f.write("    b <= and(w.x, s)\n")
+
+  def write_top(f):
+    f.write("    input clock : Clock\n")
+    f.write("    input reset : UInt<1>\n")
+    f.write("    input a : UInt<8>\n")
+    f.write("    output b : UInt\n")
+    f.write("    inst root of M0\n")
+    f.write("    root.clock <= clock\n")
+    f.write("    root.reset <= reset\n")
+    f.write("    root.a <= a\n")
+    f.write("    b <= root.b\n")
+
+  write_circuit(path, num_modules, write_module, write_top)
+
+
+def run(firtool, circuit, profile, threads):
+  """Run firtool once, returning the durations of the passes in seconds."""
+  args = [firtool, circuit, "--ir-hw", "-o", os.devnull,
+          f"--pass-profile={profile}"]
+  if threads == 0:
+    args.append("--mlir-disable-threading")
+  else:
+    args = ["taskset", "-c", f"0-{threads - 1}"] + args
+  run_firtool(args)
+  with open(profile) as f:
+    report = json.load(f)
+  durations = {name: 0.0 for name in PASSES}
+  for entry in report["passes"]:
+    if entry["pass"] in durations:
+      durations[entry["pass"]] += entry["durationUs"] / 1e6
+  return durations
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description="Measure the thread scaling of module-parallel passes")
+  parser.add_argument("--firtool", default="firtool")
+  parser.add_argument("--input", help="a .fir file, generated if omitted")
+  parser.add_argument("--modules", type=int, default=20000)
+  parser.add_argument("--threads", default="1,2,4,8")
+  parser.add_argument("--repeat", type=int, default=3)
+  args = parser.parse_args()
+
+  with tempfile.TemporaryDirectory() as tmp:
+    circuit = args.input
+    if not circuit:
+      circuit = os.path.join(tmp, "Top.fir")
+      write_tree(circuit, args.modules)
+    profile = os.path.join(tmp, "profile.json")
+
+    print(f"{'threads':>9}" + "".join(f"{name:>22}" for name in PASSES))
+    baseline = None
+    for threads in [0] + [int(t) for t in args.threads.split(",")]:
+      results = [run(args.firtool, circuit, profile, threads)
+                 for _ in range(args.repeat)]
+      best = {name: min(r[name] for r in results) for name in PASSES}
+      if baseline is None:
+        baseline = best
+      label = "disabled" if threads == 0 else str(threads)
+      row = f"{label:>9}"
+      for name in PASSES:
+        speedup = baseline[name] / best[name] if best[name] else 0
+        row += f"{best[name]:13.3f} s {speedup:5.2f}x"
+      print(row)
+
+
+if __name__ == "__main__":
+  main()
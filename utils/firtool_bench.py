@@ -0,0 +1,49 @@
+##===- utils/firtool_bench.py - Helpers of the firtool benches ---*- py -*-===##
+#
+# Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+# See https://llvm.org/LICENSE.txt for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+##===----------------------------------------------------------------------===##
+#
+# This module holds the parts shared by the bench-*.py scripts: writing a
+# generated circuit, and running firtool while measuring its wall time and
+# peak memory.
+#
+##===----------------------------------------------------------------------===##
+
+import os
+import subprocess
+import sys
+import time
+
+
+def write_circuit(path, num_modules, write_module, write_top):
+  """Write a circuit named Top, made of the modules M0 to M{num_modules - 1}
+  and of a Top module.  `write_module(f, i)` writes the body of the module
+  Mi, and `write_top(f)` the body of Top."""
+  with open(path, "w") as f:
+    f.write("circuit Top :\n")
+    for i in range(num_modules):
+      f.write(f"  module M{i} :\n")
+      write_module(f, i)
+    f.write("  module Top :\n")
+    write_top(f)
+
+
+def run_firtool(args):
+  """Run a command once, exiting if it fails, and return its wall time in
+  seconds and its peak resident memory in MiB."""
+  start = time.perf_counter()
+  process = subprocess.Popen(args)
+  _, status, usage = os.wait4(process.pid, 0)
+  elapsed = time.perf_counter() - start
+  if status != 0:
+    sys.exit(f"firtool failed: {' '.join(args)}")
+  # ru_maxrss is in KiB on Linux.
+  return elapsed, usage.ru_maxrss / 1024
+
+
+def best_of(results):
+  """Return the best wall time and peak memory of several runs."""
+  return min(r[0] for r in results), min(r[1] for r in results)